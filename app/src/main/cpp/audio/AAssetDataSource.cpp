@@ -1,15 +1,17 @@
 //
 // Created by 43975 on 12/24/2021.
 //
+#include <algorithm>
+#include <chrono>
+#include <thread>
 #include "../utils/logging.h"
-#include "oboe/Oboe.h"
 #include "AAssetDataSource.h"
 
 #if !defined(USE_FFMPEG)
 #error USE_FFMPEG should be defined in app.gradle
 #endif
 
-#if USE_FFMPEF==1
+#if USE_FFMPEG==1
     #include "FFMpegExtractor.h"
 #else
     #include "NDKExtractor.h"
@@ -17,14 +19,15 @@
 #endif
 
 
-constexpr int kMaxCompressionRatio{12};
-
 AAssetDataSource* AAssetDataSource::newFromCompressedAsset(AAssetManager &assetManager,
         const char *filename,
-        const AudioProperties targetProperties) {
+        const AudioProperties targetProperties,
+        const SampleFormat storageFormat,
+        DecodeThroughput *throughput) {
 
     // get the asset by filename via AAssetManager
-    AAsset *asset = AAssetManager_open(&assetManager, filename, AASSET_MODE_UNKNOWN);
+    // buffer mode lets the parallel FFmpeg decoder read the whole asset from memory
+    AAsset *asset = AAssetManager_open(&assetManager, filename, AASSET_MODE_BUFFER);
     if (!asset)
     {
         LOGE("Failed to open asset %s",filename);
@@ -34,39 +37,33 @@ AAssetDataSource* AAssetDataSource::newFromCompressedAsset(AAssetManager &assetM
     off_t assetSize = AAsset_getLength(asset);
     LOGD("Opened %s, size %ld",filename,assetSize);
 
-    // Allocate memory to store decompressed audio. We don't know the exact
-    // size of the decoded data until after decoding so we make an assumption about the
-    // maximum compression ratio and the decoded sample format (float for FFmpeg, int16 for NDK)
-
-#if USE_FFMPEG==true
-    const long maximumDataSizeInBytes = kMaxCompressionRatio * assetSize * sizeof(float);
-    auto decodedData = new uint8_t[maximumDataSizeInBytes];
-
-    int64_t bytesDecoded = FFMpegExtractor::decode(asset, decodedData, targetProperties);
-    auto numSamples = bytesDecoded / sizeof(float);
-
-#else
-    const long maximumDataSizeInBytes = kMaxCompressionRatio * assetSize  * sizeof(int16_t);
-    auto decodedData = new uint8_t[maximumDataSizeInBytes];
-
-    int64_t bytesDecoded = NDKExtractor::decode(asset,decodedData,targetProperties);
-    auto numSamples = bytesDecoded / sizeof(int16_t);
-#endif
-
-    // Now we know the exact number of samples we can create a float array to hold the audio data
-    auto outputBuffer  = std::make_unique<float[]>(numSamples);
-
-#if USE_FFMPEF==1
-    memcpy(outputBuffer.get(), decodedData, (size_t)bytesDecoded);
+    // We don't know the size of the decoded data until after decoding, so it is collected in
+    // chunks which are added as needed (float for FFmpeg, the NDK decoder produces int16)
+#if USE_FFMPEG==1
+    PcmBuilder builder(targetProperties.channelCount, SampleFormat::Float, storageFormat);
+    const auto numThreads = static_cast<int32_t>(std::max(1u, std::thread::hardware_concurrency()));
+    const auto decodeStartTime = std::chrono::steady_clock::now();
+    const int64_t bytesDecoded = FFMpegExtractor::decodeParallel(asset, builder, targetProperties, numThreads);
+    if (throughput != nullptr){
+        // the workers decode at the rate of the file, but only the resampled frames come out
+        const double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStartTime).count();
+        const double realTimeFactor = (decodeSeconds > 0) ?
+                builder.getNumFrames() / (double)targetProperties.sampleRate / decodeSeconds : 0;
+        *throughput = DecodeThroughput{builder.getNumFrames(), decodeSeconds, realTimeFactor};
+    }
 #else
-    // The NDK decoder can only decode to int16, we need to convert to floats
-    oboe::convertPcm16ToFloat(reinterpret_cast<int16_t*>(decodedData),outputBuffer.get(),
-            bytesDecoded/sizeof(int16_t));
+    PcmBuilder builder(targetProperties.channelCount, SampleFormat::I16, storageFormat);
+    const int64_t bytesDecoded = NDKExtractor::decode(asset, builder, targetProperties, 0, throughput);
 #endif
-
-    delete [] decodedData;
     AAsset_close(asset);
 
-    return new AAssetDataSource(std::move(outputBuffer), numSamples, targetProperties);
+    // an empty source would end up in the caches and the failure would outlive a restart
+    if (bytesDecoded <= 0 || builder.getNumFrames() == 0){
+        LOGE("Failed to decode %s", filename);
+        PcmChunkPool::getInstance().retire(builder.build());
+        return nullptr;
+    }
 
-}
\ No newline at end of file
+    int64_t numSamples = builder.getNumFrames() * targetProperties.channelCount;
+    return new AAssetDataSource(builder.build(), numSamples, targetProperties);
+}
@@ -5,29 +5,46 @@
 #ifndef OBOE_AUDIO_PLAYER_AASSETDATASOURCE_H
 #define OBOE_AUDIO_PLAYER_AASSETDATASOURCE_H
 
+#include <memory>
+#include "AudioMetrics.h"
 #include "DataSource.h"
+#include "PcmBuilder.h"
 #include <android/asset_manager.h>
 
 class AAssetDataSource : public DataSource{
 
 public:
+    // may run on the audio thread, the chunks are released later on another thread
+    ~AAssetDataSource() { PcmChunkPool::getInstance().retire(std::move(mChunks)); }
+
     int64_t getSize() const override {return mBufferSize;}
     AudioProperties getProperties() const override { return mProperties; }
-    const float* getData() const override { return mBuffer.get(); }
+    SampleFormat getSampleFormat() const override { return mChunks->getSampleFormat(); }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        return mChunks->getFrames(frameIndex, contiguousFrames);
+    }
 
+    /**
+     * @param storageFormat : format the decoded samples are kept in, I16 and Half halve the
+     * memory used compared to Float
+     * @param throughput : filled in with how fast the asset was decoded if not null
+     * @return nullptr if the asset can't be opened or nothing could be decoded from it
+     */
     static AAssetDataSource* newFromCompressedAsset(AAssetManager &assetManager,
             const char* filename,
-            AudioProperties targetProperties);
+            AudioProperties targetProperties,
+            SampleFormat storageFormat = SampleFormat::Float,
+            DecodeThroughput *throughput = nullptr);
 
 private:
-    AAssetDataSource(std::unique_ptr<float[]> data, size_t size, const AudioProperties properties)
-    :mBuffer(std::move(data)),
+    AAssetDataSource(std::unique_ptr<PcmChunks> chunks, int64_t size, const AudioProperties properties)
+    :mChunks(std::move(chunks)),
     mBufferSize(size),
     mProperties(properties){
 
     }
 
-    const std::unique_ptr<float[]> mBuffer;
+    std::unique_ptr<PcmChunks> mChunks;
     const int64_t mBufferSize;
     const AudioProperties mProperties;
 };
@@ -0,0 +1,100 @@
+//
+// Created by 43975 on 1/29/2022.
+//
+#include <cmath>
+#include <cstdlib>
+#include "AudioMetrics.h"
+
+constexpr int64_t kNanosInMicro = 1000;
+constexpr int64_t kMicrosInSecond = 1000000;
+
+// Only one thread writes the counter, so a load and a store are enough and cheaper than an
+// atomic read-modify-write
+static void addRelaxed(std::atomic<int64_t> &counter, int64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static void maxRelaxed(std::atomic<int64_t> &counter, int64_t value) {
+    if (value > counter.load(std::memory_order_relaxed)) counter.store(value, std::memory_order_relaxed);
+}
+
+int32_t AudioMetrics::getHistogramBucket(int64_t durationMicros) {
+    int32_t bucket = 0;
+    while (durationMicros > 1 && bucket < kCallbackHistogramBuckets - 1){
+        durationMicros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void AudioMetrics::recordCallback(int64_t startNanos, int64_t endNanos, int32_t numFrames,
+                                  int32_t sampleRate, int32_t xRunCount) {
+    if (mIsStreamReset.load(std::memory_order_relaxed)){
+        mIsStreamReset.store(false, std::memory_order_relaxed);
+        mLastCallbackStartNanos = -1;
+        mLastXRunCount = 0;
+    }
+
+    const int64_t durationMicros = (endNanos - startNanos) / kNanosInMicro;
+    addRelaxed(mCallbackCount, 1);
+    addRelaxed(mFramesRendered, numFrames);
+    addRelaxed(mCallbackHistogram[getHistogramBucket(durationMicros)], 1);
+    maxRelaxed(mMaxCallbackMicros, durationMicros);
+
+    // Jitter is how far the time since the previous callback is from the duration of the
+    // previous buffer
+    if (mLastCallbackStartNanos >= 0 && sampleRate > 0){
+        const int64_t periodMicros = (startNanos - mLastCallbackStartNanos) / kNanosInMicro;
+        const int64_t expectedMicros = mLastNumFrames * kMicrosInSecond / sampleRate;
+        const int64_t jitterMicros = std::abs(periodMicros - expectedMicros);
+        addRelaxed(mTotalJitterMicros, jitterMicros);
+        addRelaxed(mJitterCount, 1);
+        maxRelaxed(mMaxJitterMicros, jitterMicros);
+    }
+    mLastCallbackStartNanos = startNanos;
+    mLastNumFrames = numFrames;
+
+    if (xRunCount > mLastXRunCount){
+        addRelaxed(mXRunCount, xRunCount - mLastXRunCount);
+        mLastXRunCount = xRunCount;
+    }
+}
+
+void AudioMetrics::recordDecode(int64_t durationMillis, const DecodeThroughput &throughput) {
+    mDecodeCount.fetch_add(1, std::memory_order_relaxed);
+    mTotalDecodeMillis.fetch_add(durationMillis, std::memory_order_relaxed);
+    int64_t maxMillis = mMaxDecodeMillis.load(std::memory_order_relaxed);
+    while (durationMillis > maxMillis &&
+           !mMaxDecodeMillis.compare_exchange_weak(maxMillis, durationMillis, std::memory_order_relaxed)){
+    }
+
+    if (throughput.realTimeFactor <= 0) return;
+    mDecodedAudioMillis.fetch_add(std::llround(throughput.realTimeFactor * throughput.decodeSeconds * 1000),
+                                  std::memory_order_relaxed);
+    const int64_t speedPercent = std::llround(throughput.realTimeFactor * 100);
+    int64_t minPercent = mMinDecodeSpeedPercent.load(std::memory_order_relaxed);
+    while (speedPercent < minPercent &&
+           !mMinDecodeSpeedPercent.compare_exchange_weak(minPercent, speedPercent, std::memory_order_relaxed)){
+    }
+}
+
+AudioMetricsSnapshot AudioMetrics::getSnapshot() const {
+    AudioMetricsSnapshot snapshot{};
+    snapshot.callbackCount = mCallbackCount.load(std::memory_order_relaxed);
+    snapshot.framesRendered = mFramesRendered.load(std::memory_order_relaxed);
+    snapshot.xRunCount = mXRunCount.load(std::memory_order_relaxed);
+    snapshot.maxCallbackMicros = mMaxCallbackMicros.load(std::memory_order_relaxed);
+    const int64_t jitterCount = mJitterCount.load(std::memory_order_relaxed);
+    snapshot.meanJitterMicros = jitterCount > 0 ? mTotalJitterMicros.load(std::memory_order_relaxed) / jitterCount : 0;
+    snapshot.maxJitterMicros = mMaxJitterMicros.load(std::memory_order_relaxed);
+    snapshot.decodeCount = mDecodeCount.load(std::memory_order_relaxed);
+    snapshot.totalDecodeMillis = mTotalDecodeMillis.load(std::memory_order_relaxed);
+    snapshot.maxDecodeMillis = mMaxDecodeMillis.load(std::memory_order_relaxed);
+    snapshot.decodedAudioMillis = mDecodedAudioMillis.load(std::memory_order_relaxed);
+    const int64_t minSpeedPercent = mMinDecodeSpeedPercent.load(std::memory_order_relaxed);
+    snapshot.minDecodeSpeedPercent = (minSpeedPercent == INT64_MAX) ? 0 : minSpeedPercent;
+    for (int32_t i = 0; i < kCallbackHistogramBuckets; ++i){
+        snapshot.callbackHistogram[i] = mCallbackHistogram[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
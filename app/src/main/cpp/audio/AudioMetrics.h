@@ -0,0 +1,100 @@
+//
+// Created by 43975 on 1/29/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_AUDIOMETRICS_H
+#define OBOE_AUDIO_PLAYER_AUDIOMETRICS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Bucket i of the callback duration histogram counts callbacks which took [2^i, 2^(i+1))
+// microseconds, the last bucket everything longer
+constexpr int32_t kCallbackHistogramBuckets = 16;
+
+struct DecodeThroughput{
+    // frames which came out of the decoder, at the sample rate of the file for the NDK decoder
+    // and at the target sample rate for FFmpeg
+    int64_t framesDecoded = 0;
+    double decodeSeconds = 0;
+    // seconds of audio decoded per second
+    double realTimeFactor = 0;
+};
+
+struct AudioMetricsSnapshot{
+    int64_t callbackCount;
+    int64_t framesRendered;
+    int64_t xRunCount;
+    int64_t maxCallbackMicros;
+    int64_t meanJitterMicros;
+    int64_t maxJitterMicros;
+    int64_t decodeCount;
+    int64_t totalDecodeMillis;
+    int64_t maxDecodeMillis;
+    // length of the audio decoded, and the speed of the slowest decode in percent of real time,
+    // 0 until a decode reported its throughput
+    int64_t decodedAudioMillis;
+    int64_t minDecodeSpeedPercent;
+    std::array<int64_t, kCallbackHistogramBuckets> callbackHistogram;
+};
+
+/**
+ * Counters describing how well the audio callback keeps up.
+ *
+ * Callbacks are recorded by the audio thread alone, with relaxed loads and stores so it never
+ * waits or allocates. Decodes may be recorded from any thread. A snapshot can be taken at any
+ * time, the counters in it are each up to date but not necessarily from the same callback.
+ */
+class AudioMetrics{
+public:
+    /**
+     * Called at the end of every audio callback.
+     *
+     * @param startNanos : steady clock time the callback started at
+     * @param endNanos : steady clock time the callback finished at
+     * @param xRunCount : total number of xruns reported by the stream, negative if unknown
+     */
+    void recordCallback(int64_t startNanos, int64_t endNanos, int32_t numFrames, int32_t sampleRate,
+                        int32_t xRunCount);
+
+    /**
+     * @param throughput : how fast the decoder went, left out if it isn't known
+     */
+    void recordDecode(int64_t durationMillis, const DecodeThroughput &throughput = DecodeThroughput{});
+
+    /**
+     * Forget the callback period and xrun count of the previous stream, call when a new one
+     * is opened. The totals are kept.
+     */
+    void resetStream() { mIsStreamReset.store(true, std::memory_order_relaxed); }
+
+    AudioMetricsSnapshot getSnapshot() const;
+
+    static int32_t getHistogramBucket(int64_t durationMicros);
+
+private:
+    // Only the audio thread writes these
+    std::atomic<int64_t> mCallbackCount{0};
+    std::atomic<int64_t> mFramesRendered{0};
+    std::atomic<int64_t> mXRunCount{0};
+    std::atomic<int64_t> mMaxCallbackMicros{0};
+    std::atomic<int64_t> mTotalJitterMicros{0};
+    std::atomic<int64_t> mJitterCount{0};
+    std::atomic<int64_t> mMaxJitterMicros{0};
+    std::array<std::atomic<int64_t>, kCallbackHistogramBuckets> mCallbackHistogram{};
+
+    // Audio thread state, not read by anyone else
+    int64_t mLastCallbackStartNanos = -1;
+    int32_t mLastNumFrames = 0;
+    int32_t mLastXRunCount = 0;
+    std::atomic<bool> mIsStreamReset{false};
+
+    std::atomic<int64_t> mDecodeCount{0};
+    std::atomic<int64_t> mTotalDecodeMillis{0};
+    std::atomic<int64_t> mMaxDecodeMillis{0};
+    std::atomic<int64_t> mDecodedAudioMillis{0};
+    std::atomic<int64_t> mMinDecodeSpeedPercent{INT64_MAX};
+};
+
+#endif //OBOE_AUDIO_PLAYER_AUDIOMETRICS_H
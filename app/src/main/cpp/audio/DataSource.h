@@ -6,6 +6,7 @@
 #define OBOE_AUDIO_PLAYER_DATASOURCE_H
 
 #include "AudioProperties.h"
+#include "SampleFormat.h"
 
 class DataSource{
 public:
@@ -13,7 +14,52 @@ public:
     virtual int64_t getSize() const =0;
 
     virtual AudioProperties getProperties() const =0;
-    virtual const float* getData() const =0;
+
+    /**
+     * @return the format of the samples returned by getFrames()
+     */
+    virtual SampleFormat getSampleFormat() const { return SampleFormat::Float; }
+
+    /**
+     * Decoded audio doesn't have to be stored in one block, so it is read in contiguous runs.
+     *
+     * @param frameIndex : the first frame to read
+     * @param contiguousFrames : set to how many frames can be read from the returned pointer
+     * @return pointer to the interleaved samples of frameIndex, nullptr if it is out of range
+     */
+    virtual const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const =0;
+
+    /**
+     * Streaming sources don't hold the whole recording in memory, so getFrames() can't be used.
+     * They are read sequentially through readFrames() instead.
+     */
+    virtual bool isStreaming() const { return false; }
+
+    /**
+     * Copy up to numFrames of the next frames into targetData. Only used by streaming sources.
+     * Must not block as it is called from the audio callback.
+     *
+     * @return number of frames copied, less than numFrames when nothing more is available yet
+     */
+    virtual int32_t readFrames(float *targetData, int32_t numFrames) { return 0; }
+
+    /**
+     * @return true when a streaming source has nothing left to play.
+     */
+    virtual bool isEndOfStream() const { return true; }
+
+    /**
+     * Continue a streaming source from frameIndex. Doesn't wait for the seek to complete,
+     * readFrames() returns nothing until the audio from the new position has been decoded.
+     *
+     * @return false if the source can't seek
+     */
+    virtual bool seekToFrame(int64_t frameIndex) { return false; }
+
+    /**
+     * Streaming sources loop on their own, other sources are looped by the Player.
+     */
+    virtual void setLooping(bool isLooping) {}
 };
 
 #endif //OBOE_AUDIO_PLAYER_DATASOURCE_H
@@ -14,21 +14,48 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <memory>
-#include <oboe/Definitions.h>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "FFMpegExtractor.h"
+#include "ResamplingSink.h"
 #include "../utils/logging.h"
 
-constexpr int kInternalBufferSize = 1152; // Use MP3 block size. https://wiki.hydrogenaud.io/index.php?title=MP3
+// Size of the reads when the asset can't be mapped, large enough that the read syscalls don't
+// show up next to the decoding
+constexpr int kAssetReadBufferSize = 64 * 1024;
 
-int read(void *opaque, uint8_t *buf, int buf_size) {
+// FFmpeg copies a mapped asset into its AVIO buffer in blocks of this size
+constexpr int kMemoryBufferSize = 32 * 1024;
+
+// Splitting a short asset isn't worth opening another decoder, every segment gets at least this
+// many packets (about 6 seconds of MP3)
+constexpr int32_t kMinPacketsPerSegment = 256;
+
+// Packets decoded before the start of a segment on top of the preroll the stream asks for. This
+// covers the transform overlap with the previous packet and the MP3 bit reservoir, which can reach
+// 511 bytes back into earlier packets and so several of them at the lowest bitrates.
+constexpr int32_t kSegmentOverlapPackets = 8;
+
+// Conversion buffer of the decode loop, enough for the frames of any common codec. Grows on
+// the first frame if a codec outputs more.
+constexpr int32_t kConvertedBufferFrames = 4608;
+
+// The stitched segments are resampled in blocks of this many frames
+constexpr int32_t kResampleBlockFrames = 4096;
+
+static int readAsset(void *opaque, uint8_t *buf, int buf_size) {
 
     auto asset = (AAsset *) opaque;
     int bytesRead = AAsset_read(asset, buf, (size_t)buf_size);
     return bytesRead;
 }
 
-int64_t seek(void *opaque, int64_t offset, int whence){
+static int64_t seekAsset(void *opaque, int64_t offset, int whence){
 
     auto asset = (AAsset*)opaque;
 
@@ -51,9 +78,9 @@ bool FFMpegExtractor::createAVIOContext(AAsset *asset, uint8_t *buffer, uint32_t
             bufferSize, // For optimal decoding speed this should be the protocol block size
             isBufferWriteable,
             asset, // Will be passed to our callback functions as a (void *)
-            read, // Read callback function
+            readAsset, // Read callback function
             nullptr, // Write callback function (not used)
-            seek); // Seek callback function
+            seekAsset); // Seek callback function
 
     if (*avioContext == nullptr){
         LOGE("Failed to create AVIO context");
@@ -67,19 +94,20 @@ bool
 FFMpegExtractor::createAVFormatContext(AVIOContext *avioContext, AVFormatContext **avFormatContext) {
 
     *avFormatContext = avformat_alloc_context();
-    (*avFormatContext)->pb = avioContext;
-
     if (*avFormatContext == nullptr){
         LOGE("Failed to create AVFormatContext");
         return false;
-    } else {
-        return true;
     }
+    (*avFormatContext)->pb = avioContext;
+    return true;
 }
 
-bool FFMpegExtractor::openAVFormatContext(AVFormatContext *avFormatContext) {
+/**
+ * avformat_open_input frees the context and sets it to nullptr when it fails
+ */
+bool FFMpegExtractor::openAVFormatContext(AVFormatContext **avFormatContext) {
 
-    int result = avformat_open_input(&avFormatContext,
+    int result = avformat_open_input(avFormatContext,
                                      "", /* URL is left empty because we're providing our own I/O */
                                      nullptr /* AVInputFormat *fmt */,
                                      nullptr /* AVDictionary **options */
@@ -116,17 +144,87 @@ AVStream *FFMpegExtractor::getBestAudioStream(AVFormatContext *avFormatContext)
     }
 }
 
+/**
+ * @return the position of the packet at the source sample rate, counted from the start of the stream
+ */
+int64_t FFMpegExtractor::getPacketFrame(const AVStream *stream, int64_t timestamp) {
+    const int64_t startTimestamp = (stream->start_time != AV_NOPTS_VALUE) ? stream->start_time : 0;
+    return av_rescale_q(timestamp - startTimestamp, stream->time_base, AVRational{1, stream->codecpar->sample_rate});
+}
+
+/**
+ * Moves the demuxer to the seek point a few packets before frame. If the index doesn't reach
+ * that far yet it is extended first by demuxing on from its end, without decoding.
+ *
+ * @return the point the demuxer is now at or nullptr if seeking failed
+ */
+const SeekPoint *FFMpegExtractor::seekToFrame(AVFormatContext *avFormatContext,
+                                              AVStream *stream,
+                                              SeekIndex &seekIndex,
+                                              int64_t frame) {
+    if (!seekIndex.covers(frame)){
+        const SeekPoint *lastPoint = seekIndex.getLastPoint();
+        if (lastPoint != nullptr && !seekToPoint(avFormatContext, stream, *lastPoint)) return nullptr;
+
+        AVPacket *packet = av_packet_alloc();
+        bool isEndOfInput = true;
+        while (av_read_frame(avFormatContext, packet) == 0){
+            bool isPastFrame = false;
+            if (packet->stream_index == stream->index && packet->pts != AV_NOPTS_VALUE){
+                int64_t packetFrame = getPacketFrame(stream, packet->pts);
+                seekIndex.addPacket(packet->pts, packet->pos, packetFrame);
+                isPastFrame = packetFrame > frame;
+            }
+            av_packet_unref(packet);
+            if (isPastFrame){
+                isEndOfInput = false;
+                break;
+            }
+        }
+        av_packet_free(&packet);
+        if (isEndOfInput) seekIndex.setComplete();
+    }
+
+    const SeekPoint *point = seekIndex.findPointBefore(frame);
+    if (point == nullptr || !seekToPoint(avFormatContext, stream, *point)) return nullptr;
+    return point;
+}
+
+bool FFMpegExtractor::seekToPoint(AVFormatContext *avFormatContext, AVStream *stream, const SeekPoint &point) {
+    // A byte seek lands exactly on the packet, demuxers which can't do that seek by timestamp
+    if (point.bytePosition >= 0 &&
+            av_seek_frame(avFormatContext, stream->index, point.bytePosition, AVSEEK_FLAG_BYTE) >= 0){
+        return true;
+    }
+    int result = av_seek_frame(avFormatContext, stream->index, point.timestamp, AVSEEK_FLAG_BACKWARD);
+    if (result < 0){
+        LOGE("Failed to seek to %" PRId64 ". Error: %s", point.timestamp, av_err2str(result));
+        return false;
+    }
+    return true;
+}
+
 int64_t FFMpegExtractor::decode(
         AAsset *asset,
-        uint8_t *targetData,
-        AudioProperties targetProperties) {
+        PcmSink &sink,
+        AudioProperties targetProperties,
+        SeekIndex *seekIndex,
+        int64_t startFrame) {
 
     LOGI("Decoder: FFMpeg");
 
-    int returnValue = -1; // -1 indicates error
+    int64_t returnValue = -1; // -1 indicates error
+
+    // FFmpeg reads the compressed data straight from memory if the asset can be mapped, else
+    // through AAsset_read in large blocks
+    AssetMapping mapping;
+    MemoryReader reader{nullptr, 0, 0};
+    const bool isMapped = mapAsset(asset, mapping);
+    const int bufferSize = isMapped ? kMemoryBufferSize : kAssetReadBufferSize;
+    if (isMapped) reader = MemoryReader{mapping.data, mapping.size, 0};
 
     // Create a buffer for FFmpeg to use for decoding (freed in the custom deleter below)
-    auto buffer = reinterpret_cast<uint8_t*>(av_malloc(kInternalBufferSize));
+    auto buffer = reinterpret_cast<uint8_t*>(av_malloc(bufferSize));
 
     // Create an AVIOContext with a custom deleter
     std::unique_ptr<AVIOContext, void(*)(AVIOContext *)> ioContext {
@@ -138,26 +236,31 @@ int64_t FFMpegExtractor::decode(
     };
     {
         AVIOContext *tmp = nullptr;
-        if (!createAVIOContext(asset, buffer, kInternalBufferSize, &tmp)){
+        if (isMapped){
+            tmp = avio_alloc_context(buffer, bufferSize, 0, &reader, readMemory, nullptr, seekMemory);
+        } else if (!createAVIOContext(asset, buffer, bufferSize, &tmp)){
+            tmp = nullptr;
+        }
+        if (tmp == nullptr){
             LOGE("Could not create an AVIOContext");
+            av_free(buffer);
             return returnValue;
         }
         ioContext.reset(tmp);
     }
 
-    // Create an AVFormatContext using the avformat_free_context as the deleter function
-    std::unique_ptr<AVFormatContext, decltype(&avformat_free_context)> formatContext {
+    // Only an opened context is owned here, it is closed with avformat_close_input
+    std::unique_ptr<AVFormatContext, void(*)(AVFormatContext *)> formatContext {
             nullptr,
-            &avformat_free_context
+            closeAVFormatContext
     };
     {
         AVFormatContext *tmp;
         if (!createAVFormatContext(ioContext.get(), &tmp)) return returnValue;
+        if (!openAVFormatContext(&tmp)) return returnValue;
         formatContext.reset(tmp);
     }
 
-    if (!openAVFormatContext(formatContext.get())) return returnValue;
-
     if (!getStreamInfo(formatContext.get())) return returnValue;
 
     // Obtain the best audio stream to decode
@@ -179,7 +282,7 @@ int64_t FFMpegExtractor::decode(
     // Create the codec context, specifying the deleter function
     std::unique_ptr<AVCodecContext, void(*)(AVCodecContext *)> codecContext {
             nullptr,
-            [](AVCodecContext *c) { avformat_free_context(&c); }
+            [](AVCodecContext *c) { avcodec_free_context(&c); }
     };
     {
         AVCodecContext *tmp = avcodec_alloc_context3(codec);
@@ -202,107 +305,642 @@ int64_t FFMpegExtractor::decode(
         return returnValue;
     }
 
-    // prepare resampler
+    // swr converts the sample format and channel layout, the sample rate is converted by our
+    // own resampler which is shared with the NDK decoder
     int32_t outChannelLayout = (1 << targetProperties.channelCount) - 1;
     LOGD("Channel layout %d", outChannelLayout);
 
-    SwrContext *swr = swr_alloc();
-    av_opt_set_int(swr, "in_channel_count", stream->codecpar->channels, 0);
-    av_opt_set_int(swr, "out_channel_count", targetProperties.channelCount, 0);
-    av_opt_set_int(swr, "in_channel_layout", stream->codecpar->channel_layout, 0);
-    av_opt_set_int(swr, "out_channel_layout", outChannelLayout, 0);
-    av_opt_set_int(swr, "in_sample_rate", stream->codecpar->sample_rate, 0);
-    av_opt_set_int(swr, "out_sample_rate", targetProperties.sampleRate, 0);
-    av_opt_set_int(swr, "in_sample_fmt", stream->codecpar->format, 0);
-    av_opt_set_sample_fmt(swr, "out_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
-    av_opt_set_int(swr, "force_resampling", 1, 0);
+    std::unique_ptr<SwrContext, void(*)(SwrContext *)> swr{
+            swr_alloc(),
+            [](SwrContext *s) { swr_free(&s); }
+    };
+    av_opt_set_int(swr.get(), "in_channel_count", stream->codecpar->channels, 0);
+    av_opt_set_int(swr.get(), "out_channel_count", targetProperties.channelCount, 0);
+    av_opt_set_int(swr.get(), "in_channel_layout", getChannelLayout(stream->codecpar), 0);
+    av_opt_set_int(swr.get(), "out_channel_layout", outChannelLayout, 0);
+    av_opt_set_int(swr.get(), "in_sample_rate", stream->codecpar->sample_rate, 0);
+    av_opt_set_int(swr.get(), "out_sample_rate", stream->codecpar->sample_rate, 0);
+    av_opt_set_int(swr.get(), "in_sample_fmt", stream->codecpar->format, 0);
+    av_opt_set_sample_fmt(swr.get(), "out_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
 
     // Check that resampler has been inited
-    int result = swr_init(swr);
+    int result = swr_init(swr.get());
     if (result != 0){
         LOGE("swr_init failed. Error: %s", av_err2str(result));
         return returnValue;
     };
-    if (!swr_is_initialized(swr)) {
+    if (!swr_is_initialized(swr.get())) {
         LOGE("swr_is_initialized is false\n");
         return returnValue;
     }
 
-    // Prepare to read data
-    int bytesWritten = 0;
-    AVPacket avPacket; // Stores compressed audio data
-    av_init_packet(&avPacket);
-    AVFrame *decodedFrame = av_frame_alloc(); // Stores raw audio data
+    std::unique_ptr<ResamplingSink> resamplingSink;
+    if (stream->codecpar->sample_rate != targetProperties.sampleRate){
+        resamplingSink.reset(new ResamplingSink(sink, SampleFormat::Float, targetProperties.channelCount,
+                                                stream->codecpar->sample_rate, targetProperties.sampleRate));
+    }
+    PcmSink &convertedSink = resamplingSink ? *resamplingSink : sink;
+
+    // The packet, frame and conversion buffer are reused for the whole stream
+    std::unique_ptr<AVPacket, void(*)(AVPacket *)> packet{
+            av_packet_alloc(),
+            [](AVPacket *p) { av_packet_free(&p); }
+    };
+    std::unique_ptr<AVFrame, void(*)(AVFrame *)> decodedFrame{
+            av_frame_alloc(),
+            [](AVFrame *f) { av_frame_free(&f); }
+    };
+    std::vector<float> converted(kConvertedBufferFrames * targetProperties.channelCount);
+    int64_t bytesWritten = 0;
+    bool keepDecoding = true;
     int bytesPerSample = av_get_bytes_per_sample((AVSampleFormat)stream->codecpar->format);
 
     LOGD("Bytes per sample %d", bytesPerSample);
 
-    LOGD("DECODE START");
+    // Positions from here on are frames at the source sample rate. Everything decoded before
+    // firstFrame is dropped, which after a seek is the pre-roll.
+    int64_t firstFrame = 0;
+    int64_t nextFrame = 0;
+    int64_t firstTimestamp = AV_NOPTS_VALUE;
+    if (startFrame > 0){
+        firstFrame = av_rescale(startFrame, stream->codecpar->sample_rate, targetProperties.sampleRate);
+        const SeekPoint *point = (seekIndex != nullptr) ?
+                seekToFrame(formatContext.get(), stream, *seekIndex, firstFrame) : nullptr;
+        if (point != nullptr){
+            nextFrame = point->frame;
+            firstTimestamp = point->timestamp;
+        } else {
+            LOGW("Can't seek, decoding from the start up to frame %" PRId64, startFrame);
+            av_seek_frame(formatContext.get(), stream->index, 0, AVSEEK_FLAG_BACKWARD);
+        }
+    }
+
+    // input planes of the part of a frame which is kept
+    const bool isPlanar = av_sample_fmt_is_planar((AVSampleFormat)stream->codecpar->format);
+    const int32_t planeCount = isPlanar ? stream->codecpar->channels : 1;
+    const int32_t bytesPerFrame = isPlanar ? bytesPerSample : bytesPerSample * stream->codecpar->channels;
+    std::vector<const uint8_t *> inputPlanes(planeCount);
+
+    // Converts framesToConvert frames of inputPlanes, or flushes swr if there are none, and
+    // hands them to the sink. Only grows the buffer for a frame longer than any before it.
+    auto convert = [&](const uint8_t **input, int32_t framesToConvert){
+        int32_t maxOutputFrames = swr_get_out_samples(swr.get(), framesToConvert);
+        if (maxOutputFrames <= 0) return 0;
+        if (converted.size() < (size_t)maxOutputFrames * targetProperties.channelCount){
+            converted.resize((size_t)maxOutputFrames * targetProperties.channelCount);
+        }
+        auto output = reinterpret_cast<uint8_t *>(converted.data());
+        int frameCount = swr_convert(swr.get(), &output, maxOutputFrames, input, framesToConvert);
+        if (frameCount <= 0) return frameCount;
+
+        int64_t bytesToWrite = frameCount * sizeof(float) * targetProperties.channelCount;
+        keepDecoding = convertedSink.onDecodedData(output, bytesToWrite);
+        bytesWritten += bytesToWrite;
+        return frameCount;
+    };
+
+    // Damaged packets are skipped rather than failing the whole track
+    int32_t skippedPackets = 0;
+
+    // Takes every frame the decoder has ready
+    auto receiveFrames = [&](){
+        while (keepDecoding){
+            result = avcodec_receive_frame(codecContext.get(), decodedFrame.get());
+            if (result == AVERROR(EAGAIN) || result == AVERROR_EOF) return true;
+            if (result == AVERROR_INVALIDDATA){
+                // the decoder dropped a damaged packet, carry on with the next one
+                ++skippedPackets;
+                continue;
+            }
+            if (result != 0){
+                LOGE("avcodec_receive_frame error: %s", av_err2str(result));
+                return false;
+            }
+
+            const int64_t frameStart = nextFrame;
+            nextFrame += decodedFrame->nb_samples;
+            if (nextFrame > firstFrame){
+                const auto framesToSkip = static_cast<int32_t>(std::max<int64_t>(0, firstFrame - frameStart));
+                for (int32_t i = 0; i < planeCount; ++i){
+                    inputPlanes[i] = decodedFrame->extended_data[i] + framesToSkip * bytesPerFrame;
+                }
+                convert(inputPlanes.data(), decodedFrame->nb_samples - framesToSkip);
+            }
+            av_frame_unref(decodedFrame.get());
+        }
+        return true;
+    };
 
-    // While there is more data to read, read it into the avPacket
-    while (av_read_frame(formatContext.get(), &avPacket) == 0){
+    LOGD("DECODE START");
 
-        if (avPacket.stream_index == stream->index && avPacket.size > 0) {
+    // While there is more data to read, read it into the packet
+    bool isEndOfInput = false;
+    while (keepDecoding && !isEndOfInput){
+        if (av_read_frame(formatContext.get(), packet.get()) != 0){
+            // hand over the frames still held by the decoder
+            isEndOfInput = true;
+            avcodec_send_packet(codecContext.get(), nullptr);
+        } else {
+            if (packet->stream_index != stream->index || packet->size <= 0){
+                av_packet_unref(packet.get());
+                continue;
+            }
 
-            // Pass our compressed data into the codec
-            result = avcodec_send_packet(codecContext.get(), &avPacket);
-            if (result != 0) {
-                LOGE("avcodec_send_packet error: %s", av_err2str(result));
-                goto cleanup;
+            if (seekIndex != nullptr && packet->pts != AV_NOPTS_VALUE){
+                seekIndex->addPacket(packet->pts, packet->pos, getPacketFrame(stream, packet->pts));
             }
 
-            // Retrieve our raw data from the codec
-            result = avcodec_receive_frame(codecContext.get(), decodedFrame);
-            if (result == AVERROR(EAGAIN)) {
-                // The codec needs more data before it can decode
-                LOGI("avcodec_receive_frame returned EAGAIN");
-                av_packet_unref(&avPacket);
+            // a seek by timestamp can land a little before the seek point
+            if (firstTimestamp != AV_NOPTS_VALUE && packet->pts != AV_NOPTS_VALUE && packet->pts < firstTimestamp){
+                av_packet_unref(packet.get());
                 continue;
-            } else if (result != 0) {
-                LOGE("avcodec_receive_frame error: %s", av_err2str(result));
-                goto cleanup;
             }
 
-            // DO RESAMPLING
-            auto dst_nb_samples = (int32_t) av_rescale_rnd(
-                    swr_get_delay(swr, decodedFrame->sample_rate) + decodedFrame->nb_samples,
-                    targetProperties.sampleRate,
-                    decodedFrame->sample_rate,
-                    AV_ROUND_UP);
-
-            short *buffer1;
-            av_samples_alloc(
-                    (uint8_t **) &buffer1,
-                    nullptr,
-                    targetProperties.channelCount,
-                    dst_nb_samples,
-                    AV_SAMPLE_FMT_FLT,
-                    0);
-            int frame_count = swr_convert(
-                    swr,
-                    (uint8_t **) &buffer1,
-                    dst_nb_samples,
-                    (const uint8_t **) decodedFrame->data,
-                    decodedFrame->nb_samples);
-
-            int64_t bytesToWrite = frame_count * sizeof(float) * targetProperties.channelCount;
-            memcpy(targetData + bytesWritten, buffer1, (size_t)bytesToWrite);
-            bytesWritten += bytesToWrite;
-            av_freep(&buffer1);
-
-            av_packet_unref(&avPacket);
+            // Pass our compressed data into the codec, every frame is taken out after each packet
+            // so the decoder can't be full
+            result = avcodec_send_packet(codecContext.get(), packet.get());
+            av_packet_unref(packet.get());
+            if (result == AVERROR_INVALIDDATA){
+                ++skippedPackets;
+            } else if (result != 0){
+                LOGE("avcodec_send_packet error: %s", av_err2str(result));
+                return returnValue;
+            }
         }
+
+        if (!receiveFrames()) return returnValue;
+    }
+
+    // swr doesn't hold anything back when the rate stays the same, but flush it in case
+    while (keepDecoding && convert(nullptr, 0) > 0);
+    if (skippedPackets > 0) LOGW("Skipped %d damaged packets", skippedPackets);
+
+    // the whole stream has been demuxed unless the sink stopped us
+    if (keepDecoding && seekIndex != nullptr) seekIndex->setComplete();
+    if (resamplingSink){
+        if (keepDecoding) resamplingSink->finish();
+        bytesWritten = resamplingSink->getBytesWritten();
     }
 
-    av_frame_free(&decodedFrame);
     LOGD("DECODE END");
 
     returnValue = bytesWritten;
-
-    cleanup:
     return returnValue;
 }
 
+/**
+ * Maps the asset if it is stored uncompressed, which is the case for the media files in an APK
+ * and for plain files. Otherwise AAsset_getBuffer inflates it into memory once.
+ *
+ * @return false if the asset can't be brought into memory
+ */
+bool FFMpegExtractor::mapAsset(AAsset *asset, AssetMapping &mapping) {
+    off_t start, length;
+    int fd = AAsset_openFileDescriptor(asset, &start, &length);
+    if (fd >= 0){
+        // mmap needs a page aligned offset, the asset starts somewhere inside the APK
+        const off_t pageSize = sysconf(_SC_PAGESIZE);
+        const off_t mappingStart = start - start % pageSize;
+        const auto mappingSize = static_cast<size_t>(length + start - mappingStart);
+        void *address = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, mappingStart);
+        // the mapping stays valid after the file descriptor is closed
+        close(fd);
+        if (address != MAP_FAILED){
+            // demuxing reads the file in order
+            madvise(address, mappingSize, MADV_SEQUENTIAL);
+            mapping.mapping = address;
+            mapping.mappingSize = mappingSize;
+            mapping.data = static_cast<const uint8_t *>(address) + (start - mappingStart);
+            mapping.size = length;
+            return true;
+        }
+        LOGW("Failed to map the asset");
+    }
+
+    mapping.data = static_cast<const uint8_t *>(AAsset_getBuffer(asset));
+    mapping.size = AAsset_getLength64(asset);
+    return mapping.data != nullptr;
+}
+
+FFMpegExtractor::AssetMapping::~AssetMapping() {
+    if (mapping != nullptr) munmap(mapping, mappingSize);
+}
+
+int FFMpegExtractor::readMemory(void *opaque, uint8_t *buf, int buf_size) {
+
+    auto reader = static_cast<MemoryReader *>(opaque);
+    auto bytesToRead = static_cast<int>(std::min<int64_t>(buf_size, reader->size - reader->position));
+    if (bytesToRead <= 0) return AVERROR_EOF;
+    memcpy(buf, reader->data + reader->position, (size_t)bytesToRead);
+    reader->position += bytesToRead;
+    return bytesToRead;
+}
+
+int64_t FFMpegExtractor::seekMemory(void *opaque, int64_t offset, int whence) {
+
+    auto reader = static_cast<MemoryReader *>(opaque);
+    int64_t position;
+    switch (whence & ~AVSEEK_FORCE){
+        case AVSEEK_SIZE: return reader->size;
+        case SEEK_SET: position = offset; break;
+        case SEEK_CUR: position = reader->position + offset; break;
+        case SEEK_END: position = reader->size + offset; break;
+        default: return -1;
+    }
+    if (position < 0 || position > reader->size) return -1;
+    reader->position = position;
+    return position;
+}
+
+void FFMpegExtractor::freeAVIOContext(AVIOContext *avioContext) {
+    av_free(avioContext->buffer);
+    avio_context_free(&avioContext);
+}
+
+void FFMpegExtractor::closeAVFormatContext(AVFormatContext *avFormatContext) {
+    avformat_close_input(&avFormatContext);
+}
+
+void FFMpegExtractor::freeCodecContext(AVCodecContext *avCodecContext) {
+    avcodec_free_context(&avCodecContext);
+}
+
+int64_t FFMpegExtractor::getChannelLayout(const AVCodecParameters *parameters) {
+    // some containers don't store a layout, assume the default one for the channel count
+    return (parameters->channel_layout != 0) ? (int64_t)parameters->channel_layout
+                                             : av_get_default_channel_layout(parameters->channels);
+}
+
+bool FFMpegExtractor::openMemoryInput(const uint8_t *data, int64_t size, InputContext &input) {
+
+    input.reader = MemoryReader{data, size, 0};
+
+    auto buffer = reinterpret_cast<uint8_t*>(av_malloc(kMemoryBufferSize));
+    AVIOContext *ioContext = avio_alloc_context(buffer, kMemoryBufferSize, 0, &input.reader,
+                                                readMemory, nullptr, seekMemory);
+    if (ioContext == nullptr){
+        LOGE("Failed to create AVIO context");
+        av_free(buffer);
+        return false;
+    }
+    input.ioContext.reset(ioContext);
+
+    AVFormatContext *formatContext = avformat_alloc_context();
+    if (formatContext == nullptr){
+        LOGE("Failed to create AVFormatContext");
+        return false;
+    }
+    formatContext->pb = ioContext;
+
+    // avformat_open_input frees the context when it fails
+    int result = avformat_open_input(&formatContext, "", nullptr, nullptr);
+    if (result != 0){
+        LOGE("Failed to open file. Error code %s", av_err2str(result));
+        return false;
+    }
+    input.formatContext.reset(formatContext);
+
+    if (!getStreamInfo(formatContext)) return false;
+
+    input.stream = getBestAudioStream(formatContext);
+    if (input.stream == nullptr || input.stream->codecpar == nullptr){
+        LOGE("Could not find a suitable audio stream to decode");
+        return false;
+    }
+
+    const AVCodec *codec = avcodec_find_decoder(input.stream->codecpar->codec_id);
+    if (!codec){
+        LOGE("Could not find codec with ID: %d", input.stream->codecpar->codec_id);
+        return false;
+    }
+    input.codecContext.reset(avcodec_alloc_context3(codec));
+    if (!input.codecContext){
+        LOGE("Failed to allocate codec context");
+        return false;
+    }
+    if (avcodec_parameters_to_context(input.codecContext.get(), input.stream->codecpar) < 0){
+        LOGE("Failed to copy codec parameters to codec context");
+        return false;
+    }
+    // frame timestamps are needed to trim the segments
+    input.codecContext->pkt_timebase = input.stream->time_base;
+    if (avcodec_open2(input.codecContext.get(), codec, nullptr) < 0){
+        LOGE("Could not open codec");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reads every packet of the stream without decoding it and collects the timestamps, which is
+ * much faster than decoding. The stream can only be split if every packet has a timestamp and
+ * they are strictly increasing.
+ */
+bool FFMpegExtractor::scanPackets(InputContext &input, std::vector<int64_t> &packetTimestamps) {
+
+    AVPacket *packet = av_packet_alloc();
+    bool isSplittable = true;
+    while (av_read_frame(input.formatContext.get(), packet) == 0){
+        if (packet->stream_index == input.stream->index && packet->size > 0){
+            if (packet->pts == AV_NOPTS_VALUE ||
+                    (!packetTimestamps.empty() && packet->pts <= packetTimestamps.back())){
+                isSplittable = false;
+            }
+            packetTimestamps.push_back(packet->pts);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    return isSplittable;
+}
+
+/**
+ * @return how many packets before its start a segment is decoded from, so the decoder has
+ * converged by the time it reaches the first frame which is kept
+ */
+int32_t FFMpegExtractor::getPrerollPackets(const InputContext &input, const std::vector<int64_t> &packetTimestamps) {
+    // Opus for example needs 80 ms of preroll, which the demuxer reports as seek_preroll, and
+    // decoders with a delay output that many frames late
+    const AVCodecParameters *parameters = input.stream->codecpar;
+    const int64_t prerollFrames = std::max<int64_t>(parameters->seek_preroll, input.codecContext->delay);
+
+    // average length of a packet, the frame size isn't known for every codec
+    const int64_t streamFrames = av_rescale_q(packetTimestamps.back() - packetTimestamps.front(),
+                                              input.stream->time_base, AVRational{1, parameters->sample_rate});
+    const int64_t packetFrames = std::max<int64_t>(1, streamFrames / std::max<int64_t>(1, packetTimestamps.size() - 1));
+    return static_cast<int32_t>((prerollFrames + packetFrames - 1) / packetFrames) + kSegmentOverlapPackets;
+}
+
+/**
+ * Runs on a worker thread. Decodes the frames of the segment into its output at the source
+ * sample rate, converting them to interleaved float.
+ */
+bool FFMpegExtractor::decodeSegment(const uint8_t *data, int64_t size, Segment &segment,
+                                    DecodeProgress &progress) {
+
+    InputContext input;
+    if (!openMemoryInput(data, size, input)) return false;
+
+    AVFormatContext *formatContext = input.formatContext.get();
+    AVCodecContext *codecContext = input.codecContext.get();
+    const AVCodecParameters *parameters = input.stream->codecpar;
+    const int32_t channelCount = parameters->channels;
+    const AVRational frameTimeBase{1, parameters->sample_rate};
+
+    // Only the sample format is converted here, which needs no state between frames
+    std::unique_ptr<SwrContext, void(*)(SwrContext *)> swr{
+            swr_alloc(),
+            [](SwrContext *s) { swr_free(&s); }
+    };
+    const int64_t channelLayout = getChannelLayout(parameters);
+    av_opt_set_int(swr.get(), "in_channel_count", channelCount, 0);
+    av_opt_set_int(swr.get(), "out_channel_count", channelCount, 0);
+    av_opt_set_int(swr.get(), "in_channel_layout", channelLayout, 0);
+    av_opt_set_int(swr.get(), "out_channel_layout", channelLayout, 0);
+    av_opt_set_int(swr.get(), "in_sample_rate", parameters->sample_rate, 0);
+    av_opt_set_int(swr.get(), "out_sample_rate", parameters->sample_rate, 0);
+    av_opt_set_int(swr.get(), "in_sample_fmt", parameters->format, 0);
+    av_opt_set_sample_fmt(swr.get(), "out_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
+    int result = swr_init(swr.get());
+    if (result != 0){
+        LOGE("swr_init failed. Error: %s", av_err2str(result));
+        return false;
+    }
+
+    if (segment.prerollTimestamp != AV_NOPTS_VALUE){
+        result = av_seek_frame(formatContext, input.stream->index, segment.prerollTimestamp,
+                               AVSEEK_FLAG_BACKWARD);
+        if (result < 0){
+            LOGE("Failed to seek to segment. Error: %s", av_err2str(result));
+            return false;
+        }
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    std::vector<float> converted;
+    int64_t nextFrame = 0;
+    bool isEndOfInput = false;
+    bool isSegmentComplete = false;
+    bool isOk = true;
+
+    while (!isSegmentComplete && !progress.isCancelled.load(std::memory_order_relaxed)){
+        if (!isEndOfInput){
+            if (av_read_frame(formatContext, packet) != 0){
+                // drain the frames still held by the decoder
+                isEndOfInput = true;
+                avcodec_send_packet(codecContext, nullptr);
+            } else {
+                // a backward seek can land before the preroll, skip those packets
+                bool isWanted = packet->stream_index == input.stream->index && packet->size > 0 &&
+                        (segment.prerollTimestamp == AV_NOPTS_VALUE || packet->pts >= segment.prerollTimestamp);
+                if (isWanted){
+                    result = avcodec_send_packet(codecContext, packet);
+                    if (result != 0) LOGW("avcodec_send_packet error: %s", av_err2str(result));
+                }
+                av_packet_unref(packet);
+                if (!isWanted) continue;
+            }
+        }
+
+        while (!isSegmentComplete){
+            result = avcodec_receive_frame(codecContext, frame);
+            if (result == AVERROR(EAGAIN)) break;
+            if (result == AVERROR_EOF){
+                isSegmentComplete = true;
+                break;
+            }
+            // a damaged packet is skipped, like the serial decode does
+            if (result == AVERROR_INVALIDDATA) continue;
+            if (result != 0){
+                LOGE("avcodec_receive_frame error: %s", av_err2str(result));
+                isOk = false;
+                isSegmentComplete = true;
+                break;
+            }
+
+            // position of the frame in the stream, counted on from the previous one without a timestamp
+            const int64_t firstFrame = (frame->best_effort_timestamp != AV_NOPTS_VALUE) ?
+                    av_rescale_q(frame->best_effort_timestamp, input.stream->time_base, frameTimeBase) : nextFrame;
+            nextFrame = firstFrame + frame->nb_samples;
+
+            if (firstFrame >= segment.endFrame){
+                isSegmentComplete = true;
+            } else {
+                const int64_t framesToSkip = (segment.startFrame > firstFrame) ? segment.startFrame - firstFrame : 0;
+                const int64_t framesToKeep = std::min(nextFrame, segment.endFrame) - firstFrame - framesToSkip;
+                if (framesToKeep > 0){
+                    converted.resize((size_t)frame->nb_samples * channelCount);
+                    auto convertedData = reinterpret_cast<uint8_t *>(converted.data());
+                    swr_convert(swr.get(), &convertedData, frame->nb_samples,
+                                (const uint8_t **) frame->extended_data, frame->nb_samples);
+                    segment.output->onDecodedData(
+                            reinterpret_cast<const uint8_t *>(&converted[framesToSkip * channelCount]),
+                            framesToKeep * channelCount * sizeof(float));
+                }
+            }
+            av_frame_unref(frame);
+        }
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    return isOk;
+}
+
+/**
+ * Resamples the segments in order into the sink while the workers are still decoding the later
+ * ones, releasing each one once it is done so its chunks can be reused by the sink.
+ *
+ * @return number of bytes handed to the sink or -1 if a segment failed to decode
+ */
+int64_t FFMpegExtractor::resampleSegments(std::vector<Segment> &segments,
+                                          DecodeProgress &progress,
+                                          const AVCodecParameters *sourceParameters,
+                                          PcmSink &sink,
+                                          AudioProperties targetProperties) {
+
+    std::unique_ptr<SwrContext, void(*)(SwrContext *)> swr{
+            swr_alloc(),
+            [](SwrContext *s) { swr_free(&s); }
+    };
+    int32_t outChannelLayout = (1 << targetProperties.channelCount) - 1;
+    av_opt_set_int(swr.get(), "in_channel_count", sourceParameters->channels, 0);
+    av_opt_set_int(swr.get(), "out_channel_count", targetProperties.channelCount, 0);
+    av_opt_set_int(swr.get(), "in_channel_layout", getChannelLayout(sourceParameters), 0);
+    av_opt_set_int(swr.get(), "out_channel_layout", outChannelLayout, 0);
+    av_opt_set_int(swr.get(), "in_sample_rate", sourceParameters->sample_rate, 0);
+    av_opt_set_int(swr.get(), "out_sample_rate", sourceParameters->sample_rate, 0);
+    av_opt_set_sample_fmt(swr.get(), "in_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
+    av_opt_set_sample_fmt(swr.get(), "out_sample_fmt", AV_SAMPLE_FMT_FLT, 0);
+    int result = swr_init(swr.get());
+    if (result != 0){
+        LOGE("swr_init failed. Error: %s", av_err2str(result));
+        return -1;
+    }
+
+    // swr only remixes the channels, the rate is converted by our resampler
+    std::unique_ptr<ResamplingSink> resamplingSink;
+    if (sourceParameters->sample_rate != targetProperties.sampleRate){
+        resamplingSink.reset(new ResamplingSink(sink, SampleFormat::Float, targetProperties.channelCount,
+                                                sourceParameters->sample_rate, targetProperties.sampleRate));
+    }
+    PcmSink &convertedSink = resamplingSink ? *resamplingSink : sink;
+
+    std::vector<float> resampled;
+    int64_t bytesWritten = 0;
+    bool keepDecoding = true;
+
+    // passing no input flushes the samples still buffered by the resampler
+    auto convert = [&](const float *input, int32_t numFrames){
+        int32_t maxOutputFrames = swr_get_out_samples(swr.get(), numFrames);
+        resampled.resize((size_t)std::max(maxOutputFrames, 1) * targetProperties.channelCount);
+        auto output = reinterpret_cast<uint8_t *>(resampled.data());
+        auto inputData = reinterpret_cast<const uint8_t *>(input);
+        int frameCount = swr_convert(swr.get(), &output, maxOutputFrames,
+                                     input ? &inputData : nullptr, numFrames);
+        if (frameCount <= 0) return frameCount;
+
+        int64_t bytesToWrite = frameCount * sizeof(float) * targetProperties.channelCount;
+        keepDecoding = convertedSink.onDecodedData(output, bytesToWrite);
+        bytesWritten += bytesToWrite;
+        return frameCount;
+    };
+
+    for (Segment &segment : segments){
+        {
+            std::unique_lock<std::mutex> lock(progress.lock);
+            progress.segmentFinished.wait(lock, [&segment](){ return segment.isFinished; });
+        }
+        if (!segment.isDecoded) return -1;
+        if (!keepDecoding) break;
+
+        std::unique_ptr<PcmChunks> chunks = segment.output->build();
+        int64_t frameIndex = 0;
+        while (keepDecoding && frameIndex < chunks->getNumFrames()){
+            int64_t contiguousFrames;
+            auto input = static_cast<const float *>(chunks->getFrames(frameIndex, contiguousFrames));
+            auto framesToConvert = static_cast<int32_t>(std::min<int64_t>(contiguousFrames, kResampleBlockFrames));
+            convert(input, framesToConvert);
+            frameIndex += framesToConvert;
+        }
+        segment.output.reset();
+    }
+    while (keepDecoding && convert(nullptr, 0) > 0);
+
+    if (resamplingSink){
+        if (keepDecoding) resamplingSink->finish();
+        bytesWritten = resamplingSink->getBytesWritten();
+    }
+    return bytesWritten;
+}
+
+int64_t FFMpegExtractor::decodeParallel(AAsset *asset,
+                                        PcmSink &sink,
+                                        AudioProperties targetProperties,
+                                        int32_t numThreads) {
+
+    // Every worker needs its own read position, which is easy once the asset is in memory
+    AssetMapping mapping;
+    const bool isMapped = mapAsset(asset, mapping);
+    const uint8_t *data = mapping.data;
+    const int64_t size = mapping.size;
+    if (!isMapped){
+        LOGW("Asset can't be mapped, decoding on one thread");
+        return decode(asset, sink, targetProperties);
+    }
+
+    InputContext input;
+    if (!openMemoryInput(data, size, input)) return -1;
+    printCodecParameters(input.stream->codecpar);
+
+    std::vector<int64_t> packetTimestamps;
+    if (!scanPackets(input, packetTimestamps)) numThreads = 1;
+
+    const auto numPackets = static_cast<int32_t>(packetTimestamps.size());
+    const int32_t numSegments = std::max(1, std::min(numThreads, numPackets / kMinPacketsPerSegment));
+    const int32_t prerollPackets = (numSegments > 1) ? getPrerollPackets(input, packetTimestamps) : 0;
+    const AVRational frameTimeBase{1, input.stream->codecpar->sample_rate};
+    LOGD("Decoding %d packets in %d segments with %d packets of preroll", numPackets, numSegments, prerollPackets);
+
+    // Segments start on packet boundaries, the first and last are open ended
+    std::vector<Segment> segments(numSegments);
+    for (int32_t i = 0; i < numSegments; ++i){
+        Segment &segment = segments[i];
+        if (i == 0){
+            segment.prerollTimestamp = AV_NOPTS_VALUE;
+            segment.startFrame = INT64_MIN;
+        } else {
+            int32_t firstPacket = (int32_t)((int64_t)numPackets * i / numSegments);
+            segment.prerollTimestamp = packetTimestamps[std::max(0, firstPacket - prerollPackets)];
+            segment.startFrame = av_rescale_q(packetTimestamps[firstPacket], input.stream->time_base, frameTimeBase);
+            segments[i - 1].endFrame = segment.startFrame;
+        }
+        segment.endFrame = INT64_MAX;
+        segment.output = std::make_unique<PcmBuilder>(input.stream->codecpar->channels, SampleFormat::Float,
+                                                      SampleFormat::Float);
+    }
+
+    LOGD("DECODE START");
+    DecodeProgress progress;
+    std::vector<std::thread> workers;
+    for (int32_t i = 0; i < numSegments; ++i){
+        workers.emplace_back([data, size, &segments, &progress, i](){
+            bool isDecoded = decodeSegment(data, size, segments[i], progress);
+            std::lock_guard<std::mutex> lock(progress.lock);
+            segments[i].isDecoded = isDecoded;
+            segments[i].isFinished = true;
+            progress.segmentFinished.notify_all();
+        });
+    }
+
+    int64_t bytesWritten = resampleSegments(segments, progress, input.stream->codecpar, sink, targetProperties);
+    progress.isCancelled.store(true, std::memory_order_relaxed);
+    for (std::thread &worker : workers) worker.join();
+    LOGD("DECODE END");
+    return bytesWritten;
+}
+
 void FFMpegExtractor::printCodecParameters(AVCodecParameters *params) {
 
     LOGD("Stream properties");
@@ -24,21 +24,140 @@ extern "C" {
 #include <libavutil/opt.h>
 }
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <android/asset_manager.h>
 #include "AudioProperties.h"
+#include "PcmBuilder.h"
+#include "PcmSink.h"
+#include "SeekIndex.h"
+
+// av_err2str builds its buffer with a C compound literal, which g++ rejects. The array here lives
+// until the end of the full expression, long enough for the log call using the string.
+#undef av_err2str
+#define av_err2str(errnum) av_make_error_string(std::array<char, AV_ERROR_MAX_STRING_SIZE>().data(), \
+                                                AV_ERROR_MAX_STRING_SIZE, errnum)
 
 class FFMpegExtractor {
 public:
-    static int64_t decode(AAsset *asset, uint8_t *targetData, AudioProperties targetProperties);
+    /**
+     * Decode the asset and pass the resampled float samples to the sink block by block.
+     *
+     * @param seekIndex : filled in as the asset is demuxed if not null, and used to jump to
+     * startFrame without demuxing everything before it
+     * @param startFrame : first frame to output, at the target sample rate
+     * @return number of bytes handed to the sink or -1 on error
+     */
+    static int64_t decode(AAsset *asset, PcmSink &sink, AudioProperties targetProperties,
+                          SeekIndex *seekIndex = nullptr, int64_t startFrame = 0);
+
+    /**
+     * Decode the whole asset using up to numThreads threads, blocking until it is done.
+     *
+     * The packets are split into one segment per thread and every segment is decoded by its own
+     * set of FFmpeg contexts. A worker starts early enough before its segment to cover the preroll
+     * of the codec so the decoder has settled by the time it reaches the seam, and the overlap is
+     * trimmed using the timestamps of the decoded frames. Resampling needs continuous state, so the
+     * calling thread resamples the segments in order, each one as soon as it has been decoded, and
+     * frees it again. The output is the same for any number of threads.
+     *
+     * @return number of bytes handed to the sink or -1 on error
+     */
+    static int64_t decodeParallel(AAsset *asset, PcmSink &sink, AudioProperties targetProperties,
+                                  int32_t numThreads);
 
 private:
+    // Reads a compressed asset which is already in memory, so every worker can have its own position
+    struct MemoryReader{
+        const uint8_t *data;
+        int64_t size;
+        int64_t position;
+    };
+
+    // Compressed asset in memory, unmapped again when this goes out of scope
+    struct AssetMapping{
+        const uint8_t *data = nullptr;
+        int64_t size = 0;
+        void *mapping = nullptr;
+        size_t mappingSize = 0;
+
+        AssetMapping() = default;
+        AssetMapping(const AssetMapping &) = delete;
+        AssetMapping &operator=(const AssetMapping &) = delete;
+        ~AssetMapping();
+    };
+
+    // Everything needed to demux and decode the best audio stream of an input, freed in reverse order
+    struct InputContext{
+        MemoryReader reader{nullptr, 0, 0};
+        std::unique_ptr<AVIOContext, void(*)(AVIOContext *)> ioContext{nullptr, freeAVIOContext};
+        std::unique_ptr<AVFormatContext, void(*)(AVFormatContext *)> formatContext{nullptr, closeAVFormatContext};
+        std::unique_ptr<AVCodecContext, void(*)(AVCodecContext *)> codecContext{nullptr, freeCodecContext};
+        AVStream *stream = nullptr;
+    };
+
+    // Range of the stream decoded by one worker, in frames at the source sample rate
+    struct Segment{
+        int64_t prerollTimestamp;
+        int64_t startFrame;
+        int64_t endFrame;
+        std::unique_ptr<PcmBuilder> output;
+        bool isDecoded = false;
+        bool isFinished = false;
+    };
+
+    // Hands the segments from the workers to the thread which resamples them
+    struct DecodeProgress{
+        std::mutex lock;
+        std::condition_variable segmentFinished;
+        // set when the output isn't wanted anymore, the workers stop early
+        std::atomic<bool> isCancelled{false};
+    };
+
+    static int64_t getPacketFrame(const AVStream *stream, int64_t timestamp);
+
+    static const SeekPoint *seekToFrame(AVFormatContext *avFormatContext, AVStream *stream,
+                                        SeekIndex &seekIndex, int64_t frame);
+
+    static bool seekToPoint(AVFormatContext *avFormatContext, AVStream *stream, const SeekPoint &point);
+
+    static bool mapAsset(AAsset *asset, AssetMapping &mapping);
+
+    static int readMemory(void *opaque, uint8_t *buf, int buf_size);
+
+    static int64_t seekMemory(void *opaque, int64_t offset, int whence);
+
+    static bool openMemoryInput(const uint8_t *data, int64_t size, InputContext &input);
+
+    static bool scanPackets(InputContext &input, std::vector<int64_t> &packetTimestamps);
+
+    static int32_t getPrerollPackets(const InputContext &input, const std::vector<int64_t> &packetTimestamps);
+
+    static bool decodeSegment(const uint8_t *data, int64_t size, Segment &segment, DecodeProgress &progress);
+
+    static int64_t resampleSegments(std::vector<Segment> &segments, DecodeProgress &progress,
+                                    const AVCodecParameters *sourceParameters,
+                                    PcmSink &sink, AudioProperties targetProperties);
+
+    static int64_t getChannelLayout(const AVCodecParameters *parameters);
+
+    static void freeAVIOContext(AVIOContext *avioContext);
+
+    static void closeAVFormatContext(AVFormatContext *avFormatContext);
+
+    static void freeCodecContext(AVCodecContext *avCodecContext);
+
     static bool createAVIOContext(AAsset *asset, uint8_t *buffer, uint32_t bufferSize,
                                   AVIOContext **avioContext);
 
     static bool createAVFormatContext(AVIOContext *avioContext, AVFormatContext **avFormatContext);
 
-    static bool openAVFormatContext(AVFormatContext *avFormatContext);
+    static bool openAVFormatContext(AVFormatContext **avFormatContext);
 
     static int32_t cleanup(AVIOContext *avioContext, AVFormatContext *avFormatContext);
 
@@ -0,0 +1,104 @@
+//
+// Created by 43975 on 2/4/2022.
+//
+#include <algorithm>
+#include "LatencyTuner.h"
+
+constexpr int64_t kMillisInSecond = 1000;
+
+void LatencyTuner::resetStream(int32_t framesPerBurst, int32_t bufferCapacityFrames, int32_t sampleRate) {
+    mFramesPerBurst.store(framesPerBurst, std::memory_order_relaxed);
+    mBufferCapacityFrames.store(bufferCapacityFrames, std::memory_order_relaxed);
+    mSampleRate.store(sampleRate, std::memory_order_relaxed);
+    mIsStreamReset.store(true, std::memory_order_release);
+}
+
+int32_t LatencyTuner::getMinBufferSize() const {
+    return std::min(kMinLatencyBursts * mFramesPerBurst.load(std::memory_order_relaxed),
+                    mBufferCapacityFrames.load(std::memory_order_relaxed));
+}
+
+int32_t LatencyTuner::update(int32_t numFrames, int32_t xRunCount) {
+    if (mIsStreamReset.load(std::memory_order_acquire)){
+        mIsStreamReset.store(false, std::memory_order_relaxed);
+        mBufferSizeFrames.store(0, std::memory_order_relaxed);
+        mStreamFrame = 0;
+        mLastXRunCount = 0;
+        mFramesSinceChange = 0;
+        mShrinkDelayFrames = kInitialShrinkDelayMillis * mSampleRate.load(std::memory_order_relaxed) / kMillisInSecond;
+        mWasLastChangeShrink = false;
+    }
+    mStreamFrame += numFrames;
+
+    const int32_t framesPerBurst = mFramesPerBurst.load(std::memory_order_relaxed);
+    if (xRunCount < 0 || framesPerBurst <= 0) return 0;
+
+    // the first callback of the stream sets the smallest buffer
+    const int32_t bufferSize = mBufferSizeFrames.load(std::memory_order_relaxed);
+    if (bufferSize == 0){
+        mLastXRunCount = xRunCount;
+        return getMinBufferSize();
+    }
+
+    if (xRunCount > mLastXRunCount){
+        mLastXRunCount = xRunCount;
+        // the last shrink went too far, wait longer before trying again
+        if (mWasLastChangeShrink && mFramesSinceChange < mShrinkDelayFrames){
+            const int64_t maxShrinkDelayFrames = kMaxShrinkDelayMillis * mSampleRate.load(std::memory_order_relaxed) / kMillisInSecond;
+            mShrinkDelayFrames = std::min(2 * mShrinkDelayFrames, maxShrinkDelayFrames);
+        }
+        mFramesSinceChange = 0;
+        const int32_t bufferCapacity = mBufferCapacityFrames.load(std::memory_order_relaxed);
+        return (bufferSize < bufferCapacity) ? std::min(bufferSize + framesPerBurst, bufferCapacity) : 0;
+    }
+
+    mFramesSinceChange += numFrames;
+    if (mFramesSinceChange >= mShrinkDelayFrames && bufferSize > getMinBufferSize()){
+        mFramesSinceChange = 0;
+        return std::max(bufferSize - framesPerBurst, getMinBufferSize());
+    }
+    return 0;
+}
+
+void LatencyTuner::setBufferSize(int32_t bufferSizeFrames) {
+    const int32_t previousSize = mBufferSizeFrames.load(std::memory_order_relaxed);
+    if (bufferSizeFrames == previousSize) return;
+
+    mBufferSizeFrames.store(bufferSizeFrames, std::memory_order_relaxed);
+    mFramesSinceChange = 0;
+    if (previousSize > 0){
+        mWasLastChangeShrink = bufferSizeFrames < previousSize;
+        std::atomic<int64_t> &counter = mWasLastChangeShrink ? mShrinkCount : mGrowCount;
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // the newest change is the one dropped when nobody has read the history for a while, the
+    // audio thread can't take the oldest back out of the ring buffer
+    LatencyChange change{mStreamFrame, bufferSizeFrames, mLastXRunCount};
+    if (mChanges.write(&change, 1) == 0){
+        mDroppedChangeCount.store(mDroppedChangeCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+LatencySnapshot LatencyTuner::getSnapshot() const {
+    LatencySnapshot snapshot{};
+    snapshot.bufferSizeFrames = mBufferSizeFrames.load(std::memory_order_relaxed);
+    snapshot.framesPerBurst = mFramesPerBurst.load(std::memory_order_relaxed);
+    snapshot.bufferCapacityFrames = mBufferCapacityFrames.load(std::memory_order_relaxed);
+    const int32_t sampleRate = mSampleRate.load(std::memory_order_relaxed);
+    snapshot.latencyMillis = (sampleRate > 0) ? snapshot.bufferSizeFrames * 1000.0 / sampleRate : 0;
+    snapshot.growCount = mGrowCount.load(std::memory_order_relaxed);
+    snapshot.shrinkCount = mShrinkCount.load(std::memory_order_relaxed);
+    snapshot.droppedChangeCount = mDroppedChangeCount.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+std::vector<LatencyChange> LatencyTuner::getHistory() {
+    std::lock_guard<std::mutex> lock(mHistoryLock);
+    LatencyChange change;
+    while (mChanges.read(&change, 1) == 1){
+        mHistory.push_back(change);
+        if (mHistory.size() > kLatencyHistorySize) mHistory.pop_front();
+    }
+    return std::vector<LatencyChange>(mHistory.begin(), mHistory.end());
+}
@@ -0,0 +1,117 @@
+//
+// Created by 43975 on 2/4/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_LATENCYTUNER_H
+#define OBOE_AUDIO_PLAYER_LATENCYTUNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "SpscRingBuffer.h"
+
+// The buffer starts at and shrinks back to this many bursts, the callback fills one while the
+// device plays the other
+constexpr int32_t kMinLatencyBursts = 2;
+
+// How long the stream has to play without an xrun before the buffer shrinks by a burst. Every
+// time a shrink is followed by an xrun within this time it doubles, up to the maximum.
+constexpr int64_t kInitialShrinkDelayMillis = 10000;
+constexpr int64_t kMaxShrinkDelayMillis = 160000;
+
+// Buffer size changes kept for getHistory()
+constexpr int32_t kLatencyHistorySize = 64;
+
+struct LatencyChange{
+    // frames the stream had played when the buffer was resized
+    int64_t streamFrame;
+    int32_t bufferSizeFrames;
+    // xruns of the stream so far
+    int32_t xRunCount;
+};
+
+struct LatencySnapshot{
+    int32_t bufferSizeFrames;
+    int32_t framesPerBurst;
+    int32_t bufferCapacityFrames;
+    // latency the buffer adds, 0 until the first callback
+    double latencyMillis;
+    int64_t growCount;
+    int64_t shrinkCount;
+    // changes left out of the history because it wasn't read in time
+    int64_t droppedChangeCount;
+};
+
+/**
+ * Finds the smallest buffer size the device plays without glitches. The buffer starts at
+ * kMinLatencyBursts bursts, grows by a burst on every callback which sees new xruns and shrinks
+ * by a burst again after the stream has played for a while without any.
+ *
+ * update() and setBufferSize() are called by the audio thread alone and don't wait or allocate.
+ * The snapshot and history may be read from any thread.
+ */
+class LatencyTuner{
+public:
+    LatencyTuner():mChanges(kLatencyHistorySize){}
+
+    /**
+     * Start over for a newly opened stream, before it is started.
+     */
+    void resetStream(int32_t framesPerBurst, int32_t bufferCapacityFrames, int32_t sampleRate);
+
+    /**
+     * Called on every audio callback.
+     *
+     * @param xRunCount : total number of xruns reported by the stream, negative if unknown in
+     *                    which case the buffer is left alone
+     * @return the buffer size to set on the stream, 0 to keep the current one
+     */
+    int32_t update(int32_t numFrames, int32_t xRunCount);
+
+    /**
+     * The buffer size the stream ended up with after update() asked for a new one.
+     */
+    void setBufferSize(int32_t bufferSizeFrames);
+
+    LatencySnapshot getSnapshot() const;
+
+    /**
+     * Changes are handed over when the history is read. Once kLatencyHistorySize of them are
+     * waiting, further ones are dropped and counted in the snapshot, so the history has a gap
+     * after the changes it got.
+     *
+     * @return the last kLatencyHistorySize buffer size changes which were handed over, oldest first
+     */
+    std::vector<LatencyChange> getHistory();
+
+private:
+    int32_t getMinBufferSize() const;
+
+    // Set by resetStream(), picked up by the audio thread on its next update()
+    std::atomic<int32_t> mFramesPerBurst{0};
+    std::atomic<int32_t> mBufferCapacityFrames{0};
+    std::atomic<int32_t> mSampleRate{0};
+    std::atomic<bool> mIsStreamReset{false};
+
+    // Only the audio thread writes these
+    std::atomic<int32_t> mBufferSizeFrames{0};
+    std::atomic<int64_t> mGrowCount{0};
+    std::atomic<int64_t> mShrinkCount{0};
+    std::atomic<int64_t> mDroppedChangeCount{0};
+
+    // Audio thread state, not read by anyone else
+    int64_t mStreamFrame = 0;
+    int32_t mLastXRunCount = 0;
+    int64_t mFramesSinceChange = 0;
+    int64_t mShrinkDelayFrames = 0;
+    bool mWasLastChangeShrink = false;
+
+    // The audio thread hands the changes over to whichever thread reads the history
+    SpscRingBuffer<LatencyChange> mChanges;
+    std::mutex mHistoryLock;
+    std::deque<LatencyChange> mHistory;
+};
+
+#endif //OBOE_AUDIO_PLAYER_LATENCYTUNER_H
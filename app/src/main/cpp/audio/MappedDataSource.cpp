@@ -0,0 +1,73 @@
+//
+// Created by 43975 on 1/21/2022.
+//
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../utils/logging.h"
+#include "MappedDataSource.h"
+#include "PcmCache.h"
+
+MappedDataSource* MappedDataSource::newFromFile(const char *path,
+        const AudioProperties expectedProperties,
+        const SampleFormat expectedFormat,
+        uint64_t expectedSourceHash) {
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(PcmCacheHeader)){
+        close(fd);
+        return nullptr;
+    }
+
+    auto mappingSize = static_cast<size_t>(fileStat.st_size);
+    // MAP_POPULATE reads the whole file in and maps it here on the loading thread, so the audio
+    // callback doesn't take a page fault which waits for flash on the first touch of a page
+    void *mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    // the mapping stays valid after the file descriptor is closed
+    close(fd);
+    if (mapping == MAP_FAILED){
+        LOGE("Failed to map %s", path);
+        return nullptr;
+    }
+
+    auto header = static_cast<const PcmCacheHeader *>(mapping);
+    int64_t numSamples = header->frameCount * header->channelCount;
+    bool isValid = header->magic == kPcmCacheMagic &&
+            header->version == kPcmCacheVersion &&
+            header->sampleRate == expectedProperties.sampleRate &&
+            header->channelCount == expectedProperties.channelCount &&
+            header->sampleFormat == static_cast<int32_t>(expectedFormat) &&
+            header->sourceHash == expectedSourceHash &&
+            header->frameCount >= 0 &&
+            sizeof(PcmCacheHeader) + numSamples * getBytesPerSample(expectedFormat) == mappingSize;
+    if (!isValid){
+        LOGW("Ignoring stale or invalid cache file %s", path);
+        munmap(mapping, mappingSize);
+        return nullptr;
+    }
+
+    // Keep the pages around, MADV_SEQUENTIAL would let the kernel drop the ones played already
+    // which a looping track comes back to
+    madvise(mapping, mappingSize, MADV_WILLNEED);
+
+    auto samples = static_cast<const uint8_t *>(mapping) + sizeof(PcmCacheHeader);
+    return new MappedDataSource(mapping, mappingSize, samples, numSamples, expectedProperties, expectedFormat);
+}
+
+const void *MappedDataSource::getFrames(int64_t frameIndex, int64_t &contiguousFrames) const {
+    const int64_t numFrames = mNumSamples / mProperties.channelCount;
+    if (frameIndex < 0 || frameIndex >= numFrames){
+        contiguousFrames = 0;
+        return nullptr;
+    }
+    contiguousFrames = numFrames - frameIndex;
+    return &mSamples[frameIndex * mProperties.channelCount * getBytesPerSample(mFormat)];
+}
+
+MappedDataSource::~MappedDataSource() {
+    munmap(mMapping, mMappingSize);
+}
@@ -0,0 +1,55 @@
+//
+// Created by 43975 on 1/21/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_MAPPEDDATASOURCE_H
+#define OBOE_AUDIO_PLAYER_MAPPEDDATASOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "DataSource.h"
+
+/**
+ * Data source backed by a decoded PCM file from the PcmCache which is memory mapped instead
+ * of being read, so no decoding and no copy onto the heap is needed. The samples are paged in
+ * when the file is mapped, on the thread which loads it, not as they are played.
+ */
+class MappedDataSource : public DataSource{
+
+public:
+    ~MappedDataSource();
+
+    int64_t getSize() const override {return mNumSamples;}
+    AudioProperties getProperties() const override { return mProperties; }
+    SampleFormat getSampleFormat() const override { return mFormat; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override;
+
+    /**
+     * @return nullptr if the file is missing, invalid or doesn't match the expected
+     * properties and source hash.
+     */
+    static MappedDataSource* newFromFile(const char *path,
+            AudioProperties expectedProperties,
+            SampleFormat expectedFormat,
+            uint64_t expectedSourceHash);
+
+private:
+    MappedDataSource(void *mapping, size_t mappingSize, const uint8_t *samples, int64_t numSamples,
+            const AudioProperties properties, SampleFormat format)
+    :mMapping(mapping),
+    mMappingSize(mappingSize),
+    mSamples(samples),
+    mNumSamples(numSamples),
+    mProperties(properties),
+    mFormat(format){
+    }
+
+    void *const mMapping;
+    const size_t mMappingSize;
+    const uint8_t *const mSamples;
+    const int64_t mNumSamples;
+    const AudioProperties mProperties;
+    const SampleFormat mFormat;
+};
+
+#endif //OBOE_AUDIO_PLAYER_MAPPEDDATASOURCE_H
@@ -0,0 +1,131 @@
+//
+// Created by 43975 on 1/18/2022.
+//
+#include <algorithm>
+#include <cmath>
+#include "Mixer.h"
+#include "../utils/logging.h"
+#include "../dsp/SampleKernels.h"
+
+constexpr int32_t kMaxPendingCommands = 64;
+
+// A stolen voice is faded out over this many frames to avoid a click
+constexpr int32_t kStealFadeFrames = 64;
+
+Mixer::Mixer(int32_t channelCount)
+:mChannelCount(channelCount),
+mCommands(kMaxPendingCommands),
+mVoiceBuffer(std::make_unique<float[]>(kMixerBlockFrames * channelCount)){
+}
+
+int32_t Mixer::addSound(std::shared_ptr<DataSource> source) {
+    if (source == nullptr) return -1;
+
+    int32_t soundId = mSoundCount.load(std::memory_order_relaxed);
+    if (soundId >= kMaxMixerSounds){
+        LOGE("Mixer can't hold more than %d sounds", kMaxMixerSounds);
+        return -1;
+    }
+    if (source->isStreaming() || source->getProperties().channelCount != mChannelCount){
+        LOGE("Mixer sounds must be fully decoded and have %d channels", mChannelCount);
+        return -1;
+    }
+
+    mSounds[soundId] = std::move(source);
+    // publish the new slot to the audio thread
+    mSoundCount.store(soundId + 1, std::memory_order_release);
+    return soundId;
+}
+
+bool Mixer::playSound(int32_t soundId, float gain, float pan) {
+    if (soundId < 0 || soundId >= mSoundCount.load(std::memory_order_relaxed)) return false;
+
+    Command command{Command::Type::Play, soundId, gain, std::min(std::max(pan, -1.0f), 1.0f)};
+    return mCommands.write(&command, 1) == 1;
+}
+
+bool Mixer::stopAll() {
+    Command command{Command::Type::StopAll, -1, 0, 0};
+    return mCommands.write(&command, 1) == 1;
+}
+
+void Mixer::renderAudio(float *targetData, int32_t numFrames) {
+    processCommands(targetData, numFrames);
+
+    for (int32_t framesMixed = 0; framesMixed < numFrames; framesMixed += kMixerBlockFrames){
+        int32_t framesToMix = std::min(numFrames - framesMixed, kMixerBlockFrames);
+        float *target = &targetData[framesMixed * mChannelCount];
+
+        for (Voice &voice : mVoices){
+            if (!voice.isActive) continue;
+            mixVoice(voice, target, framesToMix);
+            if (!voice.player.isPlaying()) voice.isActive = false;
+        }
+    }
+
+    int32_t activeVoices = 0;
+    for (const Voice &voice : mVoices){
+        if (voice.isActive) ++activeVoices;
+    }
+    mActiveVoiceCount.store(activeVoices, std::memory_order_relaxed);
+}
+
+void Mixer::processCommands(float *targetData, int32_t numFrames) {
+    const int32_t soundCount = mSoundCount.load(std::memory_order_acquire);
+    Command command;
+    while (mCommands.read(&command, 1) == 1){
+        if (command.type == Command::Type::StopAll){
+            for (Voice &voice : mVoices) voice.isActive = false;
+            continue;
+        }
+        if (command.soundId >= soundCount) continue;
+
+        Voice &voice = findFreeVoice(targetData, numFrames);
+
+        // equal power panning
+        const float angle = (command.pan + 1.0f) * static_cast<float>(M_PI) / 4.0f;
+        voice.gain = command.gain;
+        voice.leftGain = command.gain * cosf(angle);
+        voice.rightGain = command.gain * sinf(angle);
+        voice.startOrder = mNextStartOrder++;
+        voice.isActive = true;
+
+        // The voice only borrows the source from the sound table, so no reference count is
+        // touched here and the audio thread never frees a source
+        voice.player.setSource(mSounds[command.soundId].get());
+        voice.player.setLooping(false);
+        voice.player.setPlaying(true);
+    }
+}
+
+/**
+ * @return an idle voice, or the oldest one after fading it out into targetData.
+ */
+Mixer::Voice &Mixer::findFreeVoice(float *targetData, int32_t numFrames) {
+    Voice *oldest = &mVoices[0];
+    for (Voice &voice : mVoices){
+        if (!voice.isActive) return voice;
+        if (voice.startOrder < oldest->startOrder) oldest = &voice;
+    }
+
+    const int32_t fadeFrames = std::min(numFrames, kStealFadeFrames);
+    oldest->player.renderAudio(mVoiceBuffer.get(), fadeFrames);
+    getSampleKernels().applyGainRamp(mVoiceBuffer.get(), fadeFrames, mChannelCount, 1.0f, 0.0f);
+    mixVoiceBuffer(*oldest, targetData, fadeFrames);
+    oldest->isActive = false;
+    return *oldest;
+}
+
+void Mixer::mixVoice(Voice &voice, float *targetData, int32_t numFrames) {
+    voice.player.renderAudio(mVoiceBuffer.get(), numFrames);
+    mixVoiceBuffer(voice, targetData, numFrames);
+}
+
+void Mixer::mixVoiceBuffer(const Voice &voice, float *targetData, int32_t numFrames) {
+    if (mChannelCount == 2){
+        getSampleKernels().mixStereo(mVoiceBuffer.get(), targetData, numFrames, voice.leftGain, voice.rightGain);
+    }else{
+        // panning only applies to stereo output
+        for (int i = 0; i < numFrames * mChannelCount; ++i) targetData[i] += mVoiceBuffer[i] * voice.gain;
+    }
+}
@@ -0,0 +1,100 @@
+//
+// Created by 43975 on 1/18/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_MIXER_H
+#define OBOE_AUDIO_PLAYER_MIXER_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include "DataSource.h"
+#include "Player.h"
+#include "SpscRingBuffer.h"
+
+constexpr int32_t kMaxMixerVoices = 32;
+constexpr int32_t kMaxMixerSounds = 64;
+
+// Voices are rendered in blocks of at most this many frames
+constexpr int32_t kMixerBlockFrames = 256;
+
+/**
+ * Plays many short sounds at once on top of whatever is already in the output buffer.
+ *
+ * Sounds are registered once with addSound() and triggered with playSound(). Every trigger
+ * takes one voice from a fixed pool, each voice is a Player with its own gain and pan. When all
+ * voices are busy the oldest one is faded out and reused.
+ *
+ * addSound(), playSound() and stopAll() must be called from one control thread. They only pass
+ * commands to the audio thread through a wait-free queue, so renderAudio() never blocks and
+ * never allocates. Mixing cost grows linearly with the number of active voices.
+ */
+class Mixer{
+public:
+    explicit Mixer(int32_t channelCount);
+
+    /**
+     * Register a sound so it can be played. The mixer keeps a reference to the source for as
+     * long as it lives, so sources are never released on the audio thread.
+     *
+     * @return the sound id to pass to playSound() or -1 if the sound can't be added
+     */
+    int32_t addSound(std::shared_ptr<DataSource> source);
+
+    /**
+     * @param gain : linear gain of the voice
+     * @param pan : -1 is fully left, 0 is centre, 1 is fully right
+     * @return false if the sound id is invalid or too many commands are pending
+     */
+    bool playSound(int32_t soundId, float gain, float pan);
+    bool stopAll();
+
+    int32_t getActiveVoiceCount() const { return mActiveVoiceCount.load(std::memory_order_relaxed); }
+
+    /**
+     * Adds all active voices to targetData. Called from the audio thread.
+     */
+    void renderAudio(float *targetData, int32_t numFrames);
+
+private:
+    struct Voice{
+        Player player{nullptr};
+        float gain = 0;
+        float leftGain = 0;
+        float rightGain = 0;
+        uint64_t startOrder = 0;
+        bool isActive = false;
+    };
+
+    struct Command{
+        enum class Type{
+            Play,
+            StopAll
+        };
+        Type type;
+        int32_t soundId;
+        float gain;
+        float pan;
+    };
+
+    void processCommands(float *targetData, int32_t numFrames);
+    Voice &findFreeVoice(float *targetData, int32_t numFrames);
+    void mixVoice(Voice &voice, float *targetData, int32_t numFrames);
+    void mixVoiceBuffer(const Voice &voice, float *targetData, int32_t numFrames);
+
+    const int32_t mChannelCount;
+
+    std::array<std::shared_ptr<DataSource>, kMaxMixerSounds> mSounds;
+    std::atomic<int32_t> mSoundCount{0};
+
+    SpscRingBuffer<Command> mCommands;
+
+    // Only touched by the audio thread
+    std::array<Voice, kMaxMixerVoices> mVoices;
+    const std::unique_ptr<float[]> mVoiceBuffer;
+    uint64_t mNextStartOrder = 0;
+
+    std::atomic<int32_t> mActiveVoiceCount{0};
+};
+
+#endif //OBOE_AUDIO_PLAYER_MIXER_H
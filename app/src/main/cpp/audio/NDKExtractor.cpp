@@ -2,23 +2,109 @@
 // Created by 43975 on 12/24/2021.
 //
 #include <sys/types.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cinttypes>
 #include <cstring>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <media/NdkMediaCodec.h>
 #include <media/NdkMediaExtractor.h>
 #include "../utils/logging.h"
 #include "NDKExtractor.h"
+#include "ResamplingSink.h"
+
+constexpr int64_t kMicrosecondsInSecond = 1000000;
+
+// How far before the seek target decoding starts
+constexpr int64_t kSeekPrerollMicros = 100000;
+
+// Frames the encoder added at the start and end of the stream, taken from the LAME/iTunSMPB
+// headers by the extractor. Same as AMEDIAFORMAT_KEY_ENCODER_DELAY/PADDING, which need API 29.
+constexpr const char *kEncoderDelayKey = "encoder-delay";
+constexpr const char *kEncoderPaddingKey = "encoder-padding";
+
+/**
+ * Hands the data to the sink except for the last paddingBytes seen so far, which are held back
+ * until more data arrives. Whatever is still held back when the stream ends is the padding.
+ *
+ * @return false if the sink stopped the decoding
+ */
+static bool writeHoldingBack(PcmSink &sink, std::vector<uint8_t> &heldBack, size_t paddingBytes,
+                             const uint8_t *data, size_t size, int64_t &bytesWritten) {
+    size_t bytesToWrite = std::max<int64_t>(0, static_cast<int64_t>(heldBack.size() + size - paddingBytes));
+
+    size_t heldBytesToWrite = std::min(heldBack.size(), bytesToWrite);
+    if (heldBytesToWrite > 0){
+        if (!sink.onDecodedData(heldBack.data(), heldBytesToWrite)) return false;
+        heldBack.erase(heldBack.begin(), heldBack.begin() + heldBytesToWrite);
+    }
+
+    size_t dataBytesToWrite = bytesToWrite - heldBytesToWrite;
+    if (dataBytesToWrite > 0 && !sink.onDecodedData(data, dataBytesToWrite)) return false;
+    heldBack.insert(heldBack.end(), data + dataBytesToWrite, data + size);
+
+    bytesWritten += bytesToWrite;
+    return true;
+}
+
+/**
+ * Extraction stage, runs on its own thread. Moves the compressed samples into the input buffers
+ * of the codec until the end of the track, then queues the end of stream.
+ *
+ * @return false if the codec failed
+ */
+static bool feedCodec(AMediaExtractor *extractor, AMediaCodec *codec, const std::atomic<bool> &isStopped) {
+    while (!isStopped.load(std::memory_order_relaxed)){
+        // Blocks until the codec has a free input buffer
+        ssize_t inputIndex = AMediaCodec_dequeueInputBuffer(codec, kCodecTimeoutMicros);
+        if (inputIndex < 0){
+            if (inputIndex != AMEDIACODEC_INFO_TRY_AGAIN_LATER){
+                LOGE("Codec.dequeueInputBuffer error %zd", inputIndex);
+                return false;
+            }
+            continue;
+        }
+
+        size_t inputSize;
+        uint8_t *inputBuffer = AMediaCodec_getInputBuffer(codec, inputIndex, &inputSize);
+        ssize_t sampleSize = AMediaExtractor_readSampleData(extractor, inputBuffer, inputSize);
+        auto presentationTimeUs = AMediaExtractor_getSampleTime(extractor);
+
+        if (sampleSize > 0){
+            // enqueue the encoded data
+            AMediaCodec_queueInputBuffer(codec, inputIndex, 0, sampleSize, presentationTimeUs, 0);
+            AMediaExtractor_advance(extractor);
+        } else {
+            LOGD("End of extractor data stream");
+            // We have to tell the codec that we have reached the end of the stream
+            AMediaCodec_queueInputBuffer(codec, inputIndex, 0, 0, std::max<int64_t>(0, presentationTimeUs),
+                                         AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+            return true;
+        }
+    }
+    return true;
+}
 
 /**
  * Decoding the audio via NDKMediaCodec, see we have used media/NdkMediaExtractor.h header file.
  *
  * @param asset : asset pointing to the music file we are going to decode
- * @param targetData : decoded data will be stored in the targetData
+ * @param sink : receives the decoded int16 data block by block, decoding stops when it returns false
  * @param targetProperties : contains information of target data
- * @return
+ * @param startFrame : first frame to hand to the sink at the target sample rate, the extractor seeks
+ *                     to the sync sample before it
+ * @param throughput : filled in with the decoding speed if not null
+ * @return number of bytes handed to the sink
  */
 
-int32_t NDKExtractor::decode(AAsset *asset, uint8_t *targetData, AudioProperties targetProperties) {
+int64_t NDKExtractor::decode(AAsset *asset, PcmSink &sink, AudioProperties targetProperties,
+                             int64_t startFrame, DecodeThroughput *throughput) {
     LOGD("Using NDK decoder");
+    const auto decodeStartTime = std::chrono::steady_clock::now();
 
     // open asset as file descriptor
     off_t start, length;
@@ -30,23 +116,26 @@ int32_t NDKExtractor::decode(AAsset *asset, uint8_t *targetData, AudioProperties
                                                               static_cast<off64_t>(length));
     if (amresult != AMEDIA_OK){
         LOGE("Error setting extractor data source, err %d", amresult);
+        AMediaExtractor_delete(extractor);
+        close(fd);
         return 0;
     }
 
     // Specify our desired output format by creating it from our source
     AMediaFormat *format = AMediaExtractor_getTrackFormat(extractor,0);
+    auto cleanup = [&](){
+        AMediaFormat_delete(format);
+        AMediaExtractor_delete(extractor);
+        close(fd);
+    };
 
     int32_t sampleRate;
     if (AMediaFormat_getInt32(format,AMEDIAFORMAT_KEY_SAMPLE_RATE, &sampleRate)){
         LOGD("Source sample rate %d",sampleRate);
-        if (sampleRate!=targetProperties.sampleRate){
-            LOGE("Input (%d) and output (%d) sample rate does not match. "
-                 "NDK decoder does not support resampling.", sampleRate, targetProperties.sampleRate);
-            return 0;
-        }
     }
     else{
         LOGE("Failed to get sample rate");
+        cleanup();
         return 0;
     }
 
@@ -60,6 +149,7 @@ int32_t NDKExtractor::decode(AAsset *asset, uint8_t *targetData, AudioProperties
         }
     }else{
         LOGE("failed to get channel count");
+        cleanup();
         return 0;
     }
 
@@ -72,109 +162,123 @@ int32_t NDKExtractor::decode(AAsset *asset, uint8_t *targetData, AudioProperties
     }
     else{
         LOGE("Failed to get mime type");
+        cleanup();
         return 0;
     }
 
     // Obtain correct decoder
-    AMediaCodec *codec = nullptr;
     AMediaExtractor_selectTrack(extractor, 0);
-    codec = AMediaCodec_createDecoderByType(mimeType);
+    AMediaCodec *codec = AMediaCodec_createDecoderByType(mimeType);
+    if (codec == nullptr){
+        LOGE("No decoder for %s", mimeType);
+        cleanup();
+        return 0;
+    }
     AMediaCodec_configure(codec,format, nullptr, nullptr, 0);
     AMediaCodec_start(codec);
 
+    // MediaCodec doesn't remove the encoder delay and padding, unlike FFmpeg, so it is done here
+    int32_t encoderDelay = 0;
+    int32_t encoderPadding = 0;
+    AMediaFormat_getInt32(format, kEncoderDelayKey, &encoderDelay);
+    AMediaFormat_getInt32(format, kEncoderPaddingKey, &encoderPadding);
+    LOGD("Encoder delay %d, padding %d", encoderDelay, encoderPadding);
 
-    // Decode
-    bool isExtracting = true;
-    bool isDecoding  = true;
-    int32_t bytesWritten=0;
-
-    while (isExtracting || isDecoding){
-        if (isExtracting){
-            // Obtain the index of the next available input buffer
-            ssize_t inputIndex = AMediaCodec_dequeueInputBuffer(codec,2000);
-            //LOGV("Got input buffer %d", inputIndex);
-
-            // The inputIndex acts as a status if its negative
-            if (inputIndex<0){
-                if (inputIndex == AMEDIACODEC_INFO_TRY_AGAIN_LATER){
-                    // LOGV("Codec.dequeueInputBuffer try again later");
-                } else{
-                    LOGE("Codec.dequeueInputBuffer unknown error status");
-                }
-            }else{
-                // Obtain actual buffer and read the encoded data into it
-                size_t inputSize;
-                uint8_t *inputBuffer = AMediaCodec_getInputBuffer(codec,inputIndex,&inputSize);
-                //LOGV("Sample size is: %d", inputSize);
-
-                ssize_t sampleSize = AMediaExtractor_readSampleData(extractor,inputBuffer,inputSize);
-                auto presentationTimeUs = AMediaExtractor_getSampleTime(extractor);
-
-                if (sampleSize>0){
-                    // enqueue the encoded data
-                    AMediaCodec_queueInputBuffer(codec, inputIndex, 0, sampleSize, presentationTimeUs, 0);
-                    AMediaExtractor_advance(extractor);
-                }
-                else{
-                    LOGD("End of extractor data stream");
-                    isExtracting = false;
-
-                    // We have to tell the codec that we have reached the end of the stream
-                    AMediaCodec_queueInputBuffer(codec,inputIndex,0,0,
-                            presentationTimeUs,AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
-                }
-            }
-        }
+    // MediaCodec decodes at the rate of the file, anything else goes through the resampler
+    std::unique_ptr<ResamplingSink> resamplingSink;
+    if (sampleRate != targetProperties.sampleRate){
+        LOGD("Resampling from %d to %d", sampleRate, targetProperties.sampleRate);
+        resamplingSink.reset(new ResamplingSink(sink, SampleFormat::I16, channelCount,
+                                                sampleRate, targetProperties.sampleRate));
+        startFrame = startFrame * sampleRate / targetProperties.sampleRate;
+    }
+    PcmSink &decodedSink = resamplingSink ? *resamplingSink : sink;
+
+    const int32_t bytesPerFrame = channelCount * sizeof(int16_t);
+    const int64_t firstFrame = startFrame + encoderDelay;
+    const size_t paddingBytes = encoderPadding * bytesPerFrame;
+    std::vector<uint8_t> heldBack;
+    heldBack.reserve(paddingBytes);
+
+    // Seek a little early so the codec has settled by the time it reaches startFrame
+    if (startFrame > 0){
+        int64_t startTimeUs = firstFrame * kMicrosecondsInSecond / sampleRate;
+        AMediaExtractor_seekTo(extractor, std::max<int64_t>(0, startTimeUs - kSeekPrerollMicros),
+                               AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC);
+    }
+
+    // The extractor feeds the codec on another thread, this one drains it
+    std::atomic<bool> isStopped{false};
+    std::atomic<bool> hasFeederFailed{false};
+    std::thread feeder([&](){
+        if (!feedCodec(extractor, codec, isStopped)) hasFeederFailed.store(true);
+    });
 
-        if (isDecoding){
-            // Dequeue the decoded data
-            AMediaCodecBufferInfo info;
-            ssize_t outputIndex = AMediaCodec_dequeueOutputBuffer(codec,&info,0);
-
-            if (outputIndex>0){
-                // check whether this is set earlier
-                if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM){
-                    LOGD("Reached end of decoding stream");
-                    isDecoding=false;
-                }
-
-                // Valid index, acquire buffer
-                size_t outputSize;
-                uint8_t *outputBuffer = AMediaCodec_getOutputBuffer(codec,outputIndex,&outputSize);
-
-                /*LOGV("Got output buffer index %d, buffer size: %d, info size: %d writing to pcm index %d",
-                     outputIndex,
-                     outputSize,
-                     info.size,
-                     m_writeIndex);*/
-
-                // copy the data out of the buffer
-                memcpy(targetData+bytesWritten,outputBuffer,info.size);
-                bytesWritten+=info.size;
-                AMediaCodec_releaseOutputBuffer(codec,outputIndex, false);
+    int64_t bytesWritten=0;
+    int64_t framesDecoded=0;
+    bool isStoppedBySink = false;
+    bool isDecoding = true;
+
+    while (isDecoding){
+        // Blocks until the codec has decoded something
+        AMediaCodecBufferInfo info;
+        ssize_t outputIndex = AMediaCodec_dequeueOutputBuffer(codec, &info, kCodecTimeoutMicros);
+
+        if (outputIndex >= 0){
+            if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM){
+                LOGD("Reached end of decoding stream");
+                isDecoding=false;
             }
-            else{
-                // The outputIndex doubles as a status return if its value is < 0
-                switch (outputIndex) {
-                    case AMEDIACODEC_INFO_TRY_AGAIN_LATER:
-                        LOGD("dequeueOutputBuffer: try again later");
-                        break;
-                    case AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED:
-                        LOGD("dequeueOutputBuffer: output buffers changed");
-                        break;
-                    case AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED:
-                        LOGD("dequeueOutpurBuffer: output outputFormat changed");
-                        break;
-                }
+
+            size_t outputSize;
+            uint8_t *outputBuffer = AMediaCodec_getOutputBuffer(codec, outputIndex, &outputSize);
+            framesDecoded += info.size / bytesPerFrame;
+
+            // drop the encoder delay and whatever lies before startFrame
+            int64_t bufferFrame = info.presentationTimeUs * sampleRate / kMicrosecondsInSecond;
+            int32_t skippedBytes = static_cast<int32_t>(std::min<int64_t>(info.size,
+                    std::max<int64_t>(0, firstFrame - bufferFrame) * bytesPerFrame));
+
+            // hand the data over to the sink, keeping back what may turn out to be padding
+            bool keepDecoding = writeHoldingBack(decodedSink, heldBack, paddingBytes,
+                    outputBuffer + info.offset + skippedBytes, info.size - skippedBytes, bytesWritten);
+            AMediaCodec_releaseOutputBuffer(codec, outputIndex, false);
+
+            if (!keepDecoding){
+                LOGD("Sink stopped the decoding");
+                isStoppedBySink=true;
+                isDecoding=false;
             }
+        } else if (outputIndex == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED){
+            LOGD("dequeueOutputBuffer: output format changed");
+        } else if (outputIndex == AMEDIACODEC_INFO_TRY_AGAIN_LATER){
+            // nothing more is coming without input
+            if (hasFeederFailed.load()) isDecoding=false;
+        } else if (outputIndex != AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED){
+            LOGE("Codec.dequeueOutputBuffer error %zd", outputIndex);
+            isDecoding=false;
         }
     }
 
+    // the feeder notices within one timeout
+    isStopped.store(true, std::memory_order_relaxed);
+    feeder.join();
+
+    // the last output of the resampler, unless the sink stopped early
+    if (resamplingSink){
+        if (!isStoppedBySink) resamplingSink->finish();
+        bytesWritten = resamplingSink->getBytesWritten();
+    }
+
+    const double decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decodeStartTime).count();
+    const double realTimeFactor = (decodeSeconds > 0) ? framesDecoded / (double)sampleRate / decodeSeconds : 0;
+    LOGD("Decoded %" PRId64 " frames in %.1f ms, %.1fx real time", framesDecoded, decodeSeconds * 1000, realTimeFactor);
+    if (throughput != nullptr) *throughput = DecodeThroughput{framesDecoded, decodeSeconds, realTimeFactor};
+
     // Clean up
-    AMediaFormat_delete(format);
+    AMediaCodec_stop(codec);
     AMediaCodec_delete(codec);
-    AMediaExtractor_delete(extractor);
+    cleanup();
 
     return bytesWritten;
-
 }
@@ -6,15 +6,29 @@
 #define OBOE_AUDIO_PLAYER_NDKEXTRACTOR_H
 
 #include <cstdint>
+#include "AudioMetrics.h"
 #include "AudioProperties.h"
+#include "PcmSink.h"
 #include "android/asset_manager.h"
 
+// How long a stage of the decoder blocks waiting for a codec buffer before it checks whether
+// the other stage has stopped
+constexpr int64_t kCodecTimeoutMicros = 10000;
+
 /**
- * NDK Media Decoder
+ * NDK Media Decoder, files at another sample rate than the target are resampled with Resampler.
+ *
+ * The extractor feeds the codec on a thread of its own while the calling thread takes the
+ * decoded buffers out and hands them to the sink, so demuxing and decoding overlap. Both stages
+ * block on the codec rather than poll it.
  */
 class NDKExtractor{
 public:
-    static int32_t decode(AAsset *asset, uint8_t *targetData, AudioProperties targetProperties);
+    /**
+     * @param throughput : filled in with how fast the asset was decoded if not null
+     */
+    static int64_t decode(AAsset *asset, PcmSink &sink, AudioProperties targetProperties,
+                          int64_t startFrame = 0, DecodeThroughput *throughput = nullptr);
 };
 
 #endif //OBOE_AUDIO_PLAYER_NDKEXTRACTOR_H
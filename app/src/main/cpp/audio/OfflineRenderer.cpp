@@ -0,0 +1,41 @@
+//
+// Created by 43975 on 1/31/2022.
+//
+#include <algorithm>
+#include <chrono>
+#include "OfflineRenderer.h"
+
+OfflineRenderer::OfflineRenderer(AudioProperties properties, int32_t blockFrames)
+:mProperties(properties),
+mBlockFrames(blockFrames),
+mBuffer(std::make_unique<float[]>(blockFrames * properties.channelCount)){
+}
+
+OfflineRenderResult OfflineRenderer::render(const RenderCallback &callback, int64_t numFrames, PcmSink &sink) {
+    return renderBlocks([&callback](void *audioData, int32_t numFrames){
+        callback(static_cast<float *>(audioData), numFrames);
+    }, sizeof(float), numFrames, sink);
+}
+
+OfflineRenderResult OfflineRenderer::renderBlocks(const BlockCallback &callback, int32_t bytesPerSample,
+                                                  int64_t numFrames, PcmSink &sink) {
+    const auto startTime = std::chrono::steady_clock::now();
+
+    int64_t framesRendered = 0;
+    while (framesRendered < numFrames){
+        auto blockFrames = static_cast<int32_t>(std::min<int64_t>(mBlockFrames, numFrames - framesRendered));
+        callback(mBuffer.get(), blockFrames);
+        framesRendered += blockFrames;
+
+        const int64_t numBytes = static_cast<int64_t>(blockFrames) * mProperties.channelCount * bytesPerSample;
+        if (!sink.onDecodedData(reinterpret_cast<const uint8_t *>(mBuffer.get()), numBytes)) break;
+    }
+
+    const double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    const double audioSeconds = static_cast<double>(framesRendered) / mProperties.sampleRate;
+    return OfflineRenderResult{
+            framesRendered,
+            renderSeconds,
+            renderSeconds > 0 ? audioSeconds / renderSeconds : 0
+    };
+}
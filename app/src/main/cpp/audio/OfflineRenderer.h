@@ -0,0 +1,71 @@
+//
+// Created by 43975 on 1/31/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_OFFLINERENDERER_H
+#define OBOE_AUDIO_PLAYER_OFFLINERENDERER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "AudioProperties.h"
+#include "PcmSink.h"
+#include "RenderGraph.h"
+
+// Frames rendered per call of the render callback, much more than a device buffer since
+// nobody is waiting for the result
+constexpr int32_t kOfflineRenderBlockFrames = 4096;
+
+/**
+ * Renders the same way the audio callback does, i.e. it fills a float buffer, such as
+ * Player::renderAudio followed by Mixer::renderAudio.
+ */
+using RenderCallback = std::function<void(float *audioData, int32_t numFrames)>;
+
+struct OfflineRenderResult{
+    int64_t framesRendered;
+    double renderSeconds;
+
+    // seconds of audio rendered per second of wall time
+    double realTimeFactor;
+};
+
+/**
+ * Drives a render callback or a RenderGraph without a device, as fast as the CPU allows, and
+ * hands the output to a sink such as a WavWriter or a PcmBuilder. Used to check the output of
+ * the engine and to measure its throughput off the device.
+ */
+class OfflineRenderer{
+public:
+    OfflineRenderer(AudioProperties properties, int32_t blockFrames = kOfflineRenderBlockFrames);
+
+    /**
+     * Renders numFrames, stopping early if the sink returns false.
+     */
+    OfflineRenderResult render(const RenderCallback &callback, int64_t numFrames, PcmSink &sink);
+
+    /**
+     * Renders numFrames of the graph as Sample, which is what a stream of that sample type plays,
+     * stopping early if the sink returns false. The graph must have been prepared for the
+     * sample rate of the renderer.
+     */
+    template <typename Sample>
+    OfflineRenderResult render(RenderGraph &graph, int64_t numFrames, PcmSink &sink) {
+        static_assert(sizeof(Sample) <= sizeof(float), "the buffer holds blocks of float");
+        return renderBlocks([&graph](void *audioData, int32_t numFrames){
+            graph.render(static_cast<Sample *>(audioData), numFrames);
+        }, sizeof(Sample), numFrames, sink);
+    }
+
+private:
+    using BlockCallback = std::function<void(void *audioData, int32_t numFrames)>;
+
+    OfflineRenderResult renderBlocks(const BlockCallback &callback, int32_t bytesPerSample,
+                                     int64_t numFrames, PcmSink &sink);
+
+    const AudioProperties mProperties;
+    const int32_t mBlockFrames;
+    std::unique_ptr<float[]> mBuffer;
+};
+
+#endif //OBOE_AUDIO_PLAYER_OFFLINERENDERER_H
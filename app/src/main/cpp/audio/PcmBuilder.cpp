@@ -0,0 +1,148 @@
+//
+// Created by 43975 on 1/23/2022.
+//
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include "PcmBuilder.h"
+#include "../dsp/SampleKernels.h"
+#include "../utils/logging.h"
+
+// Upper bound on the memory kept by the pool when nothing is loaded (2MB)
+constexpr size_t kMaxPooledChunks = 8;
+
+constexpr int32_t kConversionBufferSamples = 1024;
+
+PcmChunkPool &PcmChunkPool::getInstance() {
+    static PcmChunkPool pool;
+    return pool;
+}
+
+std::unique_ptr<uint8_t[]> PcmChunkPool::acquire() {
+    collectRetired();
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (!mFreeChunks.empty()){
+            std::unique_ptr<uint8_t[]> chunk = std::move(mFreeChunks.back());
+            mFreeChunks.pop_back();
+            return chunk;
+        }
+    }
+    return std::make_unique<uint8_t[]>(kPcmChunkBytes);
+}
+
+void PcmChunkPool::release(std::unique_ptr<uint8_t[]> chunk) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mFreeChunks.size() < kMaxPooledChunks) mFreeChunks.push_back(std::move(chunk));
+}
+
+void PcmChunkPool::retire(std::unique_ptr<PcmChunks> chunks) {
+    if (chunks == nullptr) return;
+    PcmChunks *retired = chunks.release();
+    PcmChunks *head = mRetired.load(std::memory_order_relaxed);
+    do {
+        retired->mNextRetired = head;
+    } while (!mRetired.compare_exchange_weak(head, retired, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void PcmChunkPool::collectRetired() {
+    PcmChunks *retired = mRetired.exchange(nullptr, std::memory_order_acquire);
+    while (retired != nullptr){
+        PcmChunks *next = retired->mNextRetired;
+        // the destructor hands the chunks back to the pool
+        delete retired;
+        retired = next;
+    }
+}
+
+PcmChunks::PcmChunks(std::vector<std::unique_ptr<uint8_t[]>> chunks, int32_t channelCount, SampleFormat format,
+        int64_t numFrames)
+:mChunks(std::move(chunks)),
+mChannelCount(channelCount),
+mFormat(format),
+mBytesPerFrame(channelCount * getBytesPerSample(format)),
+mFramesPerChunk(kPcmChunkBytes / mBytesPerFrame),
+mNumFrames(numFrames){
+}
+
+PcmChunks::~PcmChunks() {
+    for (auto &chunk : mChunks) PcmChunkPool::getInstance().release(std::move(chunk));
+}
+
+const void *PcmChunks::getFrames(int64_t frameIndex, int64_t &contiguousFrames) const {
+    if (frameIndex < 0 || frameIndex >= mNumFrames){
+        contiguousFrames = 0;
+        return nullptr;
+    }
+    const int64_t chunkIndex = frameIndex / mFramesPerChunk;
+    const int64_t frameInChunk = frameIndex % mFramesPerChunk;
+    contiguousFrames = std::min(mFramesPerChunk - frameInChunk, mNumFrames - frameIndex);
+    return &mChunks[chunkIndex][frameInChunk * mBytesPerFrame];
+}
+
+PcmBuilder::PcmBuilder(int32_t channelCount, SampleFormat inputFormat, SampleFormat storageFormat)
+:mChannelCount(channelCount),
+mInputFormat(inputFormat),
+mStorageFormat(storageFormat),
+mSamplesPerChunk(kPcmChunkBytes / getBytesPerSample(storageFormat) / channelCount * channelCount){
+
+    if (inputFormat == SampleFormat::I16 && storageFormat == SampleFormat::Half){
+        mConversionBuffer = std::make_unique<float[]>(kConversionBufferSamples);
+    }
+}
+
+bool PcmBuilder::onDecodedData(const uint8_t *data, int64_t numBytes) {
+    const int32_t inputBytesPerSample = getBytesPerSample(mInputFormat);
+    const int32_t storageBytesPerSample = getBytesPerSample(mStorageFormat);
+    int64_t samplesLeft = numBytes / inputBytesPerSample;
+
+    while (samplesLeft > 0){
+        if (mChunks.empty() || mSamplesInLastChunk == mSamplesPerChunk){
+            mChunks.push_back(PcmChunkPool::getInstance().acquire());
+            mSamplesInLastChunk = 0;
+        }
+
+        auto samplesToCopy = static_cast<int32_t>(std::min<int64_t>(samplesLeft,
+                mSamplesPerChunk - mSamplesInLastChunk));
+        convertSamples(data, &mChunks.back()[mSamplesInLastChunk * storageBytesPerSample], samplesToCopy);
+
+        data += samplesToCopy * inputBytesPerSample;
+        samplesLeft -= samplesToCopy;
+        mSamplesInLastChunk += samplesToCopy;
+        mNumSamples += samplesToCopy;
+    }
+    return true;
+}
+
+void PcmBuilder::convertSamples(const uint8_t *source, uint8_t *destination, int32_t numSamples) {
+    const SampleKernels &kernels = getSampleKernels();
+    auto floatSource = reinterpret_cast<const float *>(source);
+    auto i16Source = reinterpret_cast<const int16_t *>(source);
+
+    if (mInputFormat == mStorageFormat){
+        memcpy(destination, source, numSamples * getBytesPerSample(mStorageFormat));
+    }else if (mStorageFormat == SampleFormat::Float){
+        kernels.convertI16ToFloat(i16Source, reinterpret_cast<float *>(destination), numSamples);
+    }else if (mStorageFormat == SampleFormat::I16){
+        kernels.convertFloatToI16(floatSource, reinterpret_cast<int16_t *>(destination), numSamples);
+    }else if (mInputFormat == SampleFormat::Float){
+        kernels.convertFloatToHalf(floatSource, reinterpret_cast<uint16_t *>(destination), numSamples);
+    }else{
+        auto halfDestination = reinterpret_cast<uint16_t *>(destination);
+        for (int32_t i = 0; i < numSamples; i += kConversionBufferSamples){
+            int32_t samplesToConvert = std::min(numSamples - i, kConversionBufferSamples);
+            kernels.convertI16ToFloat(i16Source + i, mConversionBuffer.get(), samplesToConvert);
+            kernels.convertFloatToHalf(mConversionBuffer.get(), halfDestination + i, samplesToConvert);
+        }
+    }
+}
+
+std::unique_ptr<PcmChunks> PcmBuilder::build() {
+    auto chunks = std::make_unique<PcmChunks>(std::move(mChunks), mChannelCount, mStorageFormat,
+            getNumFrames());
+    mChunks.clear();
+    mSamplesInLastChunk = 0;
+    mNumSamples = 0;
+    LOGD("Built %" PRId64 " frames of PCM", chunks->getNumFrames());
+    return chunks;
+}
@@ -0,0 +1,124 @@
+//
+// Created by 43975 on 1/23/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_PCMBUILDER_H
+#define OBOE_AUDIO_PLAYER_PCMBUILDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "PcmSink.h"
+#include "SampleFormat.h"
+
+// Decoded audio is stored in chunks of this size
+constexpr int32_t kPcmChunkBytes = 256 * 1024;
+
+class PcmChunks;
+
+/**
+ * Keeps a few released chunks around so that loading one sound after another reuses the
+ * same memory instead of going back to the allocator every time.
+ *
+ * Data sources don't release their chunks themselves, as the last reference to a source may
+ * be dropped on the audio thread. They retire them instead, which never blocks, and the chunks
+ * are released by the next acquire() or collectRetired() on another thread.
+ */
+class PcmChunkPool{
+public:
+    static PcmChunkPool &getInstance();
+
+    std::unique_ptr<uint8_t[]> acquire();
+    void release(std::unique_ptr<uint8_t[]> chunk);
+
+    /**
+     * Lock free, may be called on the audio thread.
+     */
+    void retire(std::unique_ptr<PcmChunks> chunks);
+
+    /**
+     * Releases everything retired so far, must not be called on the audio thread.
+     */
+    void collectRetired();
+
+private:
+    std::mutex mLock;
+    std::vector<std::unique_ptr<uint8_t[]>> mFreeChunks;
+    // stack of retired chunks, linked through PcmChunks::mNextRetired
+    std::atomic<PcmChunks *> mRetired{nullptr};
+};
+
+/**
+ * Decoded, interleaved samples split into fixed size chunks. Every chunk holds a whole number
+ * of frames so a frame is never split between two chunks. The chunks go back to the pool when
+ * this is destroyed, which takes the lock of the pool, so hand it to PcmChunkPool::retire()
+ * where it might be destroyed on the audio thread.
+ */
+class PcmChunks{
+public:
+    PcmChunks(std::vector<std::unique_ptr<uint8_t[]>> chunks, int32_t channelCount, SampleFormat format,
+            int64_t numFrames);
+    ~PcmChunks();
+
+    int64_t getNumFrames() const { return mNumFrames; }
+    SampleFormat getSampleFormat() const { return mFormat; }
+
+    /**
+     * @param contiguousFrames : set to how many frames can be read from the returned pointer
+     * @return pointer to the samples of frameIndex, in the sample format of the chunks
+     */
+    const void *getFrames(int64_t frameIndex, int64_t &contiguousFrames) const;
+
+private:
+    friend class PcmChunkPool;
+
+    std::vector<std::unique_ptr<uint8_t[]>> mChunks;
+    PcmChunks *mNextRetired = nullptr;
+    const int32_t mChannelCount;
+    const SampleFormat mFormat;
+    const int32_t mBytesPerFrame;
+    const int32_t mFramesPerChunk;
+    const int64_t mNumFrames;
+};
+
+/**
+ * Sink which collects everything the extractor decodes into chunks taken from the pool,
+ * growing one chunk at a time. Nothing has to be known about the length of the recording
+ * up front and the result is handed over to the data source without another copy.
+ */
+class PcmBuilder : public PcmSink{
+public:
+    /**
+     * @param inputFormat : what the extractor produces, Float or I16
+     * @param storageFormat : what the samples are converted to as they are stored
+     */
+    PcmBuilder(int32_t channelCount, SampleFormat inputFormat, SampleFormat storageFormat);
+
+    bool onDecodedData(const uint8_t *data, int64_t numBytes) override;
+
+    int64_t getNumFrames() const { return mNumSamples / mChannelCount; }
+
+    /**
+     * Hands over the decoded audio, the builder is empty afterwards.
+     */
+    std::unique_ptr<PcmChunks> build();
+
+private:
+    void convertSamples(const uint8_t *source, uint8_t *destination, int32_t numSamples);
+
+    const int32_t mChannelCount;
+    const SampleFormat mInputFormat;
+    const SampleFormat mStorageFormat;
+    const int32_t mSamplesPerChunk;
+
+    // Only needed to convert int16 to half precision, which has to go through float
+    std::unique_ptr<float[]> mConversionBuffer;
+
+    std::vector<std::unique_ptr<uint8_t[]>> mChunks;
+    int32_t mSamplesInLastChunk = 0;
+    int64_t mNumSamples = 0;
+};
+
+#endif //OBOE_AUDIO_PLAYER_PCMBUILDER_H
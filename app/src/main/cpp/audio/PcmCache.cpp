@@ -0,0 +1,97 @@
+//
+// Created by 43975 on 1/21/2022.
+//
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include "../utils/logging.h"
+#include "PcmCache.h"
+#include "MappedDataSource.h"
+
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+// Only this much of the start and of the end of an asset goes into its hash
+constexpr off_t kHashedEdgeBytes = 64 * 1024;
+
+static uint64_t hashBytes(uint64_t hash, const uint8_t *data, size_t numBytes) {
+    for (size_t i = 0; i < numBytes; ++i){
+        hash = (hash ^ data[i]) * kFnvPrime;
+    }
+    return hash;
+}
+
+std::shared_ptr<DataSource> PcmCache::load(const char *assetName, const AudioProperties properties,
+        const SampleFormat format, uint64_t sourceHash) const {
+    std::string path = getPath(assetName, properties, format);
+    std::shared_ptr<DataSource> source{MappedDataSource::newFromFile(path.c_str(), properties, format, sourceHash)};
+    if (source != nullptr) LOGD("Loaded %s from the PCM cache", assetName);
+    return source;
+}
+
+bool PcmCache::store(const char *assetName, const DataSource &source, uint64_t sourceHash) const {
+    const AudioProperties properties = source.getProperties();
+    const SampleFormat format = source.getSampleFormat();
+    std::string path = getPath(assetName, properties, format);
+    std::string temporaryPath = path + ".tmp";
+
+    PcmCacheHeader header{};
+    header.magic = kPcmCacheMagic;
+    header.version = kPcmCacheVersion;
+    header.sampleRate = properties.sampleRate;
+    header.channelCount = properties.channelCount;
+    header.frameCount = source.getSize() / properties.channelCount;
+    header.sourceHash = sourceHash;
+    header.sampleFormat = static_cast<int32_t>(format);
+
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+    if (!file){
+        LOGE("Failed to create cache file %s", temporaryPath.c_str());
+        return false;
+    }
+    bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1;
+    int64_t frameIndex = 0;
+    while (isWritten && frameIndex < header.frameCount){
+        int64_t contiguousFrames;
+        const void *samples = source.getFrames(frameIndex, contiguousFrames);
+        auto numSamples = static_cast<size_t>(contiguousFrames * properties.channelCount);
+        isWritten = fwrite(samples, getBytesPerSample(format), numSamples, file) == numSamples;
+        frameIndex += contiguousFrames;
+    }
+    isWritten = (fclose(file) == 0) && isWritten;
+
+    if (!isWritten || rename(temporaryPath.c_str(), path.c_str()) != 0){
+        LOGE("Failed to write cache file %s", path.c_str());
+        remove(temporaryPath.c_str());
+        return false;
+    }
+    LOGD("Stored %" PRId64 " frames of %s in the PCM cache", header.frameCount, assetName);
+    return true;
+}
+
+uint64_t PcmCache::hashAsset(AAsset *asset) {
+    const auto length = static_cast<int64_t>(AAsset_getLength(asset));
+    uint64_t hash = hashBytes(kFnvOffsetBasis, reinterpret_cast<const uint8_t *>(&length), sizeof(length));
+
+    auto buffer = std::make_unique<uint8_t[]>(kHashedEdgeBytes);
+    // the start, and the end unless the start already covered it
+    const off_t offsets[2] = {0, std::max<off_t>(kHashedEdgeBytes, length - kHashedEdgeBytes)};
+    for (off_t offset : offsets){
+        if (offset >= length || AAsset_seek(asset, offset, SEEK_SET) != offset) break;
+        int bytesRead = AAsset_read(asset, buffer.get(), kHashedEdgeBytes);
+        if (bytesRead <= 0) break;
+        hash = hashBytes(hash, buffer.get(), static_cast<size_t>(bytesRead));
+    }
+    return hash;
+}
+
+std::string PcmCache::getPath(const char *assetName, const AudioProperties properties,
+        const SampleFormat format) const {
+    // assets can live in sub directories, flatten them into one file name
+    std::string name(assetName);
+    for (char &c : name){
+        if (c == '/') c = '_';
+    }
+    return mDirectory + "/" + name + "_" + std::to_string(properties.sampleRate) + "_" +
+           std::to_string(properties.channelCount) + "_" + std::to_string(static_cast<int32_t>(format)) + ".pcm";
+}
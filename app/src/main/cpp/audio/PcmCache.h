@@ -0,0 +1,69 @@
+//
+// Created by 43975 on 1/21/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_PCMCACHE_H
+#define OBOE_AUDIO_PLAYER_PCMCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <android/asset_manager.h>
+#include "DataSource.h"
+
+constexpr uint32_t kPcmCacheMagic = 0x4d435050; // "PPCM"
+constexpr uint32_t kPcmCacheVersion = 3;
+
+/**
+ * Header at the start of every cache file, the samples follow directly after it.
+ * The size is a multiple of 64 bytes so the samples stay aligned in the mapping.
+ */
+struct PcmCacheHeader{
+    uint32_t magic;
+    uint32_t version;
+    int32_t sampleRate;
+    int32_t channelCount;
+    int64_t frameCount;
+    uint64_t sourceHash;
+    int32_t sampleFormat;
+    uint8_t reserved[28];
+};
+static_assert(sizeof(PcmCacheHeader) == 64, "PcmCacheHeader must stay 64 bytes");
+
+/**
+ * On-disk cache of decoded assets so they don't need to be decoded again on the next launch.
+ *
+ * Entries are keyed by asset name, target AudioProperties and sample format. Each entry also
+ * stores a hash of the compressed asset, so a changed asset with the same name is decoded again.
+ * Assets have no modification time, so the hash covers the length and both ends of the asset,
+ * where the headers and tags of audio files live, rather than the whole file.
+ */
+class PcmCache{
+public:
+    explicit PcmCache(std::string directory):mDirectory(std::move(directory)){}
+
+    /**
+     * @return a memory mapped source or nullptr on a cache miss.
+     */
+    std::shared_ptr<DataSource> load(const char *assetName, AudioProperties properties,
+            SampleFormat format, uint64_t sourceHash) const;
+
+    /**
+     * Write a decoded source to the cache. The file is written under a temporary name and
+     * renamed once complete, so a crash never leaves a truncated entry behind.
+     */
+    bool store(const char *assetName, const DataSource &source, uint64_t sourceHash) const;
+
+    /**
+     * @return FNV-1a hash of the length and of the first and last 64 KB of the asset. Reads
+     * at most 128 KB whatever the size of the asset, and leaves it positioned anywhere.
+     */
+    static uint64_t hashAsset(AAsset *asset);
+
+private:
+    std::string getPath(const char *assetName, AudioProperties properties, SampleFormat format) const;
+
+    const std::string mDirectory;
+};
+
+#endif //OBOE_AUDIO_PLAYER_PCMCACHE_H
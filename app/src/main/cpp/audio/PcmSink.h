@@ -0,0 +1,28 @@
+//
+// Created by 43975 on 1/8/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_PCMSINK_H
+#define OBOE_AUDIO_PLAYER_PCMSINK_H
+
+#include <cstdint>
+
+/**
+ * Receives decoded audio from an extractor as it is produced, so the caller decides whether
+ * it ends up in one big buffer or in a small window that is played while decoding continues.
+ */
+class PcmSink{
+public:
+    virtual ~PcmSink(){}
+
+    /**
+     * Called by the extractor for every block of decoded, interleaved samples.
+     *
+     * @param data : decoded samples (float for FFmpeg, int16 for the NDK decoder)
+     * @param numBytes : size of the block in bytes
+     * @return false to make the extractor stop decoding
+     */
+    virtual bool onDecodedData(const uint8_t *data, int64_t numBytes) =0;
+};
+
+#endif //OBOE_AUDIO_PLAYER_PCMSINK_H
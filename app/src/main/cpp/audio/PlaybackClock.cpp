@@ -0,0 +1,53 @@
+//
+// Created by 43975 on 2/6/2022.
+//
+#include <algorithm>
+#include "PlaybackClock.h"
+#include "../utils/UtilityFunctions.h"
+
+void PlaybackClock::publish(const PlaybackClockSnapshot &snapshot) {
+    const uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(sequence + 1, std::memory_order_relaxed);
+    // the odd sequence is visible before any of the fields change
+    std::atomic_thread_fence(std::memory_order_release);
+
+    mPositionFrames.store(snapshot.positionFrames, std::memory_order_relaxed);
+    mPresentationNanos.store(snapshot.presentationNanos, std::memory_order_relaxed);
+    mSampleRate.store(snapshot.sampleRate, std::memory_order_relaxed);
+    mSpeed.store(snapshot.speed, std::memory_order_relaxed);
+    mHasTimestamp.store(snapshot.hasTimestamp, std::memory_order_relaxed);
+
+    mSequence.store(sequence + 2, std::memory_order_release);
+}
+
+PlaybackClockSnapshot PlaybackClock::getSnapshot() const {
+    PlaybackClockSnapshot snapshot;
+    uint32_t sequence;
+    do{
+        sequence = mSequence.load(std::memory_order_acquire);
+        snapshot.positionFrames = mPositionFrames.load(std::memory_order_relaxed);
+        snapshot.presentationNanos = mPresentationNanos.load(std::memory_order_relaxed);
+        snapshot.sampleRate = mSampleRate.load(std::memory_order_relaxed);
+        snapshot.speed = mSpeed.load(std::memory_order_relaxed);
+        snapshot.hasTimestamp = mHasTimestamp.load(std::memory_order_relaxed);
+        // the field loads complete before the sequence is checked again
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }while ((sequence & 1) != 0 || sequence != mSequence.load(std::memory_order_relaxed));
+    return snapshot;
+}
+
+double PlaybackClock::getPositionFrames(const PlaybackClockSnapshot &snapshot, int64_t nowNanos) {
+    if (snapshot.sampleRate <= 0) return 0;
+
+    // negative while the end of the last buffer is still on its way to the speaker, what is
+    // heard then is that much earlier in the track
+    const double elapsedFrames = (nowNanos - snapshot.presentationNanos) * snapshot.sampleRate / static_cast<double>(kNanosecondsInSecond);
+    const double position = snapshot.positionFrames + std::min(0.0, elapsedFrames) * snapshot.speed;
+    return std::max(0.0, position);
+}
+
+double PlaybackClock::getPositionMillis() const {
+    const PlaybackClockSnapshot snapshot = getSnapshot();
+    if (snapshot.sampleRate <= 0) return 0;
+    return getPositionFrames(snapshot, nowMonotonicNanos()) * kMillisecondsInSecond / snapshot.sampleRate;
+}
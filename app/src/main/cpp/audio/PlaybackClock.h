@@ -0,0 +1,67 @@
+//
+// Created by 43975 on 2/6/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_PLAYBACKCLOCK_H
+#define OBOE_AUDIO_PLAYER_PLAYBACKCLOCK_H
+
+#include <atomic>
+#include <cstdint>
+
+struct PlaybackClockSnapshot{
+    // position of the track after the last frame rendered so far, in frames of the stream
+    int64_t positionFrames = 0;
+    // CLOCK_MONOTONIC time at which that frame leaves the speaker
+    int64_t presentationNanos = 0;
+    int32_t sampleRate = 0;
+    // frames of the track per frame of the stream, 0 while paused
+    float speed = 0;
+    // false if the presentation time was estimated from the buffer size, the stream had no timestamp
+    bool hasTimestamp = false;
+};
+
+/**
+ * The position of the track that is audible right now, for UIs and for syncing other media.
+ *
+ * The audio callback publishes where the track is at the end of every buffer and when that will
+ * be heard. Readers extrapolate from there to the current time. The snapshot is shared through a
+ * seqlock, so publishing costs the audio thread a handful of stores and never waits, while
+ * readers retry in the rare case they overlap a publish.
+ */
+class PlaybackClock{
+public:
+    /**
+     * Audio thread only.
+     */
+    void publish(const PlaybackClockSnapshot &snapshot);
+
+    /**
+     * @return the last published snapshot, all of it from the same buffer
+     */
+    PlaybackClockSnapshot getSnapshot() const;
+
+    /**
+     * @return the track position audible at nowNanos, in frames of the stream. Never beyond
+     *         what has been rendered, and never less than 0.
+     */
+    static double getPositionFrames(const PlaybackClockSnapshot &snapshot, int64_t nowNanos);
+
+    /**
+     * @return the track position audible now in milliseconds
+     */
+    double getPositionMillis() const;
+
+private:
+    // odd while a publish is in progress
+    std::atomic<uint32_t> mSequence{0};
+
+    // Stored as atomics so the reads which race a publish are still well defined, the sequence
+    // tells the reader to throw them away
+    std::atomic<int64_t> mPositionFrames{0};
+    std::atomic<int64_t> mPresentationNanos{0};
+    std::atomic<int32_t> mSampleRate{0};
+    std::atomic<float> mSpeed{0};
+    std::atomic<bool> mHasTimestamp{false};
+};
+
+#endif //OBOE_AUDIO_PLAYER_PLAYBACKCLOCK_H
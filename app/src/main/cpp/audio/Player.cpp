@@ -1,43 +1,153 @@
 //
 // Created by 43975 on 12/27/2021.
 //
+#include <algorithm>
+#include <cstring>
 #include "Player.h"
+#include "../dsp/SampleKernels.h"
+#include "../dsp/TimeStretcher.h"
+#include "../dsp/VarispeedProcessor.h"
 #include "../utils/logging.h"
+#include "../utils/UtilityFunctions.h"
 
-void Player::renderAudio(float *targetData, int32_t numFrames) {
-    const AudioProperties properties = mSource->getProperties();
+int32_t Player::renderAudio(float *targetData, int32_t numFrames) {
+    const int32_t channelCount = mSource->getProperties().channelCount;
+    if (!mIsPlaying){
+        renderSilence(targetData,numFrames*channelCount);
+        return 0;
+    }
 
-    if (mIsPlaying){
-        int64_t framesToRenderFromData = numFrames;
-        int64_t totalSourceFrames = mSource->getSize() / properties.channelCount;
-        const float *data = mSource->getData();
+    if (!mSource->isStreaming() && mPendingSeekFrame.load(std::memory_order_relaxed) >= 0){
+        const int64_t totalSourceFrames = mSource->getSize() / channelCount;
+        int64_t seekFrame = mPendingSeekFrame.exchange(-1, std::memory_order_acquire);
+        mReadFrameIndex = std::min(seekFrame, std::max<int64_t>(0, totalSourceFrames - 1));
+        mIsSourceEnded = false;
+        mIsSpeedResetPending = true;
+    }
 
-        // check whether we're about to reach the end of the recording
-        if (!mIsLooping && mReadFrameIndex+numFrames >= totalSourceFrames){
-            framesToRenderFromData = totalSourceFrames-mReadFrameIndex;
-            mIsPlaying= false;
-        }
+    // At normal speed the source is rendered straight into the buffer
+    const float speed = mSpeed.load(std::memory_order_relaxed);
+    SpeedProcessor *processor = nullptr;
+    if (speed != 1.0f && mHasSpeedProcessors.load(std::memory_order_acquire)){
+        processor = getSpeedProcessor(mSpeedMode.load(std::memory_order_relaxed));
+    }
 
-        for (int i = 0; i < framesToRenderFromData; ++i) {
-            for (int j=0; j<properties.channelCount; ++j){
-                targetData[(i*properties.channelCount)+j] = data[(mReadFrameIndex*properties.channelCount)+j];
-            }
+    int32_t framesRendered;
+    if (processor != nullptr){
+        // what another processor buffered is thrown away, as is anything from before a seek
+        if (mIsSpeedResetPending.exchange(false) || processor != mActiveProcessor) processor->reset();
+        framesRendered = processor->render(mSourceReader, targetData, numFrames, speed);
+    }else{
+        framesRendered = readSource(targetData, numFrames);
+    }
+    mActiveProcessor = processor;
 
-            // Increment and handle wraparound
-            if (++mReadFrameIndex >= totalSourceFrames) mReadFrameIndex=0;
-        }
+    if (framesRendered < numFrames){
+        // either the decoder hasn't caught up yet or the recording has ended, and so has
+        // the tail a speed processor had buffered
+        renderSilence(&targetData[framesRendered*channelCount], (numFrames-framesRendered)*channelCount);
+        if (isEndOfSource()) mIsPlaying=false;
+    }
+    return framesRendered;
+}
+
+/**
+ * @return true if the source has no more frames to read, for good
+ */
+bool Player::isEndOfSource() const {
+    return mSource->isStreaming() ? mSource->isEndOfStream() : mIsSourceEnded;
+}
 
-        if (framesToRenderFromData < numFrames){
-            // fill the rest of the buffer with silence
-            renderSilence(&targetData[framesToRenderFromData], numFrames*properties.channelCount);
+/**
+ * Reads frames of the source as float at normal speed. A streaming source is read sequentially,
+ * it loops on its own and the play head of the player doesn't apply to it.
+ *
+ * @return number of frames read, fewer than numFrames if the source has run out for now
+ */
+int32_t Player::readSource(float *targetData, int32_t numFrames) {
+    if (mSource->isStreaming()) return mSource->readFrames(targetData, numFrames);
+    if (!mIsPlaying || mIsSourceEnded) return 0;
+
+    const int32_t channelCount = mSource->getProperties().channelCount;
+    const int64_t totalSourceFrames = mSource->getSize() / channelCount;
+    const SampleFormat format = mSource->getSampleFormat();
+    int32_t framesRendered = 0;
+
+    // Copy contiguous runs of frames, a run ends at the end of a chunk of the source or at the
+    // end of the recording. Chunks are much longer than a buffer so this rarely splits the copy.
+    while (framesRendered < numFrames && totalSourceFrames > 0){
+        int64_t contiguousFrames;
+        const void *data = mSource->getFrames(mReadFrameIndex, contiguousFrames);
+        auto framesToCopy = static_cast<int32_t>(std::min<int64_t>(numFrames - framesRendered,
+                contiguousFrames));
+        renderSamples(data, format, &targetData[framesRendered*channelCount], framesToCopy*channelCount);
+        framesRendered += framesToCopy;
+        mReadFrameIndex += framesToCopy;
+
+        // handle wraparound
+        if (mReadFrameIndex >= totalSourceFrames){
+            mReadFrameIndex = 0;
+            if (!mIsLooping){
+                mIsSourceEnded = true;
+                break;
+            }
         }
-    }else{
-        renderSilence(targetData,numFrames*properties.channelCount);
     }
+    return framesRendered;
 }
 
-void Player::renderSilence(float *start, int32_t numSamples) {
-    for (int i = 0; i < numSamples; ++i) {
-        start[i]=0;
+void Player::setSpeed(float speed, SpeedMode mode) {
+    if (!mHasSpeedProcessors.load(std::memory_order_acquire)){
+        const int32_t channelCount = mSource->getProperties().channelCount;
+        mLinearProcessor.reset(new VarispeedProcessor(channelCount, false));
+        mCubicProcessor.reset(new VarispeedProcessor(channelCount, true));
+        mTimeStretcher.reset(new TimeStretcher(channelCount));
+        mHasSpeedProcessors.store(true, std::memory_order_release);
+    }
+    mSpeedMode.store(mode, std::memory_order_relaxed);
+    mSpeed.store(std::min(kMaxPlaybackSpeed, std::max(kMinPlaybackSpeed, speed)), std::memory_order_relaxed);
+}
+
+SpeedProcessor *Player::getSpeedProcessor(SpeedMode mode) {
+    switch (mode){
+        case SpeedMode::Linear: return mLinearProcessor.get();
+        case SpeedMode::Cubic: return mCubicProcessor.get();
+        case SpeedMode::TimeStretch: return mTimeStretcher.get();
+    }
+    return nullptr;
+}
+
+void Player::seekToFrame(int64_t frameIndex) {
+    frameIndex = std::max<int64_t>(0, frameIndex);
+    if (mSource->isStreaming()){
+        if (!mSource->seekToFrame(frameIndex)) LOGW("Source can't seek");
+        mIsSpeedResetPending = true;
+        return;
     }
+    mPendingSeekFrame.store(frameIndex, std::memory_order_release);
+}
+
+void Player::seekToMillis(int64_t millis) {
+    seekToFrame(convertMillisToFrames(millis, mSource->getProperties().sampleRate));
+}
+
+/**
+ * Copies samples from the source into the output, converting compact formats to float.
+ */
+void Player::renderSamples(const void *source, SampleFormat format, float *target, int32_t numSamples) {
+    switch (format){
+        case SampleFormat::Float:
+            memcpy(target, source, numSamples*sizeof(float));
+            break;
+        case SampleFormat::I16:
+            getSampleKernels().convertI16ToFloat(static_cast<const int16_t *>(source), target, numSamples);
+            break;
+        case SampleFormat::Half:
+            getSampleKernels().convertHalfToFloat(static_cast<const uint16_t *>(source), target, numSamples);
+            break;
+    }
+}
+
+void Player::renderSilence(float *start, int32_t numSamples) {
+    getSampleKernels().clear(start, numSamples);
 }
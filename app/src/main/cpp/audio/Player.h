@@ -9,10 +9,12 @@
 #include "array"
 #include "chrono"
 #include "memory"
+#include "utility"
 #include "atomic"
 
 #include "android/asset_manager.h"
 #include "DataSource.h"
+#include "SpeedProcessor.h"
 
 class Player{
 public:
@@ -22,19 +24,87 @@ public:
      *
      * @param source
      */
-     Player(std::shared_ptr<DataSource> source):mSource(source){};
+     Player(std::shared_ptr<DataSource> source):mSourceOwner(std::move(source)), mSource(mSourceOwner.get()){};
 
-     void renderAudio(float *targetData, int32_t numFrames);
-     void resetPlayHead() {mReadFrameIndex=0;};
+    /**
+     * Render numFrames of audio into targetData. A streaming source is read sequentially, it
+     * loops on its own and the play head of the player doesn't apply to it.
+     *
+     * @return number of frames taken from the source, the rest of targetData is silence
+     */
+     int32_t renderAudio(float *targetData, int32_t numFrames);
+     void resetPlayHead() {mReadFrameIndex=0; mIsSourceEnded=false; mIsSpeedResetPending=true;};
      void setPlaying(bool isPlaying) {mIsPlaying=isPlaying; resetPlayHead();};
-     void setLooping(bool isLooping) {mIsLooping=isLooping;};
+     void setLooping(bool isLooping) {mIsLooping=isLooping; mSource->setLooping(isLooping);};
+     bool isPlaying() const {return mIsPlaying;};
+
+    /**
+     * Move the play head, can be called from any thread. A fully decoded source jumps on the
+     * next renderAudio(), a streaming source once the new position has been decoded.
+     *
+     * @param frameIndex : frame at the sample rate of the source
+     */
+     void seekToFrame(int64_t frameIndex);
+     void seekToMillis(int64_t millis);
+
+    /**
+     * Play faster or slower, can be called from any thread. The processors for the other speeds
+     * are allocated by the first call, for the channel count of the current source.
+     *
+     * @param speed : clamped to [kMinPlaybackSpeed, kMaxPlaybackSpeed], 1 plays the source as it is
+     * @param mode : whether the pitch follows the speed and how
+     */
+     void setSpeed(float speed, SpeedMode mode);
+     float getSpeed() const {return mSpeed.load(std::memory_order_relaxed);};
+
+    /**
+     * Plays another source without taking a reference to it, so it can be called on the audio
+     * thread. The caller keeps the source alive for as long as the player uses it.
+     */
+     void setSource(DataSource *source) {mSource=source;};
 
 private:
-    int32_t mReadFrameIndex = 0;
+    int64_t mReadFrameIndex = 0;
+     // a fully decoded source which doesn't loop has been read to the end, a speed processor
+     // may still be playing out what it buffered
+     bool mIsSourceEnded = false;
      std::atomic<bool> mIsPlaying{false};
      std::atomic<bool> mIsLooping{false};
-     std::shared_ptr<DataSource> mSource;
+     std::atomic<int64_t> mPendingSeekFrame{-1};
+     // null for players which are handed their sources with setSource()
+     std::shared_ptr<DataSource> mSourceOwner;
+     DataSource *mSource;
+
+     // Hands the source to the speed processors
+     class SourceReader : public FrameReader{
+     public:
+         explicit SourceReader(Player &player):mPlayer(player){}
+         int32_t readFrames(float *buffer, int32_t numFrames) override {
+             return mPlayer.readSource(buffer, numFrames);
+         }
+         bool isEndOfInput() const override {
+             return mPlayer.isEndOfSource();
+         }
+     private:
+         Player &mPlayer;
+     };
+
+     std::atomic<float> mSpeed{1.0f};
+     std::atomic<SpeedMode> mSpeedMode{SpeedMode::Linear};
+     std::atomic<bool> mIsSpeedResetPending{false};
+     // set once the processors below exist, they are never replaced after that
+     std::atomic<bool> mHasSpeedProcessors{false};
+     std::unique_ptr<SpeedProcessor> mLinearProcessor;
+     std::unique_ptr<SpeedProcessor> mCubicProcessor;
+     std::unique_ptr<SpeedProcessor> mTimeStretcher;
+     SourceReader mSourceReader{*this};
+     // processor used by the previous renderAudio, if any
+     SpeedProcessor *mActiveProcessor = nullptr;
 
+     int32_t readSource(float *targetData, int32_t numFrames);
+     bool isEndOfSource() const;
+     SpeedProcessor *getSpeedProcessor(SpeedMode mode);
+     void renderSamples(const void *source, SampleFormat format, float *target, int32_t numSamples);
      void renderSilence(float *, int32_t);
 };
 
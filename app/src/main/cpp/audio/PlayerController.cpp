@@ -3,11 +3,28 @@
 //
 
 #include "PlayerController.h"
+#include "algorithm"
 #include "thread"
 #include "../utils/logging.h"
 #include "../utils/UtilityFunctions.h"
+#include "../dsp/SampleKernels.h"
 
 PlayerController::PlayerController(AAssetManager &assetManager):mAssetManager(assetManager) {
+    // pick the sample kernels now rather than on the first audio callback
+    LOGD("Using %s sample kernels", getSampleKernels().name);
+    setEqBand(0, EqBandType::LowShelf, 100.0f, 0.0f, 0.707f);
+    setEqBand(1, EqBandType::Peaking, 1000.0f, 0.0f, 0.707f);
+    setEqBand(2, EqBandType::HighShelf, 8000.0f, 0.0f, 0.707f);
+    mPreloadThread = std::thread(&PlayerController::preloadLoop, this);
+}
+
+PlayerController::~PlayerController() {
+    {
+        std::lock_guard<std::mutex> lock(mPlaylistLock);
+        mIsShuttingDown = true;
+    }
+    mPlaylistCondition.notify_one();
+    mPreloadThread.join();
 }
 /**
  * Initializes stream and player then eventually starting the stream.
@@ -35,14 +52,13 @@ void PlayerController::load() {
 }
 
 /**
- * sets the audio filename, call the load method.
+ * sets the audio filename, call the load method. A track which is loaded already is resumed.
  * @param fileName : name of the asset audio file.
  */
 void PlayerController::start(char *fileName) {
-   // LOGD("PlayerController, comp= %d",strcmp(fileName,trackFilename));
-    if (paused){
-        LOGD("PlayerController, setPlaying true");
-        mTrack->setPlaying(true);
+    if (mControllerState == PlayerControllerState::Playing){
+        LOGD("PlayerController, resuming");
+        scheduleCommand(TransportCommand{TransportCommandType::Play});
     }
     else{
         LOGD("PlayerController, starting Player");
@@ -57,6 +73,8 @@ void PlayerController::start(char *fileName) {
  * stop the audio stream.
  */
 void PlayerController::stop() {
+    // the next start() loads the track again
+    mControllerState = PlayerControllerState::Loading;
     if (mAudioStream){
         mAudioStream->stop();
         mAudioStream->close();
@@ -64,10 +82,134 @@ void PlayerController::stop() {
     }
 }
 
-void PlayerController::pause() {
-    mAudioStream->pause();
+/**
+ * Sounds are decoded to the properties of the stream. Before the stream has opened they are
+ * decoded to the native rate of the device, which the app passes in as
+ * DefaultStreamValues::SampleRate and which the stream opens at as well.
+ */
+int32_t PlayerController::loadSound(const char *fileName) {
+    AudioProperties targetProperties;
+    {
+        std::lock_guard<std::mutex> lock(mPlaylistLock);
+        targetProperties = mStreamProperties;
+    }
+    if (targetProperties.sampleRate == 0){
+        targetProperties = AudioProperties{
+                .channelCount = kStreamChannelCount,
+                .sampleRate = DefaultStreamValues::SampleRate > 0 ? DefaultStreamValues::SampleRate
+                        : kFallbackSampleRate
+        };
+    }
+    std::shared_ptr<DataSource> source = loadAsset(fileName, targetProperties, false);
+    if (source == nullptr){
+        LOGE("Could not load sound: %s", fileName);
+        return -1;
+    }
+    mSoundSampleRate.store(targetProperties.sampleRate, std::memory_order_relaxed);
+    return mGraph.getMixer().addSound(source);
+}
+
+bool PlayerController::playSound(int32_t soundId, float gain, float pan) {
+    return mGraph.getMixer().playSound(soundId, gain, pan);
+}
+
+void PlayerController::seekToMillis(int64_t positionMillis) {
+    TransportCommand command{TransportCommandType::Seek};
+    command.positionMillis = positionMillis;
+    scheduleCommand(command);
+}
+
+void PlayerController::enqueueTrack(const char *fileName) {
+    {
+        std::lock_guard<std::mutex> lock(mPlaylistLock);
+        mPlaylist.emplace_back(fileName);
+    }
+    setLooping(false);
+    mPlaylistCondition.notify_one();
+}
+
+void PlayerController::setPlaybackSpeed(float speed, SpeedMode mode) {
+    mPlaybackSpeed.store(speed, std::memory_order_relaxed);
+    mSpeedMode.store(mode, std::memory_order_relaxed);
+
+    TransportCommand command{TransportCommandType::SetSpeed};
+    command.speed = speed;
+    command.speedMode = mode;
+    scheduleCommand(command);
+}
 
-    //mTrack->setPlaying(false);
+void PlayerController::setLooping(bool isLooping) {
+    TransportCommand command{TransportCommandType::SetLooping};
+    command.isLooping = isLooping;
+    scheduleCommand(command);
+}
+
+void PlayerController::setTrackGain(float gain) {
+    TransportCommand command{TransportCommandType::SetGain};
+    command.gain = std::max(0.0f, gain);
+    scheduleCommand(command);
+}
+
+bool PlayerController::scheduleCommand(const TransportCommand &command) {
+    // while the track loads the commands wait in the queue, the first callback applies them
+    if (mControllerState == PlayerControllerState::FailedToLoad){
+        LOGW("No track loaded, dropped a transport command");
+        return false;
+    }
+    if (!mGraph.scheduleCommand(command)){
+        LOGW("Too many transport commands pending, dropped one");
+        return false;
+    }
+    return true;
+}
+
+void PlayerController::setEqBand(int32_t band, EqBandType type, float frequency, float gainDecibels, float q) {
+    mGraph.getMasterEffects().get<0>().setBand(band, type, frequency, gainDecibels, q);
+}
+
+void PlayerController::setCompressor(float thresholdDecibels, float ratio, float attackMillis,
+                                     float releaseMillis, float makeupDecibels) {
+    mGraph.getMasterEffects().get<1>().setParameters(thresholdDecibels, ratio, attackMillis, releaseMillis, makeupDecibels);
+}
+
+void PlayerController::setLimiter(float ceilingDecibels, float releaseMillis) {
+    mGraph.getMasterEffects().get<2>().setParameters(ceilingDecibels, releaseMillis);
+}
+
+/**
+ * Runs on the preload thread. Keeps the next track of the playlist loaded, so that the audio
+ * callback only has to swap two pointers to move on to it.
+ */
+void PlayerController::preloadLoop() {
+    std::unique_lock<std::mutex> lock(mPlaylistLock);
+    while (!mIsShuttingDown){
+        mPlaylistCondition.wait_for(lock, kPreloadPollInterval);
+        // free the samples of sources the audio thread let go of
+        PcmChunkPool::getInstance().collectRetired();
+        if (mGraph.isNextTrackReady() || mControllerState != PlayerControllerState::Playing) continue;
+
+        // this is the track which just finished, don't destroy it on the audio thread
+        std::unique_ptr<Player> finishedTrack = mGraph.takeFinishedTrack();
+        if (mPlaylist.empty()) continue;
+        std::string filename = std::move(mPlaylist.front());
+        mPlaylist.pop_front();
+        const AudioProperties targetProperties = mStreamProperties;
+
+        lock.unlock();
+        finishedTrack.reset();
+        LOGD("Preloading %s", filename.c_str());
+        std::unique_ptr<Player> player = newTrackPlayer(filename.c_str(), targetProperties, false);
+        lock.lock();
+
+        if (player) mGraph.setNextTrack(std::move(player));
+    }
+}
+
+/**
+ * Pauses the track, the stream keeps running so sounds can still be played.
+ */
+void PlayerController::pause() {
+    scheduleCommand(TransportCommand{TransportCommandType::Pause});
 }
 
 /**
@@ -78,18 +220,66 @@ void PlayerController::pause() {
  * @return DataCallbackResult::Continue or DataCallbackResult::Stop
  */
 DataCallbackResult PlayerController::onAudioReady(AudioStream *oboeStream, void *audioData, int32_t numFrames) {
-    auto *outputBuffer = static_cast<float *>(audioData);
-    for (int i=0; i<numFrames; ++i){
-        mSongPosition = convertFramesToMillis(mCurrentFrame,mAudioStream->getSampleRate());
-        mCurrentFrame++;
-        mTrack->renderAudio(outputBuffer+(oboeStream->getChannelCount()*i), 1);
+    const int64_t callbackStartNanos = nowUptimeNanos();
+    const int64_t bufferStartFrame = oboeStream->getFramesWritten();
+
+    switch (mOutputFormat.load(std::memory_order_relaxed)){
+        case AudioFormat::I16:
+            mGraph.render(static_cast<int16_t *>(audioData), numFrames);
+            break;
+        case AudioFormat::I24:
+            mGraph.render(static_cast<PackedInt24 *>(audioData), numFrames);
+            break;
+        case AudioFormat::I32:
+            mGraph.render(static_cast<int32_t *>(audioData), numFrames);
+            break;
+        default:
+            mGraph.render(static_cast<float *>(audioData), numFrames);
+            break;
+    }
+    publishClock(oboeStream, bufferStartFrame + numFrames);
+
+    ResultWithValue<int32_t> xRunResult = oboeStream->getXRunCount();
+    const int32_t xRunCount = xRunResult ? xRunResult.value() : -1;
+    mMetrics.recordCallback(callbackStartNanos, nowUptimeNanos(), numFrames, oboeStream->getSampleRate(), xRunCount);
+
+    // the device may round the size, the tuner goes on from whatever it got
+    const int32_t bufferSize = mLatencyTuner.update(numFrames, xRunCount);
+    if (bufferSize > 0){
+        oboeStream->setBufferSizeInFrames(bufferSize);
+        mLatencyTuner.setBufferSize(oboeStream->getBufferSizeInFrames());
     }
-    mLastUpdateTime = nowUptimeMillis();
     return DataCallbackResult::Continue;
 }
 
 /**
- * reset the stream, frame, song position, update time. and restart the stream.
+ * Tells the playback clock where the track is at the end of the buffer and when that will be
+ * heard. The stream timestamp says when a recent frame left the speaker. Without one, the frames
+ * already in the buffer are assumed to play first.
+ *
+ * @param bufferEndFrame : frame of the stream after the buffer, counted by the stream
+ */
+void PlayerController::publishClock(AudioStream *oboeStream, int64_t bufferEndFrame) {
+    PlaybackClockSnapshot snapshot;
+    snapshot.positionFrames = mGraph.getPositionFrames();
+    snapshot.sampleRate = oboeStream->getSampleRate();
+    snapshot.speed = mGraph.getTrackSpeed();
+
+    const double nanosPerFrame = static_cast<double>(kNanosecondsInSecond) / snapshot.sampleRate;
+    ResultWithValue<FrameTimestamp> timestamp = oboeStream->getTimestamp(CLOCK_MONOTONIC);
+    if (timestamp){
+        snapshot.presentationNanos = timestamp.value().timestamp +
+                static_cast<int64_t>((bufferEndFrame - timestamp.value().position) * nanosPerFrame);
+        snapshot.hasTimestamp = true;
+    }else{
+        snapshot.presentationNanos = nowMonotonicNanos() +
+                static_cast<int64_t>(oboeStream->getBufferSizeInFrames() * nanosPerFrame);
+    }
+    mClock.publish(snapshot);
+}
+
+/**
+ * reset the stream, frame, song position and restart the stream.
  * @param oboeStream: audioStream pointer to the associated stream
  * @param error
  */
@@ -97,9 +287,6 @@ void PlayerController::onErrorAfterClose(AudioStream *oboeStream, Result error)
     if (error == Result::ErrorDisconnected){
         mControllerState = PlayerControllerState::Loading;
         mAudioStream.reset();
-        mCurrentFrame=0;
-        mSongPosition=0;
-        mLastUpdateTime=0;
         start(trackFilename);
     }else{
         LOGE("Stream error: %s",convertToText(error));
@@ -137,6 +324,9 @@ void PlayerController::onErrorAfterClose(AudioStream *oboeStream, Result error)
  *              most music application use 44100Hz = 44.1kHz
  *              48kHz is commonly used when producing audio for video because relationship between audio samples
  *              and the frame rate of video.
+ *              Left unspecified so the stream opens at the native rate of the device. Tracks and
+ *              sounds are decoded to whatever rate the stream got, so nothing is resampled per
+ *              buffer.
  *
  * Performance Mode:
  * None:        default mode, It uses basic stream that balances power and latency.
@@ -151,15 +341,25 @@ void PlayerController::onErrorAfterClose(AudioStream *oboeStream, Result error)
  *              8 Bits = 48 dB dynamic range, Audible noise that changes the sound: less resolution for quiet sound.
  *              16 Bits = 96 dB dynamic range, Low noise: Good resolution of quiet sounds.
  *
+ * Format:      Left unspecified so the stream opens with the native format of the device, which
+ *              is often I16 on the low latency path. onAudioReady renders float and converts it
+ *              itself, so Float, I16, I24 and I32 are all fine.
+ *
  * FormatConversionAllowed:
  *              If true oboe might convert data format for optimal results. For ex: A float stream could not
  *              get a low latency data path. So an I16 stream might be opened and converted to float.
+ *              Not needed as we take any format, and the extra conversion pass can keep the
+ *              stream off the exclusive MMAP path.
  *
  * SampleRateConversionQuality: Specifies the quality of sample rate conversion performed by Oboe.
  *              None: No conversion by oboe.
  *              Fastest: May not sound great
  *              Low, Medium, High,
  *              Best: high quality conversion may be expensive in terms of CPU.
+ *              None, the stream runs at the native rate so there is nothing to convert, and a
+ *              resampler in the path would keep it off the MMAP path.
+ *
+ * Buffer Size: Not set here, LatencyTuner adjusts it from the audio callback.
  *
  * setDataCallback: Pass the AudioStreamDataCallback, we can pass this as we have made PlayerController child of AudioStreamDataCallback
  * setErrorCallback: Pass the AudioStreamErrorCallback, we can pass this as we have made PlayerController child of AudioStreamErrorCallback
@@ -169,13 +369,12 @@ void PlayerController::onErrorAfterClose(AudioStream *oboeStream, Result error)
 bool PlayerController::openStream() {
     // create an audio stream
     AudioStreamBuilder builder;
-    builder.setFormat(AudioFormat::Float)
-            ->setFormatConversionAllowed(true)
+    builder.setFormat(AudioFormat::Unspecified)
+            ->setFormatConversionAllowed(false)
             ->setPerformanceMode(PerformanceMode::LowLatency)
             ->setSharingMode(SharingMode::Exclusive)
-            ->setSampleRate(32000)
-            ->setSampleRateConversionQuality(SampleRateConversionQuality::Medium)
-            ->setChannelCount(ChannelCount::Stereo)
+            ->setSampleRateConversionQuality(SampleRateConversionQuality::None)
+            ->setChannelCount(kStreamChannelCount)
             ->setDataCallback(this)
             ->setErrorCallback(this);
 
@@ -184,6 +383,32 @@ bool PlayerController::openStream() {
         LOGE("Failed to open stream. Error: %s", convertToText(result));
         return false;
     }
+    const AudioFormat format = mAudioStream->getFormat();
+    if (format != AudioFormat::Float && format != AudioFormat::I16 && format != AudioFormat::I24
+            && format != AudioFormat::I32){
+        LOGE("Stream opened with unsupported format %s", convertToText(format));
+        mAudioStream->close();
+        mAudioStream.reset();
+        return false;
+    }
+    LOGD("Stream opened with format %s at %d Hz", convertToText(format), mAudioStream->getSampleRate());
+    const int32_t soundSampleRate = mSoundSampleRate.load(std::memory_order_relaxed);
+    if (soundSampleRate != 0 && soundSampleRate != mAudioStream->getSampleRate()){
+        LOGW("Sounds were decoded at %d Hz, they play at the wrong pitch", soundSampleRate);
+    }
+    mOutputFormat.store(format, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mPlaylistLock);
+        mStreamProperties = AudioProperties{
+                .channelCount = mAudioStream->getChannelCount(),
+                .sampleRate = mAudioStream->getSampleRate()
+        };
+    }
+    mMetrics.resetStream();
+    mGraph.prepare(mAudioStream->getSampleRate());
+    // the buffer starts small and grows as far as xruns show it has to
+    mLatencyTuner.resetStream(mAudioStream->getFramesPerBurst(), mAudioStream->getBufferCapacityInFrames(),
+            mAudioStream->getSampleRate());
 
     return true;
 }
@@ -192,27 +417,123 @@ bool PlayerController::openStream() {
  * @return true if data source is loaded successfully and passed to the player.
  */
 bool PlayerController::setupAudioSources() {
-    //Set the properties of our audio source(s) to match that of our audio stream
-    AudioProperties targetProperties{
-            .channelCount = mAudioStream->getChannelCount(),
-            .sampleRate = mAudioStream->getSampleRate()
-    };
+    // The track loops until another one is queued after it
+    bool isLooping;
+    AudioProperties targetProperties;
+    {
+        std::lock_guard<std::mutex> lock(mPlaylistLock);
+        isLooping = mPlaylist.empty();
+        targetProperties = mStreamProperties;
+    }
+    std::unique_ptr<Player> track = newTrackPlayer(trackFilename, targetProperties, isLooping);
+    if (track == nullptr) return false;
+    // the callback isn't running yet, a track paused before a stop() plays again
+    mGraph.setTrack(std::move(track));
+    return true;
+}
 
+/**
+ * Creates a playing player for a track. Doesn't touch the stream, which another thread may be
+ * closing meanwhile.
+ *
+ * @param targetProperties : the properties of the stream, which the track is decoded to
+ * @return the player or nullptr if the track couldn't be loaded
+ */
+std::unique_ptr<Player> PlayerController::newTrackPlayer(const char *filename,
+        const AudioProperties targetProperties,
+        bool isLooping) {
     // Create a data source and player for our track
-    std::shared_ptr<AAssetDataSource> trackSource{
-        AAssetDataSource::newFromCompressedAsset(mAssetManager,trackFilename,targetProperties)
-    };
+    std::shared_ptr<DataSource> trackSource = loadAsset(filename, targetProperties, true, isLooping);
     if (trackSource== nullptr){
-        LOGE("Could not load source data for track: %s",trackFilename);
-        return false;
+        LOGE("Could not load source data for track: %s",filename);
+        return nullptr;
     }
 
-    mTrack = std::make_unique<Player>(trackSource);
-    mTrack->setPlaying(true);
-    mTrack->setLooping(true);
+    auto player = std::make_unique<Player>(trackSource);
+    player->setPlaying(true);
+    player->setLooping(isLooping);
+    // also allocates the speed processors, so speed commands never allocate on the audio thread
+    player->setSpeed(mPlaybackSpeed.load(std::memory_order_relaxed), mSpeedMode.load(std::memory_order_relaxed));
+    return player;
+}
 
-    return true;
+void PlayerController::setCacheDirectory(const char *directory) {
+    mPcmCache = std::make_unique<PcmCache>(directory);
+}
+
+/**
+ * Creates the data source for an asset, or shares the one still in the source cache from an
+ * earlier load.
+ *
+ * @param isLooping : whether a streamed asset starts over at its end
+ * @return the data source or nullptr if the asset couldn't be loaded
+ */
+std::shared_ptr<DataSource> PlayerController::loadAsset(const char *filename,
+        const AudioProperties targetProperties,
+        bool allowStreaming,
+        bool isLooping) {
+    return SourceCache::getInstance().getOrLoad(filename, targetProperties, [&](){
+        return loadUncachedAsset(filename, targetProperties, allowStreaming, isLooping);
+    });
 }
+
+/**
+ * Long tracks are decoded while they play if allowed. Other assets come from the PCM cache when
+ * it has a decoded copy, or are decoded up front and added to the PCM cache.
+ *
+ * @return the data source or nullptr if the asset couldn't be loaded
+ */
+std::shared_ptr<DataSource> PlayerController::loadUncachedAsset(const char *filename,
+        const AudioProperties targetProperties,
+        bool allowStreaming,
+        bool isLooping) {
+
+    // streamed tracks never go through the PCM cache, so they don't need a hash either
+    if (allowStreaming && isStreamingAsset(filename)){
+        return std::shared_ptr<DataSource>{
+            StreamingDataSource::newFromCompressedAsset(mAssetManager, filename, targetProperties, isLooping)
+        };
+    }
+
+    uint64_t sourceHash = 0;
+    if (mPcmCache){
+        AAsset *asset = AAssetManager_open(&mAssetManager, filename, AASSET_MODE_RANDOM);
+        if (!asset){
+            LOGE("Failed to open asset %s", filename);
+            return nullptr;
+        }
+        sourceHash = PcmCache::hashAsset(asset);
+        AAsset_close(asset);
+
+        std::shared_ptr<DataSource> cachedSource = mPcmCache->load(filename, targetProperties,
+                kDecodedSampleFormat, sourceHash);
+        if (cachedSource != nullptr) return cachedSource;
+    }
+
+    int64_t decodeStartTime = nowUptimeMillis();
+    DecodeThroughput throughput;
+    std::shared_ptr<DataSource> source{
+        AAssetDataSource::newFromCompressedAsset(mAssetManager, filename, targetProperties, kDecodedSampleFormat,
+                                                 &throughput)
+    };
+    if (source != nullptr) mMetrics.recordDecode(nowUptimeMillis() - decodeStartTime, throughput);
+    if (source != nullptr && mPcmCache) mPcmCache->store(filename, *source, sourceHash);
+    return source;
+}
+
+/**
+ * @param filename : name of the asset audio file
+ * @return true if the compressed asset is big enough that it should be streamed
+ */
+bool PlayerController::isStreamingAsset(const char *filename) {
+    AAsset *asset = AAssetManager_open(&mAssetManager, filename, AASSET_MODE_UNKNOWN);
+    if (!asset) return false;
+
+    off_t assetSize = AAsset_getLength(asset);
+    AAsset_close(asset);
+    return assetSize >= kStreamingThresholdBytes;
+}
+
 /**
  * sets the file name to class variable.
  * @param filename : name of asset audio file
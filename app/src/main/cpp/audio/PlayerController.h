@@ -9,25 +9,149 @@
 #include <oboe/Oboe.h>
 #include "Player.h"
 #include "AAssetDataSource.h"
+#include "StreamingDataSource.h"
+#include "PcmCache.h"
+#include "SourceCache.h"
+#include "AudioMetrics.h"
+#include "LatencyTuner.h"
+#include "PlaybackClock.h"
+#include "RenderGraph.h"
 #include "future"
+#include "deque"
+#include "string"
+#include "thread"
+#include "mutex"
+#include "condition_variable"
 
 using namespace oboe;
 
+// Compressed assets of at least this size are streamed instead of being decoded up front
+constexpr off_t kStreamingThresholdBytes = 4 * 1024 * 1024;
+
+constexpr int32_t kStreamChannelCount = kRenderChannelCount;
+
+// Sample rate sounds are decoded to when neither the stream nor the app has told the native one
+constexpr int32_t kFallbackSampleRate = 48000;
+
+// How often the preload thread checks whether the audio callback has moved on to the next track
+constexpr auto kPreloadPollInterval = std::chrono::milliseconds(50);
+
+// Fully decoded assets are kept as int16, which is what the NDK decoder produces anyway and
+// takes half the memory of float
+constexpr SampleFormat kDecodedSampleFormat = SampleFormat::I16;
+
 enum class PlayerControllerState{
     Loading,
     Playing,
     FailedToLoad
 };
 
+/**
+ * Plays a track, the tracks queued after it and sound effects over them.
+ *
+ * Transport controls don't touch the track directly, they are passed to the audio callback as
+ * commands through a TransportQueue. A command applies at the start of the next callback or,
+ * given a stream frame, exactly on that frame. So the controls never race the callback or make
+ * it wait. What the callback renders is a RenderGraph, which works without a stream as well.
+ */
 class PlayerController : public AudioStreamDataCallback, AudioStreamErrorCallback{
 
 public:
     explicit PlayerController(AAssetManager&);
+    ~PlayerController();
+
+    /**
+     * Loads the track and starts the stream, or resumes the track if it is loaded already.
+     */
     void start(char *fileName);
     void stop();
     void pause();
 
-    bool paused=false;
+    /**
+     * Decode a short sound so it can be played over the track with playSound(). Sounds are
+     * decoded to the sample rate of the stream, so they play at the wrong pitch if the stream is
+     * reopened at another rate, say after the output device changed.
+     * @return the sound id or -1 on failure
+     */
+    int32_t loadSound(const char *fileName);
+    bool playSound(int32_t soundId, float gain, float pan);
+
+    /**
+     * Move the track to the given position, ignored until the track has been loaded.
+     */
+    void seekToMillis(int64_t positionMillis);
+
+    /**
+     * Add a track to play after the current one. The next track is loaded in the background
+     * while the current one plays and follows it without a gap. The current track stops looping.
+     */
+    void enqueueTrack(const char *fileName);
+
+    /**
+     * Play the track and the ones after it faster or slower, see Player::setSpeed().
+     */
+    void setPlaybackSpeed(float speed, SpeedMode mode);
+
+    void setLooping(bool isLooping);
+
+    /**
+     * @param gain : linear gain of the track, sounds aren't affected
+     */
+    void setTrackGain(float gain);
+
+    /**
+     * Applies a command on the frame of the stream it is scheduled for, see getStreamFrame().
+     * Commands for a frame which has passed already apply at the start of the next callback, the
+     * ones scheduled while the track is loading once it plays.
+     *
+     * @return false if the track failed to load or too many commands are pending
+     */
+    bool scheduleCommand(const TransportCommand &command);
+
+    /**
+     * Master effects, they apply to the track and the sounds and may be changed from any thread.
+     * New values glide in over a few blocks.
+     */
+    void setEqBand(int32_t band, EqBandType type, float frequency, float gainDecibels, float q);
+    void setCompressor(float thresholdDecibels, float ratio, float attackMillis, float releaseMillis,
+                       float makeupDecibels);
+    void setLimiter(float ceilingDecibels, float releaseMillis);
+
+    /**
+     * Whether integer output is dithered, on by default. Float streams are never dithered.
+     */
+    void setDither(bool isEnabled) { mGraph.setDither(isEnabled); }
+
+    /**
+     * @return the sample format the stream opened with, Unspecified before it is open
+     */
+    AudioFormat getOutputFormat() const { return mOutputFormat.load(std::memory_order_relaxed); }
+
+    /**
+     * @return frames rendered by the streams so far, the clock commands are scheduled by
+     */
+    int64_t getStreamFrame() const { return mGraph.getStreamFrame(); }
+
+    /**
+     * The position of the track which is audible right now, output latency included. Cheap
+     * enough to be polled every frame of the UI, from any thread.
+     */
+    double getPositionMillis() const { return mClock.getPositionMillis(); }
+    PlaybackClockSnapshot getClockSnapshot() const { return mClock.getSnapshot(); }
+
+    /**
+     * Enables the on-disk cache of decoded assets, call before start().
+     * @param directory : a writable directory such as the app's cache directory
+     */
+    void setCacheDirectory(const char *directory);
+
+    AudioMetricsSnapshot getMetrics() const { return mMetrics.getSnapshot(); }
+
+    /**
+     * The buffer size the latency tuner settled on so far, see LatencyTuner.
+     */
+    LatencySnapshot getLatency() const { return mLatencyTuner.getSnapshot(); }
+    std::vector<LatencyChange> getLatencyHistory() { return mLatencyTuner.getHistory(); }
 
     // Inherited from oboe::AudioStreamDataCallback
     DataCallbackResult onAudioReady(AudioStream *oboeStream, void* audioData, int32_t numFrames) override ;
@@ -38,19 +162,42 @@ public:
 private:
     AAssetManager& mAssetManager;
     std::shared_ptr<AudioStream> mAudioStream;
-    std::atomic<int64_t> mCurrentFrame{0};
-    std::atomic<int64_t> mSongPosition{0};
+    std::atomic<float> mPlaybackSpeed{1.0f};
+    std::atomic<SpeedMode> mSpeedMode{SpeedMode::Linear};
     std::atomic<PlayerControllerState> mControllerState{PlayerControllerState::Loading};
     std::future<void> mLoadingResult;
-    std::atomic<int64_t> mLastUpdateTime { 0 };
+    AudioMetrics mMetrics;
+    PlaybackClock mClock;
+    LatencyTuner mLatencyTuner;
+    std::atomic<AudioFormat> mOutputFormat{AudioFormat::Unspecified};
+    // rate the sounds loaded so far were decoded to, 0 before the first one
+    std::atomic<int32_t> mSoundSampleRate{0};
+
+    // the preload thread is the one which hands it the next track
+    RenderGraph mGraph;
 
     char* trackFilename;
 
-    std::unique_ptr<Player> mTrack;
+    std::deque<std::string> mPlaylist;
+    // what the stream opened with, copied so the preload thread never touches the stream
+    AudioProperties mStreamProperties{};
+    std::mutex mPlaylistLock;
+    std::condition_variable mPlaylistCondition;
+    bool mIsShuttingDown = false;
+    std::thread mPreloadThread;
+    std::unique_ptr<PcmCache> mPcmCache;
 
     void load();
     bool openStream();
     bool setupAudioSources();
+    std::unique_ptr<Player> newTrackPlayer(const char *filename, AudioProperties targetProperties, bool isLooping);
+    void preloadLoop();
+    void publishClock(AudioStream *oboeStream, int64_t bufferEndFrame);
+    bool isStreamingAsset(const char *filename);
+    std::shared_ptr<DataSource> loadAsset(const char *filename, AudioProperties targetProperties,
+            bool allowStreaming, bool isLooping = true);
+    std::shared_ptr<DataSource> loadUncachedAsset(const char *filename, AudioProperties targetProperties,
+            bool allowStreaming, bool isLooping);
     void setAudioTrackFilename(char *filename);
 
 };
@@ -0,0 +1,143 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+#include <algorithm>
+#include "RenderGraph.h"
+#include "../utils/UtilityFunctions.h"
+#include "../dsp/SampleKernels.h"
+
+void RenderGraph::prepare(int32_t sampleRate) {
+    mSampleRate = sampleRate;
+    mMasterEffects.prepare(sampleRate);
+}
+
+void RenderGraph::setTrack(std::unique_ptr<Player> track) {
+    mTrack = std::move(track);
+    mIsTrackPaused = false;
+    mPositionFrames.store(0, std::memory_order_relaxed);
+    mPositionRemainder = 0;
+}
+
+void RenderGraph::setNextTrack(std::unique_ptr<Player> track) {
+    mNextTrack = std::move(track);
+    mIsNextTrackReady.store(true, std::memory_order_release);
+}
+
+/**
+ * Runs on the render thread, with the track all to itself.
+ */
+void RenderGraph::applyCommand(const TransportCommand &command) {
+    switch (command.type){
+        case TransportCommandType::Play:
+            mIsTrackPaused = false;
+            if (!mTrack->isPlaying()){
+                // the track has ended and starts over, a streaming source has to be rewound as
+                // the play head doesn't apply to it
+                mTrack->seekToFrame(0);
+                mTrack->setPlaying(true);
+                mPositionFrames.store(0, std::memory_order_relaxed);
+                mPositionRemainder = 0;
+            }
+            break;
+        case TransportCommandType::Pause:
+            mIsTrackPaused = true;
+            break;
+        case TransportCommandType::Stop:
+            mIsTrackPaused = true;
+            mTrack->seekToFrame(0);
+            mPositionFrames.store(0, std::memory_order_relaxed);
+            mPositionRemainder = 0;
+            break;
+        case TransportCommandType::SetLooping:
+            mTrack->setLooping(command.isLooping);
+            break;
+        case TransportCommandType::Seek:
+            mTrack->seekToMillis(command.positionMillis);
+            // the reported position counts frames of the output
+            mPositionFrames.store(convertMillisToFrames(command.positionMillis, mSampleRate), std::memory_order_relaxed);
+            mPositionRemainder = 0;
+            break;
+        case TransportCommandType::SetGain:
+            mTargetTrackGain = command.gain;
+            break;
+        case TransportCommandType::SetSpeed:
+            // the processors were allocated along with the player, this doesn't allocate
+            mTrack->setSpeed(command.speed, command.speedMode);
+            break;
+    }
+}
+
+/**
+ * Renders the track and the sounds, with the master effects, as float.
+ */
+void RenderGraph::renderMix(float *audioData, int32_t numFrames) {
+    // The buffer is rendered in segments which end where the next command is due, so every
+    // command lands on its frame
+    mTransport.receive();
+    int64_t streamFrame = mStreamFrame.load(std::memory_order_relaxed);
+    for (int32_t frame = 0; frame < numFrames;){
+        TransportCommand command;
+        while (mTransport.popDue(streamFrame, command)) applyCommand(command);
+
+        const int32_t segmentFrames = mTransport.getFramesUntilNext(streamFrame, numFrames - frame);
+        renderTrack(&audioData[frame * kRenderChannelCount], segmentFrames);
+        frame += segmentFrames;
+        streamFrame += segmentFrames;
+    }
+    mStreamFrame.store(streamFrame, std::memory_order_relaxed);
+    mMixer.renderAudio(audioData, numFrames);
+    mMasterEffects.process(audioData, numFrames);
+}
+
+/**
+ * Renders a segment of the buffer with the track, or silence while it is paused.
+ */
+void RenderGraph::renderTrack(float *audioData, int32_t numFrames) {
+    if (mIsTrackPaused){
+        getSampleKernels().clear(audioData, numFrames * kRenderChannelCount);
+        return;
+    }
+
+    int32_t framesRendered = mTrack->renderAudio(audioData, numFrames);
+    int64_t positionFrames = mPositionFrames.load(std::memory_order_relaxed);
+    if (switchToNextTrack(audioData, framesRendered, numFrames)){
+        // the next track started framesRendered into this segment
+        positionFrames = -framesRendered;
+    }
+    applyTrackGain(audioData, numFrames);
+
+    // the track moves on by speed frames for every frame of the output
+    mPositionRemainder += numFrames * static_cast<double>(mTrack->getSpeed());
+    const auto framesPlayed = static_cast<int64_t>(mPositionRemainder);
+    mPositionRemainder -= framesPlayed;
+    mPositionFrames.store(positionFrames + framesPlayed, std::memory_order_relaxed);
+}
+
+/**
+ * Moves on to the preloaded track once the current one has ended, the next track starts on the
+ * frame after the last one of the current track.
+ *
+ * @param framesRendered : frames of audioData the current track rendered
+ * @return true if the track was switched
+ */
+bool RenderGraph::switchToNextTrack(float *audioData, int32_t framesRendered, int32_t numFrames) {
+    if (mTrack->isPlaying() || !mIsNextTrackReady.load(std::memory_order_acquire)) return false;
+
+    mTrack.swap(mNextTrack);
+    mIsNextTrackReady.store(false, std::memory_order_release);
+    mTrack->renderAudio(&audioData[framesRendered * kRenderChannelCount], numFrames - framesRendered);
+    return true;
+}
+
+void RenderGraph::applyTrackGain(float *audioData, int32_t numFrames) {
+    int32_t rampFrames = 0;
+    if (mTrackGain != mTargetTrackGain){
+        rampFrames = std::min(numFrames, kTrackGainRampFrames);
+        getSampleKernels().applyGainRamp(audioData, rampFrames, kRenderChannelCount, mTrackGain, mTargetTrackGain);
+        mTrackGain = mTargetTrackGain;
+    }
+    if (mTrackGain != 1.0f){
+        getSampleKernels().applyGain(&audioData[rampFrames * kRenderChannelCount],
+                (numFrames - rampFrames) * kRenderChannelCount, mTrackGain);
+    }
+}
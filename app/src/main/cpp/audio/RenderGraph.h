@@ -0,0 +1,164 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_RENDERGRAPH_H
+#define OBOE_AUDIO_PLAYER_RENDERGRAPH_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "Player.h"
+#include "Mixer.h"
+#include "BiquadEq.h"
+#include "Compressor.h"
+#include "EffectChain.h"
+#include "Limiter.h"
+#include "OutputFormat.h"
+#include "TransportQueue.h"
+
+constexpr int32_t kRenderChannelCount = 2;
+
+// A gain change of the track is ramped over this many frames to avoid a click
+constexpr int32_t kTrackGainRampFrames = 64;
+
+// EQ bands of the master effects, a low shelf, a peak and a high shelf by default
+constexpr int32_t kMasterEqBands = 3;
+
+// Everything the graph renders goes through these
+using MasterEffectChain = EffectChain<kRenderChannelCount,
+        BiquadEq<kRenderChannelCount, kMasterEqBands>,
+        Compressor<kRenderChannelCount>,
+        Limiter<kRenderChannelCount>>;
+
+// Output which isn't float is rendered into a float buffer of this many frames at a time and
+// converted from there
+constexpr int32_t kRenderBufferFrames = 512;
+
+/**
+ * Everything the audio callback of PlayerController renders, without the stream: the track and
+ * the one queued after it, the transport commands, the sounds, the master effects and the
+ * conversion to the output sample type. OfflineRenderer drives it the same way the callback does.
+ *
+ * render() and the getters documented as such belong to the audio thread. scheduleCommand(),
+ * setDither() and the mixer and effect controls may be called from any thread. The next track is
+ * handed over with setNextTrack() by a single loading thread, see there.
+ */
+class RenderGraph{
+public:
+    /**
+     * Resets the effects for the sample rate of the output, while nothing renders.
+     */
+    void prepare(int32_t sampleRate);
+
+    /**
+     * Replaces the track and starts its position at 0, while nothing renders.
+     */
+    void setTrack(std::unique_ptr<Player> track);
+
+    /**
+     * @return false if too many commands are pending
+     */
+    bool scheduleCommand(const TransportCommand &command) { return mTransport.push(command); }
+
+    /**
+     * The loading thread owns the next track while it isn't ready. The render thread takes it
+     * once the current track ends and leaves the finished track in its place, so the finished
+     * track is never destroyed on the render thread.
+     *
+     * @return true while a next track is waiting to be played
+     */
+    bool isNextTrackReady() const { return mIsNextTrackReady.load(std::memory_order_acquire); }
+
+    /**
+     * Loading thread only, while isNextTrackReady() is false.
+     * @return the track the render thread moved on from, if any
+     */
+    std::unique_ptr<Player> takeFinishedTrack() { return std::move(mNextTrack); }
+
+    /**
+     * Loading thread only, while isNextTrackReady() is false.
+     */
+    void setNextTrack(std::unique_ptr<Player> track);
+
+    Mixer &getMixer() { return mMixer; }
+    MasterEffectChain &getMasterEffects() { return mMasterEffects; }
+
+    /**
+     * Whether integer output is dithered, on by default. Float output is never dithered.
+     */
+    void setDither(bool isEnabled) { mIsDitherEnabled.store(isEnabled, std::memory_order_relaxed); }
+
+    /**
+     * Fills the buffer with the mix. Float output is mixed in place, other sample types through
+     * the render buffer and converted.
+     */
+    void render(float *audioData, int32_t numFrames) { renderMix(audioData, numFrames); }
+    template <typename Sample>
+    void render(Sample *audioData, int32_t numFrames) { renderConverted(audioData, numFrames); }
+
+    /**
+     * @return frames rendered so far, the clock commands are scheduled by
+     */
+    int64_t getStreamFrame() const { return mStreamFrame.load(std::memory_order_relaxed); }
+
+    /**
+     * @return frame of the track the next render starts at
+     */
+    int64_t getPositionFrames() const { return mPositionFrames.load(std::memory_order_relaxed); }
+
+    /**
+     * @return frames of the track played per rendered frame, 0 while paused. Render thread only.
+     */
+    float getTrackSpeed() const { return mIsTrackPaused ? 0.0f : mTrack->getSpeed(); }
+
+private:
+    void renderMix(float *audioData, int32_t numFrames);
+    template <typename Sample>
+    void renderConverted(Sample *audioData, int32_t numFrames);
+    void renderTrack(float *audioData, int32_t numFrames);
+    bool switchToNextTrack(float *audioData, int32_t framesRendered, int32_t numFrames);
+    void applyCommand(const TransportCommand &command);
+    void applyTrackGain(float *audioData, int32_t numFrames);
+
+    int32_t mSampleRate = 48000;
+    std::atomic<int64_t> mStreamFrame{0};
+    std::atomic<int64_t> mPositionFrames{0};
+    // part of a track frame played but not yet counted in mPositionFrames, render thread only
+    double mPositionRemainder = 0;
+
+    TransportQueue mTransport;
+    // Render thread state
+    bool mIsTrackPaused = false;
+    float mTrackGain = 1.0f;
+    float mTargetTrackGain = 1.0f;
+
+    std::unique_ptr<Player> mTrack;
+    std::unique_ptr<Player> mNextTrack;
+    std::atomic<bool> mIsNextTrackReady{false};
+
+    Mixer mMixer{kRenderChannelCount};
+    MasterEffectChain mMasterEffects;
+
+    std::atomic<bool> mIsDitherEnabled{true};
+    OutputConverter mOutputConverter;
+    // the mix of output which isn't float, render thread only
+    float mRenderBuffer[kRenderBufferFrames * kRenderChannelCount];
+};
+
+/**
+ * Renders into the float render buffer and converts to the sample type of the output, a
+ * render buffer at a time.
+ */
+template <typename Sample>
+void RenderGraph::renderConverted(Sample *audioData, int32_t numFrames) {
+    const bool isDithered = mIsDitherEnabled.load(std::memory_order_relaxed);
+    for (int32_t frame = 0; frame < numFrames; frame += kRenderBufferFrames){
+        const int32_t chunkFrames = std::min(kRenderBufferFrames, numFrames - frame);
+        renderMix(mRenderBuffer, chunkFrames);
+        mOutputConverter.convert(mRenderBuffer, &audioData[frame * kRenderChannelCount],
+                chunkFrames * kRenderChannelCount, isDithered);
+    }
+}
+
+#endif //OBOE_AUDIO_PLAYER_RENDERGRAPH_H
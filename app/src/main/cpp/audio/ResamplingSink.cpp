@@ -0,0 +1,63 @@
+//
+// Created by 43975 on 2/1/2022.
+//
+#include <algorithm>
+#include <cstring>
+#include "ResamplingSink.h"
+#include "SampleKernels.h"
+
+ResamplingSink::ResamplingSink(PcmSink &target, SampleFormat format, int32_t channelCount,
+                               int32_t inputRate, int32_t outputRate, ResamplerQuality quality)
+:mTarget(target),
+mFormat(format),
+mChannelCount(channelCount),
+mResampler(channelCount, inputRate, outputRate, quality){
+    const int32_t maxOutputFrames = std::max(mResampler.getMaxOutputFrames(kResamplerBlockFrames),
+                                             mResampler.getMaxFlushFrames());
+    mInput.resize(kResamplerBlockFrames * channelCount);
+    mOutput.resize(maxOutputFrames * channelCount);
+    if (format == SampleFormat::I16) mOutputI16.resize(mOutput.size());
+}
+
+bool ResamplingSink::onDecodedData(const uint8_t *data, int64_t numBytes) {
+    const SampleKernels &kernels = getSampleKernels();
+    const int32_t bytesPerFrame = getBytesPerSample(mFormat) * mChannelCount;
+    int64_t numFrames = numBytes / bytesPerFrame;
+
+    while (numFrames > 0){
+        const int32_t blockFrames = static_cast<int32_t>(std::min<int64_t>(numFrames, kResamplerBlockFrames));
+        if (mFormat == SampleFormat::I16){
+            kernels.convertI16ToFloat(reinterpret_cast<const int16_t *>(data), mInput.data(),
+                                      blockFrames * mChannelCount);
+        } else {
+            // the decoders don't guarantee any alignment
+            memcpy(mInput.data(), data, blockFrames * bytesPerFrame);
+        }
+
+        int32_t framesOutput = mResampler.process(mInput.data(), blockFrames, mOutput.data());
+        if (!writeToTarget(framesOutput)) return false;
+
+        data += blockFrames * bytesPerFrame;
+        numFrames -= blockFrames;
+    }
+    return true;
+}
+
+bool ResamplingSink::finish() {
+    return writeToTarget(mResampler.flush(mOutput.data()));
+}
+
+bool ResamplingSink::writeToTarget(int32_t numFrames) {
+    if (numFrames == 0) return true;
+    const int32_t numSamples = numFrames * mChannelCount;
+    const uint8_t *data;
+    if (mFormat == SampleFormat::I16){
+        getSampleKernels().convertFloatToI16(mOutput.data(), mOutputI16.data(), numSamples);
+        data = reinterpret_cast<const uint8_t *>(mOutputI16.data());
+    } else {
+        data = reinterpret_cast<const uint8_t *>(mOutput.data());
+    }
+    const int64_t numBytes = static_cast<int64_t>(numSamples) * getBytesPerSample(mFormat);
+    mBytesWritten += numBytes;
+    return mTarget.onDecodedData(data, numBytes);
+}
@@ -0,0 +1,53 @@
+//
+// Created by 43975 on 2/1/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_RESAMPLINGSINK_H
+#define OBOE_AUDIO_PLAYER_RESAMPLINGSINK_H
+
+#include <cstdint>
+#include <vector>
+#include "PcmSink.h"
+#include "SampleFormat.h"
+#include "Resampler.h"
+
+/**
+ * Converts the sample rate of decoded data on its way to another sink, so an extractor can
+ * decode at the rate of the file and hand over data at the rate of the stream.
+ * The samples stay in the format they were decoded to, float or int16.
+ */
+class ResamplingSink : public PcmSink{
+public:
+    ResamplingSink(PcmSink &target, SampleFormat format, int32_t channelCount,
+                   int32_t inputRate, int32_t outputRate,
+                   ResamplerQuality quality = ResamplerQuality::Medium);
+
+    /**
+     * @param data : whole frames in the format given to the constructor
+     */
+    bool onDecodedData(const uint8_t *data, int64_t numBytes) override;
+
+    /**
+     * Hand the tail of the filter to the target once the decoder is done.
+     * @return false if the target stopped the decoding
+     */
+    bool finish();
+
+    // Bytes handed to the target so far
+    int64_t getBytesWritten() const { return mBytesWritten; }
+
+private:
+    bool writeToTarget(int32_t numFrames);
+
+    PcmSink &mTarget;
+    const SampleFormat mFormat;
+    const int32_t mChannelCount;
+    Resampler mResampler;
+
+    std::vector<float> mInput;
+    std::vector<float> mOutput;
+    std::vector<int16_t> mOutputI16;
+    int64_t mBytesWritten = 0;
+};
+
+#endif //OBOE_AUDIO_PLAYER_RESAMPLINGSINK_H
@@ -0,0 +1,25 @@
+//
+// Created by 43975 on 1/25/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_SAMPLEFORMAT_H
+#define OBOE_AUDIO_PLAYER_SAMPLEFORMAT_H
+
+#include <cstdint>
+
+/**
+ * How decoded samples are stored in memory. Float is what the mixer works with, the others
+ * take half the memory and are converted to float as they are played.
+ */
+enum class SampleFormat : int32_t{
+    Float = 0,
+    I16 = 1,
+    // IEEE half precision, more dynamic range than I16 but only 11 bits of precision
+    Half = 2
+};
+
+inline int32_t getBytesPerSample(SampleFormat format){
+    return (format == SampleFormat::Float) ? sizeof(float) : sizeof(int16_t);
+}
+
+#endif //OBOE_AUDIO_PLAYER_SAMPLEFORMAT_H
@@ -0,0 +1,31 @@
+//
+// Created by 43975 on 1/27/2022.
+//
+#include <algorithm>
+#include "SeekIndex.h"
+
+void SeekIndex::addPacket(int64_t timestamp, int64_t bytePosition, int64_t frame) {
+    if (mIsComplete || timestamp <= mLastTimestamp) return;
+
+    if (mPacketCount % kPacketsPerSeekPoint == 0){
+        mPoints.push_back(SeekPoint{timestamp, bytePosition, frame});
+    }
+    mLastTimestamp = timestamp;
+    mLastFrame = frame;
+    ++mPacketCount;
+}
+
+bool SeekIndex::covers(int64_t frame) const {
+    return mIsComplete || (!mPoints.empty() && frame < mLastFrame);
+}
+
+const SeekPoint *SeekIndex::findPointBefore(int64_t frame) const {
+    if (mPoints.empty()) return nullptr;
+
+    auto next = std::upper_bound(mPoints.begin(), mPoints.end(), frame,
+            [](int64_t value, const SeekPoint &point){ return value < point.frame; });
+
+    // next is the first point after frame, step back past the point containing frame as well
+    auto index = std::max<std::ptrdiff_t>(0, (next - mPoints.begin()) - 2);
+    return &mPoints[index];
+}
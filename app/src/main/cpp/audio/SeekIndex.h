@@ -0,0 +1,64 @@
+//
+// Created by 43975 on 1/27/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_SEEKINDEX_H
+#define OBOE_AUDIO_PLAYER_SEEKINDEX_H
+
+#include <cstdint>
+#include <vector>
+
+// One seek point is kept for this many packets, which bounds the memory used by long files
+// while a seek only has to decode a handful of packets
+constexpr int32_t kPacketsPerSeekPoint = 4;
+
+struct SeekPoint{
+    // timestamp of the packet in the time base of its stream
+    int64_t timestamp;
+    // offset of the packet in the file, -1 if the demuxer doesn't know it
+    int64_t bytePosition;
+    // first frame decoded from the packet, at the source sample rate
+    int64_t frame;
+};
+
+/**
+ * Maps output positions to compressed packets so a seek can jump straight to the right place
+ * in the file instead of demuxing it from the start.
+ *
+ * The index is filled while the file is demuxed. Packets must be added in order without gaps,
+ * so only the packets after the last one added are taken and the rest are ignored. Not thread
+ * safe, it is meant to be owned by a decoder thread.
+ */
+class SeekIndex{
+public:
+    void addPacket(int64_t timestamp, int64_t bytePosition, int64_t frame);
+
+    /**
+     * Mark that every packet of the stream has been added.
+     */
+    void setComplete() { mIsComplete = true; }
+    bool isComplete() const { return mIsComplete; }
+    bool isEmpty() const { return mPoints.empty(); }
+
+    /**
+     * @return true if the index reaches far enough to seek to frame
+     */
+    bool covers(int64_t frame) const;
+
+    /**
+     * @return the last point at least one point before the one containing frame, so the
+     * decoder gets kPacketsPerSeekPoint packets of pre-roll. nullptr if the index is empty.
+     */
+    const SeekPoint *findPointBefore(int64_t frame) const;
+
+    const SeekPoint *getLastPoint() const { return mPoints.empty() ? nullptr : &mPoints.back(); }
+
+private:
+    std::vector<SeekPoint> mPoints;
+    int64_t mLastTimestamp = INT64_MIN;
+    int64_t mLastFrame = INT64_MIN;
+    int64_t mPacketCount = 0;
+    bool mIsComplete = false;
+};
+
+#endif //OBOE_AUDIO_PLAYER_SEEKINDEX_H
@@ -0,0 +1,89 @@
+//
+// Created by 43975 on 1/28/2022.
+//
+#include "SourceCache.h"
+
+SourceCache &SourceCache::getInstance() {
+    static SourceCache instance;
+    return instance;
+}
+
+std::shared_ptr<DataSource> SourceCache::getOrLoad(const std::string &name,
+                                                   AudioProperties properties,
+                                                   const Loader &load) {
+    const Key key{name, properties.channelCount, properties.sampleRate};
+
+    std::unique_lock<std::mutex> lock(mLock);
+    auto entry = mEntries.find(key);
+    if (entry != mEntries.end()){
+        ++mHits;
+        mLru.splice(mLru.begin(), mLru, entry->second.lruPosition);
+        return entry->second.source;
+    }
+
+    // somebody else is loading it already
+    auto pending = mPendingLoads.find(key);
+    if (pending != mPendingLoads.end()){
+        ++mWaits;
+        PendingLoad result = pending->second;
+        lock.unlock();
+        std::shared_ptr<DataSource> source = result.get();
+        // a streaming source can't be shared, load another one
+        if (source != nullptr && source->isStreaming()) return load();
+        return source;
+    }
+
+    ++mMisses;
+    std::promise<std::shared_ptr<DataSource>> promise;
+    mPendingLoads.emplace(key, promise.get_future().share());
+    lock.unlock();
+
+    std::shared_ptr<DataSource> source = load();
+
+    lock.lock();
+    mPendingLoads.erase(key);
+    if (source != nullptr && !source->isStreaming()) insert(key, source);
+    lock.unlock();
+
+    promise.set_value(source);
+    return source;
+}
+
+void SourceCache::setBudget(int64_t budgetBytes) {
+    std::lock_guard<std::mutex> lock(mLock);
+    mBudgetBytes = budgetBytes;
+    evictOverBudget();
+}
+
+void SourceCache::clear() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mEntries.clear();
+    mLru.clear();
+    mBytes = 0;
+}
+
+SourceCacheStats SourceCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return SourceCacheStats{mHits, mWaits, mMisses, mEvictions, mBytes};
+}
+
+void SourceCache::insert(const Key &key, const std::shared_ptr<DataSource> &source) {
+    const int64_t bytes = source->getSize() * getBytesPerSample(source->getSampleFormat());
+    // would only push everything else out
+    if (bytes > mBudgetBytes) return;
+
+    mLru.push_front(key);
+    mEntries[key] = Entry{source, bytes, mLru.begin()};
+    mBytes += bytes;
+    evictOverBudget();
+}
+
+void SourceCache::evictOverBudget() {
+    while (mBytes > mBudgetBytes && !mLru.empty()){
+        auto entry = mEntries.find(mLru.back());
+        mBytes -= entry->second.bytes;
+        mEntries.erase(entry);
+        mLru.pop_back();
+        ++mEvictions;
+    }
+}
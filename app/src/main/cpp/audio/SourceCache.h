@@ -0,0 +1,102 @@
+//
+// Created by 43975 on 1/28/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_SOURCECACHE_H
+#define OBOE_AUDIO_PLAYER_SOURCECACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "DataSource.h"
+
+// Decoded sources kept in memory by default, about six minutes of stereo int16 at 48kHz
+constexpr int64_t kDefaultSourceCacheBytes = 64 * 1024 * 1024;
+
+struct SourceCacheStats{
+    int64_t hits;
+    // requests which found the source still loading for another caller and waited for it
+    int64_t waits;
+    int64_t misses;
+    int64_t evictions;
+    int64_t bytes;
+};
+
+/**
+ * Process wide cache of decoded data sources, keyed by asset name and target properties, so
+ * that playing an asset again shares the source instead of decoding it again.
+ *
+ * The least recently used sources are dropped once the cache holds more than its budget.
+ * A dropped source stays alive for as long as a player still uses it. When several threads
+ * ask for the same source at once only one of them loads it, the others wait for the result.
+ * Streaming sources belong to a single player and are never kept.
+ */
+class SourceCache{
+public:
+    using Loader = std::function<std::shared_ptr<DataSource>()>;
+
+    static SourceCache &getInstance();
+
+    explicit SourceCache(int64_t budgetBytes = kDefaultSourceCacheBytes):mBudgetBytes(budgetBytes){}
+
+    /**
+     * @param load : called to create the source when it isn't in the cache
+     * @return the cached or loaded source, nullptr if loading failed
+     */
+    std::shared_ptr<DataSource> getOrLoad(const std::string &name, AudioProperties properties,
+                                          const Loader &load);
+
+    void setBudget(int64_t budgetBytes);
+    void clear();
+    SourceCacheStats getStats() const;
+
+private:
+    struct Key{
+        std::string name;
+        int32_t channelCount;
+        int32_t sampleRate;
+
+        bool operator==(const Key &other) const {
+            return channelCount == other.channelCount && sampleRate == other.sampleRate && name == other.name;
+        }
+    };
+
+    struct KeyHash{
+        size_t operator()(const Key &key) const {
+            return std::hash<std::string>()(key.name) ^
+                   (static_cast<size_t>(key.channelCount) << 24) ^ static_cast<size_t>(key.sampleRate);
+        }
+    };
+
+    struct Entry{
+        std::shared_ptr<DataSource> source;
+        int64_t bytes;
+        std::list<Key>::iterator lruPosition;
+    };
+
+    using PendingLoad = std::shared_future<std::shared_ptr<DataSource>>;
+
+    void insert(const Key &key, const std::shared_ptr<DataSource> &source);
+    void evictOverBudget();
+
+    mutable std::mutex mLock;
+    int64_t mBudgetBytes;
+    int64_t mBytes = 0;
+
+    // most recently used at the front
+    std::list<Key> mLru;
+    std::unordered_map<Key, Entry, KeyHash> mEntries;
+    std::unordered_map<Key, PendingLoad, KeyHash> mPendingLoads;
+
+    int64_t mHits = 0;
+    int64_t mWaits = 0;
+    int64_t mMisses = 0;
+    int64_t mEvictions = 0;
+};
+
+#endif //OBOE_AUDIO_PLAYER_SOURCECACHE_H
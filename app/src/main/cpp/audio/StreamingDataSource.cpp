@@ -0,0 +1,198 @@
+//
+// Created by 43975 on 1/8/2022.
+//
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include "../utils/logging.h"
+#include "../utils/UtilityFunctions.h"
+#include "../dsp/SampleKernels.h"
+#include "StreamingDataSource.h"
+
+#if !defined(USE_FFMPEG)
+#error USE_FFMPEG should be defined in app.gradle
+#endif
+
+#if USE_FFMPEG==1
+    #include "FFMpegExtractor.h"
+#else
+    #include "NDKExtractor.h"
+#endif
+
+// How much decoded audio is kept ahead of the play head
+constexpr int64_t kWindowDurationMillis{2000};
+
+// The NDK decoder produces int16, which is converted to float in blocks of this many samples
+constexpr int64_t kConversionBufferSamples{4096};
+
+// How long the decoder thread waits for the audio callback when the window is full
+constexpr auto kDecoderBackoff = std::chrono::milliseconds(10);
+
+StreamingDataSource* StreamingDataSource::newFromCompressedAsset(AAssetManager &assetManager,
+        const char *filename,
+        const AudioProperties targetProperties,
+        bool isLooping) {
+
+    int64_t loadStartTime = nowUptimeMillis();
+
+    AAsset *asset = AAssetManager_open(&assetManager, filename, AASSET_MODE_STREAMING);
+    if (!asset)
+    {
+        LOGE("Failed to open asset %s",filename);
+        return nullptr;
+    }
+    LOGD("Streaming %s, size %ld",filename,AAsset_getLength(asset));
+
+    auto source = new StreamingDataSource(asset, targetProperties, isLooping);
+    source->mLoadStartTime = loadStartTime;
+
+    // only start decoding once the object is fully constructed
+    source->mDecoderThread = std::thread(&StreamingDataSource::decodeLoop, source);
+    return source;
+}
+
+StreamingDataSource::StreamingDataSource(AAsset *asset, const AudioProperties properties, bool isLooping)
+:mAsset(asset),
+mProperties(properties),
+mIsLooping(isLooping),
+mWindow(static_cast<int32_t>(properties.sampleRate * kWindowDurationMillis / kMillisecondsInSecond *
+        properties.channelCount)){
+
+#if USE_FFMPEG!=1
+    mConversionBuffer = std::make_unique<float[]>(kConversionBufferSamples);
+#endif
+}
+
+StreamingDataSource::~StreamingDataSource() {
+    mIsStopRequested = true;
+    if (mDecoderThread.joinable()) mDecoderThread.join();
+    AAsset_close(mAsset);
+}
+
+/**
+ * Runs on the decoder thread. Decodes the asset into the window, starting over from the
+ * beginning when looping. At the end of a stream which doesn't loop it waits for a seek.
+ */
+void StreamingDataSource::decodeLoop() {
+    int64_t startFrame = 0;
+    while (!mIsStopRequested){
+        int64_t bytesDecoded = decodeFrom(startFrame);
+
+        if (mPendingSeekFrame.load(std::memory_order_acquire) < 0){
+            if (bytesDecoded <= 0) LOGE("Streaming decode failed, nothing was decoded");
+            if (mIsLooping && bytesDecoded > 0){
+                startFrame = 0;
+                continue;
+            }
+
+            mIsDecodeFinished = true;
+            while (!mIsStopRequested && mPendingSeekFrame.load(std::memory_order_acquire) < 0){
+                std::this_thread::sleep_for(kDecoderBackoff);
+            }
+            if (mIsStopRequested) break;
+            mIsDecodeFinished = false;
+        }
+        startFrame = flushForSeek();
+    }
+
+    mIsDecodeFinished = true;
+}
+
+int64_t StreamingDataSource::decodeFrom(int64_t startFrame) {
+    AAsset_seek(mAsset, 0, SEEK_SET);
+
+#if USE_FFMPEG==1
+    return FFMpegExtractor::decode(mAsset, *this, mProperties, &mSeekIndex, startFrame);
+#else
+    return NDKExtractor::decode(mAsset, *this, mProperties, startFrame);
+#endif
+}
+
+/**
+ * Waits for the audio callback to throw away the audio decoded before the seek.
+ *
+ * @return the frame to continue decoding from
+ */
+int64_t StreamingDataSource::flushForSeek() {
+    mIsFlushRequested.store(true, std::memory_order_release);
+    int64_t seekFrame = mPendingSeekFrame.exchange(-1, std::memory_order_acq_rel);
+    while (mIsFlushRequested.load(std::memory_order_acquire) && !mIsStopRequested){
+        std::this_thread::sleep_for(kDecoderBackoff);
+    }
+    LOGD("Seeking to frame %" PRId64, seekFrame);
+    return seekFrame;
+}
+
+bool StreamingDataSource::seekToFrame(int64_t frameIndex) {
+    mPendingSeekFrame.store(std::max<int64_t>(0, frameIndex), std::memory_order_release);
+    return true;
+}
+
+bool StreamingDataSource::onDecodedData(const uint8_t *data, int64_t numBytes) {
+    if (!mHasDecodedFirstBlock){
+        mHasDecodedFirstBlock = true;
+        LOGD("First audio block decoded after %" PRId64 " ms", nowUptimeMillis() - mLoadStartTime);
+    }
+
+#if USE_FFMPEG==1
+    return writeSamples(reinterpret_cast<const float *>(data), numBytes / sizeof(float));
+#else
+    // The NDK decoder can only decode to int16, we need to convert to floats
+    auto samples = reinterpret_cast<const int16_t *>(data);
+    int64_t numSamples = numBytes / sizeof(int16_t);
+    while (numSamples > 0){
+        int64_t samplesToConvert = std::min(numSamples, kConversionBufferSamples);
+        getSampleKernels().convertI16ToFloat(samples, mConversionBuffer.get(), samplesToConvert);
+        if (!writeSamples(mConversionBuffer.get(), samplesToConvert)) return false;
+        samples += samplesToConvert;
+        numSamples -= samplesToConvert;
+    }
+    return true;
+#endif
+}
+
+/**
+ * Copies the samples into the window, waiting for the audio callback to make room when it is full.
+ *
+ * @return false if the source is being destroyed or seeked and decoding should stop
+ */
+bool StreamingDataSource::writeSamples(const float *data, int64_t numSamples) {
+    while (numSamples > 0){
+        if (mIsStopRequested || mPendingSeekFrame.load(std::memory_order_relaxed) >= 0) return false;
+
+        int32_t samplesWritten = mWindow.write(data,
+                static_cast<int32_t>(std::min<int64_t>(numSamples, mWindow.getCapacity())));
+        if (samplesWritten == 0){
+            std::this_thread::sleep_for(kDecoderBackoff);
+            continue;
+        }
+        data += samplesWritten;
+        numSamples -= samplesWritten;
+    }
+    return true;
+}
+
+int32_t StreamingDataSource::readFrames(float *targetData, int32_t numFrames) {
+    // audio from before a seek is never played, the decoder has stopped writing once it asks
+    // for the flush so everything in the window can be dropped
+    if (mIsFlushRequested.load(std::memory_order_acquire)){
+        mWindow.discard();
+        mIsFlushRequested.store(false, std::memory_order_release);
+        return 0;
+    }
+    if (mPendingSeekFrame.load(std::memory_order_relaxed) >= 0) return 0;
+
+    int32_t availableFrames = mWindow.getAvailableToRead() / mProperties.channelCount;
+    int32_t framesToRead = std::min(numFrames, availableFrames);
+    mWindow.read(targetData, framesToRead * mProperties.channelCount);
+    return framesToRead;
+}
+
+bool StreamingDataSource::isEndOfStream() const {
+    // a seek after the end starts the stream again, even before the decoder thread has seen it
+    if (mPendingSeekFrame.load(std::memory_order_acquire) >= 0 || mIsFlushRequested.load(std::memory_order_acquire)){
+        return false;
+    }
+    return mIsDecodeFinished.load(std::memory_order_acquire) && mWindow.getAvailableToRead() == 0;
+}
@@ -0,0 +1,85 @@
+//
+// Created by 43975 on 1/8/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_STREAMINGDATASOURCE_H
+#define OBOE_AUDIO_PLAYER_STREAMINGDATASOURCE_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <android/asset_manager.h>
+#include "DataSource.h"
+#include "PcmSink.h"
+#include "SeekIndex.h"
+#include "SpscRingBuffer.h"
+
+/**
+ * Data source which decodes the asset on a background thread while it is being played.
+ *
+ * Only a fixed window of decoded audio is kept in memory, so memory use doesn't depend on
+ * the length of the track and playback can begin as soon as the first block is decoded.
+ * The decoder thread writes into the window and the audio callback reads from it, a streaming
+ * source therefore must only be used by a single Player.
+ */
+class StreamingDataSource : public DataSource, private PcmSink{
+
+public:
+    ~StreamingDataSource();
+
+    // The length of a stream isn't known until it has been decoded completely
+    int64_t getSize() const override { return 0; }
+    AudioProperties getProperties() const override { return mProperties; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        contiguousFrames = 0;
+        return nullptr;
+    }
+
+    bool isStreaming() const override { return true; }
+    int32_t readFrames(float *targetData, int32_t numFrames) override;
+    bool isEndOfStream() const override;
+    bool seekToFrame(int64_t frameIndex) override;
+    void setLooping(bool isLooping) override { mIsLooping = isLooping; }
+
+    static StreamingDataSource* newFromCompressedAsset(AAssetManager &assetManager,
+            const char* filename,
+            AudioProperties targetProperties,
+            bool isLooping);
+
+private:
+    StreamingDataSource(AAsset *asset, const AudioProperties properties, bool isLooping);
+
+    // Inherited from PcmSink, called on the decoder thread
+    bool onDecodedData(const uint8_t *data, int64_t numBytes) override;
+
+    void decodeLoop();
+    int64_t decodeFrom(int64_t startFrame);
+    int64_t flushForSeek();
+    bool writeSamples(const float *data, int64_t numSamples);
+
+    AAsset *mAsset;
+    const AudioProperties mProperties;
+    std::atomic<bool> mIsLooping;
+
+    // Written by the decoder thread, read by the audio callback
+    SpscRingBuffer<float> mWindow;
+    std::unique_ptr<float[]> mConversionBuffer;
+
+    std::atomic<bool> mIsStopRequested{false};
+    std::atomic<bool> mIsDecodeFinished{false};
+
+    // Set by seekToFrame(), the decoder thread takes it and asks the audio callback to empty the
+    // window before decoding from the new position
+    std::atomic<int64_t> mPendingSeekFrame{-1};
+    std::atomic<bool> mIsFlushRequested{false};
+
+    // Only used by the decoder thread, kept across loops and seeks so the asset is demuxed once
+    SeekIndex mSeekIndex;
+
+    int64_t mLoadStartTime = 0;
+    bool mHasDecodedFirstBlock = false;
+
+    std::thread mDecoderThread;
+};
+
+#endif //OBOE_AUDIO_PLAYER_STREAMINGDATASOURCE_H
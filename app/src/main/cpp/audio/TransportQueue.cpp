@@ -0,0 +1,38 @@
+//
+// Created by 43975 on 2/5/2022.
+//
+#include <algorithm>
+#include "TransportQueue.h"
+
+bool TransportQueue::push(const TransportCommand &command) {
+    std::lock_guard<std::mutex> lock(mPushLock);
+    return mIncoming.write(&command, 1) == 1;
+}
+
+void TransportQueue::receive() {
+    // whatever doesn't fit stays in the ring buffer until commands have been applied
+    TransportCommand command;
+    while (mScheduledCount < kMaxPendingTransportCommands && mIncoming.read(&command, 1) == 1){
+        // after every command due at the same frame or earlier
+        auto end = mScheduled.begin() + mScheduledCount;
+        auto position = std::upper_bound(mScheduled.begin(), end, command,
+                [](const TransportCommand &a, const TransportCommand &b){ return a.streamFrame < b.streamFrame; });
+        std::move_backward(position, end, end + 1);
+        *position = command;
+        ++mScheduledCount;
+    }
+}
+
+bool TransportQueue::popDue(int64_t streamFrame, TransportCommand &command) {
+    if (mScheduledCount == 0 || mScheduled[0].streamFrame > streamFrame) return false;
+
+    command = mScheduled[0];
+    std::move(mScheduled.begin() + 1, mScheduled.begin() + mScheduledCount, mScheduled.begin());
+    --mScheduledCount;
+    return true;
+}
+
+int32_t TransportQueue::getFramesUntilNext(int64_t streamFrame, int32_t maxFrames) const {
+    if (mScheduledCount == 0) return maxFrames;
+    return static_cast<int32_t>(std::min<int64_t>(maxFrames, std::max<int64_t>(0, mScheduled[0].streamFrame - streamFrame)));
+}
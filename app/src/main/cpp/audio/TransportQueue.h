@@ -0,0 +1,92 @@
+//
+// Created by 43975 on 2/5/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_TRANSPORTQUEUE_H
+#define OBOE_AUDIO_PLAYER_TRANSPORTQUEUE_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include "SpeedProcessor.h"
+#include "SpscRingBuffer.h"
+
+constexpr int32_t kMaxPendingTransportCommands = 64;
+
+// Stream frame of a command which applies at the start of the next audio callback
+constexpr int64_t kTransportImmediate = -1;
+
+enum class TransportCommandType{
+    // resume where the track was paused, a finished track starts over
+    Play,
+    Pause,
+    // pause and go back to the start
+    Stop,
+    SetLooping,
+    Seek,
+    SetGain,
+    SetSpeed
+};
+
+struct TransportCommand{
+    TransportCommandType type;
+    // frame of the stream to apply the command at, counted from the first stream opened
+    int64_t streamFrame = kTransportImmediate;
+    bool isLooping = false;
+    int64_t positionMillis = 0;
+    // linear gain of the track
+    float gain = 1.0f;
+    float speed = 1.0f;
+    SpeedMode speedMode = SpeedMode::Linear;
+};
+
+/**
+ * Carries transport commands from control threads to the audio thread and keeps them until the
+ * frame they are due at.
+ *
+ * push() may be called from any number of threads, they take turns on a lock which the audio
+ * thread never touches. The audio thread side is wait-free and doesn't allocate: receive() picks
+ * up the pushed commands at the start of a callback, popDue() and getFramesUntilNext() then let
+ * the callback split its buffer at the frames the commands are due at.
+ */
+class TransportQueue{
+public:
+    TransportQueue():mIncoming(kMaxPendingTransportCommands){}
+
+    /**
+     * @return false if too many commands are pending
+     */
+    bool push(const TransportCommand &command);
+
+    /**
+     * Moves the pushed commands into the schedule, ordered by frame. Commands for the same frame
+     * keep the order they were pushed in. Audio thread only.
+     */
+    void receive();
+
+    /**
+     * Takes the next command due at or before streamFrame, which includes the immediate ones.
+     * Audio thread only.
+     *
+     * @return false if no command is due
+     */
+    bool popDue(int64_t streamFrame, TransportCommand &command);
+
+    /**
+     * @return frames from streamFrame to the next scheduled command, at most maxFrames
+     */
+    int32_t getFramesUntilNext(int64_t streamFrame, int32_t maxFrames) const;
+
+    int32_t getScheduledCount() const { return mScheduledCount; }
+
+private:
+    SpscRingBuffer<TransportCommand> mIncoming;
+    // serializes the producers, the ring buffer only supports one
+    std::mutex mPushLock;
+
+    // Audio thread state, sorted by stream frame
+    std::array<TransportCommand, kMaxPendingTransportCommands> mScheduled;
+    int32_t mScheduledCount = 0;
+};
+
+#endif //OBOE_AUDIO_PLAYER_TRANSPORTQUEUE_H
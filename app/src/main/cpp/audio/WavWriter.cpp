@@ -0,0 +1,115 @@
+//
+// Created by 43975 on 1/31/2022.
+//
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+#include "../utils/logging.h"
+#include "WavWriter.h"
+
+constexpr uint16_t kWaveFormatIeeeFloat = 3;
+
+// Float WAV files need the extended fmt chunk and a fact chunk, the samples follow the header.
+// Both Android and the hosts we build on are little endian, which is what WAV uses.
+struct WavHeader{
+    char riffId[4];
+    uint32_t riffSize;
+    char waveId[4];
+
+    char fmtId[4];
+    uint32_t fmtSize;
+    uint16_t formatTag;
+    uint16_t channelCount;
+    uint32_t sampleRate;
+    uint32_t bytesPerSecond;
+    uint16_t blockAlign;
+    uint16_t bitsPerSample;
+    uint16_t extensionSize;
+
+    char factId[4];
+    uint32_t factSize;
+    uint32_t frameCount;
+
+    char dataId[4];
+    uint32_t dataSize;
+} __attribute__((packed));
+static_assert(sizeof(WavHeader) == 58, "WavHeader must not be padded");
+static_assert(kMaxWavDataBytes == UINT32_MAX - (sizeof(WavHeader) - 8), "the RIFF size must not wrap");
+
+static WavHeader newWavHeader(int32_t channelCount, int32_t sampleRate, int64_t dataBytes) {
+    const auto blockAlign = static_cast<uint16_t>(channelCount * sizeof(float));
+    WavHeader header{};
+    memcpy(header.riffId, "RIFF", 4);
+    header.riffSize = static_cast<uint32_t>(sizeof(WavHeader) - 8 + dataBytes);
+    memcpy(header.waveId, "WAVE", 4);
+    memcpy(header.fmtId, "fmt ", 4);
+    header.fmtSize = 18;
+    header.formatTag = kWaveFormatIeeeFloat;
+    header.channelCount = static_cast<uint16_t>(channelCount);
+    header.sampleRate = static_cast<uint32_t>(sampleRate);
+    header.bytesPerSecond = static_cast<uint32_t>(sampleRate) * blockAlign;
+    header.blockAlign = blockAlign;
+    header.bitsPerSample = 32;
+    header.extensionSize = 0;
+    memcpy(header.factId, "fact", 4);
+    header.factSize = 4;
+    header.frameCount = static_cast<uint32_t>(dataBytes / blockAlign);
+    memcpy(header.dataId, "data", 4);
+    header.dataSize = static_cast<uint32_t>(dataBytes);
+    return header;
+}
+
+WavWriter* WavWriter::newFromPath(const char *path, int32_t channelCount, int32_t sampleRate,
+                                  int64_t maxDataBytes) {
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr){
+        LOGE("Failed to create WAV file %s", path);
+        return nullptr;
+    }
+
+    // the sizes are written again once they are known
+    WavHeader header = newWavHeader(channelCount, sampleRate, 0);
+    if (fwrite(&header, sizeof(header), 1, file) != 1){
+        LOGE("Failed to write WAV header to %s", path);
+        fclose(file);
+        return nullptr;
+    }
+    return new WavWriter(file, channelCount, sampleRate, std::min(maxDataBytes, kMaxWavDataBytes));
+}
+
+WavWriter::~WavWriter() {
+    close();
+}
+
+bool WavWriter::onDecodedData(const uint8_t *data, int64_t numBytes) {
+    if (mFile == nullptr || mIsFailed) return false;
+
+    // the header can't describe more, keep the whole frames which still fit
+    const int64_t bytesPerFrame = mChannelCount * sizeof(float);
+    const int64_t maxBytes = (mMaxDataBytes - mDataBytes) / bytesPerFrame * bytesPerFrame;
+    const int64_t bytesToWrite = std::min(numBytes, maxBytes);
+    if (fwrite(data, 1, bytesToWrite, mFile) != static_cast<size_t>(bytesToWrite)){
+        LOGE("Failed to write WAV samples");
+        mIsFailed = true;
+        return false;
+    }
+    mDataBytes += bytesToWrite;
+    if (bytesToWrite < numBytes){
+        LOGE("WAV file is full, dropped %" PRId64 " bytes", numBytes - bytesToWrite);
+        return false;
+    }
+    return true;
+}
+
+bool WavWriter::close() {
+    if (mFile == nullptr) return !mIsFailed;
+
+    WavHeader header = newWavHeader(mChannelCount, mSampleRate, mDataBytes);
+    bool isWritten = fseek(mFile, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, mFile) == 1;
+    isWritten = (fclose(mFile) == 0) && isWritten;
+    mFile = nullptr;
+    if (!isWritten) LOGE("Failed to finish WAV file");
+
+    mIsFailed |= !isWritten;
+    return !mIsFailed;
+}
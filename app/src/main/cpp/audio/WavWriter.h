@@ -0,0 +1,54 @@
+//
+// Created by 43975 on 1/31/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_WAVWRITER_H
+#define OBOE_AUDIO_PLAYER_WAVWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include "PcmSink.h"
+
+// The sizes in a WAV header are 32 bit, this is as many sample bytes as the header can describe
+constexpr int64_t kMaxWavDataBytes = UINT32_MAX - 50;
+
+/**
+ * Writes interleaved float samples to a 32 bit float WAV file, so rendered output can be
+ * compared bit for bit. The sizes in the header are filled in by close().
+ *
+ * The file ends at the last whole frame which fits in maxDataBytes. Samples past it are
+ * dropped and onDecodedData() returns false, so the file always stays readable.
+ */
+class WavWriter : public PcmSink{
+public:
+    ~WavWriter();
+
+    /**
+     * @return the writer or nullptr if the file can't be created
+     */
+    static WavWriter* newFromPath(const char *path, int32_t channelCount, int32_t sampleRate,
+                                  int64_t maxDataBytes = kMaxWavDataBytes);
+
+    bool onDecodedData(const uint8_t *data, int64_t numBytes) override;
+
+    /**
+     * Finish the header and close the file, also done by the destructor.
+     * @return false if anything couldn't be written
+     */
+    bool close();
+
+    int64_t getNumFrames() const { return mDataBytes / (mChannelCount * sizeof(float)); }
+
+private:
+    WavWriter(FILE *file, int32_t channelCount, int32_t sampleRate, int64_t maxDataBytes)
+    :mFile(file), mChannelCount(channelCount), mSampleRate(sampleRate), mMaxDataBytes(maxDataBytes){}
+
+    FILE *mFile;
+    const int32_t mChannelCount;
+    const int32_t mSampleRate;
+    const int64_t mMaxDataBytes;
+    int64_t mDataBytes = 0;
+    bool mIsFailed = false;
+};
+
+#endif //OBOE_AUDIO_PLAYER_WAVWRITER_H
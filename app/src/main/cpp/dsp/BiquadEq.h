@@ -0,0 +1,231 @@
+//
+// Created by 43975 on 2/7/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_BIQUADEQ_H
+#define OBOE_AUDIO_PLAYER_BIQUADEQ_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include "EffectChain.h"
+
+enum class EqBandType{
+    LowShelf,
+    Peaking,
+    HighShelf
+};
+
+// Smallest value the filter state keeps, anything closer to 0 is flushed so a decaying state
+// never turns denormal
+constexpr float kDenormalThreshold = 1e-15f;
+
+// A band which changes its type fades to 0 dB and back over this many blocks each way
+constexpr int32_t kEqTypeFadeBlocks = 8;
+
+/**
+ * Equalizer made of Bands biquads in series, from the RBJ cookbook. A band at 0 dB passes the
+ * signal unchanged whatever its type, such a band is skipped, and a band changes its type at
+ * 0 dB so the switch doesn't click.
+ *
+ * The state is kept as structure of arrays, [band][channel]. A block runs through one band at a
+ * time with its coefficients and state in registers, all channels of a frame in one
+ * fixed-length loop the compiler vectorizes.
+ */
+template <int32_t ChannelCount, int32_t Bands>
+class BiquadEq{
+public:
+    static constexpr int32_t kChannelCount = ChannelCount;
+    static constexpr int32_t kBands = Bands;
+
+    BiquadEq() {
+        for (int32_t band = 0; band < Bands; ++band){
+            mTypes[band].store(EqBandType::Peaking, std::memory_order_relaxed);
+            mActiveTypes[band] = EqBandType::Peaking;
+            mFrequencies[band].setTarget(1000.0f);
+            mQs[band].setTarget(0.707f);
+        }
+        prepare(mSampleRate);
+    }
+
+    /**
+     * May be called from any thread, the frequency, gain and Q glide to the new values. A new
+     * type fades in over 2 * kEqTypeFadeBlocks blocks.
+     */
+    void setBand(int32_t band, EqBandType type, float frequency, float gainDecibels, float q) {
+        if (band < 0 || band >= Bands) return;
+        mTypes[band].store(type, std::memory_order_relaxed);
+        mFrequencies[band].setTarget(frequency);
+        mGains[band].setTarget(gainDecibels);
+        mQs[band].setTarget(std::max(0.1f, q));
+    }
+
+    void prepare(int32_t sampleRate) {
+        mSampleRate = sampleRate;
+        mSmoothingCoefficient = getSmoothingCoefficient(kParameterSmoothingMillis, sampleRate, kEffectBlockFrames);
+        for (int32_t band = 0; band < Bands; ++band){
+            mFrequencies[band].jumpToTarget();
+            mGains[band].jumpToTarget();
+            mQs[band].jumpToTarget();
+            mActiveTypes[band] = mTypes[band].load(std::memory_order_relaxed);
+            mTypeFades[band] = 1.0f;
+            updateCoefficients(band);
+            mIsBandActive[band] = mGains[band].getValue() != 0;
+            mZ1[band].fill(0);
+            mZ2[band].fill(0);
+        }
+    }
+
+    void beginBlock() {
+        for (int32_t band = 0; band < Bands; ++band){
+            bool isChanged = mFrequencies[band].advance(mSmoothingCoefficient);
+            isChanged |= mGains[band].advance(mSmoothingCoefficient);
+            isChanged |= mQs[band].advance(mSmoothingCoefficient);
+            isChanged |= advanceTypeFade(band);
+            if (isChanged) updateCoefficients(band);
+
+            // the state of a band at 0 dB is the difference between its output and input,
+            // which has died away by the time the gain got there
+            mIsBandActive[band] = getBandGain(band) != 0 || mGains[band].getTarget() != 0;
+            if (!mIsBandActive[band]){
+                mZ1[band].fill(0);
+                mZ2[band].fill(0);
+                continue;
+            }
+            for (int32_t channel = 0; channel < ChannelCount; ++channel){
+                if (std::fabs(mZ1[band][channel]) < kDenormalThreshold) mZ1[band][channel] = 0;
+                if (std::fabs(mZ2[band][channel]) < kDenormalThreshold) mZ2[band][channel] = 0;
+            }
+        }
+    }
+
+    void processBlock(float *audioData, int32_t numFrames) {
+        for (int32_t band = 0; band < Bands; ++band){
+            if (!mIsBandActive[band]) continue;
+            const float b0 = mB0[band], b1 = mB1[band], b2 = mB2[band], a1 = mA1[band], a2 = mA2[band];
+            float z1[ChannelCount], z2[ChannelCount];
+            std::copy(mZ1[band].begin(), mZ1[band].end(), z1);
+            std::copy(mZ2[band].begin(), mZ2[band].end(), z2);
+            // transposed direct form II
+            for (int32_t i = 0; i < numFrames; ++i){
+                float *frame = &audioData[i * ChannelCount];
+                for (int32_t channel = 0; channel < ChannelCount; ++channel){
+                    const float input = frame[channel];
+                    const float output = b0 * input + z1[channel];
+                    z1[channel] = b1 * input - a1 * output + z2[channel];
+                    z2[channel] = b2 * input - a2 * output;
+                    frame[channel] = output;
+                }
+            }
+            std::copy(z1, z1 + ChannelCount, mZ1[band].begin());
+            std::copy(z2, z2 + ChannelCount, mZ2[band].begin());
+        }
+    }
+
+    void processFrame(float *frame) {
+        for (int32_t band = 0; band < Bands; ++band){
+            if (!mIsBandActive[band]) continue;
+            const float b0 = mB0[band], b1 = mB1[band], b2 = mB2[band], a1 = mA1[band], a2 = mA2[band];
+            float *z1 = mZ1[band].data();
+            float *z2 = mZ2[band].data();
+            // transposed direct form II
+            for (int32_t channel = 0; channel < ChannelCount; ++channel){
+                const float input = frame[channel];
+                const float output = b0 * input + z1[channel];
+                z1[channel] = b1 * input - a1 * output + z2[channel];
+                z2[channel] = b2 * input - a2 * output;
+                frame[channel] = output;
+            }
+        }
+    }
+
+private:
+    float getBandGain(int32_t band) const { return mGains[band].getValue() * mTypeFades[band]; }
+
+    /**
+     * A band whose type changed fades out, takes the new type once it is at 0 dB and fades back
+     * in, a block at a time.
+     *
+     * @return false if the band isn't fading
+     */
+    bool advanceTypeFade(int32_t band) {
+        const EqBandType type = mTypes[band].load(std::memory_order_relaxed);
+        float &fade = mTypeFades[band];
+        if (type != mActiveTypes[band]){
+            // a band at 0 dB already can switch right away
+            fade = (mGains[band].getValue() == 0) ? 0 : std::max(0.0f, fade - 1.0f / kEqTypeFadeBlocks);
+            if (fade == 0) mActiveTypes[band] = type;
+            return true;
+        }
+        if (fade == 1.0f) return false;
+        fade = std::min(1.0f, fade + 1.0f / kEqTypeFadeBlocks);
+        return true;
+    }
+
+    void updateCoefficients(int32_t band) {
+        const float nyquist = 0.5f * mSampleRate;
+        const float frequency = std::min(std::max(mFrequencies[band].getValue(), 10.0f), 0.95f * nyquist);
+        const float omega = 2.0f * static_cast<float>(M_PI) * frequency / mSampleRate;
+        const float cosOmega = std::cos(omega);
+        const float alpha = std::sin(omega) / (2.0f * mQs[band].getValue());
+        const float amplitude = std::pow(10.0f, getBandGain(band) / 40.0f);
+
+        float b0, b1, b2, a0, a1, a2;
+        switch (mActiveTypes[band]){
+            case EqBandType::LowShelf:{
+                const float shelf = 2.0f * std::sqrt(amplitude) * alpha;
+                b0 = amplitude * ((amplitude + 1) - (amplitude - 1) * cosOmega + shelf);
+                b1 = 2 * amplitude * ((amplitude - 1) - (amplitude + 1) * cosOmega);
+                b2 = amplitude * ((amplitude + 1) - (amplitude - 1) * cosOmega - shelf);
+                a0 = (amplitude + 1) + (amplitude - 1) * cosOmega + shelf;
+                a1 = -2 * ((amplitude - 1) + (amplitude + 1) * cosOmega);
+                a2 = (amplitude + 1) + (amplitude - 1) * cosOmega - shelf;
+                break;
+            }
+            case EqBandType::HighShelf:{
+                const float shelf = 2.0f * std::sqrt(amplitude) * alpha;
+                b0 = amplitude * ((amplitude + 1) + (amplitude - 1) * cosOmega + shelf);
+                b1 = -2 * amplitude * ((amplitude - 1) + (amplitude + 1) * cosOmega);
+                b2 = amplitude * ((amplitude + 1) + (amplitude - 1) * cosOmega - shelf);
+                a0 = (amplitude + 1) - (amplitude - 1) * cosOmega + shelf;
+                a1 = 2 * ((amplitude - 1) - (amplitude + 1) * cosOmega);
+                a2 = (amplitude + 1) - (amplitude - 1) * cosOmega - shelf;
+                break;
+            }
+            case EqBandType::Peaking:
+            default:
+                b0 = 1 + alpha * amplitude;
+                b1 = -2 * cosOmega;
+                b2 = 1 - alpha * amplitude;
+                a0 = 1 + alpha / amplitude;
+                a1 = -2 * cosOmega;
+                a2 = 1 - alpha / amplitude;
+                break;
+        }
+        mB0[band] = b0 / a0;
+        mB1[band] = b1 / a0;
+        mB2[band] = b2 / a0;
+        mA1[band] = a1 / a0;
+        mA2[band] = a2 / a0;
+    }
+
+    std::array<std::atomic<EqBandType>, Bands> mTypes;
+    std::array<SmoothedParameter, Bands> mFrequencies;
+    std::array<SmoothedParameter, Bands> mGains;
+    std::array<SmoothedParameter, Bands> mQs;
+
+    int32_t mSampleRate = 48000;
+    float mSmoothingCoefficient = 1.0f;
+
+    // Audio thread state
+    std::array<EqBandType, Bands> mActiveTypes;
+    // 1 while a band plays at its gain, down to 0 while it changes its type
+    std::array<float, Bands> mTypeFades{};
+    std::array<bool, Bands> mIsBandActive{};
+    std::array<float, Bands> mB0{}, mB1{}, mB2{}, mA1{}, mA2{};
+    std::array<std::array<float, ChannelCount>, Bands> mZ1{}, mZ2{};
+};
+
+#endif //OBOE_AUDIO_PLAYER_BIQUADEQ_H
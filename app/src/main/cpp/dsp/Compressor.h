@@ -0,0 +1,154 @@
+//
+// Created by 43975 on 2/7/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_COMPRESSOR_H
+#define OBOE_AUDIO_PLAYER_COMPRESSOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "EffectChain.h"
+
+/**
+ * Feed-forward compressor with the channels linked, so the stereo image doesn't move. A peak
+ * envelope follows the loudest channel with the attack and release times, everything above the
+ * threshold is scaled down by the ratio. With a ratio of 1 it only applies the makeup gain,
+ * and with no makeup gain either it leaves the blocks alone.
+ *
+ * processBlock() follows the envelope frame by frame first and then works out the gains and
+ * applies them, which has no dependencies from one frame to the next and vectorizes.
+ */
+template <int32_t ChannelCount>
+class Compressor{
+public:
+    static constexpr int32_t kChannelCount = ChannelCount;
+
+    Compressor() {
+        mRatio.setTarget(1.0f);
+        mAttackMillis.setTarget(5.0f);
+        mReleaseMillis.setTarget(100.0f);
+        prepare(mSampleRate);
+    }
+
+    /**
+     * May be called from any thread.
+     */
+    void setParameters(float thresholdDecibels, float ratio, float attackMillis, float releaseMillis,
+                       float makeupDecibels) {
+        mThreshold.setTarget(thresholdDecibels);
+        mRatio.setTarget(std::max(1.0f, ratio));
+        mAttackMillis.setTarget(std::max(0.0f, attackMillis));
+        mReleaseMillis.setTarget(std::max(0.0f, releaseMillis));
+        mMakeup.setTarget(makeupDecibels);
+    }
+
+    void prepare(int32_t sampleRate) {
+        mSampleRate = sampleRate;
+        mSmoothingCoefficient = getSmoothingCoefficient(kParameterSmoothingMillis, sampleRate, kEffectBlockFrames);
+        for (SmoothedParameter *parameter : {&mThreshold, &mRatio, &mAttackMillis, &mReleaseMillis, &mMakeup}){
+            parameter->jumpToTarget();
+        }
+        updateParameters();
+        mEnvelope = 0;
+        mMakeupGain = mMakeupGainTarget;
+        mMakeupGainStep = 0;
+    }
+
+    void beginBlock() {
+        bool isChanged = false;
+        for (SmoothedParameter *parameter : {&mThreshold, &mRatio, &mAttackMillis, &mReleaseMillis, &mMakeup}){
+            isChanged |= parameter->advance(mSmoothingCoefficient);
+        }
+        if (isChanged) updateParameters();
+        // the ramp lands on the target, not just next to it
+        if (std::fabs(mMakeupGainTarget - mMakeupGain) < 1e-6f) mMakeupGain = mMakeupGainTarget;
+        // the makeup gain ramps within the block as well, so it doesn't step
+        mMakeupGainStep = (mMakeupGainTarget - mMakeupGain) / kEffectBlockFrames;
+        // the envelope isn't followed meanwhile, it catches up within the attack time
+        mIsNeutral = (mSlope == 0 && mMakeupGain == 1.0f && mMakeupGainStep == 0);
+    }
+
+    void processBlock(float *audioData, int32_t numFrames) {
+        if (mIsNeutral) return;
+
+        // copies of the members, the compiler can't tell they aren't part of audioData
+        const float attackCoefficient = mAttackCoefficient, releaseCoefficient = mReleaseCoefficient;
+        const float thresholdLog2 = mThresholdLog2, slope = mSlope;
+        const float makeupGain = mMakeupGain, makeupGainStep = mMakeupGainStep;
+
+        float gains[kEffectBlockFrames];
+        float envelope = mEnvelope;
+        for (int32_t i = 0; i < numFrames; ++i){
+            const float *frame = &audioData[i * ChannelCount];
+            float peak = 0;
+            for (int32_t channel = 0; channel < ChannelCount; ++channel) peak = std::max(peak, std::fabs(frame[channel]));
+            const float coefficient = (peak > envelope) ? attackCoefficient : releaseCoefficient;
+            envelope += (peak - envelope) * coefficient;
+            gains[i] = envelope;
+        }
+        mEnvelope = envelope;
+
+        // a frame at or below the threshold comes out at 2^0, so the gain needs no branch
+        for (int32_t i = 0; i < numFrames; ++i){
+            const float overOctaves = std::max(0.0f, fastLog2(gains[i]) - thresholdLog2);
+            gains[i] = (makeupGain + (i + 1) * makeupGainStep) * fastExp2(-overOctaves * slope);
+        }
+        for (int32_t i = 0; i < numFrames; ++i){
+            for (int32_t channel = 0; channel < ChannelCount; ++channel) audioData[i * ChannelCount + channel] *= gains[i];
+        }
+        mMakeupGain = makeupGain + numFrames * makeupGainStep;
+    }
+
+    void processFrame(float *frame) {
+        float peak = 0;
+        for (int32_t channel = 0; channel < ChannelCount; ++channel) peak = std::max(peak, std::fabs(frame[channel]));
+        const float coefficient = (peak > mEnvelope) ? mAttackCoefficient : mReleaseCoefficient;
+        mEnvelope += (peak - mEnvelope) * coefficient;
+
+        mMakeupGain += mMakeupGainStep;
+        float gain = mMakeupGain;
+        // the logarithms are only needed above the threshold, they are taken in base 2 which
+        // is cheap to approximate
+        if (mEnvelope > mThresholdGain){
+            const float overOctaves = fastLog2(mEnvelope) - mThresholdLog2;
+            gain *= fastExp2(-overOctaves * mSlope);
+        }
+        for (int32_t channel = 0; channel < ChannelCount; ++channel) frame[channel] *= gain;
+    }
+
+    float getEnvelope() const { return mEnvelope; }
+
+private:
+    void updateParameters() {
+        mThresholdGain = decibelsToGain(mThreshold.getValue());
+        mThresholdLog2 = std::log2(mThresholdGain);
+        mSlope = 1.0f - 1.0f / mRatio.getValue();
+        mAttackCoefficient = getSmoothingCoefficient(mAttackMillis.getValue(), mSampleRate);
+        mReleaseCoefficient = getSmoothingCoefficient(mReleaseMillis.getValue(), mSampleRate);
+        mMakeupGainTarget = decibelsToGain(mMakeup.getValue());
+    }
+
+    SmoothedParameter mThreshold;
+    SmoothedParameter mRatio;
+    SmoothedParameter mAttackMillis;
+    SmoothedParameter mReleaseMillis;
+    SmoothedParameter mMakeup;
+
+    int32_t mSampleRate = 48000;
+    float mSmoothingCoefficient = 1.0f;
+
+    // Audio thread state
+    float mThresholdGain = 1.0f;
+    float mThresholdLog2 = 0;
+    float mSlope = 0;
+    float mAttackCoefficient = 1.0f;
+    float mReleaseCoefficient = 1.0f;
+    float mMakeupGainTarget = 1.0f;
+    float mMakeupGain = 1.0f;
+    float mMakeupGainStep = 0;
+    float mEnvelope = 0;
+    bool mIsNeutral = false;
+};
+
+#endif //OBOE_AUDIO_PLAYER_COMPRESSOR_H
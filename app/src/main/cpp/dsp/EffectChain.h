@@ -0,0 +1,170 @@
+//
+// Created by 43975 on 2/7/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_EFFECTCHAIN_H
+#define OBOE_AUDIO_PLAYER_EFFECTCHAIN_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+// Parameter changes are picked up at the start of every block of this many frames
+constexpr int32_t kEffectBlockFrames = 64;
+
+// Time constant parameters glide to a new value with
+constexpr float kParameterSmoothingMillis = 20.0f;
+
+inline float decibelsToGain(float decibels) { return std::pow(10.0f, decibels / 20.0f); }
+inline float gainToDecibels(float gain) { return 20.0f * std::log10(gain); }
+
+/**
+ * log2 for positive normal floats, within 1e-5 of the exact value. About ten times as fast as
+ * std::log2, for gain computers which need a logarithm per frame.
+ */
+inline float fastLog2(float value) {
+    int32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const auto exponent = static_cast<float>(((bits >> 23) & 0xff) - 127);
+    bits = (bits & 0x007fffff) | 0x3f800000;
+    float mantissa;
+    memcpy(&mantissa, &bits, sizeof(mantissa));
+    // log2 of the mantissa in [1, 2), minimax polynomial
+    const float m = mantissa - 1.0f;
+    return exponent + m * (1.4425449f + m * (-0.7181452f + m * (0.4575485f + m * (-0.2779042f + m * (0.1217970f + m * -0.0258411f)))));
+}
+
+/**
+ * 2^value for value in [-126, 127], within 1e-4 of the exact value relatively, which is
+ * under 0.001 dB.
+ */
+inline float fastExp2(float value) {
+    // floor by truncation, which unlike std::floor vectorizes without SSE4.1
+    const auto truncated = static_cast<int32_t>(value);
+    const int32_t whole = truncated - ((value < static_cast<float>(truncated)) ? 1 : 0);
+    const float f = value - static_cast<float>(whole);
+    // 2^f for f in [0, 1)
+    const float fraction = 1.0f + f * (0.6931472f + f * (0.2402265f + f * (0.0555041f + f * (0.0096181f + f * 0.0013333f))));
+    const int32_t bits = (whole + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return fraction * scale;
+}
+
+/**
+ * Coefficient of a one-pole smoother which covers 63% of the way in timeMillis, when advanced
+ * every intervalFrames frames.
+ */
+inline float getSmoothingCoefficient(float timeMillis, int32_t sampleRate, int32_t intervalFrames = 1) {
+    if (timeMillis <= 0) return 1.0f;
+    return 1.0f - std::exp(-intervalFrames * 1000.0f / (timeMillis * sampleRate));
+}
+
+/**
+ * A parameter any thread may set, which the audio thread moves towards the new value a little
+ * every block so it doesn't jump.
+ */
+class SmoothedParameter{
+public:
+    explicit SmoothedParameter(float value = 0):mTarget(value), mValue(value){}
+
+    void setTarget(float value) { mTarget.store(value, std::memory_order_relaxed); }
+    float getTarget() const { return mTarget.load(std::memory_order_relaxed); }
+
+    /**
+     * Audio thread only.
+     * @return false if the value has reached the target already
+     */
+    bool advance(float coefficient) {
+        const float target = mTarget.load(std::memory_order_relaxed);
+        if (mValue == target) return false;
+        mValue += (target - mValue) * coefficient;
+        if (std::fabs(target - mValue) <= 1e-4f * std::fabs(target) + 1e-6f) mValue = target;
+        return true;
+    }
+
+    // Skip to the target, while the audio thread isn't running
+    void jumpToTarget() { mValue = mTarget.load(std::memory_order_relaxed); }
+
+    float getValue() const { return mValue; }
+
+private:
+    std::atomic<float> mTarget;
+    float mValue;
+};
+
+/**
+ * Runs audio through a fixed series of processors. The processors and the channel count are
+ * template parameters, so the calls inline and every processor runs over a block of up to
+ * kEffectBlockFrames frames at a time, which stays in the L1 cache on its way through the chain.
+ * Within a block each processor can keep its state in registers and vectorize, and skip the
+ * block altogether when its settings leave the audio unchanged.
+ *
+ * Each processor has a static kChannelCount and these members:
+ *   void prepare(int32_t sampleRate)                        - resets the state, while the chain
+ *                                                             isn't running
+ *   void beginBlock()                                       - audio thread, picks up parameter
+ *                                                             changes
+ *   void processBlock(float *audioData, int32_t numFrames)  - audio thread, processes up to
+ *                                                             kEffectBlockFrames interleaved
+ *                                                             frames in place
+ *   void processFrame(float *frame)                         - the same for a single frame, the
+ *                                                             reference processBlock() is tested
+ *                                                             against
+ * Their parameter setters may be called from any thread.
+ */
+template <int32_t ChannelCount, typename... Processors>
+class EffectChain{
+public:
+    static constexpr int32_t kChannelCount = ChannelCount;
+
+    void prepare(int32_t sampleRate) {
+        forEach([sampleRate](auto &processor){ processor.prepare(sampleRate); });
+    }
+
+    /**
+     * @param audioData : interleaved frames, processed in place
+     */
+    void process(float *audioData, int32_t numFrames) {
+        for (int32_t blockStart = 0; blockStart < numFrames; blockStart += kEffectBlockFrames){
+            const int32_t blockFrames = std::min(kEffectBlockFrames, numFrames - blockStart);
+            float *block = &audioData[blockStart * ChannelCount];
+            forEach([](auto &processor){ processor.beginBlock(); });
+            forEach([block, blockFrames](auto &processor){ processor.processBlock(block, blockFrames); });
+        }
+    }
+
+    template <size_t Index>
+    typename std::tuple_element<Index, std::tuple<Processors...>>::type &get() {
+        return std::get<Index>(mProcessors);
+    }
+
+private:
+    static constexpr bool haveChannelCount() {
+        const bool matches[] = {true, (Processors::kChannelCount == ChannelCount)...};
+        for (bool isMatch : matches){
+            if (!isMatch) return false;
+        }
+        return true;
+    }
+    static_assert(haveChannelCount(), "every processor must have the channel count of the chain");
+
+    template <typename Function, size_t... Indices>
+    void forEach(Function function, std::index_sequence<Indices...>) {
+        using expand = int[];
+        (void)expand{0, (function(std::get<Indices>(mProcessors)), 0)...};
+    }
+
+    template <typename Function>
+    void forEach(Function function) {
+        forEach(function, std::index_sequence_for<Processors...>{});
+    }
+
+    std::tuple<Processors...> mProcessors;
+};
+
+#endif //OBOE_AUDIO_PLAYER_EFFECTCHAIN_H
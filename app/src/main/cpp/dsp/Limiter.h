@@ -0,0 +1,96 @@
+//
+// Created by 43975 on 2/7/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_LIMITER_H
+#define OBOE_AUDIO_PLAYER_LIMITER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "EffectChain.h"
+
+// A gain this close to 1 counts as recovered, about 1e-5 dB
+constexpr float kLimiterRecoveredGap = 1e-6f;
+
+/**
+ * Brickwall limiter, no sample leaves it above the ceiling. The gain drops to whatever the
+ * loudest channel of a frame needs at once and recovers with the release time. There is no
+ * lookahead, so it adds no latency at the price of some distortion on sharp peaks.
+ *
+ * Once the gain has recovered, a block in which nothing reaches the ceiling is left alone.
+ */
+template <int32_t ChannelCount>
+class Limiter{
+public:
+    static constexpr int32_t kChannelCount = ChannelCount;
+
+    Limiter() {
+        mReleaseMillis.setTarget(50.0f);
+        prepare(mSampleRate);
+    }
+
+    /**
+     * May be called from any thread.
+     */
+    void setParameters(float ceilingDecibels, float releaseMillis) {
+        mCeiling.setTarget(std::min(0.0f, ceilingDecibels));
+        mReleaseMillis.setTarget(std::max(0.0f, releaseMillis));
+    }
+
+    void prepare(int32_t sampleRate) {
+        mSampleRate = sampleRate;
+        mSmoothingCoefficient = getSmoothingCoefficient(kParameterSmoothingMillis, sampleRate, kEffectBlockFrames);
+        mCeiling.jumpToTarget();
+        mReleaseMillis.jumpToTarget();
+        updateParameters();
+        mGain = 1.0f;
+    }
+
+    void beginBlock() {
+        bool isChanged = mCeiling.advance(mSmoothingCoefficient);
+        isChanged |= mReleaseMillis.advance(mSmoothingCoefficient);
+        if (isChanged) updateParameters();
+        // the recovery only approaches 1, it is there once it can't be heard any more
+        if (1.0f - mGain < kLimiterRecoveredGap) mGain = 1.0f;
+    }
+
+    void processBlock(float *audioData, int32_t numFrames) {
+        if (mGain == 1.0f){
+            float peak = 0;
+            for (int32_t i = 0; i < numFrames * ChannelCount; ++i) peak = std::max(peak, std::fabs(audioData[i]));
+            if (peak <= mCeilingGain) return;
+        }
+        for (int32_t i = 0; i < numFrames; ++i) processFrame(&audioData[i * ChannelCount]);
+    }
+
+    void processFrame(float *frame) {
+        float peak = 0;
+        for (int32_t channel = 0; channel < ChannelCount; ++channel) peak = std::max(peak, std::fabs(frame[channel]));
+        if (peak * mGain > mCeilingGain) mGain = mCeilingGain / peak;
+
+        for (int32_t channel = 0; channel < ChannelCount; ++channel) frame[channel] *= mGain;
+        mGain += (1.0f - mGain) * mReleaseCoefficient;
+    }
+
+    float getGain() const { return mGain; }
+
+private:
+    void updateParameters() {
+        mCeilingGain = decibelsToGain(mCeiling.getValue());
+        mReleaseCoefficient = getSmoothingCoefficient(mReleaseMillis.getValue(), mSampleRate);
+    }
+
+    SmoothedParameter mCeiling;
+    SmoothedParameter mReleaseMillis;
+
+    int32_t mSampleRate = 48000;
+    float mSmoothingCoefficient = 1.0f;
+
+    // Audio thread state
+    float mCeilingGain = 1.0f;
+    float mReleaseCoefficient = 1.0f;
+    float mGain = 1.0f;
+};
+
+#endif //OBOE_AUDIO_PLAYER_LIMITER_H
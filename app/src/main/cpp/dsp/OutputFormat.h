@@ -0,0 +1,159 @@
+//
+// Created by 43975 on 2/8/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_OUTPUTFORMAT_H
+#define OBOE_AUDIO_PLAYER_OUTPUTFORMAT_H
+
+#include <algorithm>
+#include <cstdint>
+#include "SampleKernels.h"
+
+// Independent random generators in TpdfDither, enough to fill a vector register or two
+constexpr int32_t kDitherLanes = 8;
+// Samples converted to int32 at a time before they are packed into 24 bits
+constexpr int32_t kPackedInt24BlockSamples = 256;
+
+constexpr float kInt24MinValue = -8388608.0f;
+constexpr float kInt24MaxValue = 8388607.0f;
+constexpr float kFloatToInt24Scale = 8388608.0f;
+constexpr float kInt32MinValue = -2147483648.0f;
+// the largest float below 2^31
+constexpr float kInt32MaxValue = 2147483520.0f;
+constexpr float kFloatToInt32Scale = 2147483648.0f;
+
+/**
+ * One sample of a packed 24 bit stream, little endian like every device Android runs on.
+ */
+struct PackedInt24{
+    uint8_t bytes[3];
+};
+static_assert(sizeof(PackedInt24) == 3, "24 bit samples must be packed");
+
+/**
+ * Triangular (TPDF) dither of up to one LSB either way. It makes the rounding error to a
+ * shorter sample noise which doesn't depend on the signal, so quiet passages and fades don't
+ * turn into distortion.
+ *
+ * Every lane has its own xorshift generator, so the compiler can step them side by side in
+ * vector registers. The two 16 bit halves of a random word are uniform and their difference
+ * is triangular, which takes one step of a generator per sample.
+ */
+class TpdfDither{
+public:
+    TpdfDither() {
+        uint32_t seed = 0x9e3779b9u;
+        for (uint32_t &state : mState){
+            state = seed;
+            seed = seed * 1664525u + 1013904223u;
+        }
+    }
+
+    /**
+     * buffer += dither
+     * @param lsb : size of the LSB of the target format, in float sample units
+     */
+    void apply(float *buffer, int32_t numSamples, float lsb) {
+        const float scale = lsb / 65536.0f;
+        for (int32_t i = 0; i < numSamples; i += kDitherLanes){
+            float noise[kDitherLanes];
+            for (int32_t lane = 0; lane < kDitherLanes; ++lane){
+                uint32_t x = mState[lane];
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                mState[lane] = x;
+                noise[lane] = static_cast<float>(static_cast<int32_t>(x & 0xffffu) - static_cast<int32_t>(x >> 16)) * scale;
+            }
+            const int32_t count = std::min(kDitherLanes, numSamples - i);
+            for (int32_t lane = 0; lane < count; ++lane) buffer[i + lane] += noise[lane];
+        }
+    }
+
+private:
+    uint32_t mState[kDitherLanes];
+};
+
+/**
+ * Rounds to the nearest integer, halves away from zero, and clips to [minValue, maxValue].
+ * Written as selects rather than with copysign() or lrintf(), and rounding before clipping,
+ * since that is the form compilers vectorize.
+ */
+inline int32_t roundAndClip(float value, float minValue, float maxValue) {
+    value += (value < 0) ? -0.5f : 0.5f;
+    return static_cast<int32_t>(std::min(std::max(value, minValue), maxValue));
+}
+
+/**
+ * What the converter needs to know about each output sample type. Float streams take the
+ * rendered buffer as it is and never go through the converter.
+ */
+template <typename Sample>
+struct OutputSampleTraits;
+
+template <>
+struct OutputSampleTraits<int16_t>{
+    static constexpr float kLsb = 1.0f / kFloatToInt16Scale;
+
+    static void convert(const float *source, int16_t *destination, int32_t numSamples) {
+        getSampleKernels().convertFloatToI16(source, destination, numSamples);
+    }
+};
+
+template <>
+struct OutputSampleTraits<PackedInt24>{
+    static constexpr float kLsb = 1.0f / kFloatToInt24Scale;
+
+    static void convert(const float *source, PackedInt24 *destination, int32_t numSamples) {
+        for (int32_t blockStart = 0; blockStart < numSamples; blockStart += kPackedInt24BlockSamples){
+            const int32_t blockSamples = std::min(kPackedInt24BlockSamples, numSamples - blockStart);
+            int32_t block[kPackedInt24BlockSamples];
+            for (int32_t i = 0; i < blockSamples; ++i){
+                block[i] = roundAndClip(source[blockStart + i] * kFloatToInt24Scale, kInt24MinValue, kInt24MaxValue);
+            }
+            for (int32_t i = 0; i < blockSamples; ++i){
+                const uint32_t value = static_cast<uint32_t>(block[i]);
+                uint8_t *bytes = destination[blockStart + i].bytes;
+                bytes[0] = static_cast<uint8_t>(value);
+                bytes[1] = static_cast<uint8_t>(value >> 8);
+                bytes[2] = static_cast<uint8_t>(value >> 16);
+            }
+        }
+    }
+};
+
+template <>
+struct OutputSampleTraits<int32_t>{
+    // A float sample only has 24 bits of precision, there is nothing to dither below that
+    static constexpr float kLsb = 0;
+
+    static void convert(const float *source, int32_t *destination, int32_t numSamples) {
+        for (int32_t i = 0; i < numSamples; ++i){
+            destination[i] = roundAndClip(source[i] * kFloatToInt32Scale, kInt32MinValue, kInt32MaxValue);
+        }
+    }
+};
+
+/**
+ * Converts the float mix to the sample type of the stream, for streams which don't take
+ * float. Audio thread only, apart from construction.
+ */
+class OutputConverter{
+public:
+    /**
+     * @param source : rendered samples, the dither is added to them in place
+     * @param isDithered : whether to dither formats with fewer bits than a float
+     */
+    template <typename Sample>
+    void convert(float *source, Sample *destination, int32_t numSamples, bool isDithered) {
+        if (isDithered && OutputSampleTraits<Sample>::kLsb > 0){
+            mDither.apply(source, numSamples, OutputSampleTraits<Sample>::kLsb);
+        }
+        OutputSampleTraits<Sample>::convert(source, destination, numSamples);
+    }
+
+private:
+    TpdfDither mDither;
+};
+
+#endif //OBOE_AUDIO_PLAYER_OUTPUTFORMAT_H
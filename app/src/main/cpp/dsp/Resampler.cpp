@@ -0,0 +1,184 @@
+//
+// Created by 43975 on 2/1/2022.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "Resampler.h"
+#include "SampleKernels.h"
+
+struct ResamplerTier{
+    int32_t numTaps;
+    float cutoff;
+    double kaiserBeta;
+};
+
+static ResamplerTier getTier(ResamplerQuality quality) {
+    switch (quality){
+        case ResamplerQuality::Fast: return ResamplerTier{8, 0.85f, 5.0};
+        case ResamplerQuality::High: return ResamplerTier{32, 0.95f, 9.0};
+        case ResamplerQuality::Medium:
+        default: return ResamplerTier{16, 0.9f, 7.0};
+    }
+}
+
+// Modified Bessel function of the first kind, order 0
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k){
+        const double factor = x / (2.0 * k);
+        term *= factor * factor;
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static int32_t greatestCommonDivisor(int32_t a, int32_t b) {
+    while (b != 0){
+        int32_t remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+Resampler::Resampler(int32_t channelCount, int32_t inputRate, int32_t outputRate, ResamplerQuality quality)
+:mChannelCount(channelCount),
+mInputRate(inputRate),
+mOutputRate(outputRate){
+    const int32_t divisor = greatestCommonDivisor(inputRate, outputRate);
+    mNumPhases = outputRate / divisor;
+    mStep = inputRate / divisor;
+    if (mNumPhases > kMaxResamplerPhases){
+        mStep = static_cast<int32_t>(std::lround(static_cast<double>(inputRate) * kMaxResamplerPhases / outputRate));
+        mNumPhases = kMaxResamplerPhases;
+    }
+
+    // When downsampling the cutoff moves down to the output Nyquist frequency, the filter is
+    // made longer by the same factor to keep the transition band as steep
+    const ResamplerTier tier = getTier(quality);
+    const float ratio = std::min(1.0f, static_cast<float>(mNumPhases) / mStep);
+    mNumTaps = static_cast<int32_t>(std::ceil(tier.numTaps / ratio));
+    mNumTaps = (mNumTaps + 3) & ~3;
+    buildFilters(tier.cutoff * ratio, tier.kaiserBeta);
+
+    mHistoryCapacity = mNumTaps + kResamplerBlockFrames + mStep / mNumPhases + 1;
+    mHistory.resize(channelCount, std::vector<float>(mHistoryCapacity));
+    reset();
+}
+
+/**
+ * Tap k of phase p weighs the input sample which is (numTaps/2 - 1 - k) + p/numPhases frames
+ * before the output time.
+ */
+void Resampler::buildFilters(float cutoff, double kaiserBeta) {
+    mFilters.resize(static_cast<size_t>(mNumPhases) * mNumTaps);
+    const double halfLength = mNumTaps / 2.0;
+    const double windowScale = 1.0 / besselI0(kaiserBeta);
+
+    for (int32_t phase = 0; phase < mNumPhases; ++phase){
+        float *filter = &mFilters[static_cast<size_t>(phase) * mNumTaps];
+        double sum = 0;
+        for (int32_t k = 0; k < mNumTaps; ++k){
+            const double x = static_cast<double>(phase) / mNumPhases + (halfLength - 1 - k);
+            const double sincArgument = M_PI * cutoff * x;
+            const double sinc = (x == 0) ? 1.0 : std::sin(sincArgument) / sincArgument;
+            const double position = x / halfLength;
+            const double window = (std::abs(position) >= 1.0) ? 0.0 :
+                    besselI0(kaiserBeta * std::sqrt(1.0 - position * position)) * windowScale;
+            filter[k] = static_cast<float>(sinc * window);
+            sum += filter[k];
+        }
+        // unity gain at DC for every phase
+        for (int32_t k = 0; k < mNumTaps; ++k) filter[k] = static_cast<float>(filter[k] / sum);
+    }
+}
+
+void Resampler::reset() {
+    // Start with half a filter of silence so the first output lines up with the first input
+    for (auto &plane : mHistory) std::fill(plane.begin(), plane.end(), 0.0f);
+    mHistoryFrames = mNumTaps / 2 - 1;
+    mWindowStart = 0;
+    mPhase = 0;
+    mInputFramesTotal = 0;
+    mOutputFramesTotal = 0;
+}
+
+int32_t Resampler::getMaxOutputFrames(int32_t numInputFrames) const {
+    return static_cast<int32_t>((static_cast<int64_t>(numInputFrames) * mNumPhases) / mStep) + 2;
+}
+
+int32_t Resampler::process(const float *input, int32_t numInputFrames, float *output) {
+    mInputFramesTotal += numInputFrames;
+    int32_t framesOutput = 0;
+    while (numInputFrames > 0){
+        int32_t framesAppended = appendInput(input, numInputFrames);
+        input += framesAppended * mChannelCount;
+        numInputFrames -= framesAppended;
+        framesOutput += produceOutput(output + framesOutput * mChannelCount, INT64_MAX);
+    }
+    return framesOutput;
+}
+
+int32_t Resampler::flush(float *output) {
+    // The last output is the one for the last input frame
+    const int64_t totalOutputFrames = (mInputFramesTotal * mNumPhases + mStep - 1) / mStep;
+    int32_t framesOutput = 0;
+    int32_t silentFrames = mNumTaps;
+    while (silentFrames > 0 && mOutputFramesTotal < totalOutputFrames){
+        int32_t framesAppended = appendInput(nullptr, silentFrames);
+        silentFrames -= framesAppended;
+        framesOutput += produceOutput(output + framesOutput * mChannelCount,
+                totalOutputFrames - mOutputFramesTotal);
+    }
+    return framesOutput;
+}
+
+/**
+ * Deinterleaves as much input as fits into the history, silence if input is null.
+ * @return number of frames taken
+ */
+int32_t Resampler::appendInput(const float *input, int32_t numFrames) {
+    // move what is still needed to the front
+    if (mWindowStart > 0){
+        const int32_t framesToDrop = std::min(mWindowStart, mHistoryFrames);
+        for (auto &plane : mHistory){
+            memmove(plane.data(), plane.data() + framesToDrop, (mHistoryFrames - framesToDrop) * sizeof(float));
+        }
+        mHistoryFrames -= framesToDrop;
+        mWindowStart -= framesToDrop;
+    }
+
+    const int32_t framesToAppend = std::min(numFrames, mHistoryCapacity - mHistoryFrames);
+    for (int32_t channel = 0; channel < mChannelCount; ++channel){
+        float *plane = mHistory[channel].data() + mHistoryFrames;
+        if (input == nullptr){
+            std::fill(plane, plane + framesToAppend, 0.0f);
+            continue;
+        }
+        for (int32_t i = 0; i < framesToAppend; ++i) plane[i] = input[i * mChannelCount + channel];
+    }
+    mHistoryFrames += framesToAppend;
+    return framesToAppend;
+}
+
+int32_t Resampler::produceOutput(float *output, int64_t maxFrames) {
+    const SampleKernels &kernels = getSampleKernels();
+    int32_t framesOutput = 0;
+    while (mWindowStart + mNumTaps <= mHistoryFrames && framesOutput < maxFrames){
+        const float *filter = &mFilters[static_cast<size_t>(mPhase) * mNumTaps];
+        for (int32_t channel = 0; channel < mChannelCount; ++channel){
+            output[channel] = kernels.dotProduct(filter, mHistory[channel].data() + mWindowStart, mNumTaps);
+        }
+        output += mChannelCount;
+        ++framesOutput;
+
+        mPhase += mStep;
+        mWindowStart += mPhase / mNumPhases;
+        mPhase %= mNumPhases;
+    }
+    mOutputFramesTotal += framesOutput;
+    return framesOutput;
+}
@@ -0,0 +1,104 @@
+//
+// Created by 43975 on 2/1/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_RESAMPLER_H
+#define OBOE_AUDIO_PLAYER_RESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+// Input frames the resampler takes at a time, longer blocks are split up
+constexpr int32_t kResamplerBlockFrames = 1024;
+
+// Rates which would need more phases than this are approximated by rounding the step between
+// output frames to 1/kMaxResamplerPhases of an input frame. The step is about 1024 times the
+// rate ratio, so the rate and pitch are off by at most 0.5/step: 4.9e-4 or about 0.85 cent
+// for rates close to each other, twice that when upsampling 2x.
+constexpr int32_t kMaxResamplerPhases = 1024;
+
+/**
+ * Filter length and cutoff, higher tiers have a steeper filter and less aliasing but cost more.
+ * Fast: 8 taps, ~50dB stopband. Medium: 16 taps, ~70dB. High: 32 taps, ~90dB.
+ * The number of taps grows by the conversion ratio when downsampling.
+ */
+enum class ResamplerQuality : int32_t{
+    Fast,
+    Medium,
+    High
+};
+
+/**
+ * Band limited polyphase resampler for interleaved float audio.
+ *
+ * The ratio between the rates is reduced to outputRate/inputRate = L/M and a windowed sinc
+ * filter is precomputed for each of the L output phases, so every output sample is a single
+ * dot product of the taps with the input history, done with the vectorized SampleKernels.
+ *
+ * Works on a stream of blocks of any size, the output lags the input by half the filter length
+ * which flush() returns at the end. Nothing is allocated after construction.
+ */
+class Resampler{
+public:
+    Resampler(int32_t channelCount, int32_t inputRate, int32_t outputRate,
+              ResamplerQuality quality = ResamplerQuality::Medium);
+
+    /**
+     * @return the most frames process() can output for numInputFrames of input
+     */
+    int32_t getMaxOutputFrames(int32_t numInputFrames) const;
+
+    /**
+     * @return the most frames flush() can output
+     */
+    int32_t getMaxFlushFrames() const { return getMaxOutputFrames(mNumTaps); }
+
+    /**
+     * Consumes all the input.
+     * @return number of frames written to output
+     */
+    int32_t process(const float *input, int32_t numInputFrames, float *output);
+
+    /**
+     * Outputs what is left after the last input, so that the output lasts exactly as long as
+     * the input. Call reset() before using the resampler for another stream.
+     *
+     * @return number of frames written to output
+     */
+    int32_t flush(float *output);
+
+    void reset();
+
+    int32_t getNumTaps() const { return mNumTaps; }
+    int32_t getInputRate() const { return mInputRate; }
+    int32_t getOutputRate() const { return mOutputRate; }
+
+private:
+    void buildFilters(float cutoff, double kaiserBeta);
+    int32_t appendInput(const float *input, int32_t numFrames);
+    int32_t produceOutput(float *output, int64_t maxFrames);
+
+    const int32_t mChannelCount;
+    const int32_t mInputRate;
+    const int32_t mOutputRate;
+
+    // Every output frame advances the input by mStep/mNumPhases frames
+    int32_t mNumPhases;
+    int32_t mStep;
+    int32_t mNumTaps;
+
+    // mNumPhases filters of mNumTaps coefficients
+    std::vector<float> mFilters;
+
+    // Input history, one plane per channel, the next output starts at mWindowStart
+    std::vector<std::vector<float>> mHistory;
+    int32_t mHistoryCapacity;
+    int32_t mHistoryFrames;
+    int32_t mWindowStart;
+    int32_t mPhase;
+
+    int64_t mInputFramesTotal;
+    int64_t mOutputFramesTotal;
+};
+
+#endif //OBOE_AUDIO_PLAYER_RESAMPLER_H
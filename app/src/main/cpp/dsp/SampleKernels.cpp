@@ -0,0 +1,157 @@
+//
+// Created by 43975 on 1/14/2022.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "SampleKernels.h"
+
+static void convertI16ToFloatScalar(const int16_t *source, float *destination, int32_t numSamples) {
+    for (int i = 0; i < numSamples; ++i) {
+        destination[i] = source[i] * kInt16ToFloatScale;
+    }
+}
+
+static void convertFloatToI16Scalar(const float *source, int16_t *destination, int32_t numSamples) {
+    for (int i = 0; i < numSamples; ++i) {
+        float scaled = std::min(std::max(source[i] * kFloatToInt16Scale, kInt16MinValue), kInt16MaxValue);
+        destination[i] = static_cast<int16_t>(lrintf(scaled));
+    }
+}
+
+static float halfToFloat(uint16_t half) {
+    const uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        // infinity or NaN
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // subnormal halves are normal floats, shift the mantissa up to the implicit bit
+        uint32_t floatExponent = 127 - 15 + 1;
+        while ((mantissa & 0x400u) == 0) {
+            mantissa <<= 1;
+            --floatExponent;
+        }
+        bits = sign | (floatExponent << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    uint32_t magnitude = bits & 0x7fffffffu;
+
+    if (magnitude >= 0x7f800000u) {
+        // infinity stays infinity, NaN stays a quiet NaN
+        return sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u | ((magnitude >> 13) & 0x3ffu) : 0u);
+    }
+    if (magnitude >= 0x477ff000u) {
+        // rounds to more than the largest half (65504)
+        return sign | 0x7c00u;
+    }
+    if (magnitude < 0x38800000u) {
+        // Below the smallest normal half. Adding 0.5 moves the value to where the float ulp is
+        // the half subnormal step, so the FPU does the rounding to nearest even.
+        float magnitudeValue;
+        memcpy(&magnitudeValue, &magnitude, sizeof(magnitude));
+        magnitudeValue += 0.5f;
+        uint32_t roundedBits;
+        memcpy(&roundedBits, &magnitudeValue, sizeof(roundedBits));
+        return sign | static_cast<uint16_t>(roundedBits - 0x3f000000u);
+    }
+    // rebias the exponent and round the 13 dropped mantissa bits to nearest even
+    const uint32_t isMantissaOdd = (magnitude >> 13) & 1u;
+    magnitude += (static_cast<uint32_t>(15 - 127) << 23) + 0xfffu + isMantissaOdd;
+    return sign | static_cast<uint16_t>(magnitude >> 13);
+}
+
+static void convertHalfToFloatScalar(const uint16_t *source, float *destination, int32_t numSamples) {
+    for (int i = 0; i < numSamples; ++i) {
+        destination[i] = halfToFloat(source[i]);
+    }
+}
+
+static void convertFloatToHalfScalar(const float *source, uint16_t *destination, int32_t numSamples) {
+    for (int i = 0; i < numSamples; ++i) {
+        destination[i] = floatToHalf(source[i]);
+    }
+}
+
+static void applyGainScalar(float *buffer, int32_t numSamples, float gain) {
+    for (int i = 0; i < numSamples; ++i) {
+        buffer[i] *= gain;
+    }
+}
+
+static void applyGainRampScalar(float *buffer, int32_t numFrames, int32_t channelCount,
+        float startGain, float endGain) {
+    const float step = (endGain - startGain) / numFrames;
+    for (int i = 0; i < numFrames; ++i) {
+        const float gain = startGain + step * static_cast<float>(i);
+        for (int j = 0; j < channelCount; ++j) {
+            buffer[i * channelCount + j] *= gain;
+        }
+    }
+}
+
+static void mixStereoScalar(const float *source, float *destination, int32_t numFrames,
+        float leftGain, float rightGain) {
+    for (int i = 0; i < numFrames; ++i) {
+        destination[i * 2] += source[i * 2] * leftGain;
+        destination[i * 2 + 1] += source[i * 2 + 1] * rightGain;
+    }
+}
+
+static void clearScalar(float *buffer, int32_t numSamples) {
+    memset(buffer, 0, numSamples * sizeof(float));
+}
+
+static float dotProductScalar(const float *a, const float *b, int32_t numSamples) {
+    float sum = 0;
+    for (int i = 0; i < numSamples; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static const SampleKernels kScalarKernels{
+        "scalar",
+        convertI16ToFloatScalar,
+        convertFloatToI16Scalar,
+        convertHalfToFloatScalar,
+        convertFloatToHalfScalar,
+        applyGainScalar,
+        applyGainRampScalar,
+        mixStereoScalar,
+        clearScalar,
+        dotProductScalar
+};
+
+const SampleKernels &getScalarSampleKernels() {
+    return kScalarKernels;
+}
+
+std::vector<const SampleKernels *> getSupportedSampleKernels() {
+    std::vector<const SampleKernels *> kernels{&kScalarKernels};
+    for (const SampleKernels *simdKernels : {getNeonSampleKernels(), getSse2SampleKernels(),
+                                             getAvx2SampleKernels()}) {
+        if (simdKernels != nullptr) kernels.push_back(simdKernels);
+    }
+    return kernels;
+}
+
+const SampleKernels &getSampleKernels() {
+    // Ordered from the least to the most capable, so the last one supported wins
+    static const SampleKernels &kernels = *getSupportedSampleKernels().back();
+    return kernels;
+}
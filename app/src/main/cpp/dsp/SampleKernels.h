@@ -0,0 +1,82 @@
+//
+// Created by 43975 on 1/14/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_SAMPLEKERNELS_H
+#define OBOE_AUDIO_PLAYER_SAMPLEKERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+constexpr float kInt16ToFloatScale = 1.0f / 32768.0f;
+constexpr float kFloatToInt16Scale = 32768.0f;
+constexpr float kInt16MinValue = -32768.0f;
+constexpr float kInt16MaxValue = 32767.0f;
+
+/**
+ * Table of the sample format and mixing routines used on the render and decode paths.
+ *
+ * There is a scalar implementation which works everywhere and vectorized ones for NEON, SSE2
+ * and AVX2. The fastest one supported by the CPU is picked the first time getSampleKernels()
+ * is called, so call it once during setup rather than first on the audio thread.
+ *
+ * All buffers hold interleaved samples and don't need any particular alignment.
+ */
+struct SampleKernels{
+    const char *name;
+
+    // int16 -> float in the range [-1, 1)
+    void (*convertI16ToFloat)(const int16_t *source, float *destination, int32_t numSamples);
+
+    // float -> int16, rounded to nearest and clipped to the int16 range
+    void (*convertFloatToI16)(const float *source, int16_t *destination, int32_t numSamples);
+
+    // IEEE half precision -> float, exact
+    void (*convertHalfToFloat)(const uint16_t *source, float *destination, int32_t numSamples);
+
+    // float -> IEEE half precision, rounded to nearest even
+    void (*convertFloatToHalf)(const float *source, uint16_t *destination, int32_t numSamples);
+
+    // buffer *= gain
+    void (*applyGain)(float *buffer, int32_t numSamples, float gain);
+
+    // Gain moves linearly from startGain at the first frame towards endGain, which is reached
+    // on the frame after the last one, so consecutive ramps join up smoothly.
+    void (*applyGainRamp)(float *buffer, int32_t numFrames, int32_t channelCount,
+            float startGain, float endGain);
+
+    // destination += source * gain, with separate gains for the left and right channels of
+    // interleaved stereo buffers
+    void (*mixStereo)(const float *source, float *destination, int32_t numFrames,
+            float leftGain, float rightGain);
+
+    // buffer = 0
+    void (*clear)(float *buffer, int32_t numSamples);
+
+    // sum of a[i] * b[i], the vectorized versions add in a different order so the result may
+    // differ from the scalar one in the last bits
+    float (*dotProduct)(const float *a, const float *b, int32_t numSamples);
+};
+
+/**
+ * @return the fastest implementation supported by this CPU.
+ */
+const SampleKernels &getSampleKernels();
+
+/**
+ * @return the plain C++ implementation which the vectorized ones must match.
+ */
+const SampleKernels &getScalarSampleKernels();
+
+/**
+ * @return every implementation which can run on this CPU, the scalar one first.
+ */
+std::vector<const SampleKernels *> getSupportedSampleKernels();
+
+// Per instruction set tables, these return nullptr if the instruction set isn't available
+// in this build or on this CPU
+const SampleKernels *getNeonSampleKernels();
+const SampleKernels *getSse2SampleKernels();
+const SampleKernels *getAvx2SampleKernels();
+
+#endif //OBOE_AUDIO_PLAYER_SAMPLEKERNELS_H
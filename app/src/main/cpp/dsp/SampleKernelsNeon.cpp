@@ -0,0 +1,181 @@
+//
+// Created by 43975 on 1/14/2022.
+//
+#include "SampleKernels.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static void convertI16ToFloatNeon(const int16_t *source, float *destination, int32_t numSamples) {
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        int16x8_t samples = vld1q_s16(source + i);
+        float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples)));
+        float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples)));
+        vst1q_f32(destination + i, vmulq_n_f32(low, kInt16ToFloatScale));
+        vst1q_f32(destination + i + 4, vmulq_n_f32(high, kInt16ToFloatScale));
+    }
+    getScalarSampleKernels().convertI16ToFloat(source + i, destination + i, numSamples - i);
+}
+
+static inline int32x4_t roundToInt32(float32x4_t values) {
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(values);
+#else
+    // ARMv7 can only truncate, so round half away from zero instead. This differs from the
+    // scalar version by one LSB for values exactly halfway between two integers.
+    const float32x4_t half = vbslq_f32(vcltq_f32(values, vdupq_n_f32(0.0f)),
+            vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+    return vcvtq_s32_f32(vaddq_f32(values, half));
+#endif
+}
+
+static void convertFloatToI16Neon(const float *source, int16_t *destination, int32_t numSamples) {
+    const float32x4_t minValue = vdupq_n_f32(kInt16MinValue);
+    const float32x4_t maxValue = vdupq_n_f32(kInt16MaxValue);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        float32x4_t low = vmulq_n_f32(vld1q_f32(source + i), kFloatToInt16Scale);
+        float32x4_t high = vmulq_n_f32(vld1q_f32(source + i + 4), kFloatToInt16Scale);
+        low = vminq_f32(vmaxq_f32(low, minValue), maxValue);
+        high = vminq_f32(vmaxq_f32(high, minValue), maxValue);
+        int16x8_t packed = vcombine_s16(vqmovn_s32(roundToInt32(low)), vqmovn_s32(roundToInt32(high)));
+        vst1q_s16(destination + i, packed);
+    }
+    getScalarSampleKernels().convertFloatToI16(source + i, destination + i, numSamples - i);
+}
+
+static void convertHalfToFloatNeon(const uint16_t *source, float *destination, int32_t numSamples) {
+#if defined(__aarch64__)
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        vst1q_f32(destination + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(source + i))));
+        vst1q_f32(destination + i + 4, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(source + i + 4))));
+    }
+    getScalarSampleKernels().convertHalfToFloat(source + i, destination + i, numSamples - i);
+#else
+    // half precision conversions are an optional extension on ARMv7
+    getScalarSampleKernels().convertHalfToFloat(source, destination, numSamples);
+#endif
+}
+
+static void convertFloatToHalfNeon(const float *source, uint16_t *destination, int32_t numSamples) {
+#if defined(__aarch64__)
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        vst1_u16(destination + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source + i))));
+        vst1_u16(destination + i + 4, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(source + i + 4))));
+    }
+    getScalarSampleKernels().convertFloatToHalf(source + i, destination + i, numSamples - i);
+#else
+    getScalarSampleKernels().convertFloatToHalf(source, destination, numSamples);
+#endif
+}
+
+static void applyGainNeon(float *buffer, int32_t numSamples, float gain) {
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        vst1q_f32(buffer + i, vmulq_n_f32(vld1q_f32(buffer + i), gain));
+    }
+    getScalarSampleKernels().applyGain(buffer + i, numSamples - i, gain);
+}
+
+static void applyGainRampNeon(float *buffer, int32_t numFrames, int32_t channelCount,
+        float startGain, float endGain) {
+    if (channelCount != 1 && channelCount != 2) {
+        getScalarSampleKernels().applyGainRamp(buffer, numFrames, channelCount, startGain, endGain);
+        return;
+    }
+    const float step = (endGain - startGain) / numFrames;
+    const float32x4_t starts = vdupq_n_f32(startGain);
+
+    // frame index of every lane, a vector holds 4 mono or 2 stereo frames
+    const int32_t framesPerVector = 4 / channelCount;
+    static const float kMonoIndices[4] = {0, 1, 2, 3};
+    static const float kStereoIndices[4] = {0, 0, 1, 1};
+    float32x4_t frameIndices = vld1q_f32(channelCount == 1 ? kMonoIndices : kStereoIndices);
+    const float32x4_t increment = vdupq_n_f32(static_cast<float>(framesPerVector));
+
+    int i = 0;
+    for (; i + framesPerVector <= numFrames; i += framesPerVector) {
+        // multiply and add separately rather than fused so the result matches the scalar version
+        float32x4_t gains = vaddq_f32(starts, vmulq_n_f32(frameIndices, step));
+        float *samples = buffer + i * channelCount;
+        vst1q_f32(samples, vmulq_f32(vld1q_f32(samples), gains));
+        frameIndices = vaddq_f32(frameIndices, increment);
+    }
+    for (; i < numFrames; ++i) {
+        const float gain = startGain + step * static_cast<float>(i);
+        for (int j = 0; j < channelCount; ++j) buffer[i * channelCount + j] *= gain;
+    }
+}
+
+static void mixStereoNeon(const float *source, float *destination, int32_t numFrames,
+        float leftGain, float rightGain) {
+    const float gainValues[4] = {leftGain, rightGain, leftGain, rightGain};
+    const float32x4_t gains = vld1q_f32(gainValues);
+    int i = 0;
+    for (; i + 2 <= numFrames; i += 2) {
+        float32x4_t mixed = vaddq_f32(vld1q_f32(destination + i * 2),
+                vmulq_f32(vld1q_f32(source + i * 2), gains));
+        vst1q_f32(destination + i * 2, mixed);
+    }
+    getScalarSampleKernels().mixStereo(source + i * 2, destination + i * 2, numFrames - i,
+            leftGain, rightGain);
+}
+
+static void clearNeon(float *buffer, int32_t numSamples) {
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        vst1q_f32(buffer + i, zero);
+    }
+    for (; i < numSamples; ++i) buffer[i] = 0;
+}
+
+static float dotProductNeon(const float *a, const float *b, int32_t numSamples) {
+    float32x4_t sum = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float32x2_t pairs = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    float result = vget_lane_f32(vpadd_f32(pairs, pairs), 0);
+    for (; i < numSamples; ++i) result += a[i] * b[i];
+    return result;
+}
+
+static const SampleKernels kNeonKernels{
+        "neon",
+        convertI16ToFloatNeon,
+        convertFloatToI16Neon,
+        convertHalfToFloatNeon,
+        convertFloatToHalfNeon,
+        applyGainNeon,
+        applyGainRampNeon,
+        mixStereoNeon,
+        clearNeon,
+        dotProductNeon
+};
+
+const SampleKernels *getNeonSampleKernels() {
+#if defined(__arm__)
+    // NEON is optional on ARMv7
+    if ((getauxval(AT_HWCAP) & HWCAP_NEON) == 0) return nullptr;
+#endif
+    return &kNeonKernels;
+}
+
+#else
+
+const SampleKernels *getNeonSampleKernels() {
+    return nullptr;
+}
+
+#endif
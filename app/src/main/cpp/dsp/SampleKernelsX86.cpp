@@ -0,0 +1,303 @@
+//
+// Created by 43975 on 1/14/2022.
+//
+#include "SampleKernels.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+// The SSE2 versions are compiled for the baseline of every x86 Android ABI. The AVX2 versions
+// are compiled with a per function target attribute so that the rest of the library doesn't
+// require AVX2, they are only used after checking the CPU supports it. They also use the F16C
+// half precision conversions, which are a separate feature a hypervisor can hide even when it
+// exposes AVX2, so both are checked.
+
+#define AVX2_TARGET __attribute__((target("avx2,f16c")))
+
+// SSE2
+
+static void convertI16ToFloatSse2(const int16_t *source, float *destination, int32_t numSamples) {
+    const __m128 scale = _mm_set1_ps(kInt16ToFloatScale);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+        // sign extend to 32 bits by placing the samples in the upper halves and shifting down
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(destination + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+    getScalarSampleKernels().convertI16ToFloat(source + i, destination + i, numSamples - i);
+}
+
+static void convertFloatToI16Sse2(const float *source, int16_t *destination, int32_t numSamples) {
+    const __m128 scale = _mm_set1_ps(kFloatToInt16Scale);
+    const __m128 minValue = _mm_set1_ps(kInt16MinValue);
+    const __m128 maxValue = _mm_set1_ps(kInt16MaxValue);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        __m128 low = _mm_mul_ps(_mm_loadu_ps(source + i), scale);
+        __m128 high = _mm_mul_ps(_mm_loadu_ps(source + i + 4), scale);
+        low = _mm_min_ps(_mm_max_ps(low, minValue), maxValue);
+        high = _mm_min_ps(_mm_max_ps(high, minValue), maxValue);
+        // _mm_cvtps_epi32 rounds to nearest even like lrintf
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), packed);
+    }
+    getScalarSampleKernels().convertFloatToI16(source + i, destination + i, numSamples - i);
+}
+
+// SSE2 has no half precision conversions
+static void convertHalfToFloatSse2(const uint16_t *source, float *destination, int32_t numSamples) {
+    getScalarSampleKernels().convertHalfToFloat(source, destination, numSamples);
+}
+
+static void convertFloatToHalfSse2(const float *source, uint16_t *destination, int32_t numSamples) {
+    getScalarSampleKernels().convertFloatToHalf(source, destination, numSamples);
+}
+
+static void applyGainSse2(float *buffer, int32_t numSamples, float gain) {
+    const __m128 gains = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        _mm_storeu_ps(buffer + i, _mm_mul_ps(_mm_loadu_ps(buffer + i), gains));
+    }
+    getScalarSampleKernels().applyGain(buffer + i, numSamples - i, gain);
+}
+
+static void applyGainRampSse2(float *buffer, int32_t numFrames, int32_t channelCount,
+        float startGain, float endGain) {
+    if (channelCount != 1 && channelCount != 2) {
+        getScalarSampleKernels().applyGainRamp(buffer, numFrames, channelCount, startGain, endGain);
+        return;
+    }
+    const float step = (endGain - startGain) / numFrames;
+    const __m128 starts = _mm_set1_ps(startGain);
+    const __m128 steps = _mm_set1_ps(step);
+
+    // frame index of every lane, a vector holds 4 mono or 2 stereo frames
+    const int32_t framesPerVector = 4 / channelCount;
+    __m128 frameIndices = (channelCount == 1) ? _mm_setr_ps(0, 1, 2, 3) : _mm_setr_ps(0, 0, 1, 1);
+    const __m128 increment = _mm_set1_ps(static_cast<float>(framesPerVector));
+
+    int i = 0;
+    for (; i + framesPerVector <= numFrames; i += framesPerVector) {
+        __m128 gains = _mm_add_ps(starts, _mm_mul_ps(steps, frameIndices));
+        float *samples = buffer + i * channelCount;
+        _mm_storeu_ps(samples, _mm_mul_ps(_mm_loadu_ps(samples), gains));
+        frameIndices = _mm_add_ps(frameIndices, increment);
+    }
+    for (; i < numFrames; ++i) {
+        const float gain = startGain + step * static_cast<float>(i);
+        for (int j = 0; j < channelCount; ++j) buffer[i * channelCount + j] *= gain;
+    }
+}
+
+static void mixStereoSse2(const float *source, float *destination, int32_t numFrames,
+        float leftGain, float rightGain) {
+    const __m128 gains = _mm_setr_ps(leftGain, rightGain, leftGain, rightGain);
+    int i = 0;
+    for (; i + 2 <= numFrames; i += 2) {
+        __m128 mixed = _mm_add_ps(_mm_loadu_ps(destination + i * 2),
+                _mm_mul_ps(_mm_loadu_ps(source + i * 2), gains));
+        _mm_storeu_ps(destination + i * 2, mixed);
+    }
+    getScalarSampleKernels().mixStereo(source + i * 2, destination + i * 2, numFrames - i,
+            leftGain, rightGain);
+}
+
+static void clearSse2(float *buffer, int32_t numSamples) {
+    const __m128 zero = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        _mm_storeu_ps(buffer + i, zero);
+    }
+    for (; i < numSamples; ++i) buffer[i] = 0;
+}
+
+static float dotProductSse2(const float *a, const float *b, int32_t numSamples) {
+    __m128 sum = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= numSamples; i += 4) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    // horizontal add of the four partial sums
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    float result = _mm_cvtss_f32(sum);
+    for (; i < numSamples; ++i) result += a[i] * b[i];
+    return result;
+}
+
+// AVX2
+
+AVX2_TARGET static void convertI16ToFloatAvx2(const int16_t *source, float *destination, int32_t numSamples) {
+    const __m256 scale = _mm256_set1_ps(kInt16ToFloatScale);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i)));
+        _mm256_storeu_ps(destination + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+    }
+    getScalarSampleKernels().convertI16ToFloat(source + i, destination + i, numSamples - i);
+}
+
+AVX2_TARGET static void convertFloatToI16Avx2(const float *source, int16_t *destination, int32_t numSamples) {
+    const __m256 scale = _mm256_set1_ps(kFloatToInt16Scale);
+    const __m256 minValue = _mm256_set1_ps(kInt16MinValue);
+    const __m256 maxValue = _mm256_set1_ps(kInt16MaxValue);
+    int i = 0;
+    for (; i + 16 <= numSamples; i += 16) {
+        __m256 low = _mm256_mul_ps(_mm256_loadu_ps(source + i), scale);
+        __m256 high = _mm256_mul_ps(_mm256_loadu_ps(source + i + 8), scale);
+        low = _mm256_min_ps(_mm256_max_ps(low, minValue), maxValue);
+        high = _mm256_min_ps(_mm256_max_ps(high, minValue), maxValue);
+        // packs works within 128 bit lanes, the permute puts the 64 bit blocks back in order
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(low), _mm256_cvtps_epi32(high));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), packed);
+    }
+    convertFloatToI16Sse2(source + i, destination + i, numSamples - i);
+}
+
+AVX2_TARGET static void convertHalfToFloatAvx2(const uint16_t *source, float *destination, int32_t numSamples) {
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+        _mm256_storeu_ps(destination + i, _mm256_cvtph_ps(halves));
+    }
+    getScalarSampleKernels().convertHalfToFloat(source + i, destination + i, numSamples - i);
+}
+
+AVX2_TARGET static void convertFloatToHalfAvx2(const float *source, uint16_t *destination, int32_t numSamples) {
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), halves);
+    }
+    getScalarSampleKernels().convertFloatToHalf(source + i, destination + i, numSamples - i);
+}
+
+AVX2_TARGET static void applyGainAvx2(float *buffer, int32_t numSamples, float gain) {
+    const __m256 gains = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        _mm256_storeu_ps(buffer + i, _mm256_mul_ps(_mm256_loadu_ps(buffer + i), gains));
+    }
+    getScalarSampleKernels().applyGain(buffer + i, numSamples - i, gain);
+}
+
+AVX2_TARGET static void applyGainRampAvx2(float *buffer, int32_t numFrames, int32_t channelCount,
+        float startGain, float endGain) {
+    if (channelCount != 1 && channelCount != 2) {
+        getScalarSampleKernels().applyGainRamp(buffer, numFrames, channelCount, startGain, endGain);
+        return;
+    }
+    const float step = (endGain - startGain) / numFrames;
+    const __m256 starts = _mm256_set1_ps(startGain);
+    const __m256 steps = _mm256_set1_ps(step);
+
+    const int32_t framesPerVector = 8 / channelCount;
+    __m256 frameIndices = (channelCount == 1) ? _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)
+                                              : _mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256 increment = _mm256_set1_ps(static_cast<float>(framesPerVector));
+
+    int i = 0;
+    for (; i + framesPerVector <= numFrames; i += framesPerVector) {
+        __m256 gains = _mm256_add_ps(starts, _mm256_mul_ps(steps, frameIndices));
+        float *samples = buffer + i * channelCount;
+        _mm256_storeu_ps(samples, _mm256_mul_ps(_mm256_loadu_ps(samples), gains));
+        frameIndices = _mm256_add_ps(frameIndices, increment);
+    }
+    for (; i < numFrames; ++i) {
+        const float gain = startGain + step * static_cast<float>(i);
+        for (int j = 0; j < channelCount; ++j) buffer[i * channelCount + j] *= gain;
+    }
+}
+
+AVX2_TARGET static void mixStereoAvx2(const float *source, float *destination, int32_t numFrames,
+        float leftGain, float rightGain) {
+    const __m256 gains = _mm256_setr_ps(leftGain, rightGain, leftGain, rightGain,
+                                        leftGain, rightGain, leftGain, rightGain);
+    int i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        __m256 mixed = _mm256_add_ps(_mm256_loadu_ps(destination + i * 2),
+                _mm256_mul_ps(_mm256_loadu_ps(source + i * 2), gains));
+        _mm256_storeu_ps(destination + i * 2, mixed);
+    }
+    getScalarSampleKernels().mixStereo(source + i * 2, destination + i * 2, numFrames - i,
+            leftGain, rightGain);
+}
+
+AVX2_TARGET static void clearAvx2(float *buffer, int32_t numSamples) {
+    const __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        _mm256_storeu_ps(buffer + i, zero);
+    }
+    for (; i < numSamples; ++i) buffer[i] = 0;
+}
+
+AVX2_TARGET static float dotProductAvx2(const float *a, const float *b, int32_t numSamples) {
+    __m256 sum = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= numSamples; i += 8) {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float result = _mm_cvtss_f32(half);
+    for (; i < numSamples; ++i) result += a[i] * b[i];
+    return result;
+}
+
+static const SampleKernels kSse2Kernels{
+        "sse2",
+        convertI16ToFloatSse2,
+        convertFloatToI16Sse2,
+        convertHalfToFloatSse2,
+        convertFloatToHalfSse2,
+        applyGainSse2,
+        applyGainRampSse2,
+        mixStereoSse2,
+        clearSse2,
+        dotProductSse2
+};
+
+static const SampleKernels kAvx2Kernels{
+        "avx2",
+        convertI16ToFloatAvx2,
+        convertFloatToI16Avx2,
+        convertHalfToFloatAvx2,
+        convertFloatToHalfAvx2,
+        applyGainAvx2,
+        applyGainRampAvx2,
+        mixStereoAvx2,
+        clearAvx2,
+        dotProductAvx2
+};
+
+const SampleKernels *getSse2SampleKernels() {
+    return &kSse2Kernels;
+}
+
+const SampleKernels *getAvx2SampleKernels() {
+    // read F16C from CPUID directly, not every compiler knows it in __builtin_cpu_supports
+    unsigned int eax, ebx, ecx, edx;
+    const bool hasF16c = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_F16C) != 0;
+    return (__builtin_cpu_supports("avx2") && hasF16c) ? &kAvx2Kernels : nullptr;
+}
+
+#else
+
+const SampleKernels *getSse2SampleKernels() {
+    return nullptr;
+}
+
+const SampleKernels *getAvx2SampleKernels() {
+    return nullptr;
+}
+
+#endif
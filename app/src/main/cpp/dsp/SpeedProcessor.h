@@ -0,0 +1,62 @@
+//
+// Created by 43975 on 2/2/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_SPEEDPROCESSOR_H
+#define OBOE_AUDIO_PLAYER_SPEEDPROCESSOR_H
+
+#include <cstdint>
+
+constexpr float kMinPlaybackSpeed = 0.5f;
+constexpr float kMaxPlaybackSpeed = 2.0f;
+
+/**
+ * How playback at other than normal speed is done. Linear and Cubic read the source at a
+ * fractional position, so the pitch follows the speed like a tape. TimeStretch keeps the pitch.
+ */
+enum class SpeedMode : int32_t{
+    Linear,
+    Cubic,
+    TimeStretch
+};
+
+/**
+ * Where a SpeedProcessor pulls its input from, on the audio thread.
+ */
+class FrameReader{
+public:
+    virtual ~FrameReader(){}
+
+    /**
+     * @return number of interleaved float frames written to buffer, fewer than numFrames if no
+     * more input is available right now
+     */
+    virtual int32_t readFrames(float *buffer, int32_t numFrames) =0;
+
+    // true once no more input will come, as opposed to none being available right now
+    virtual bool isEndOfInput() const { return false; }
+};
+
+/**
+ * Plays the input of a FrameReader at a different speed. Processors allocate everything they
+ * need up front and can be used from the audio callback.
+ */
+class SpeedProcessor{
+public:
+    virtual ~SpeedProcessor(){}
+
+    /**
+     * Render numFrames of output, reading as much input as that takes. When the reader runs
+     * dry the processor keeps what it has and continues from there on the next call. At the end
+     * of the input it plays out what it has buffered instead, until nothing is left.
+     *
+     * @param speed : between kMinPlaybackSpeed and kMaxPlaybackSpeed
+     * @return number of frames written to output
+     */
+    virtual int32_t render(FrameReader &reader, float *output, int32_t numFrames, float speed) =0;
+
+    // Forget the buffered input, as after a seek
+    virtual void reset() =0;
+};
+
+#endif //OBOE_AUDIO_PLAYER_SPEEDPROCESSOR_H
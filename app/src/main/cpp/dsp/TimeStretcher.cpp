@@ -0,0 +1,193 @@
+//
+// Created by 43975 on 2/2/2022.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "TimeStretcher.h"
+#include "SampleKernels.h"
+
+// Span of input one segment and its search range can cover, plus one step at the highest speed
+// so that most blocks are synthesized without reading more
+constexpr int32_t kStretchInputFrames = 2 * kStretchSearchFrames + 2 * kStretchOverlapFrames
+        + static_cast<int32_t>(kMaxPlaybackSpeed * kStretchOverlapFrames) + 1;
+
+TimeStretcher::TimeStretcher(int32_t channelCount)
+:mChannelCount(channelCount),
+mFadeIn(kStretchOverlapFrames),
+mInput(kStretchInputFrames * channelCount),
+mPreviousTail(kStretchOverlapFrames * channelCount),
+mPreviousTailMono(kStretchOverlapFrames),
+mSearchMono(2 * kStretchSearchFrames + kStretchOverlapFrames),
+mBlock(kStretchOverlapFrames * channelCount){
+    // raised cosine, fade in and fade out add up to one
+    for (int32_t i = 0; i < kStretchOverlapFrames; ++i){
+        mFadeIn[i] = 0.5f - 0.5f * std::cos(static_cast<float>(M_PI) * (i + 0.5f) / kStretchOverlapFrames);
+    }
+    reset();
+}
+
+void TimeStretcher::reset() {
+    mInputFrames = 0;
+    mNextPosition = 0;
+    mIsDraining = false;
+    mHasPreviousTail = false;
+    mBlockReadFrame = kStretchOverlapFrames;
+}
+
+int32_t TimeStretcher::render(FrameReader &reader, float *output, int32_t numFrames, float speed) {
+    int32_t framesRendered = 0;
+    while (framesRendered < numFrames){
+        if (mBlockReadFrame == kStretchOverlapFrames){
+            if (!synthesizeBlock(reader, speed)) break;
+            mBlockReadFrame = 0;
+        }
+        const int32_t framesToCopy = std::min(numFrames - framesRendered, kStretchOverlapFrames - mBlockReadFrame);
+        memcpy(&output[framesRendered * mChannelCount], &mBlock[mBlockReadFrame * mChannelCount],
+               framesToCopy * mChannelCount * sizeof(float));
+        framesRendered += framesToCopy;
+        mBlockReadFrame += framesToCopy;
+    }
+    return framesRendered;
+}
+
+/**
+ * Makes sure frames [firstFrameNeeded, firstFrameNeeded + framesNeeded) of the input are
+ * buffered, dropping the ones before firstFrameNeeded. Positions move accordingly.
+ * @return false if the reader doesn't have enough input yet
+ */
+bool TimeStretcher::readInput(FrameReader &reader, int32_t firstFrameNeeded, int32_t framesNeeded) {
+    if (firstFrameNeeded > 0){
+        const int32_t framesToDrop = std::min(firstFrameNeeded, mInputFrames);
+        memmove(mInput.data(), &mInput[framesToDrop * mChannelCount],
+                (mInputFrames - framesToDrop) * mChannelCount * sizeof(float));
+        mInputFrames -= framesToDrop;
+        mNextPosition -= framesToDrop;
+        mEndFrame -= framesToDrop;
+        mPreviousTailFrame -= framesToDrop;
+        // frames skipped over at high speed which were never buffered
+        if (framesToDrop < firstFrameNeeded){
+            float skipped[256];
+            int32_t framesToSkip = firstFrameNeeded - framesToDrop;
+            const int32_t maxSkipFrames = static_cast<int32_t>(sizeof(skipped) / sizeof(float)) / mChannelCount;
+            while (framesToSkip > 0){
+                int32_t framesRead = pullInput(reader, skipped, std::min(framesToSkip, maxSkipFrames));
+                if (framesRead == 0) return false;
+                framesToSkip -= framesRead;
+                mNextPosition -= framesRead;
+                mEndFrame -= framesRead;
+                mPreviousTailFrame -= framesRead;
+            }
+        }
+    }
+
+    while (mInputFrames < framesNeeded){
+        const auto capacity = static_cast<int32_t>(mInput.size() / mChannelCount);
+        int32_t framesRead = pullInput(reader, &mInput[mInputFrames * mChannelCount], capacity - mInputFrames);
+        if (framesRead == 0) return false;
+        mInputFrames += framesRead;
+    }
+    return true;
+}
+
+/**
+ * Reads from the reader until it has ended, then hands out silence so the segments still
+ * buffered can be played out.
+ * @return number of frames written to buffer
+ */
+int32_t TimeStretcher::pullInput(FrameReader &reader, float *buffer, int32_t numFrames) {
+    if (!mIsDraining){
+        const int32_t framesRead = reader.readFrames(buffer, numFrames);
+        if (framesRead > 0 || !reader.isEndOfInput()) return framesRead;
+        mIsDraining = true;
+        mEndFrame = mInputFrames;
+    }
+    std::fill(buffer, buffer + numFrames * mChannelCount, 0.0f);
+    return numFrames;
+}
+
+/**
+ * @return start of the candidate segment, among the first numOffsets frames of the input, which
+ * correlates best with the previous tail
+ */
+int32_t TimeStretcher::findBestOffset(int32_t numOffsets) {
+    const SampleKernels &kernels = getSampleKernels();
+    const int32_t searchFrames = numOffsets - 1 + kStretchOverlapFrames;
+    const float channelScale = 1.0f / mChannelCount;
+    for (int32_t i = 0; i < searchFrames; ++i){
+        const float *frame = &mInput[i * mChannelCount];
+        float sum = 0;
+        for (int32_t channel = 0; channel < mChannelCount; ++channel) sum += frame[channel];
+        mSearchMono[i] = sum * channelScale;
+    }
+
+    // energy of the candidate, updated as the window slides along
+    float energy = kernels.dotProduct(mSearchMono.data(), mSearchMono.data(), kStretchOverlapFrames);
+    int32_t bestOffset = 0;
+    float bestScore = -INFINITY;
+    for (int32_t offset = 0; offset < numOffsets; ++offset){
+        if (offset > 0){
+            const float leaving = mSearchMono[offset - 1];
+            const float entering = mSearchMono[offset - 1 + kStretchOverlapFrames];
+            energy = std::max(0.0f, energy - leaving * leaving + entering * entering);
+        }
+        const float correlation = kernels.dotProduct(mPreviousTailMono.data(), &mSearchMono[offset],
+                                                     kStretchOverlapFrames);
+        // compare correlation / sqrt(energy) without the square root, keeping the sign
+        const float score = correlation * std::abs(correlation) / (energy + 1e-9f);
+        if (score > bestScore){
+            bestScore = score;
+            bestOffset = offset;
+        }
+    }
+    return bestOffset;
+}
+
+/**
+ * Cross-fades the next segment into mBlock and keeps its second half for the next block.
+ * @return false if there isn't enough input, or the input has ended and been played out
+ */
+bool TimeStretcher::synthesizeBlock(FrameReader &reader, float speed) {
+    // done once all that's left to cross-fade is the silence after the end
+    if (mIsDraining && (mHasPreviousTail ? mPreviousTailFrame : std::lround(mNextPosition)) >= mEndFrame){
+        return false;
+    }
+
+    const auto nominal = static_cast<int32_t>(std::lround(mNextPosition));
+    // the first segment is taken as it is
+    const int32_t searchFrames = mHasPreviousTail ? kStretchSearchFrames : 0;
+    const int32_t searchStart = std::max(0, nominal - searchFrames);
+    const int32_t numOffsets = nominal + searchFrames + 1 - searchStart;
+
+    // the search range starts the buffer from here on
+    if (!readInput(reader, searchStart, numOffsets - 1 + 2 * kStretchOverlapFrames)) return false;
+
+    const int32_t segmentStart = mHasPreviousTail ? findBestOffset(numOffsets) : 0;
+    const float *segment = &mInput[segmentStart * mChannelCount];
+    if (mHasPreviousTail){
+        for (int32_t i = 0; i < kStretchOverlapFrames; ++i){
+            const float fadeIn = mFadeIn[i];
+            for (int32_t channel = 0; channel < mChannelCount; ++channel){
+                const int32_t sample = i * mChannelCount + channel;
+                mBlock[sample] = mPreviousTail[sample] + fadeIn * (segment[sample] - mPreviousTail[sample]);
+            }
+        }
+    } else {
+        memcpy(mBlock.data(), segment, mBlock.size() * sizeof(float));
+    }
+
+    // the natural continuation of this segment is what the next one has to match
+    const float *tail = segment + kStretchOverlapFrames * mChannelCount;
+    mPreviousTailFrame = segmentStart + kStretchOverlapFrames;
+    memcpy(mPreviousTail.data(), tail, mPreviousTail.size() * sizeof(float));
+    const float channelScale = 1.0f / mChannelCount;
+    for (int32_t i = 0; i < kStretchOverlapFrames; ++i){
+        float sum = 0;
+        for (int32_t channel = 0; channel < mChannelCount; ++channel) sum += tail[i * mChannelCount + channel];
+        mPreviousTailMono[i] = sum * channelScale;
+    }
+    mHasPreviousTail = true;
+
+    mNextPosition += speed * kStretchOverlapFrames;
+    return true;
+}
@@ -0,0 +1,65 @@
+//
+// Created by 43975 on 2/2/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_TIMESTRETCHER_H
+#define OBOE_AUDIO_PLAYER_TIMESTRETCHER_H
+
+#include <cstdint>
+#include <vector>
+#include "SpeedProcessor.h"
+
+// Output is built from segments of twice this many frames which overlap by half. Long enough to
+// span a couple of pitch periods, short enough not to smear transients (11ms at 48kHz).
+constexpr int32_t kStretchOverlapFrames = 512;
+
+// How far a segment may move from where the speed puts it to line up with the previous one
+constexpr int32_t kStretchSearchFrames = 128;
+
+/**
+ * Changes the speed without changing the pitch by WSOLA (waveform similarity overlap-add).
+ *
+ * Segments are taken from the input at a step of speed * kStretchOverlapFrames and cross-faded
+ * at a step of kStretchOverlapFrames. Each segment is moved by up to kStretchSearchFrames to where
+ * it best matches the continuation of the previous segment, found with a normalized
+ * cross-correlation of the mono downmix, so the waveforms line up and the seams don't beat.
+ */
+class TimeStretcher : public SpeedProcessor{
+public:
+    explicit TimeStretcher(int32_t channelCount);
+
+    int32_t render(FrameReader &reader, float *output, int32_t numFrames, float speed) override;
+    void reset() override;
+
+private:
+    bool readInput(FrameReader &reader, int32_t firstFrameNeeded, int32_t framesNeeded);
+    int32_t pullInput(FrameReader &reader, float *buffer, int32_t numFrames);
+    int32_t findBestOffset(int32_t numOffsets);
+    bool synthesizeBlock(FrameReader &reader, float speed);
+
+    const int32_t mChannelCount;
+
+    std::vector<float> mFadeIn;
+
+    // input frames, interleaved, the next segment is taken around mNextPosition
+    std::vector<float> mInput;
+    int32_t mInputFrames = 0;
+    double mNextPosition = 0;
+    // once the reader has ended the input goes on as silence, from mEndFrame on
+    bool mIsDraining = false;
+    int32_t mEndFrame = 0;
+
+    // second half of the previous segment which the next one is cross-faded with
+    std::vector<float> mPreviousTail;
+    std::vector<float> mPreviousTailMono;
+    bool mHasPreviousTail = false;
+    // where the previous tail starts in mInput
+    int32_t mPreviousTailFrame = 0;
+    std::vector<float> mSearchMono;
+
+    // cross-faded output which hasn't been rendered yet
+    std::vector<float> mBlock;
+    int32_t mBlockReadFrame = kStretchOverlapFrames;
+};
+
+#endif //OBOE_AUDIO_PLAYER_TIMESTRETCHER_H
@@ -0,0 +1,93 @@
+//
+// Created by 43975 on 2/2/2022.
+//
+#include <algorithm>
+#include <cstring>
+#include "VarispeedProcessor.h"
+
+// frames needed before and after the position to interpolate
+constexpr int32_t kFramesBefore = 1;
+constexpr int32_t kFramesAfter = 2;
+
+VarispeedProcessor::VarispeedProcessor(int32_t channelCount, bool isCubic)
+:mChannelCount(channelCount),
+mIsCubic(isCubic),
+mInput((kVarispeedBlockFrames + kFramesBefore + kFramesAfter + 1) * channelCount){
+    reset();
+}
+
+void VarispeedProcessor::reset() {
+    // start on a frame of silence which stands in for the frame before the first one
+    std::fill(mInput.begin(), mInput.begin() + mChannelCount, 0.0f);
+    mInputFrames = kFramesBefore;
+    mPosition = kFramesBefore;
+    mIsDraining = false;
+}
+
+/**
+ * Drops the frames which are behind the position and fills the rest of the buffer.
+ * @return false if the reader didn't have any input
+ */
+bool VarispeedProcessor::readInput(FrameReader &reader) {
+    const int32_t framesToDrop = std::min(static_cast<int32_t>(mPosition) - kFramesBefore, mInputFrames);
+    if (framesToDrop > 0){
+        memmove(mInput.data(), &mInput[framesToDrop * mChannelCount],
+                (mInputFrames - framesToDrop) * mChannelCount * sizeof(float));
+        mInputFrames -= framesToDrop;
+        mPosition -= framesToDrop;
+    }
+
+    const auto capacity = static_cast<int32_t>(mInput.size() / mChannelCount);
+    const int32_t framesRead = reader.readFrames(&mInput[mInputFrames * mChannelCount], capacity - mInputFrames);
+    mInputFrames += framesRead;
+    return framesRead > 0;
+}
+
+/**
+ * Pads the input with the silence which the frames after the last one of the reader stand for.
+ * @return false if the reader hasn't ended or the input is padded already
+ */
+bool VarispeedProcessor::padInput(FrameReader &reader) {
+    if (mIsDraining || !reader.isEndOfInput()) return false;
+    // readInput() has just dropped the frames behind the position, so they fit
+    std::fill(&mInput[mInputFrames * mChannelCount], &mInput[(mInputFrames + kFramesAfter) * mChannelCount], 0.0f);
+    mEndFrame = mInputFrames;
+    mInputFrames += kFramesAfter;
+    mIsDraining = true;
+    return true;
+}
+
+int32_t VarispeedProcessor::render(FrameReader &reader, float *output, int32_t numFrames, float speed) {
+    int32_t framesRendered = 0;
+    while (framesRendered < numFrames){
+        const auto index = static_cast<int32_t>(mPosition);
+        if (mIsDraining && index >= mEndFrame) break;
+        if (index + kFramesAfter >= mInputFrames){
+            if (!readInput(reader) && !padInput(reader)) break;
+            continue;
+        }
+
+        const auto t = static_cast<float>(mPosition - index);
+        const float *x1 = &mInput[index * mChannelCount];
+        if (mIsCubic){
+            const float *x0 = x1 - mChannelCount;
+            const float *x2 = x1 + mChannelCount;
+            const float *x3 = x2 + mChannelCount;
+            for (int32_t channel = 0; channel < mChannelCount; ++channel){
+                const float p0 = x0[channel], p1 = x1[channel], p2 = x2[channel], p3 = x3[channel];
+                output[channel] = p1 + 0.5f * t * (p2 - p0 + t * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3
+                        + t * (3.0f * (p1 - p2) + p3 - p0)));
+            }
+        } else {
+            const float *x2 = x1 + mChannelCount;
+            for (int32_t channel = 0; channel < mChannelCount; ++channel){
+                output[channel] = x1[channel] + t * (x2[channel] - x1[channel]);
+            }
+        }
+
+        output += mChannelCount;
+        ++framesRendered;
+        mPosition += speed;
+    }
+    return framesRendered;
+}
@@ -0,0 +1,51 @@
+//
+// Created by 43975 on 2/2/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_VARISPEEDPROCESSOR_H
+#define OBOE_AUDIO_PLAYER_VARISPEEDPROCESSOR_H
+
+#include <cstdint>
+#include <vector>
+#include "SpeedProcessor.h"
+
+// Input frames read from the FrameReader at a time
+constexpr int32_t kVarispeedBlockFrames = 512;
+
+/**
+ * Steps through the input by speed frames per output frame and interpolates between the frames
+ * around the fractional position, linearly or with a Catmull-Rom cubic which keeps more of the
+ * high frequencies.
+ *
+ * There is no anti-aliasing filter. Above normal speed whatever lies above
+ * sampleRate / (2 * speed) folds back, at 2x everything above a quarter of the sample rate.
+ * The interpolation damps the top of the band, the linear one more than the cubic, but bright
+ * material audibly aliases near 2x. TimeStretch doesn't have this problem.
+ */
+class VarispeedProcessor : public SpeedProcessor{
+public:
+    VarispeedProcessor(int32_t channelCount, bool isCubic);
+
+    int32_t render(FrameReader &reader, float *output, int32_t numFrames, float speed) override;
+    void reset() override;
+
+private:
+    bool readInput(FrameReader &reader);
+    bool padInput(FrameReader &reader);
+
+    const int32_t mChannelCount;
+    const bool mIsCubic;
+
+    // frames around the play position, interleaved
+    std::vector<float> mInput;
+    int32_t mInputFrames = 0;
+    // position of the next output frame in mInput, always at least one frame into it so the
+    // cubic has a frame before it
+    double mPosition = 0;
+    // once the reader has ended, the input is padded with silence and the frames from
+    // mEndFrame on are only there to interpolate the last ones
+    bool mIsDraining = false;
+    int32_t mEndFrame = 0;
+};
+
+#endif //OBOE_AUDIO_PLAYER_VARISPEEDPROCESSOR_H
@@ -1,5 +1,7 @@
 #include <jni.h>
 #include <string>
+#include <algorithm>
+#include <array>
 #include "utils/logging.h"
 #include "audio/PlayerController.h"
 #include <android/asset_manager_jni.h>
@@ -24,20 +26,259 @@ char* convertJString(JNIEnv* env, jstring str)
 }
 
 std::unique_ptr<PlayerController> mController;
+std::string cacheDirectory;
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setCacheDirectory(JNIEnv *env, jobject thiz, jstring directory) {
+    const char *path = env->GetStringUTFChars(directory, nullptr);
+    cacheDirectory = path;
+    env->ReleaseStringUTFChars(directory, path);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setDefaultStreamValues(JNIEnv *env, jobject thiz, jint sample_rate,
+        jint frames_per_burst) {
+    oboe::DefaultStreamValues::SampleRate = sample_rate;
+    oboe::DefaultStreamValues::FramesPerBurst = frames_per_burst;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setSourceCacheBudget(JNIEnv *env, jobject thiz, jlong budget_bytes) {
+    SourceCache::getInstance().setBudget(budget_bytes);
+}
+
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_oboeaudioplayer_MainActivity_getSourceCacheStats(JNIEnv *env, jobject thiz) {
+    SourceCacheStats stats = SourceCache::getInstance().getStats();
+
+    // the layout is documented on MainActivity.getSourceCacheStats()
+    std::array<jlong, 5> values{stats.hits, stats.waits, stats.misses, stats.evictions, stats.bytes};
+
+    jlongArray result = env->NewLongArray(values.size());
+    env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    return result;
+}
 
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_oboeaudioplayer_MainActivity_startPlaying(JNIEnv *env, jobject thiz
         , jobject jAssetManager, jstring file_name) {
 
-    AAssetManager *assetManager = AAssetManager_fromJava(env,jAssetManager);
-
-    mController=std::make_unique<PlayerController>(*assetManager);
+    // The controller lives as long as the library, replacing it would free it under a running
+    // stream. A loaded track just resumes.
+    if (!mController){
+        AAssetManager *assetManager = AAssetManager_fromJava(env,jAssetManager);
+        mController=std::make_unique<PlayerController>(*assetManager);
+        if (!cacheDirectory.empty()) mController->setCacheDirectory(cacheDirectory.c_str());
+    }
 
     char* trackFileName = convertJString(env,file_name);
     mController->start(trackFileName);
 }
 
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_oboeaudioplayer_MainActivity_loadSound(JNIEnv *env, jobject thiz, jstring file_name) {
+    if (!mController) return -1;
+
+    const char *fileName = env->GetStringUTFChars(file_name, nullptr);
+    int32_t soundId = mController->loadSound(fileName);
+    env->ReleaseStringUTFChars(file_name, fileName);
+    return soundId;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_oboeaudioplayer_MainActivity_playSound(JNIEnv *env, jobject thiz, jint sound_id,
+        jfloat gain, jfloat pan) {
+    if (!mController) return JNI_FALSE;
+    return mController->playSound(sound_id, gain, pan) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_seekTo(JNIEnv *env, jobject thiz, jlong position_millis) {
+    if (!mController) return;
+    mController->seekToMillis(position_millis);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setPlaybackSpeed(JNIEnv *env, jobject thiz, jfloat speed,
+                                                       jint mode) {
+    if (!mController) return;
+    if (mode < static_cast<jint>(SpeedMode::Linear) || mode > static_cast<jint>(SpeedMode::TimeStretch)){
+        LOGE("Unknown speed mode %d", mode);
+        return;
+    }
+    mController->setPlaybackSpeed(speed, static_cast<SpeedMode>(mode));
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_pausePlaying(JNIEnv *env, jobject thiz) {
+    if (!mController) return;
+    mController->pause();
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setLooping(JNIEnv *env, jobject thiz, jboolean is_looping) {
+    if (!mController) return;
+    mController->setLooping(is_looping == JNI_TRUE);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setTrackGain(JNIEnv *env, jobject thiz, jfloat gain) {
+    if (!mController) return;
+    mController->setTrackGain(gain);
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_oboeaudioplayer_MainActivity_getStreamFrame(JNIEnv *env, jobject thiz) {
+    if (!mController) return 0;
+    return mController->getStreamFrame();
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setEqBand(JNIEnv *env, jobject thiz, jint band, jint type,
+                                                jfloat frequency, jfloat gain_decibels, jfloat q) {
+    if (!mController) return;
+    if (type < static_cast<jint>(EqBandType::LowShelf) || type > static_cast<jint>(EqBandType::HighShelf)){
+        LOGE("Unknown EQ band type %d", type);
+        return;
+    }
+    mController->setEqBand(band, static_cast<EqBandType>(type), frequency, gain_decibels, q);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setCompressor(JNIEnv *env, jobject thiz, jfloat threshold_decibels,
+                                                    jfloat ratio, jfloat attack_millis,
+                                                    jfloat release_millis, jfloat makeup_decibels) {
+    if (!mController) return;
+    mController->setCompressor(threshold_decibels, ratio, attack_millis, release_millis, makeup_decibels);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setLimiter(JNIEnv *env, jobject thiz, jfloat ceiling_decibels,
+                                                 jfloat release_millis) {
+    if (!mController) return;
+    mController->setLimiter(ceiling_decibels, release_millis);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_setDither(JNIEnv *env, jobject thiz, jboolean is_enabled) {
+    if (!mController) return;
+    mController->setDither(is_enabled);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_oboeaudioplayer_MainActivity_getOutputFormat(JNIEnv *env, jobject thiz) {
+    if (!mController) return static_cast<jint>(AudioFormat::Unspecified);
+    return static_cast<jint>(mController->getOutputFormat());
+}
+
+extern "C"
+JNIEXPORT jdouble JNICALL
+Java_com_oboeaudioplayer_MainActivity_getPositionMillis(JNIEnv *env, jobject thiz) {
+    if (!mController) return 0;
+    return mController->getPositionMillis();
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_oboeaudioplayer_MainActivity_scheduleTransport(JNIEnv *env, jobject thiz, jint type,
+                                                        jlong stream_frame, jdouble value) {
+    if (!mController) return JNI_FALSE;
+    if (type < static_cast<jint>(TransportCommandType::Play) || type > static_cast<jint>(TransportCommandType::SetGain)){
+        LOGE("Unknown transport command %d", type);
+        return JNI_FALSE;
+    }
+
+    // the layout is documented on MainActivity.scheduleTransport()
+    TransportCommand command{static_cast<TransportCommandType>(type), stream_frame};
+    command.isLooping = value != 0;
+    command.positionMillis = static_cast<int64_t>(value);
+    command.gain = std::max(0.0f, static_cast<float>(value));
+    return mController->scheduleCommand(command) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_oboeaudioplayer_MainActivity_enqueueTrack(JNIEnv *env, jobject thiz, jstring file_name) {
+    if (!mController) return;
+
+    const char *fileName = env->GetStringUTFChars(file_name, nullptr);
+    mController->enqueueTrack(fileName);
+    env->ReleaseStringUTFChars(file_name, fileName);
+}
+
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_oboeaudioplayer_MainActivity_getMetrics(JNIEnv *env, jobject thiz) {
+    AudioMetricsSnapshot metrics{};
+    if (mController) metrics = mController->getMetrics();
+
+    // the layout is documented on MainActivity.getMetrics()
+    std::array<jlong, 11 + kCallbackHistogramBuckets> values{
+            metrics.callbackCount, metrics.framesRendered, metrics.xRunCount,
+            metrics.maxCallbackMicros, metrics.meanJitterMicros, metrics.maxJitterMicros,
+            metrics.decodeCount, metrics.totalDecodeMillis, metrics.maxDecodeMillis,
+            metrics.decodedAudioMillis, metrics.minDecodeSpeedPercent
+    };
+    std::copy(metrics.callbackHistogram.begin(), metrics.callbackHistogram.end(), values.begin() + 11);
+
+    jlongArray result = env->NewLongArray(values.size());
+    env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    return result;
+}
+
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_oboeaudioplayer_MainActivity_getLatency(JNIEnv *env, jobject thiz) {
+    LatencySnapshot latency{};
+    if (mController) latency = mController->getLatency();
+
+    // the layout is documented on MainActivity.getLatency()
+    std::array<jlong, 7> values{
+            latency.bufferSizeFrames, latency.framesPerBurst, latency.bufferCapacityFrames,
+            static_cast<jlong>(latency.latencyMillis * 1000), latency.growCount, latency.shrinkCount,
+            latency.droppedChangeCount
+    };
+
+    jlongArray result = env->NewLongArray(values.size());
+    env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    return result;
+}
+
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_com_oboeaudioplayer_MainActivity_getLatencyHistory(JNIEnv *env, jobject thiz) {
+    std::vector<LatencyChange> history;
+    if (mController) history = mController->getLatencyHistory();
+
+    std::vector<jlong> values;
+    values.reserve(history.size() * 3);
+    for (const LatencyChange &change : history){
+        values.insert(values.end(), {change.streamFrame, change.bufferSizeFrames, change.xRunCount});
+    }
+
+    jlongArray result = env->NewLongArray(values.size());
+    env->SetLongArrayRegion(result, 0, values.size(), values.data());
+    return result;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_oboeaudioplayer_MainActivity_stopPlaying(JNIEnv *env, jobject thiz) {
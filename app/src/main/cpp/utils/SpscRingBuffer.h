@@ -0,0 +1,144 @@
+//
+// Created by 43975 on 1/10/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_SPSCRINGBUFFER_H
+#define OBOE_AUDIO_PLAYER_SPSCRINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+constexpr int32_t kCacheLineSize = 64;
+
+/**
+ * Wait-free ring buffer for passing samples from exactly one producer thread to exactly one
+ * consumer thread, for example from a decoder thread to the audio callback.
+ *
+ * Neither side ever blocks, allocates or takes a lock: write() stores as much as fits and read()
+ * returns as much as is available. The read and write indices live on separate cache lines so
+ * the two threads don't keep invalidating each other's cache.
+ *
+ * For zero-copy access the free/filled region can be obtained as two spans, the second one is
+ * only non-empty when the region wraps around the end of the buffer.
+ */
+template <typename T>
+class SpscRingBuffer{
+public:
+    struct Span{
+        T *data;
+        int32_t size;
+    };
+
+    /**
+     * @param minCapacity : minimum number of elements, rounded up to the next power of two.
+     */
+    explicit SpscRingBuffer(int32_t minCapacity)
+    :mCapacity(roundUpToPowerOfTwo(minCapacity)),
+    mMask(mCapacity - 1),
+    mBuffer(std::make_unique<T[]>(mCapacity)){
+    }
+
+    int32_t getCapacity() const { return mCapacity; }
+
+    // Producer side
+
+    int32_t getAvailableToWrite() const {
+        return mCapacity - static_cast<int32_t>(mWrite.value.load(std::memory_order_relaxed) -
+                                                mRead.value.load(std::memory_order_acquire));
+    }
+
+    int32_t getWriteSpans(Span &first, Span &second) {
+        uint32_t writeIndex = mWrite.value.load(std::memory_order_relaxed);
+        return getSpans(writeIndex, getAvailableToWrite(), first, second);
+    }
+
+    void commitWrite(int32_t count) {
+        mWrite.value.store(mWrite.value.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * @return number of elements written, less than count if the buffer is full.
+     */
+    int32_t write(const T *data, int32_t count) {
+        Span first, second;
+        count = std::min(count, getWriteSpans(first, second));
+        int32_t firstCount = std::min(count, first.size);
+        std::copy(data, data + firstCount, first.data);
+        std::copy(data + firstCount, data + count, second.data);
+        commitWrite(count);
+        return count;
+    }
+
+    // Consumer side
+
+    int32_t getAvailableToRead() const {
+        return static_cast<int32_t>(mWrite.value.load(std::memory_order_acquire) -
+                                    mRead.value.load(std::memory_order_relaxed));
+    }
+
+    int32_t getReadSpans(Span &first, Span &second) {
+        uint32_t readIndex = mRead.value.load(std::memory_order_relaxed);
+        return getSpans(readIndex, getAvailableToRead(), first, second);
+    }
+
+    void commitRead(int32_t count) {
+        mRead.value.store(mRead.value.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * @return number of elements read, less than count if not enough data is available.
+     */
+    int32_t read(T *data, int32_t count) {
+        Span first, second;
+        count = std::min(count, getReadSpans(first, second));
+        int32_t firstCount = std::min(count, first.size);
+        std::copy(first.data, first.data + firstCount, data);
+        std::copy(second.data, second.data + (count - firstCount), data + firstCount);
+        commitRead(count);
+        return count;
+    }
+
+    /**
+     * Drop everything that is currently readable. Consumer side only.
+     */
+    void discard() {
+        commitRead(getAvailableToRead());
+    }
+
+private:
+    static int32_t roundUpToPowerOfTwo(int32_t value) {
+        int32_t result = 1;
+        while (result < value) result <<= 1;
+        return result;
+    }
+
+    int32_t getSpans(uint32_t index, int32_t count, Span &first, Span &second) {
+        auto start = static_cast<int32_t>(index & mMask);
+        int32_t firstCount = std::min(count, mCapacity - start);
+        first = Span{&mBuffer[start], firstCount};
+        second = Span{&mBuffer[0], count - firstCount};
+        return count;
+    }
+
+    // Keeps an index on its own cache line. Padding is used rather than alignas because
+    // over-aligned heap allocations aren't supported before C++17.
+    struct PaddedIndex{
+        char leadingPadding[kCacheLineSize];
+        std::atomic<uint32_t> value{0};
+        char trailingPadding[kCacheLineSize - sizeof(std::atomic<uint32_t>)];
+    };
+
+    const int32_t mCapacity;
+    const uint32_t mMask;
+    const std::unique_ptr<T[]> mBuffer;
+
+    // The indices only ever increase and wrap around at 2^32, which works because the capacity
+    // is a power of two. They are kept on separate cache lines to avoid false sharing.
+    PaddedIndex mWrite;
+    PaddedIndex mRead;
+};
+
+#endif //OBOE_AUDIO_PLAYER_SPSCRINGBUFFER_H
@@ -5,15 +5,38 @@
 #ifndef OBOE_AUDIO_PLAYER_UTILITYFUNCTIONS_H
 #define OBOE_AUDIO_PLAYER_UTILITYFUNCTIONS_H
 
+#include <chrono>
+#include <cstdint>
+#include <time.h>
+
 constexpr int64_t kMillisecondsInSecond = 1000;
+constexpr int64_t kNanosecondsInSecond = 1000000000;
 
 constexpr int64_t convertFramesToMillis(const int64_t frames, const int sampleRate){
     return static_cast<int64_t>((static_cast<double>(frames)/ sampleRate) * kMillisecondsInSecond);
 }
 
-int64_t nowUptimeMillis() {
+constexpr int64_t convertMillisToFrames(const int64_t millis, const int sampleRate){
+    return millis * sampleRate / kMillisecondsInSecond;
+}
+
+inline int64_t nowUptimeMillis() {
     using namespace std::chrono;
     return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
+inline int64_t nowUptimeNanos() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * The clock stream timestamps are taken with, see AudioStream::getTimestamp(CLOCK_MONOTONIC).
+ */
+inline int64_t nowMonotonicNanos() {
+    timespec time{};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * kNanosecondsInSecond + time.tv_nsec;
+}
+
 #endif //OBOE_AUDIO_PLAYER_UTILITYFUNCTIONS_H
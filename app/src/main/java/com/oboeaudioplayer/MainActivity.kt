@@ -1,6 +1,8 @@
 package com.oboeaudioplayer
 
+import android.content.Context
 import android.content.res.AssetManager
+import android.media.AudioManager
 import android.os.Bundle
 import android.widget.Button
 import androidx.appcompat.app.AppCompatActivity
@@ -11,11 +13,16 @@ class MainActivity : AppCompatActivity() {
         setContentView(R.layout.activity_main)
 
         stringFromJNI()
+        val audioManager = getSystemService(Context.AUDIO_SERVICE) as AudioManager
+        setDefaultStreamValues(
+            audioManager.getProperty(AudioManager.PROPERTY_OUTPUT_SAMPLE_RATE)?.toInt() ?: 0,
+            audioManager.getProperty(AudioManager.PROPERTY_OUTPUT_FRAMES_PER_BURST)?.toInt() ?: 0)
+        setCacheDirectory(cacheDir.absolutePath)
         findViewById<Button>(R.id.btnPlay).setOnClickListener {
             startPlaying(assets,"sample.mp3");
         }
         findViewById<Button>(R.id.btnPause).setOnClickListener {
-            stopPlaying()
+            pausePlaying()
         }
     }
 
@@ -27,6 +34,122 @@ class MainActivity : AppCompatActivity() {
     external fun startPlaying(assetManager: AssetManager, fileName:String);
     external fun stopPlaying();
 
+    /**
+     * Pauses the track where it is, [startPlaying] resumes it.
+     */
+    external fun pausePlaying()
+    external fun setLooping(isLooping: Boolean)
+    external fun setTrackGain(gain: Float)
+
+    /**
+     * Frames rendered by the output stream so far, the clock [scheduleTransport] goes by.
+     */
+    external fun getStreamFrame(): Long
+
+    /**
+     * Position of the track which is audible right now in ms, output latency included. Cheap
+     * enough to poll on every frame of the UI.
+     */
+    external fun getPositionMillis(): Double
+
+    /**
+     * Master EQ, [band] 0 to 2. [type] 0 is a low shelf, 1 a peak and 2 a high shelf, a band
+     * at 0 dB leaves the sound alone.
+     */
+    external fun setEqBand(band: Int, type: Int, frequency: Float, gainDecibels: Float, q: Float)
+
+    /**
+     * Master compressor, a [ratio] of 1 turns it off.
+     */
+    external fun setCompressor(thresholdDecibels: Float, ratio: Float, attackMillis: Float,
+                               releaseMillis: Float, makeupDecibels: Float)
+
+    /**
+     * Master limiter, nothing plays louder than [ceilingDecibels] relative to full scale, at most 0.
+     */
+    external fun setLimiter(ceilingDecibels: Float, releaseMillis: Float)
+
+    /**
+     * Dithers the output when the stream takes integer samples, on by default.
+     */
+    external fun setDither(isEnabled: Boolean)
+
+    /**
+     * Sample format the stream opened with, 0 before it is open, 1 I16, 2 float, 3 packed I24
+     * or 4 I32.
+     */
+    external fun getOutputFormat(): Int
+
+    /**
+     * Applies a transport command exactly on [streamFrame], or as soon as possible if it has
+     * passed. [command] is 0 play, 1 pause, 2 stop, 3 looping ([value] 0 or 1), 4 seek ([value]
+     * in ms) or 5 gain ([value] linear).
+     * @return false if no track is playing or too many commands are pending
+     */
+    external fun scheduleTransport(command: Int, streamFrame: Long, value: Double): Boolean
+    external fun setCacheDirectory(directory: String)
+
+    /**
+     * The native sample rate and burst size of the device, 0 if unknown. Sounds loaded before
+     * the stream has opened are decoded to this rate.
+     */
+    external fun setDefaultStreamValues(sampleRate: Int, framesPerBurst: Int)
+
+    /**
+     * How much decoded audio is kept in memory for replaying, least recently used assets go first.
+     */
+    external fun setSourceCacheBudget(budgetBytes: Long)
+
+    /**
+     * Source cache counters since the start, in this order: hits, loads which waited for the same
+     * asset to finish loading elsewhere, misses, evictions, then the bytes held now.
+     */
+    external fun getSourceCacheStats(): LongArray
+
+    /**
+     * Sound effects are mixed over the playing track, load them after [startPlaying].
+     * @return the id to pass to [playSound] or -1 on failure
+     */
+    external fun loadSound(fileName: String): Int
+    external fun playSound(soundId: Int, gain: Float, pan: Float): Boolean
+
+    /**
+     * Moves the playing track to [positionMillis], ignored while it is still loading.
+     */
+    external fun seekTo(positionMillis: Long)
+
+    /**
+     * Plays at [speed] times the normal speed, from 0.5 to 2. [mode] 0 and 1 change the pitch
+     * along with the speed using linear or cubic interpolation, 2 keeps the pitch.
+     */
+    external fun setPlaybackSpeed(speed: Float, mode: Int)
+
+    /**
+     * Queues [fileName] to play right after the current track, without a gap.
+     */
+    external fun enqueueTrack(fileName: String)
+
+    /**
+     * Playback metrics since the start, in this order: callbacks, frames rendered, xruns,
+     * longest callback (us), mean and max callback period jitter (us), decodes, total and longest
+     * decode time (ms), length of the audio decoded (ms), speed of the slowest decode (percent of
+     * real time, 0 until known), then 16 buckets counting callbacks that took [2^i, 2^(i+1)) us.
+     */
+    external fun getMetrics(): LongArray
+
+    /**
+     * Output latency the buffer size tuner has settled on, in this order: buffer size and burst
+     * size (frames), buffer capacity (frames), latency (us), times the buffer grew and shrank,
+     * changes missing from [getLatencyHistory] because it wasn't called often enough.
+     */
+    external fun getLatency(): LongArray
+
+    /**
+     * The last 64 buffer size changes, oldest first, as triples of stream frame, buffer size
+     * (frames) and the xrun count at the time. Changes beyond 64 since the last call are dropped.
+     */
+    external fun getLatencyHistory(): LongArray
+
     companion object {
         // Used to load the 'native-lib' library on application startup.
         init {
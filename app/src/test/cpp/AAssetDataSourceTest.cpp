@@ -0,0 +1,91 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "AAssetDataSource.h"
+#include "HostAssetManager.h"
+#include "MockMediaCodec.h"
+
+constexpr AudioProperties kDecodedProperties{2, 48000};
+constexpr int32_t kDecodedPacketFrames = 1000;
+constexpr const char *kDecodedAssetName = "sound.mock";
+
+static MockMediaTrack silentTrack(int32_t numPackets) {
+    MockMediaTrack track;
+    track.sampleRate = kDecodedProperties.sampleRate;
+    track.channelCount = kDecodedProperties.channelCount;
+    for (int32_t i = 0; i < numPackets; ++i){
+        track.packets.emplace_back(kDecodedPacketFrames * kDecodedProperties.channelCount, 0);
+    }
+    return track;
+}
+
+// The mock extractor ignores the contents of the file, there only has to be one to open
+class AAssetDataSourceTest : public ::testing::Test{
+protected:
+    void SetUp() override {
+        char directory[] = "/tmp/asset-source-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(directory));
+        mDirectory = directory;
+        FILE *file = fopen((mDirectory + "/" + kDecodedAssetName).c_str(), "wb");
+        ASSERT_NE(nullptr, file);
+        fputs("mock", file);
+        fclose(file);
+        mAssetManager = HostAssetManager_new(mDirectory.c_str());
+    }
+
+    void TearDown() override {
+        HostAssetManager_delete(mAssetManager);
+        unlink((mDirectory + "/" + kDecodedAssetName).c_str());
+        rmdir(mDirectory.c_str());
+    }
+
+    std::unique_ptr<AAssetDataSource> load(DecodeThroughput *throughput = nullptr) {
+        return std::unique_ptr<AAssetDataSource>(AAssetDataSource::newFromCompressedAsset(*mAssetManager,
+                kDecodedAssetName, kDecodedProperties, SampleFormat::I16, throughput));
+    }
+
+    std::string mDirectory;
+    AAssetManager *mAssetManager = nullptr;
+};
+
+TEST_F(AAssetDataSourceTest, DecodesTheWholeAsset) {
+    MockMedia_setTrack(silentTrack(5));
+    std::unique_ptr<AAssetDataSource> source = load();
+    ASSERT_NE(nullptr, source);
+    EXPECT_EQ(5 * kDecodedPacketFrames * kDecodedProperties.channelCount, source->getSize());
+}
+
+TEST_F(AAssetDataSourceTest, ReportsTheDecodeThroughput) {
+    // the metrics of PlayerController are fed from this
+    MockMedia_setTrack(silentTrack(5));
+    DecodeThroughput throughput;
+    ASSERT_NE(nullptr, load(&throughput));
+    EXPECT_EQ(5 * kDecodedPacketFrames, throughput.framesDecoded);
+    EXPECT_GT(throughput.realTimeFactor, 0);
+}
+
+TEST_F(AAssetDataSourceTest, FailsWhenNothingCanBeDecoded) {
+    // an empty source would be cached as if it was the asset
+    MockMedia_setTrack(silentTrack(0));
+    EXPECT_EQ(nullptr, load());
+}
+
+TEST_F(AAssetDataSourceTest, ChunksGoBackToThePoolOnceCollected) {
+    MockMedia_setTrack(silentTrack(1));
+    std::unique_ptr<AAssetDataSource> source = load();
+    ASSERT_NE(nullptr, source);
+    int64_t contiguousFrames;
+    const void *chunk = source->getFrames(0, contiguousFrames);
+
+    // destroying the source only retires the chunk, acquiring collects it
+    source.reset();
+    std::unique_ptr<uint8_t[]> reused = PcmChunkPool::getInstance().acquire();
+    EXPECT_EQ(chunk, reused.get());
+    PcmChunkPool::getInstance().release(std::move(reused));
+}
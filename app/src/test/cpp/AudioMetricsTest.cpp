@@ -0,0 +1,74 @@
+//
+// Created by 43975 on 1/29/2022.
+//
+#include <gtest/gtest.h>
+#include "AudioMetrics.h"
+
+constexpr int64_t kNanosInMilli = 1000000;
+
+TEST(AudioMetricsTest, HistogramBucketsArePowersOfTwo) {
+    EXPECT_EQ(0, AudioMetrics::getHistogramBucket(0));
+    EXPECT_EQ(0, AudioMetrics::getHistogramBucket(1));
+    EXPECT_EQ(1, AudioMetrics::getHistogramBucket(2));
+    EXPECT_EQ(1, AudioMetrics::getHistogramBucket(3));
+    EXPECT_EQ(10, AudioMetrics::getHistogramBucket(1024));
+    EXPECT_EQ(kCallbackHistogramBuckets - 1, AudioMetrics::getHistogramBucket(INT64_MAX));
+}
+
+TEST(AudioMetricsTest, RecordsCallbacks) {
+    AudioMetrics metrics;
+    // 480 frames at 48kHz are 10ms, the second callback comes 2ms late
+    metrics.recordCallback(0, 100000, 480, 48000, 0);
+    metrics.recordCallback(12 * kNanosInMilli, 12 * kNanosInMilli + 3000000, 480, 48000, 2);
+    metrics.recordCallback(20 * kNanosInMilli, 20 * kNanosInMilli + 100000, 480, 48000, 3);
+
+    AudioMetricsSnapshot snapshot = metrics.getSnapshot();
+    EXPECT_EQ(3, snapshot.callbackCount);
+    EXPECT_EQ(1440, snapshot.framesRendered);
+    EXPECT_EQ(3, snapshot.xRunCount);
+    EXPECT_EQ(3000, snapshot.maxCallbackMicros);
+    EXPECT_EQ(2000, snapshot.maxJitterMicros);
+    EXPECT_EQ(2000, snapshot.meanJitterMicros);
+    EXPECT_EQ(2, snapshot.callbackHistogram[AudioMetrics::getHistogramBucket(100)]);
+    EXPECT_EQ(1, snapshot.callbackHistogram[AudioMetrics::getHistogramBucket(3000)]);
+}
+
+TEST(AudioMetricsTest, NewStreamStartsCountingAgain) {
+    AudioMetrics metrics;
+    metrics.recordCallback(0, 1000, 480, 48000, 5);
+    metrics.resetStream();
+    // a new stream counts xruns from zero and its first callback has no period
+    metrics.recordCallback(50 * kNanosInMilli, 50 * kNanosInMilli + 1000, 480, 48000, 1);
+
+    AudioMetricsSnapshot snapshot = metrics.getSnapshot();
+    EXPECT_EQ(6, snapshot.xRunCount);
+    EXPECT_EQ(0, snapshot.maxJitterMicros);
+}
+
+TEST(AudioMetricsTest, RecordsDecodes) {
+    AudioMetrics metrics;
+    metrics.recordDecode(30);
+    metrics.recordDecode(10);
+
+    AudioMetricsSnapshot snapshot = metrics.getSnapshot();
+    EXPECT_EQ(2, snapshot.decodeCount);
+    EXPECT_EQ(40, snapshot.totalDecodeMillis);
+    EXPECT_EQ(30, snapshot.maxDecodeMillis);
+}
+
+TEST(AudioMetricsTest, RecordsDecodeThroughput) {
+    AudioMetrics metrics;
+    AudioMetricsSnapshot snapshot = metrics.getSnapshot();
+    EXPECT_EQ(0, snapshot.minDecodeSpeedPercent);
+
+    // 10 s of audio in 0.5 s and 4 s of audio in 1 s
+    metrics.recordDecode(500, DecodeThroughput{441000, 0.5, 20.0});
+    metrics.recordDecode(1000, DecodeThroughput{176400, 1.0, 4.0});
+    // a decode without a throughput leaves them alone
+    metrics.recordDecode(10);
+
+    snapshot = metrics.getSnapshot();
+    EXPECT_EQ(3, snapshot.decodeCount);
+    EXPECT_EQ(14000, snapshot.decodedAudioMillis);
+    EXPECT_EQ(400, snapshot.minDecodeSpeedPercent);
+}
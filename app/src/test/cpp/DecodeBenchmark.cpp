@@ -0,0 +1,44 @@
+//
+// Created by 43975 on 1/30/2022.
+//
+#include <benchmark/benchmark.h>
+#include "HostAssetManager.h"
+#include "FFMpegExtractor.h"
+#include "PcmBuilder.h"
+
+// Decoding a whole asset of the app into memory, as AAssetDataSource does. Only built when
+// FFmpeg is installed on the host, the NDK decoder needs a device.
+
+constexpr const char *kBenchmarkAsset = "sample.mp3";
+constexpr AudioProperties kTargetProperties{2, 48000};
+
+static void decodeAsset(benchmark::State &state, int32_t numThreads) {
+    AAssetManager *assetManager = HostAssetManager_new(ENGINE_ASSETS_DIR);
+    int64_t framesDecoded = 0;
+
+    for (auto _ : state){
+        AAsset *asset = AAssetManager_open(assetManager, kBenchmarkAsset, AASSET_MODE_BUFFER);
+        if (asset == nullptr){
+            state.SkipWithError("Could not open the asset");
+            break;
+        }
+        PcmBuilder builder(kTargetProperties.channelCount, SampleFormat::Float, SampleFormat::Float);
+        if (numThreads > 0){
+            FFMpegExtractor::decodeParallel(asset, builder, kTargetProperties, numThreads);
+        } else {
+            FFMpegExtractor::decode(asset, builder, kTargetProperties);
+        }
+        framesDecoded += builder.getNumFrames();
+        AAsset_close(asset);
+    }
+
+    HostAssetManager_delete(assetManager);
+    state.counters["frames_per_second"] = benchmark::Counter(
+            static_cast<double>(framesDecoded), benchmark::Counter::kIsRate);
+}
+
+// All of them are timed by the wall clock, the CPU time of the calling thread leaves out the
+// workers of the parallel ones and isn't comparable
+BENCHMARK_CAPTURE(decodeAsset, Serial, 0)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(decodeAsset, Parallel2, 2)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(decodeAsset, Parallel4, 4)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,115 @@
+//
+// Created by 43975 on 2/7/2022.
+//
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "BiquadEq.h"
+#include "Compressor.h"
+#include "EffectChain.h"
+#include "Limiter.h"
+
+// Cost of the master effects for one stereo callback buffer, the argument is its length in
+// frames. The templated chain runs the processBlock() of every processor inline, a block of
+// kEffectBlockFrames at a time. The baseline is the same processors behind a virtual
+// interface, each one running frame by frame over the whole buffer before the next one starts,
+// which is how a chain assembled at run time usually looks. The chain should come out ahead
+// of the baseline at every buffer length.
+
+constexpr int32_t kChannelCount = 2;
+constexpr int32_t kBands = 3;
+constexpr int32_t kSampleRate = 48000;
+
+static std::vector<float> makeInput(int32_t numFrames) {
+    std::vector<float> samples(numFrames * kChannelCount);
+    for (size_t i = 0; i < samples.size(); ++i) samples[i] = 0.8f * std::sin(0.05f * i);
+    return samples;
+}
+
+// Settings which keep every processor busy
+template <typename Eq, typename Compressor, typename Limiter>
+static void configure(Eq &eq, Compressor &compressor, Limiter &limiter) {
+    eq.setBand(0, EqBandType::LowShelf, 100, 3, 0.707f);
+    eq.setBand(1, EqBandType::Peaking, 1000, -2, 1);
+    eq.setBand(2, EqBandType::HighShelf, 8000, 2, 0.707f);
+    compressor.setParameters(-18, 3, 5, 100, 4);
+    limiter.setParameters(-1, 50);
+}
+
+static void BM_EffectChainTemplated(benchmark::State &state) {
+    const auto numFrames = static_cast<int32_t>(state.range(0));
+    EffectChain<kChannelCount, BiquadEq<kChannelCount, kBands>, Compressor<kChannelCount>, Limiter<kChannelCount>> chain;
+    configure(chain.get<0>(), chain.get<1>(), chain.get<2>());
+    chain.prepare(kSampleRate);
+
+    std::vector<float> input = makeInput(numFrames), buffer(input.size());
+    for (auto _ : state) {
+        std::copy(input.begin(), input.end(), buffer.begin());
+        chain.process(buffer.data(), numFrames);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * numFrames);
+}
+BENCHMARK(BM_EffectChainTemplated)->Arg(192)->Arg(256)->Arg(1024);
+
+// The chain with the settings it starts with, where every processor leaves the audio alone
+static void BM_EffectChainNeutral(benchmark::State &state) {
+    const auto numFrames = static_cast<int32_t>(state.range(0));
+    EffectChain<kChannelCount, BiquadEq<kChannelCount, kBands>, Compressor<kChannelCount>, Limiter<kChannelCount>> chain;
+    chain.prepare(kSampleRate);
+
+    std::vector<float> input = makeInput(numFrames), buffer(input.size());
+    for (auto _ : state) {
+        std::copy(input.begin(), input.end(), buffer.begin());
+        chain.process(buffer.data(), numFrames);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * numFrames);
+}
+BENCHMARK(BM_EffectChainNeutral)->Arg(192)->Arg(1024);
+
+class Effect{
+public:
+    virtual ~Effect() = default;
+    virtual void process(float *audioData, int32_t numFrames) = 0;
+};
+
+template <typename Processor>
+class VirtualEffect : public Effect{
+public:
+    void process(float *audioData, int32_t numFrames) override {
+        for (int32_t blockStart = 0; blockStart < numFrames; blockStart += kEffectBlockFrames){
+            const int32_t blockEnd = std::min(numFrames, blockStart + kEffectBlockFrames);
+            mProcessor.beginBlock();
+            for (int32_t i = blockStart; i < blockEnd; ++i) mProcessor.processFrame(&audioData[i * kChannelCount]);
+        }
+    }
+
+    Processor mProcessor;
+};
+
+static void BM_EffectChainVirtual(benchmark::State &state) {
+    const auto numFrames = static_cast<int32_t>(state.range(0));
+    auto eq = std::make_unique<VirtualEffect<BiquadEq<kChannelCount, kBands>>>();
+    auto compressor = std::make_unique<VirtualEffect<Compressor<kChannelCount>>>();
+    auto limiter = std::make_unique<VirtualEffect<Limiter<kChannelCount>>>();
+    configure(eq->mProcessor, compressor->mProcessor, limiter->mProcessor);
+    eq->mProcessor.prepare(kSampleRate);
+    compressor->mProcessor.prepare(kSampleRate);
+    limiter->mProcessor.prepare(kSampleRate);
+
+    std::vector<std::unique_ptr<Effect>> chain;
+    chain.push_back(std::move(eq));
+    chain.push_back(std::move(compressor));
+    chain.push_back(std::move(limiter));
+
+    std::vector<float> input = makeInput(numFrames), buffer(input.size());
+    for (auto _ : state) {
+        std::copy(input.begin(), input.end(), buffer.begin());
+        for (auto &effect : chain) effect->process(buffer.data(), numFrames);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * numFrames);
+}
+BENCHMARK(BM_EffectChainVirtual)->Arg(192)->Arg(256)->Arg(1024);
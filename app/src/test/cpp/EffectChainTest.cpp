@@ -0,0 +1,217 @@
+//
+// Created by 43975 on 2/7/2022.
+//
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include "BiquadEq.h"
+#include "Compressor.h"
+#include "EffectChain.h"
+#include "Limiter.h"
+
+constexpr int32_t kSampleRate = 48000;
+
+using StereoChain = EffectChain<2, BiquadEq<2, 3>, Compressor<2>, Limiter<2>>;
+
+static std::vector<float> stereoSine(int32_t numFrames, double frequency, float amplitude) {
+    std::vector<float> samples(numFrames * 2);
+    for (int32_t i = 0; i < numFrames; ++i){
+        samples[2 * i] = samples[2 * i + 1] = static_cast<float>(amplitude * std::sin(2 * M_PI * frequency * i / kSampleRate));
+    }
+    return samples;
+}
+
+// Peak of the left channel over the last numFrames frames
+static float tailPeak(const std::vector<float> &samples, int32_t numFrames) {
+    float peak = 0;
+    for (size_t i = samples.size() - numFrames * 2; i < samples.size(); i += 2) peak = std::max(peak, std::fabs(samples[i]));
+    return peak;
+}
+
+TEST(EffectChainTest, NeutralChainPassesAudioUnchanged) {
+    StereoChain chain;
+    chain.prepare(kSampleRate);
+    std::vector<float> input = stereoSine(4800, 440, 0.5f);
+    std::vector<float> output = input;
+    chain.process(output.data(), 4800);
+
+    for (size_t i = 0; i < input.size(); ++i) ASSERT_NEAR(input[i], output[i], 1e-5f) << "at sample " << i;
+}
+
+TEST(EffectChainTest, PeakingBandBoostsItsFrequency) {
+    StereoChain chain;
+    chain.get<0>().setBand(1, EqBandType::Peaking, 1000, 6, 1);
+    chain.prepare(kSampleRate);
+
+    std::vector<float> atCentre = stereoSine(9600, 1000, 0.1f);
+    chain.process(atCentre.data(), 9600);
+    EXPECT_NEAR(0.1f * decibelsToGain(6), tailPeak(atCentre, 4800), 0.002f);
+
+    chain.prepare(kSampleRate);
+    std::vector<float> farAway = stereoSine(9600, 50, 0.1f);
+    chain.process(farAway.data(), 9600);
+    EXPECT_NEAR(0.1f, tailPeak(farAway, 4800), 0.003f);
+}
+
+TEST(EffectChainTest, ShelvesBoostTheirEnds) {
+    EffectChain<2, BiquadEq<2, 2>> chain;
+    chain.get<0>().setBand(0, EqBandType::LowShelf, 200, -12, 0.707f);
+    chain.get<0>().setBand(1, EqBandType::HighShelf, 4000, 6, 0.707f);
+    chain.prepare(kSampleRate);
+
+    std::vector<float> low = stereoSine(9600, 40, 0.5f);
+    chain.process(low.data(), 9600);
+    EXPECT_NEAR(0.5f * decibelsToGain(-12), tailPeak(low, 4800), 0.01f);
+
+    chain.prepare(kSampleRate);
+    std::vector<float> high = stereoSine(9600, 15000, 0.1f);
+    chain.process(high.data(), 9600);
+    EXPECT_NEAR(0.1f * decibelsToGain(6), tailPeak(high, 4800), 0.005f);
+}
+
+TEST(EffectChainTest, CompressorScalesDownAboveThreshold) {
+    StereoChain chain;
+    // 6 dB over the threshold at 2:1 comes out 3 dB over it
+    chain.get<1>().setParameters(-12, 2, 1, 50, 0);
+    chain.prepare(kSampleRate);
+
+    const float amplitude = decibelsToGain(-6);
+    std::vector<float> samples = stereoSine(48000, 100, amplitude);
+    chain.process(samples.data(), 48000);
+    // the peak envelope ripples a little with the release
+    EXPECT_NEAR(gainToDecibels(amplitude) - 3, gainToDecibels(tailPeak(samples, 4800)), 0.5f);
+
+    // below the threshold only the makeup gain applies
+    chain.get<1>().setParameters(-12, 2, 1, 50, 6);
+    chain.prepare(kSampleRate);
+    std::vector<float> quiet = stereoSine(9600, 100, 0.1f);
+    chain.process(quiet.data(), 9600);
+    EXPECT_NEAR(0.1f * decibelsToGain(6), tailPeak(quiet, 4800), 0.001f);
+}
+
+TEST(EffectChainTest, LimiterNeverExceedsTheCeiling) {
+    StereoChain chain;
+    chain.get<0>().setBand(1, EqBandType::Peaking, 1000, 12, 1);
+    chain.get<2>().setParameters(-1, 50);
+    chain.prepare(kSampleRate);
+
+    std::vector<float> samples = stereoSine(48000, 1000, 0.9f);
+    // a few spikes too
+    for (size_t i = 0; i < samples.size(); i += 997) samples[i] = 4.0f;
+    chain.process(samples.data(), 48000);
+
+    const float ceiling = decibelsToGain(-1);
+    for (float sample : samples) ASSERT_LE(std::fabs(sample), ceiling * 1.0001f);
+}
+
+TEST(EffectChainTest, ParameterChangesGlide) {
+    EffectChain<1, Compressor<1>> chain;
+    chain.prepare(kSampleRate);
+    std::vector<float> samples(48000, 0.1f);
+    chain.process(samples.data(), kEffectBlockFrames);
+
+    // 12 dB of makeup gain doesn't jump in at once but is there after a while
+    chain.get<0>().setParameters(0, 1, 5, 100, 12);
+    chain.process(&samples[kEffectBlockFrames], 48000 - kEffectBlockFrames);
+    EXPECT_FLOAT_EQ(0.1f, samples[kEffectBlockFrames - 1]);
+    EXPECT_LT(samples[kEffectBlockFrames], 0.11f);
+    for (int32_t i = kEffectBlockFrames + 1; i < 48000; ++i){
+        ASSERT_LT(samples[i] - samples[i - 1], 0.001f) << "at frame " << i;
+    }
+    EXPECT_NEAR(0.1f * decibelsToGain(12), samples.back(), 0.001f);
+}
+
+// Runs a processor over samples the way the chain does, by block or by frame
+template <typename Processor>
+static void runProcessor(Processor &processor, std::vector<float> &samples, bool isByBlock) {
+    const int32_t numFrames = static_cast<int32_t>(samples.size()) / Processor::kChannelCount;
+    for (int32_t blockStart = 0; blockStart < numFrames; blockStart += kEffectBlockFrames){
+        const int32_t blockFrames = std::min(kEffectBlockFrames, numFrames - blockStart);
+        float *block = &samples[blockStart * Processor::kChannelCount];
+        processor.beginBlock();
+        if (isByBlock){
+            processor.processBlock(block, blockFrames);
+        } else {
+            for (int32_t i = 0; i < blockFrames; ++i) processor.processFrame(&block[i * Processor::kChannelCount]);
+        }
+    }
+}
+
+// Processes the same sine by block and by frame, changing the settings half way
+template <typename Processor, typename Configure>
+static void expectBlocksMatchFrames(Configure configure, float amplitude) {
+    std::vector<float> byBlock = stereoSine(9600, 440, amplitude);
+    std::vector<float> byFrame = byBlock;
+    for (bool isByBlock : {true, false}){
+        Processor processor;
+        configure(processor, 0);
+        processor.prepare(kSampleRate);
+        std::vector<float> &samples = isByBlock ? byBlock : byFrame;
+        std::vector<float> firstHalf(samples.begin(), samples.begin() + 9600);
+        runProcessor(processor, firstHalf, isByBlock);
+        configure(processor, 1);
+        // not a whole number of blocks
+        std::vector<float> secondHalf(samples.begin() + 9600, samples.end() - 2 * 10);
+        runProcessor(processor, secondHalf, isByBlock);
+        std::copy(firstHalf.begin(), firstHalf.end(), samples.begin());
+        std::copy(secondHalf.begin(), secondHalf.end(), samples.begin() + 9600);
+    }
+    for (size_t i = 0; i < byBlock.size(); ++i) ASSERT_NEAR(byFrame[i], byBlock[i], 1e-5f) << "at sample " << i;
+}
+
+TEST(EffectChainTest, BlocksMatchFrameByFrame) {
+    expectBlocksMatchFrames<BiquadEq<2, 3>>([](BiquadEq<2, 3> &eq, int32_t setting){
+        eq.setBand(0, EqBandType::LowShelf, 100, setting == 0 ? 3 : -6, 0.707f);
+        eq.setBand(1, setting == 0 ? EqBandType::Peaking : EqBandType::HighShelf, 1000, 6, 1);
+        eq.setBand(2, EqBandType::HighShelf, 8000, setting == 0 ? 0 : 4, 0.707f);
+    }, 0.5f);
+    expectBlocksMatchFrames<Compressor<2>>([](Compressor<2> &compressor, int32_t setting){
+        compressor.setParameters(-18, setting == 0 ? 3 : 6, 5, 100, setting == 0 ? 4 : 0);
+    }, 0.8f);
+    expectBlocksMatchFrames<Limiter<2>>([](Limiter<2> &limiter, int32_t setting){
+        limiter.setParameters(setting == 0 ? -3 : -1, 50);
+    }, 0.9f);
+}
+
+TEST(EffectChainTest, NeutralProcessorsLeaveTheSamplesAlone) {
+    StereoChain chain;
+    chain.get<0>().setBand(1, EqBandType::Peaking, 1000, 6, 1);
+    chain.get<1>().setParameters(-12, 2, 1, 50, 3);
+    chain.prepare(kSampleRate);
+    std::vector<float> samples = stereoSine(9600, 440, 0.5f);
+    chain.process(samples.data(), 9600);
+
+    // back to 0 dB and a ratio of 1, once the settings have glided there nothing is touched
+    chain.get<0>().setBand(1, EqBandType::Peaking, 1000, 0, 1);
+    chain.get<1>().setParameters(-12, 1, 1, 50, 0);
+    samples = stereoSine(48000, 440, 0.5f);
+    chain.process(samples.data(), 48000);
+
+    const std::vector<float> input = stereoSine(4800, 440, 0.5f);
+    std::vector<float> output = input;
+    chain.process(output.data(), 4800);
+    for (size_t i = 0; i < input.size(); ++i) ASSERT_EQ(input[i], output[i]) << "at sample " << i;
+}
+
+TEST(EffectChainTest, BandTypeChangesPassThroughZeroDecibels) {
+    // 1 kHz gets 12 dB from either type, a switch without a fade wouldn't change the level
+    EffectChain<2, BiquadEq<2, 1>> chain;
+    chain.get<0>().setBand(0, EqBandType::Peaking, 1000, 12, 1);
+    chain.prepare(kSampleRate);
+    std::vector<float> samples = stereoSine(9600 + 32 * kEffectBlockFrames, 1000, 0.1f);
+    chain.process(samples.data(), 9600);
+    EXPECT_NEAR(0.1f * decibelsToGain(12), tailPeak(std::vector<float>(samples.begin(), samples.begin() + 2 * 9600), 4800), 0.01f);
+
+    chain.get<0>().setBand(0, EqBandType::HighShelf, 100, 12, 0.707f);
+    float quietestBlock = 1.0f;
+    for (int32_t block = 0; block < 2 * kEqTypeFadeBlocks; ++block){
+        float *blockStart = &samples[(9600 + block * kEffectBlockFrames) * 2];
+        chain.process(blockStart, kEffectBlockFrames);
+        quietestBlock = std::min(quietestBlock, tailPeak(std::vector<float>(blockStart, blockStart + 2 * kEffectBlockFrames), kEffectBlockFrames));
+    }
+    EXPECT_LT(quietestBlock, 0.15f);
+
+    chain.process(&samples[(9600 + 2 * kEqTypeFadeBlocks * kEffectBlockFrames) * 2], (32 - 2 * kEqTypeFadeBlocks) * kEffectBlockFrames);
+    EXPECT_NEAR(0.1f * decibelsToGain(12), tailPeak(samples, 4 * kEffectBlockFrames), 0.01f);
+}
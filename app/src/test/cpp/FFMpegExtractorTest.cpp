@@ -0,0 +1,279 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "FFMpegExtractor.h"
+#include "HostAssetManager.h"
+#include "PcmBuilder.h"
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+constexpr int32_t kEncodedChannelCount = 2;
+constexpr int32_t kEncodedSampleRate = 44100;
+// 30 seconds, enough packets for decodeParallel to split the stream in four
+constexpr int32_t kEncodedFrames = 1300 * 1024;
+constexpr const char *kEncodedAssetName = "tone.aac";
+constexpr const char *kDamagedAssetName = "damaged.aac";
+constexpr const char *kWavAssetName = "ramp.wav";
+// not a whole number of the packets the WAV demuxer reads
+constexpr int32_t kWavFrames = 44100 + 123;
+constexpr int32_t kAacPacketFrames = 1024;
+
+// Two tones whose level changes slowly, so a seam which isn't decoded the same shows up
+static float toneSample(int32_t channel, int64_t frame) {
+    const double time = static_cast<double>(frame) / kEncodedSampleRate;
+    const double frequency = (channel == 0) ? 440.0 : 660.0;
+    return static_cast<float>((0.3 + 0.2 * std::sin(2 * M_PI * 0.25 * time)) * std::sin(2 * M_PI * frequency * time));
+}
+
+/**
+ * Encodes the tones with the AAC encoder of FFmpeg into an ADTS file. Every AAC packet overlaps
+ * the one before it, so the seams of decodeParallel only match the serial decode with a preroll.
+ */
+static bool writeAacFile(const std::string &path) {
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+    if (codec == nullptr) return false;
+    AVFormatContext *format = nullptr;
+    if (avformat_alloc_output_context2(&format, nullptr, "adts", path.c_str()) < 0) return false;
+
+    AVStream *stream = avformat_new_stream(format, nullptr);
+    AVCodecContext *encoder = avcodec_alloc_context3(codec);
+    encoder->sample_fmt = AV_SAMPLE_FMT_FLTP;
+    encoder->sample_rate = kEncodedSampleRate;
+    encoder->channels = kEncodedChannelCount;
+    encoder->channel_layout = AV_CH_LAYOUT_STEREO;
+    encoder->bit_rate = 128000;
+    encoder->time_base = AVRational{1, kEncodedSampleRate};
+    // noise substitution draws from a random generator which the decoders at the seams don't share
+    av_opt_set_int(encoder->priv_data, "aac_pns", 0, 0);
+
+    bool isOk = stream != nullptr &&
+            avcodec_open2(encoder, codec, nullptr) == 0 &&
+            avcodec_parameters_from_context(stream->codecpar, encoder) >= 0 &&
+            avio_open(&format->pb, path.c_str(), AVIO_FLAG_WRITE) >= 0;
+    const bool isHeaderWritten = isOk && avformat_write_header(format, nullptr) >= 0;
+    isOk = isHeaderWritten;
+
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *packet = av_packet_alloc();
+    auto writePackets = [&](){
+        while (avcodec_receive_packet(encoder, packet) == 0){
+            av_packet_rescale_ts(packet, encoder->time_base, stream->time_base);
+            packet->stream_index = stream->index;
+            if (av_interleaved_write_frame(format, packet) < 0) isOk = false;
+        }
+    };
+
+    int64_t position = 0;
+    while (isOk && position < kEncodedFrames){
+        frame->nb_samples = encoder->frame_size;
+        frame->format = encoder->sample_fmt;
+        frame->channels = encoder->channels;
+        frame->channel_layout = encoder->channel_layout;
+        frame->sample_rate = encoder->sample_rate;
+        if (av_frame_get_buffer(frame, 0) != 0){
+            isOk = false;
+            break;
+        }
+        for (int32_t channel = 0; channel < kEncodedChannelCount; ++channel){
+            auto samples = reinterpret_cast<float *>(frame->data[channel]);
+            for (int32_t i = 0; i < frame->nb_samples; ++i) samples[i] = toneSample(channel, position + i);
+        }
+        frame->pts = position;
+        position += frame->nb_samples;
+        if (avcodec_send_frame(encoder, frame) != 0) isOk = false;
+        av_frame_unref(frame);
+        writePackets();
+    }
+    avcodec_send_frame(encoder, nullptr);
+    writePackets();
+
+    if (isHeaderWritten && av_write_trailer(format) < 0) isOk = false;
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&encoder);
+    if (format->pb != nullptr) avio_closep(&format->pb);
+    avformat_free_context(format);
+    return isOk;
+}
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+    std::vector<uint8_t> bytes;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) return bytes;
+    uint8_t buffer[4096];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + bytesRead);
+    fclose(file);
+    return bytes;
+}
+
+static bool writeFile(const std::string &path, const std::vector<uint8_t> &bytes) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file == nullptr) return false;
+    const bool isWritten = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return (fclose(file) == 0) && isWritten;
+}
+
+// Offsets of the ADTS frames of the file, each one holds a single AAC packet
+static std::vector<size_t> findAdtsFrames(const std::vector<uint8_t> &bytes) {
+    std::vector<size_t> frames;
+    size_t offset = 0;
+    while (offset + 7 <= bytes.size() && bytes[offset] == 0xFF && (bytes[offset + 1] & 0xF0) == 0xF0){
+        const size_t frameLength = ((bytes[offset + 3] & 0x03) << 11) | (bytes[offset + 4] << 3) | (bytes[offset + 5] >> 5);
+        if (frameLength < 7) break;
+        frames.push_back(offset);
+        offset += frameLength;
+    }
+    return frames;
+}
+
+// 16 bit stereo WAV of kWavFrames, whose left and right samples are +frame and -frame
+static bool writeWavFile(const std::string &path) {
+    const uint32_t dataBytes = kWavFrames * kEncodedChannelCount * sizeof(int16_t);
+    std::vector<uint8_t> bytes;
+    auto append = [&](uint32_t value, int32_t size){
+        for (int32_t i = 0; i < size; ++i) bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    };
+    bytes.insert(bytes.end(), {'R', 'I', 'F', 'F'});
+    append(36 + dataBytes, 4);
+    bytes.insert(bytes.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    append(16, 4);
+    append(1, 2);
+    append(kEncodedChannelCount, 2);
+    append(kEncodedSampleRate, 4);
+    append(kEncodedSampleRate * kEncodedChannelCount * sizeof(int16_t), 4);
+    append(kEncodedChannelCount * sizeof(int16_t), 2);
+    append(16, 2);
+    bytes.insert(bytes.end(), {'d', 'a', 't', 'a'});
+    append(dataBytes, 4);
+    for (int32_t frame = 0; frame < kWavFrames; ++frame){
+        append(static_cast<uint16_t>(frame % 32768), 2);
+        append(static_cast<uint16_t>(-(frame % 32768)), 2);
+    }
+    return writeFile(path, bytes);
+}
+
+class FFMpegExtractorTest : public ::testing::Test{
+protected:
+    void SetUp() override {
+        char directory[] = "/tmp/ffmpeg-extractor-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(directory));
+        mDirectory = directory;
+        ASSERT_TRUE(writeAacFile(mDirectory + "/" + kEncodedAssetName));
+        mAssetManager = HostAssetManager_new(mDirectory.c_str());
+    }
+
+    void TearDown() override {
+        HostAssetManager_delete(mAssetManager);
+        for (const char *name : {kEncodedAssetName, kDamagedAssetName, kWavAssetName}){
+            unlink((mDirectory + "/" + name).c_str());
+        }
+        rmdir(mDirectory.c_str());
+    }
+
+    // Interleaved float samples of the asset, decoded serially if numThreads is 0
+    std::vector<float> decode(AudioProperties properties, int32_t numThreads,
+                              const char *assetName = kEncodedAssetName) {
+        AAsset *asset = AAssetManager_open(mAssetManager, assetName, AASSET_MODE_BUFFER);
+        EXPECT_NE(nullptr, asset);
+        if (asset == nullptr) return {};
+        PcmBuilder builder(properties.channelCount, SampleFormat::Float, SampleFormat::Float);
+        const int64_t bytesDecoded = (numThreads > 0) ?
+                FFMpegExtractor::decodeParallel(asset, builder, properties, numThreads) :
+                FFMpegExtractor::decode(asset, builder, properties);
+        AAsset_close(asset);
+        EXPECT_GT(bytesDecoded, 0);
+
+        std::unique_ptr<PcmChunks> chunks = builder.build();
+        std::vector<float> samples;
+        int64_t frameIndex = 0;
+        while (frameIndex < chunks->getNumFrames()){
+            int64_t contiguousFrames;
+            auto frames = static_cast<const float *>(chunks->getFrames(frameIndex, contiguousFrames));
+            samples.insert(samples.end(), frames, frames + contiguousFrames * properties.channelCount);
+            frameIndex += contiguousFrames;
+        }
+        return samples;
+    }
+
+    std::string mDirectory;
+    AAssetManager *mAssetManager = nullptr;
+};
+
+static void expectSameSamples(const std::vector<float> &expected, const std::vector<float> &actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) ASSERT_NEAR(expected[i], actual[i], 1e-6) << i;
+}
+
+TEST_F(FFMpegExtractorTest, ParallelDecodeMatchesSerialDecode) {
+    const AudioProperties properties{kEncodedChannelCount, kEncodedSampleRate};
+    const std::vector<float> serial = decode(properties, 0);
+    ASSERT_FALSE(serial.empty());
+    expectSameSamples(serial, decode(properties, 4));
+    expectSameSamples(serial, decode(properties, 1));
+}
+
+TEST_F(FFMpegExtractorTest, ParallelDecodeMatchesSerialDecodeWhenResampling) {
+    // the segments are resampled one after the other while the later ones are still decoding
+    const AudioProperties properties{kEncodedChannelCount, 48000};
+    const std::vector<float> serial = decode(properties, 0);
+    ASSERT_FALSE(serial.empty());
+    expectSameSamples(serial, decode(properties, 4));
+}
+
+TEST_F(FFMpegExtractorTest, DecodesToTheLastSample) {
+    ASSERT_TRUE(writeWavFile(mDirectory + "/" + kWavAssetName));
+    const std::vector<float> samples = decode(AudioProperties{kEncodedChannelCount, kEncodedSampleRate}, 0, kWavAssetName);
+    ASSERT_EQ(static_cast<size_t>(kWavFrames * kEncodedChannelCount), samples.size());
+    const float lastSample = static_cast<float>((kWavFrames - 1) % 32768) / 32768.0f;
+    EXPECT_FLOAT_EQ(lastSample, samples[samples.size() - 2]);
+    EXPECT_FLOAT_EQ(-lastSample, samples[samples.size() - 1]);
+}
+
+TEST_F(FFMpegExtractorTest, DecodesEveryAacPacket) {
+    // the packets the decoder holds back are flushed at the end of the stream
+    const std::vector<size_t> packets = findAdtsFrames(readFile(mDirectory + "/" + kEncodedAssetName));
+    ASSERT_GE(packets.size() * kAacPacketFrames, static_cast<size_t>(kEncodedFrames));
+    const std::vector<float> samples = decode(AudioProperties{kEncodedChannelCount, kEncodedSampleRate}, 0);
+    EXPECT_EQ(packets.size() * kAacPacketFrames * kEncodedChannelCount, samples.size());
+}
+
+TEST_F(FFMpegExtractorTest, SkipsDamagedPackets) {
+    // the payload of a few packets is wiped, their ADTS headers stay intact so the demuxer
+    // still finds every packet
+    std::vector<uint8_t> bytes = readFile(mDirectory + "/" + kEncodedAssetName);
+    const std::vector<size_t> packets = findAdtsFrames(bytes);
+    ASSERT_GT(packets.size(), 1000u);
+    const std::vector<size_t> damagedPackets{100, 500, 501, 900};
+    for (size_t packet : damagedPackets){
+        std::fill(bytes.begin() + packets[packet] + 7, bytes.begin() + packets[packet + 1], 0);
+    }
+    ASSERT_TRUE(writeFile(mDirectory + "/" + kDamagedAssetName, bytes));
+
+    const AudioProperties properties{kEncodedChannelCount, kEncodedSampleRate};
+    const std::vector<float> serial = decode(properties, 0, kDamagedAssetName);
+    // at most the damaged packets are missing
+    const size_t frameCount = serial.size() / kEncodedChannelCount;
+    EXPECT_LE(frameCount, packets.size() * kAacPacketFrames);
+    EXPECT_GE(frameCount, (packets.size() - damagedPackets.size()) * kAacPacketFrames);
+
+    // the end of the track is still decoded
+    const std::vector<float> intact = decode(properties, 0);
+    ASSERT_GE(intact.size(), serial.size());
+    const size_t offset = intact.size() - serial.size();
+    for (size_t i = serial.size() - kAacPacketFrames * kEncodedChannelCount; i < serial.size(); ++i){
+        ASSERT_NEAR(intact[i + offset], serial[i], 1e-6) << i;
+    }
+
+    // the parallel decode skips them as well
+    EXPECT_FALSE(decode(properties, 4, kDamagedAssetName).empty());
+}
@@ -0,0 +1,155 @@
+//
+// Created by 43975 on 2/4/2022.
+//
+#include <gtest/gtest.h>
+#include "LatencyTuner.h"
+
+constexpr int32_t kBurst = 192;
+constexpr int32_t kCapacity = 8 * kBurst;
+constexpr int32_t kSampleRate = 48000;
+
+// Stands in for the stream, applies whatever the tuner asks for like a device which doesn't
+// round the buffer size
+class FakeStream{
+public:
+    explicit FakeStream(LatencyTuner &tuner):mTuner(tuner){
+        mTuner.resetStream(kBurst, kCapacity, kSampleRate);
+    }
+
+    void play(int64_t millis) {
+        for (int64_t frames = millis * kSampleRate / 1000; frames > 0; frames -= kBurst) callback();
+    }
+
+    void xRun() {
+        ++mXRunCount;
+        callback();
+    }
+
+    int32_t mBufferSize = 960;
+
+private:
+    void callback() {
+        int32_t bufferSize = mTuner.update(kBurst, mXRunCount);
+        if (bufferSize > 0){
+            mBufferSize = bufferSize;
+            mTuner.setBufferSize(mBufferSize);
+        }
+    }
+
+    LatencyTuner &mTuner;
+    int32_t mXRunCount = 0;
+};
+
+TEST(LatencyTunerTest, StartsAtTheMinimumBuffer) {
+    LatencyTuner tuner;
+    FakeStream stream(tuner);
+    stream.play(10);
+
+    EXPECT_EQ(kMinLatencyBursts * kBurst, stream.mBufferSize);
+    LatencySnapshot snapshot = tuner.getSnapshot();
+    EXPECT_EQ(kMinLatencyBursts * kBurst, snapshot.bufferSizeFrames);
+    EXPECT_DOUBLE_EQ(kMinLatencyBursts * kBurst * 1000.0 / kSampleRate, snapshot.latencyMillis);
+    EXPECT_EQ(0, snapshot.growCount);
+}
+
+TEST(LatencyTunerTest, GrowsOnXRunsUpToTheCapacity) {
+    LatencyTuner tuner;
+    FakeStream stream(tuner);
+    stream.play(10);
+
+    stream.xRun();
+    EXPECT_EQ((kMinLatencyBursts + 1) * kBurst, stream.mBufferSize);
+    for (int32_t i = 0; i < 20; ++i) stream.xRun();
+    EXPECT_EQ(kCapacity, stream.mBufferSize);
+    EXPECT_EQ(kCapacity / kBurst - kMinLatencyBursts, tuner.getSnapshot().growCount);
+}
+
+TEST(LatencyTunerTest, ShrinksAfterStablePeriods) {
+    LatencyTuner tuner;
+    FakeStream stream(tuner);
+    stream.play(10);
+    stream.xRun();
+    stream.xRun();
+    ASSERT_EQ((kMinLatencyBursts + 2) * kBurst, stream.mBufferSize);
+
+    stream.play(kInitialShrinkDelayMillis - 100);
+    EXPECT_EQ((kMinLatencyBursts + 2) * kBurst, stream.mBufferSize);
+    stream.play(200);
+    EXPECT_EQ((kMinLatencyBursts + 1) * kBurst, stream.mBufferSize);
+    stream.play(kInitialShrinkDelayMillis + 100);
+    EXPECT_EQ(kMinLatencyBursts * kBurst, stream.mBufferSize);
+
+    // never below the minimum
+    stream.play(4 * kInitialShrinkDelayMillis);
+    EXPECT_EQ(kMinLatencyBursts * kBurst, stream.mBufferSize);
+    EXPECT_EQ(2, tuner.getSnapshot().shrinkCount);
+}
+
+TEST(LatencyTunerTest, BacksOffWhenShrinkingGlitches) {
+    LatencyTuner tuner;
+    FakeStream stream(tuner);
+    stream.play(10);
+    stream.xRun();
+    stream.play(kInitialShrinkDelayMillis + 100);
+    ASSERT_EQ(kMinLatencyBursts * kBurst, stream.mBufferSize);
+
+    // the smaller buffer glitches right away, the next attempt waits twice as long
+    stream.xRun();
+    ASSERT_EQ((kMinLatencyBursts + 1) * kBurst, stream.mBufferSize);
+    stream.play(kInitialShrinkDelayMillis + 100);
+    EXPECT_EQ((kMinLatencyBursts + 1) * kBurst, stream.mBufferSize);
+    stream.play(kInitialShrinkDelayMillis);
+    EXPECT_EQ(kMinLatencyBursts * kBurst, stream.mBufferSize);
+}
+
+TEST(LatencyTunerTest, LeavesTheBufferAloneWithoutXRunCounts) {
+    LatencyTuner tuner;
+    tuner.resetStream(kBurst, kCapacity, kSampleRate);
+    for (int32_t i = 0; i < 100; ++i) EXPECT_EQ(0, tuner.update(kBurst, -1));
+}
+
+TEST(LatencyTunerTest, KeepsHistoryAcrossStreams) {
+    LatencyTuner tuner;
+    {
+        FakeStream stream(tuner);
+        stream.play(10);
+        stream.xRun();
+    }
+    // the next stream starts counting xruns from zero again
+    FakeStream stream(tuner);
+    stream.play(10);
+    stream.xRun();
+
+    std::vector<LatencyChange> history = tuner.getHistory();
+    ASSERT_EQ(4u, history.size());
+    EXPECT_EQ(kMinLatencyBursts * kBurst, history[0].bufferSizeFrames);
+    EXPECT_EQ((kMinLatencyBursts + 1) * kBurst, history[1].bufferSizeFrames);
+    EXPECT_EQ(1, history[1].xRunCount);
+    EXPECT_EQ(kMinLatencyBursts * kBurst, history[2].bufferSizeFrames);
+    EXPECT_EQ(0, history[2].xRunCount);
+    EXPECT_EQ((kMinLatencyBursts + 1) * kBurst, history[3].bufferSizeFrames);
+    EXPECT_LT(history[0].streamFrame, history[1].streamFrame);
+    EXPECT_EQ(4u, tuner.getHistory().size());
+}
+
+TEST(LatencyTunerTest, CountsChangesDroppedWhileTheHistoryIsntRead) {
+    LatencyTuner tuner;
+    tuner.resetStream(kBurst, kCapacity, kSampleRate);
+    for (int32_t i = 0; i < kLatencyHistorySize + 10; ++i){
+        tuner.setBufferSize((i % 2 == 0) ? 3 * kBurst : 2 * kBurst);
+    }
+    EXPECT_EQ(10, tuner.getSnapshot().droppedChangeCount);
+
+    // the history holds the changes up to the first one dropped
+    std::vector<LatencyChange> history = tuner.getHistory();
+    ASSERT_EQ(static_cast<size_t>(kLatencyHistorySize), history.size());
+    EXPECT_EQ(3 * kBurst, history.front().bufferSizeFrames);
+    EXPECT_EQ(2 * kBurst, history.back().bufferSizeFrames);
+
+    // once read there is room again
+    tuner.setBufferSize(4 * kBurst);
+    history = tuner.getHistory();
+    ASSERT_EQ(static_cast<size_t>(kLatencyHistorySize), history.size());
+    EXPECT_EQ(4 * kBurst, history.back().bufferSizeFrames);
+    EXPECT_EQ(10, tuner.getSnapshot().droppedChangeCount);
+}
@@ -0,0 +1,132 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Mixer.h"
+
+constexpr int32_t kMixerChannelCount = 2;
+constexpr int32_t kMixerTestFrames = 256;
+
+// Every sample of the sound has the same value
+class ConstantDataSource : public DataSource{
+public:
+    ConstantDataSource(float value, int64_t numFrames):mSamples(numFrames * kMixerChannelCount, value){}
+
+    int64_t getSize() const override { return mSamples.size(); }
+    AudioProperties getProperties() const override { return AudioProperties{kMixerChannelCount, 48000}; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        contiguousFrames = getSize() / kMixerChannelCount - frameIndex;
+        return &mSamples[frameIndex * kMixerChannelCount];
+    }
+
+private:
+    std::vector<float> mSamples;
+};
+
+static std::vector<float> render(Mixer &mixer, float initialValue = 0) {
+    std::vector<float> output(kMixerTestFrames * kMixerChannelCount, initialValue);
+    mixer.renderAudio(output.data(), kMixerTestFrames);
+    return output;
+}
+
+TEST(MixerTest, AppliesGainAndEqualPowerPan) {
+    Mixer mixer(kMixerChannelCount);
+    const int32_t soundId = mixer.addSound(std::make_shared<ConstantDataSource>(1.0f, 10000));
+    ASSERT_EQ(0, soundId);
+
+    ASSERT_TRUE(mixer.playSound(soundId, 0.5f, 0.0f));
+    std::vector<float> centre = render(mixer);
+    EXPECT_NEAR(0.5f * std::sqrt(0.5f), centre[0], 1e-6);
+    EXPECT_NEAR(0.5f * std::sqrt(0.5f), centre[1], 1e-6);
+
+    ASSERT_TRUE(mixer.stopAll());
+    ASSERT_TRUE(mixer.playSound(soundId, 0.5f, -1.0f));
+    std::vector<float> left = render(mixer);
+    EXPECT_NEAR(0.5f, left[0], 1e-6);
+    EXPECT_NEAR(0.0f, left[1], 1e-6);
+}
+
+TEST(MixerTest, MixesOnTopOfTheOutput) {
+    Mixer mixer(kMixerChannelCount);
+    const int32_t soundId = mixer.addSound(std::make_shared<ConstantDataSource>(0.25f, 10000));
+    ASSERT_TRUE(mixer.playSound(soundId, 1.0f, -1.0f));
+    ASSERT_TRUE(mixer.playSound(soundId, 1.0f, -1.0f));
+
+    std::vector<float> output = render(mixer, 0.125f);
+    for (int32_t frame = 0; frame < kMixerTestFrames; ++frame){
+        ASSERT_NEAR(0.625f, output[frame * kMixerChannelCount], 1e-6) << frame;
+        ASSERT_NEAR(0.125f, output[frame * kMixerChannelCount + 1], 1e-6) << frame;
+    }
+    EXPECT_EQ(2, mixer.getActiveVoiceCount());
+}
+
+TEST(MixerTest, FreesVoicesWhenTheirSoundEnds) {
+    Mixer mixer(kMixerChannelCount);
+    const int32_t soundId = mixer.addSound(std::make_shared<ConstantDataSource>(1.0f, 100));
+    ASSERT_TRUE(mixer.playSound(soundId, 1.0f, -1.0f));
+
+    std::vector<float> output = render(mixer);
+    EXPECT_FLOAT_EQ(1.0f, output[99 * kMixerChannelCount]);
+    EXPECT_FLOAT_EQ(0.0f, output[100 * kMixerChannelCount]);
+    EXPECT_EQ(0, mixer.getActiveVoiceCount());
+}
+
+TEST(MixerTest, StealsTheOldestVoiceWithAFade) {
+    Mixer mixer(kMixerChannelCount);
+    const int32_t loudId = mixer.addSound(std::make_shared<ConstantDataSource>(1.0f, 100000));
+    const int32_t silentId = mixer.addSound(std::make_shared<ConstantDataSource>(0.0f, 100000));
+
+    // the loud voice is the oldest one
+    ASSERT_TRUE(mixer.playSound(loudId, 1.0f, -1.0f));
+    for (int32_t i = 1; i < kMaxMixerVoices; ++i) ASSERT_TRUE(mixer.playSound(silentId, 1.0f, -1.0f));
+    std::vector<float> output = render(mixer);
+    EXPECT_FLOAT_EQ(1.0f, output[0]);
+    EXPECT_EQ(kMaxMixerVoices, mixer.getActiveVoiceCount());
+
+    ASSERT_TRUE(mixer.playSound(silentId, 1.0f, -1.0f));
+    output = render(mixer);
+    EXPECT_EQ(kMaxMixerVoices, mixer.getActiveVoiceCount());
+    // the loud voice fades out rather than stopping dead, then it is gone
+    EXPECT_FLOAT_EQ(1.0f, output[0]);
+    for (int32_t frame = 1; frame < 64; ++frame){
+        ASSERT_LT(output[frame * kMixerChannelCount], output[(frame - 1) * kMixerChannelCount]) << frame;
+    }
+    for (int32_t frame = 64; frame < kMixerTestFrames; ++frame){
+        ASSERT_FLOAT_EQ(0.0f, output[frame * kMixerChannelCount]) << frame;
+    }
+}
+
+TEST(MixerTest, RejectsInvalidSoundsAndAFullQueue) {
+    Mixer mixer(kMixerChannelCount);
+    EXPECT_FALSE(mixer.playSound(0, 1.0f, 0.0f));
+    EXPECT_EQ(-1, mixer.addSound(nullptr));
+
+    // sounds must have the channel count of the mixer
+    Mixer monoMixer(1);
+    EXPECT_EQ(-1, monoMixer.addSound(std::make_shared<ConstantDataSource>(1.0f, 100)));
+
+    const int32_t soundId = mixer.addSound(std::make_shared<ConstantDataSource>(1.0f, 100));
+    int32_t numQueued = 0;
+    while (mixer.playSound(soundId, 1.0f, 0.0f) && numQueued < 1000) ++numQueued;
+    EXPECT_EQ(64, numQueued);
+
+    // the audio thread takes them all, only the newest ones keep a voice
+    render(mixer);
+    EXPECT_TRUE(mixer.playSound(soundId, 1.0f, 0.0f));
+}
+
+TEST(MixerTest, StopAllSilencesEveryVoice) {
+    Mixer mixer(kMixerChannelCount);
+    const int32_t soundId = mixer.addSound(std::make_shared<ConstantDataSource>(1.0f, 100000));
+    for (int32_t i = 0; i < 4; ++i) ASSERT_TRUE(mixer.playSound(soundId, 1.0f, 0.0f));
+    render(mixer);
+    ASSERT_EQ(4, mixer.getActiveVoiceCount());
+
+    ASSERT_TRUE(mixer.stopAll());
+    std::vector<float> output = render(mixer);
+    EXPECT_EQ(0, mixer.getActiveVoiceCount());
+    for (float sample : output) ASSERT_EQ(0.0f, sample);
+}
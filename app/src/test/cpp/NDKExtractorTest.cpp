@@ -0,0 +1,167 @@
+//
+// Created by 43975 on 2/3/2022.
+//
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "HostAssetManager.h"
+#include "MockMediaCodec.h"
+#include "NDKExtractor.h"
+
+constexpr int32_t kChannelCount = 2;
+constexpr int32_t kPacketFrames = 1152;
+constexpr const char *kAssetName = "track.mock";
+
+// Every sample is its index, so a missing or repeated buffer shows up as a jump
+static MockMediaTrack countingTrack(int32_t numPackets, int32_t sampleRate = 48000) {
+    MockMediaTrack track;
+    track.sampleRate = sampleRate;
+    track.channelCount = kChannelCount;
+    int16_t sample = 0;
+    for (int32_t i = 0; i < numPackets; ++i){
+        std::vector<int16_t> packet(kPacketFrames * kChannelCount);
+        for (auto &value : packet) value = sample++;
+        track.packets.push_back(packet);
+    }
+    return track;
+}
+
+class Int16Sink : public PcmSink{
+public:
+    explicit Int16Sink(int64_t maxSamples = INT64_MAX):mMaxSamples(maxSamples){}
+
+    bool onDecodedData(const uint8_t *data, int64_t numBytes) override {
+        auto samples = reinterpret_cast<const int16_t *>(data);
+        mSamples.insert(mSamples.end(), samples, samples + numBytes / sizeof(int16_t));
+        return static_cast<int64_t>(mSamples.size()) < mMaxSamples;
+    }
+
+    std::vector<int16_t> mSamples;
+
+private:
+    int64_t mMaxSamples;
+};
+
+// The mock extractor ignores the contents of the file, there only has to be one to open
+class NDKExtractorTest : public ::testing::Test{
+protected:
+    void SetUp() override {
+        char directory[] = "/tmp/ndk-extractor-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(directory));
+        mDirectory = directory;
+        FILE *file = fopen((mDirectory + "/" + kAssetName).c_str(), "wb");
+        ASSERT_NE(nullptr, file);
+        fputs("mock", file);
+        fclose(file);
+        mAssetManager = HostAssetManager_new(mDirectory.c_str());
+    }
+
+    void TearDown() override {
+        HostAssetManager_delete(mAssetManager);
+        unlink((mDirectory + "/" + kAssetName).c_str());
+        rmdir(mDirectory.c_str());
+        EXPECT_EQ(0, MockMedia_getStats().openCodecs);
+    }
+
+    int64_t decode(PcmSink &sink, AudioProperties targetProperties, int64_t startFrame = 0,
+                   DecodeThroughput *throughput = nullptr) {
+        AAsset *asset = AAssetManager_open(mAssetManager, kAssetName, AASSET_MODE_UNKNOWN);
+        EXPECT_NE(nullptr, asset);
+        int64_t bytesWritten = NDKExtractor::decode(asset, sink, targetProperties, startFrame, throughput);
+        AAsset_close(asset);
+        return bytesWritten;
+    }
+
+    std::string mDirectory;
+    AAssetManager *mAssetManager = nullptr;
+};
+
+TEST_F(NDKExtractorTest, DecodesEveryBufferThroughTheEnd) {
+    // the codec holds back more packets than it has output buffers for
+    MockMediaTrack track = countingTrack(20);
+    track.latencyPackets = 3;
+    track.numOutputBuffers = 2;
+    MockMedia_setTrack(track);
+
+    Int16Sink sink;
+    int64_t bytesWritten = decode(sink, AudioProperties{kChannelCount, 48000});
+
+    ASSERT_EQ(20u * kPacketFrames * kChannelCount, sink.mSamples.size());
+    EXPECT_EQ(static_cast<int64_t>(sink.mSamples.size() * sizeof(int16_t)), bytesWritten);
+    for (size_t i = 0; i < sink.mSamples.size(); ++i){
+        ASSERT_EQ(static_cast<int16_t>(i), sink.mSamples[i]) << "at sample " << i;
+    }
+}
+
+TEST_F(NDKExtractorTest, TrimsEncoderDelayAndPadding) {
+    MockMediaTrack track = countingTrack(8);
+    track.encoderDelay = 1105;
+    track.encoderPadding = 700;
+    MockMedia_setTrack(track);
+
+    Int16Sink sink;
+    decode(sink, AudioProperties{kChannelCount, 48000});
+
+    const size_t expectedFrames = 8 * kPacketFrames - 1105 - 700;
+    ASSERT_EQ(expectedFrames * kChannelCount, sink.mSamples.size());
+    EXPECT_EQ(static_cast<int16_t>(1105 * kChannelCount), sink.mSamples.front());
+    EXPECT_EQ(static_cast<int16_t>((1105 + expectedFrames) * kChannelCount - 1), sink.mSamples.back());
+}
+
+TEST_F(NDKExtractorTest, StartsAtStartFrame) {
+    MockMedia_setTrack(countingTrack(40));
+
+    Int16Sink sink;
+    decode(sink, AudioProperties{kChannelCount, 48000}, 30000);
+
+    ASSERT_EQ((40u * kPacketFrames - 30000) * kChannelCount, sink.mSamples.size());
+    EXPECT_EQ(static_cast<int16_t>(30000 * kChannelCount), sink.mSamples.front());
+}
+
+TEST_F(NDKExtractorTest, StopsWhenTheSinkDoes) {
+    MockMedia_setTrack(countingTrack(200));
+
+    Int16Sink sink(3 * kPacketFrames * kChannelCount);
+    decode(sink, AudioProperties{kChannelCount, 48000});
+
+    EXPECT_EQ(3u * kPacketFrames * kChannelCount, sink.mSamples.size());
+    // the feeder stopped too instead of pushing the whole track through
+    EXPECT_LT(MockMedia_getStats().inputBuffersQueued, 200);
+}
+
+TEST_F(NDKExtractorTest, BlocksOnTheCodecInsteadOfPolling) {
+    MockMedia_setTrack(countingTrack(50));
+
+    Int16Sink sink;
+    decode(sink, AudioProperties{kChannelCount, 48000});
+
+    MockMediaStats stats = MockMedia_getStats();
+    EXPECT_EQ(0, stats.zeroTimeoutDequeues);
+    EXPECT_EQ(51, stats.inputBuffersQueued);
+    EXPECT_EQ(51, stats.outputBuffersReleased);
+}
+
+TEST_F(NDKExtractorTest, ResamplesToTheTargetRate) {
+    MockMedia_setTrack(countingTrack(40, 44100));
+
+    Int16Sink sink;
+    int64_t bytesWritten = decode(sink, AudioProperties{kChannelCount, 48000});
+
+    const double expectedFrames = 40.0 * kPacketFrames * 48000 / 44100;
+    EXPECT_NEAR(expectedFrames, sink.mSamples.size() / kChannelCount, 2);
+    EXPECT_EQ(static_cast<int64_t>(sink.mSamples.size() * sizeof(int16_t)), bytesWritten);
+}
+
+TEST_F(NDKExtractorTest, ReportsThroughput) {
+    MockMedia_setTrack(countingTrack(10));
+
+    Int16Sink sink;
+    DecodeThroughput throughput;
+    decode(sink, AudioProperties{kChannelCount, 48000}, 0, &throughput);
+
+    EXPECT_EQ(10 * kPacketFrames, throughput.framesDecoded);
+    EXPECT_GT(throughput.decodeSeconds, 0);
+    EXPECT_GT(throughput.realTimeFactor, 0);
+}
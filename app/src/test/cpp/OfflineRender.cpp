@@ -0,0 +1,51 @@
+//
+// Created by 43975 on 1/31/2022.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include "HostAssetManager.h"
+#include "AAssetDataSource.h"
+#include "OfflineRenderer.h"
+#include "Player.h"
+#include "RenderGraph.h"
+#include "WavWriter.h"
+
+// Decodes an asset and renders it through the render graph of the player, master effects
+// included, to a float WAV file as fast as possible, printing the real-time factor.
+//   offline-render <assets directory> <asset> <output.wav> [sample rate]
+
+int main(int argc, char **argv) {
+    if (argc < 4){
+        fprintf(stderr, "usage: %s <assets directory> <asset> <output.wav> [sample rate]\n", argv[0]);
+        return 2;
+    }
+    const AudioProperties properties{kRenderChannelCount, argc > 4 ? atoi(argv[4]) : 48000};
+
+    AAssetManager *assetManager = HostAssetManager_new(argv[1]);
+    std::shared_ptr<DataSource> source{
+        AAssetDataSource::newFromCompressedAsset(*assetManager, argv[2], properties)
+    };
+    HostAssetManager_delete(assetManager);
+    if (source == nullptr){
+        fprintf(stderr, "Could not decode %s\n", argv[2]);
+        return 1;
+    }
+
+    std::unique_ptr<WavWriter> writer{WavWriter::newFromPath(argv[3], properties.channelCount, properties.sampleRate)};
+    if (writer == nullptr) return 1;
+
+    auto track = std::make_unique<Player>(source);
+    track->setPlaying(true);
+    RenderGraph graph;
+    graph.prepare(properties.sampleRate);
+    graph.setTrack(std::move(track));
+
+    OfflineRenderer renderer(properties);
+    OfflineRenderResult result = renderer.render<float>(graph, source->getSize() / properties.channelCount, *writer);
+
+    if (!writer->close()) return 1;
+    printf("%lld frames in %.3f s, %.1fx real time\n", static_cast<long long>(result.framesRendered),
+           result.renderSeconds, result.realTimeFactor);
+    return 0;
+}
@@ -0,0 +1,223 @@
+//
+// Created by 43975 on 1/31/2022.
+//
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "OfflineRenderer.h"
+#include "Player.h"
+#include "RenderGraph.h"
+#include "WavWriter.h"
+
+constexpr AudioProperties kProperties{2, 48000};
+
+class RampDataSource : public DataSource{
+public:
+    explicit RampDataSource(int64_t numFrames):mSamples(numFrames * kProperties.channelCount){
+        for (size_t i = 0; i < mSamples.size(); ++i) mSamples[i] = static_cast<float>(i) / mSamples.size();
+    }
+
+    int64_t getSize() const override { return mSamples.size(); }
+    AudioProperties getProperties() const override { return kProperties; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        contiguousFrames = getSize() / kProperties.channelCount - frameIndex;
+        return &mSamples[frameIndex * kProperties.channelCount];
+    }
+
+    const std::vector<float> &getSamples() const { return mSamples; }
+
+private:
+    std::vector<float> mSamples;
+};
+
+template <typename Sample>
+class SampleSink : public PcmSink{
+public:
+    bool onDecodedData(const uint8_t *data, int64_t numBytes) override {
+        auto samples = reinterpret_cast<const Sample *>(data);
+        mSamples.insert(mSamples.end(), samples, samples + numBytes / sizeof(Sample));
+        return true;
+    }
+
+    std::vector<Sample> mSamples;
+};
+
+using MemorySink = SampleSink<float>;
+
+// A graph which plays the source as its track, with the master effects at their neutral defaults
+static std::unique_ptr<RenderGraph> newTrackGraph(const std::shared_ptr<DataSource> &source) {
+    auto track = std::make_unique<Player>(source);
+    track->setPlaying(true);
+    auto graph = std::make_unique<RenderGraph>();
+    graph->prepare(kProperties.sampleRate);
+    graph->setTrack(std::move(track));
+    return graph;
+}
+
+static TransportCommand commandAt(TransportCommandType type, int64_t streamFrame) {
+    TransportCommand command{type};
+    command.streamFrame = streamFrame;
+    return command;
+}
+
+TEST(OfflineRendererTest, RendersPlayerBitExactly) {
+    auto source = std::make_shared<RampDataSource>(10000);
+    Player player(source);
+    player.setPlaying(true);
+
+    // the block size doesn't divide the length, the last block is short
+    OfflineRenderer renderer(kProperties, 512);
+    MemorySink sink;
+    OfflineRenderResult result = renderer.render([&player](float *audioData, int32_t numFrames){
+        player.renderAudio(audioData, numFrames);
+    }, 10000, sink);
+
+    EXPECT_EQ(10000, result.framesRendered);
+    EXPECT_GT(result.realTimeFactor, 0);
+    ASSERT_EQ(source->getSamples().size(), sink.mSamples.size());
+    EXPECT_EQ(0, memcmp(source->getSamples().data(), sink.mSamples.data(),
+            sink.mSamples.size() * sizeof(float)));
+}
+
+TEST(OfflineRendererTest, WritesFloatWav) {
+    char path[] = "/tmp/offline-render-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    auto source = std::make_shared<RampDataSource>(1000);
+    Player player(source);
+    player.setPlaying(true);
+    std::unique_ptr<WavWriter> writer{WavWriter::newFromPath(path, kProperties.channelCount, kProperties.sampleRate)};
+    ASSERT_NE(nullptr, writer);
+
+    OfflineRenderer renderer(kProperties);
+    renderer.render([&player](float *audioData, int32_t numFrames){
+        player.renderAudio(audioData, numFrames);
+    }, 1000, *writer);
+    EXPECT_EQ(1000, writer->getNumFrames());
+    ASSERT_TRUE(writer->close());
+
+    FILE *file = fopen(path, "rb");
+    ASSERT_NE(nullptr, file);
+    std::vector<uint8_t> contents(58 + 1000 * 2 * sizeof(float) + 1);
+    size_t fileSize = fread(contents.data(), 1, contents.size(), file);
+    fclose(file);
+    unlink(path);
+
+    ASSERT_EQ(contents.size() - 1, fileSize);
+    EXPECT_EQ(0, memcmp(contents.data(), "RIFF", 4));
+    EXPECT_EQ(0, memcmp(&contents[8], "WAVE", 4));
+    uint16_t formatTag, channelCount;
+    uint32_t sampleRate, dataSize;
+    memcpy(&formatTag, &contents[20], 2);
+    memcpy(&channelCount, &contents[22], 2);
+    memcpy(&sampleRate, &contents[24], 4);
+    memcpy(&dataSize, &contents[54], 4);
+    EXPECT_EQ(3, formatTag);
+    EXPECT_EQ(2, channelCount);
+    EXPECT_EQ(48000u, sampleRate);
+    EXPECT_EQ(1000u * 2 * sizeof(float), dataSize);
+    EXPECT_EQ(0, memcmp(&contents[58], source->getSamples().data(), dataSize));
+}
+
+TEST(OfflineRendererTest, RendersTheGraphWithItsTransportCommands) {
+    auto source = std::make_shared<RampDataSource>(10000);
+    std::unique_ptr<RenderGraph> graph = newTrackGraph(source);
+    ASSERT_TRUE(graph->scheduleCommand(commandAt(TransportCommandType::Pause, 1000)));
+    ASSERT_TRUE(graph->scheduleCommand(commandAt(TransportCommandType::Play, 3000)));
+
+    // the commands fall inside render blocks
+    OfflineRenderer renderer(kProperties, 512);
+    MemorySink sink;
+    renderer.render<float>(*graph, 5000, sink);
+    ASSERT_EQ(5000u * kProperties.channelCount, sink.mSamples.size());
+    EXPECT_EQ(5000, graph->getStreamFrame());
+
+    const std::vector<float> &ramp = source->getSamples();
+    for (size_t i = 0; i < 1000u * kProperties.channelCount; ++i) ASSERT_NEAR(ramp[i], sink.mSamples[i], 1e-5) << i;
+    for (size_t i = 1000u * kProperties.channelCount; i < 3000u * kProperties.channelCount; ++i){
+        ASSERT_NEAR(0.0f, sink.mSamples[i], 1e-5) << i;
+    }
+    // the track resumes where it was paused
+    for (size_t i = 3000u * kProperties.channelCount; i < sink.mSamples.size(); ++i){
+        ASSERT_NEAR(ramp[i - 2000u * kProperties.channelCount], sink.mSamples[i], 1e-5) << i;
+    }
+    EXPECT_EQ(3000, graph->getPositionFrames());
+}
+
+TEST(OfflineRendererTest, RendersTheGraphThroughTheMasterEffects) {
+    auto source = std::make_shared<RampDataSource>(4000);
+    std::unique_ptr<RenderGraph> graph = newTrackGraph(source);
+    graph->getMasterEffects().get<2>().setParameters(-6.0f, 50.0f);
+    graph->prepare(kProperties.sampleRate);
+
+    OfflineRenderer renderer(kProperties);
+    MemorySink sink;
+    renderer.render<float>(*graph, 4000, sink);
+
+    // the ramp goes up to full scale, the limiter holds it at the ceiling
+    const float ceiling = std::pow(10.0f, -6.0f / 20.0f);
+    for (float sample : sink.mSamples) ASSERT_LE(std::fabs(sample), ceiling + 1e-6f);
+    EXPECT_NEAR(ceiling, sink.mSamples.back(), 1e-3);
+}
+
+TEST(OfflineRendererTest, RendersTheGraphConvertedToTheOutputSampleType) {
+    auto source = std::make_shared<RampDataSource>(3000);
+    std::unique_ptr<RenderGraph> graph = newTrackGraph(source);
+    graph->setDither(false);
+
+    // longer than the render buffer of the graph, which converts a part at a time
+    OfflineRenderer renderer(kProperties, 1500);
+    SampleSink<int16_t> sink;
+    renderer.render<int16_t>(*graph, 3000, sink);
+
+    const std::vector<float> &ramp = source->getSamples();
+    ASSERT_EQ(ramp.size(), sink.mSamples.size());
+    for (size_t i = 0; i < ramp.size(); ++i){
+        ASSERT_NEAR(ramp[i], sink.mSamples[i] / 32768.0f, 1.5f / 32768) << i;
+    }
+}
+
+TEST(OfflineRendererTest, StopsWritingWhereTheWavHeaderEnds) {
+    char path[] = "/tmp/offline-render-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    // room for 1000 frames and half of another, only whole frames are written
+    const int64_t frameBytes = kProperties.channelCount * sizeof(float);
+    std::unique_ptr<WavWriter> writer{WavWriter::newFromPath(path, kProperties.channelCount, kProperties.sampleRate,
+            1000 * frameBytes + frameBytes / 2)};
+    ASSERT_NE(nullptr, writer);
+
+    auto source = std::make_shared<RampDataSource>(2000);
+    Player player(source);
+    player.setPlaying(true);
+    OfflineRenderer renderer(kProperties, 256);
+    OfflineRenderResult result = renderer.render([&player](float *audioData, int32_t numFrames){
+        player.renderAudio(audioData, numFrames);
+    }, 2000, *writer);
+
+    // the render stops at the block the writer refused
+    EXPECT_EQ(1024, result.framesRendered);
+    EXPECT_EQ(1000, writer->getNumFrames());
+    ASSERT_TRUE(writer->close());
+
+    FILE *file = fopen(path, "rb");
+    ASSERT_NE(nullptr, file);
+    fseek(file, 0, SEEK_END);
+    const long fileSize = ftell(file);
+    uint32_t dataSize = 0;
+    fseek(file, 54, SEEK_SET);
+    ASSERT_EQ(1u, fread(&dataSize, sizeof(dataSize), 1, file));
+    fclose(file);
+    unlink(path);
+
+    EXPECT_EQ(1000u * frameBytes, dataSize);
+    EXPECT_EQ(58 + 1000 * frameBytes, fileSize);
+}
@@ -0,0 +1,92 @@
+//
+// Created by 43975 on 2/8/2022.
+//
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include "OutputFormat.h"
+
+static int32_t unpack(const PackedInt24 &sample) {
+    const uint32_t value = sample.bytes[0] | (sample.bytes[1] << 8) | (sample.bytes[2] << 16);
+    // sign extend from 24 bits
+    return static_cast<int32_t>(value << 8) >> 8;
+}
+
+TEST(OutputFormatTest, PacksInt24LittleEndian) {
+    std::vector<float> source{0.0f, 0.5f, -0.5f, 1.0f / kFloatToInt24Scale, 1.0f, -1.0f, 2.0f, -2.0f};
+    std::vector<PackedInt24> destination(source.size());
+    OutputConverter converter;
+    converter.convert(source.data(), destination.data(), static_cast<int32_t>(source.size()), false);
+
+    const std::vector<int32_t> expected{0, 4194304, -4194304, 1, 8388607, -8388608, 8388607, -8388608};
+    for (size_t i = 0; i < source.size(); ++i) EXPECT_EQ(expected[i], unpack(destination[i])) << i;
+    EXPECT_EQ(0x00, destination[1].bytes[0]);
+    EXPECT_EQ(0x00, destination[1].bytes[1]);
+    EXPECT_EQ(0x40, destination[1].bytes[2]);
+}
+
+TEST(OutputFormatTest, ConvertsInt32WithoutOverflow) {
+    std::vector<float> source{0.0f, 0.25f, -0.25f, 1.0f, -1.0f, 3.0f, -3.0f};
+    std::vector<int32_t> destination(source.size());
+    OutputConverter converter;
+    converter.convert(source.data(), destination.data(), static_cast<int32_t>(source.size()), true);
+
+    const std::vector<int32_t> expected{0, 536870912, -536870912, 2147483520, INT32_MIN, 2147483520, INT32_MIN};
+    for (size_t i = 0; i < source.size(); ++i) EXPECT_EQ(expected[i], destination[i]) << i;
+}
+
+TEST(OutputFormatTest, Int16MatchesTheSampleKernels) {
+    std::vector<float> source(1000);
+    for (size_t i = 0; i < source.size(); ++i) source[i] = std::sin(0.01f * i) * 1.2f;
+    std::vector<int16_t> expected(source.size()), destination(source.size());
+    getScalarSampleKernels().convertFloatToI16(source.data(), expected.data(), static_cast<int32_t>(source.size()));
+
+    OutputConverter converter;
+    converter.convert(source.data(), destination.data(), static_cast<int32_t>(source.size()), false);
+    EXPECT_EQ(expected, destination);
+}
+
+TEST(OutputFormatTest, DitherIsTriangularWithinOneLsb) {
+    // odd length, so the last lanes are only partly used
+    constexpr int32_t kNumSamples = 100001;
+    constexpr float kLsb = 1.0f / kFloatToInt16Scale;
+    std::vector<float> noise(kNumSamples, 0.0f);
+    TpdfDither dither;
+    dither.apply(noise.data(), kNumSamples, kLsb);
+
+    double sum = 0, sumOfSquares = 0;
+    int32_t numNearZero = 0, numNearEdge = 0;
+    for (float value : noise){
+        const float lsbs = value / kLsb;
+        ASSERT_LT(std::fabs(lsbs), 1.0f);
+        sum += lsbs;
+        sumOfSquares += lsbs * lsbs;
+        if (std::fabs(lsbs) < 0.25f) ++numNearZero;
+        if (std::fabs(lsbs) > 0.75f) ++numNearEdge;
+    }
+    EXPECT_NEAR(0, sum / kNumSamples, 0.01);
+    // a triangular distribution over [-1, 1] has a variance of 1/6
+    EXPECT_NEAR(1.0 / 6, sumOfSquares / kNumSamples, 0.005);
+    // and 7 times as much of it within 0.25 of the middle as within 0.25 of the ends
+    EXPECT_NEAR(7.0, static_cast<double>(numNearZero) / numNearEdge, 0.5);
+}
+
+TEST(OutputFormatTest, DitherBreaksUpQuietSignals) {
+    // a signal a third of an LSB loud rounds to silence without dither, with dither it survives
+    // on average
+    constexpr int32_t kNumSamples = 48000;
+    constexpr float kLevel = 1.0f / (3 * kFloatToInt16Scale);
+    std::vector<float> plain(kNumSamples, kLevel), dithered(kNumSamples, kLevel);
+    std::vector<int16_t> plainOutput(kNumSamples), ditheredOutput(kNumSamples);
+    OutputConverter converter;
+    converter.convert(plain.data(), plainOutput.data(), kNumSamples, false);
+    converter.convert(dithered.data(), ditheredOutput.data(), kNumSamples, true);
+
+    double plainSum = 0, ditheredSum = 0;
+    for (int32_t i = 0; i < kNumSamples; ++i){
+        plainSum += plainOutput[i];
+        ditheredSum += ditheredOutput[i];
+    }
+    EXPECT_EQ(0, plainSum);
+    EXPECT_NEAR(1.0 / 3, ditheredSum / kNumSamples, 0.02);
+}
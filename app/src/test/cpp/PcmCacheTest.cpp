@@ -0,0 +1,160 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "HostAssetManager.h"
+#include "MappedDataSource.h"
+#include "PcmCache.h"
+
+constexpr AudioProperties kCachedProperties{2, 48000};
+constexpr uint64_t kCachedHash = 0x1234;
+constexpr const char *kCachedAssetName = "sounds/click.mp3";
+
+// int16 samples which count up from 0, held in memory
+class CountingI16Source : public DataSource{
+public:
+    explicit CountingI16Source(int64_t numFrames):mSamples(numFrames * kCachedProperties.channelCount){
+        for (size_t i = 0; i < mSamples.size(); ++i) mSamples[i] = static_cast<int16_t>(i);
+    }
+
+    int64_t getSize() const override { return mSamples.size(); }
+    AudioProperties getProperties() const override { return kCachedProperties; }
+    SampleFormat getSampleFormat() const override { return SampleFormat::I16; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        contiguousFrames = getSize() / kCachedProperties.channelCount - frameIndex;
+        return &mSamples[frameIndex * kCachedProperties.channelCount];
+    }
+
+private:
+    std::vector<int16_t> mSamples;
+};
+
+class PcmCacheTest : public ::testing::Test{
+protected:
+    void SetUp() override {
+        char directory[] = "/tmp/pcm-cache-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(directory));
+        mDirectory = directory;
+        mCache = std::make_unique<PcmCache>(mDirectory);
+    }
+
+    void TearDown() override {
+        DIR *directory = opendir(mDirectory.c_str());
+        while (dirent *entry = readdir(directory)){
+            if (entry->d_name[0] != '.') unlink((mDirectory + "/" + entry->d_name).c_str());
+        }
+        closedir(directory);
+        rmdir(mDirectory.c_str());
+    }
+
+    std::shared_ptr<DataSource> load(uint64_t sourceHash = kCachedHash, AudioProperties properties = kCachedProperties) {
+        return mCache->load(kCachedAssetName, properties, SampleFormat::I16, sourceHash);
+    }
+
+    // the only file in the cache directory
+    std::string getEntryPath() {
+        std::string path;
+        DIR *directory = opendir(mDirectory.c_str());
+        while (dirent *entry = readdir(directory)){
+            if (entry->d_name[0] != '.') path = mDirectory + "/" + entry->d_name;
+        }
+        closedir(directory);
+        return path;
+    }
+
+    void writeFile(const std::string &path, const std::vector<uint8_t> &contents) {
+        FILE *file = fopen(path.c_str(), "wb");
+        ASSERT_NE(nullptr, file);
+        fwrite(contents.data(), 1, contents.size(), file);
+        fclose(file);
+    }
+
+    uint64_t hashFile(const std::vector<uint8_t> &contents) {
+        writeFile(mDirectory + "/asset.bin", contents);
+        AAssetManager *assetManager = HostAssetManager_new(mDirectory.c_str());
+        AAsset *asset = AAssetManager_open(assetManager, "asset.bin", AASSET_MODE_RANDOM);
+        uint64_t hash = PcmCache::hashAsset(asset);
+        AAsset_close(asset);
+        HostAssetManager_delete(assetManager);
+        unlink((mDirectory + "/asset.bin").c_str());
+        return hash;
+    }
+
+    std::string mDirectory;
+    std::unique_ptr<PcmCache> mCache;
+};
+
+TEST_F(PcmCacheTest, MissesWhenNothingIsStored) {
+    EXPECT_EQ(nullptr, load());
+}
+
+TEST_F(PcmCacheTest, MapsWhatWasStored) {
+    CountingI16Source stored(5000);
+    ASSERT_TRUE(mCache->store(kCachedAssetName, stored, kCachedHash));
+
+    std::shared_ptr<DataSource> source = load();
+    ASSERT_NE(nullptr, source);
+    EXPECT_EQ(stored.getSize(), source->getSize());
+    EXPECT_EQ(SampleFormat::I16, source->getSampleFormat());
+    int64_t contiguousFrames;
+    auto samples = static_cast<const int16_t *>(source->getFrames(1000, contiguousFrames));
+    ASSERT_NE(nullptr, samples);
+    EXPECT_EQ(4000, contiguousFrames);
+    EXPECT_EQ(2000, samples[0]);
+    EXPECT_EQ(nullptr, source->getFrames(5000, contiguousFrames));
+}
+
+TEST_F(PcmCacheTest, IgnoresAStaleHashOrOtherProperties) {
+    ASSERT_TRUE(mCache->store(kCachedAssetName, CountingI16Source(100), kCachedHash));
+    EXPECT_EQ(nullptr, load(kCachedHash + 1));
+    EXPECT_EQ(nullptr, load(kCachedHash, AudioProperties{2, 44100}));
+    EXPECT_NE(nullptr, load());
+}
+
+TEST_F(PcmCacheTest, IgnoresCorruptFiles) {
+    ASSERT_TRUE(mCache->store(kCachedAssetName, CountingI16Source(100), kCachedHash));
+    const std::string path = getEntryPath();
+    ASSERT_FALSE(path.empty());
+
+    // truncated, the samples don't match the frame count of the header
+    ASSERT_EQ(0, truncate(path.c_str(), sizeof(PcmCacheHeader) + 10));
+    EXPECT_EQ(nullptr, load());
+
+    // shorter than a header
+    ASSERT_EQ(0, truncate(path.c_str(), 10));
+    EXPECT_EQ(nullptr, load());
+
+    // not a cache file at all
+    writeFile(path, std::vector<uint8_t>(sizeof(PcmCacheHeader) + 400, 0xab));
+    EXPECT_EQ(nullptr, load());
+}
+
+TEST_F(PcmCacheTest, HashesTheLengthAndBothEnds) {
+    std::vector<uint8_t> contents(1024 * 1024);
+    for (size_t i = 0; i < contents.size(); ++i) contents[i] = static_cast<uint8_t>(i * 7);
+    const uint64_t hash = hashFile(contents);
+    EXPECT_EQ(hash, hashFile(contents));
+
+    std::vector<uint8_t> changedStart = contents;
+    changedStart[100] ^= 1;
+    EXPECT_NE(hash, hashFile(changedStart));
+
+    std::vector<uint8_t> changedEnd = contents;
+    changedEnd[contents.size() - 100] ^= 1;
+    EXPECT_NE(hash, hashFile(changedEnd));
+
+    std::vector<uint8_t> longer = contents;
+    longer.push_back(0);
+    EXPECT_NE(hash, hashFile(longer));
+
+    // small assets are hashed whole
+    std::vector<uint8_t> small(1000, 1), changedSmall(1000, 1);
+    changedSmall[500] = 2;
+    EXPECT_NE(hashFile(small), hashFile(changedSmall));
+}
@@ -0,0 +1,69 @@
+//
+// Created by 43975 on 2/6/2022.
+//
+#include <atomic>
+#include <thread>
+#include <gtest/gtest.h>
+#include "PlaybackClock.h"
+
+constexpr int64_t kNanosInMilli = 1000000;
+
+static PlaybackClockSnapshot snapshotAt(int64_t positionFrames, int64_t presentationNanos, float speed = 1.0f) {
+    PlaybackClockSnapshot snapshot;
+    snapshot.positionFrames = positionFrames;
+    snapshot.presentationNanos = presentationNanos;
+    snapshot.sampleRate = 48000;
+    snapshot.speed = speed;
+    snapshot.hasTimestamp = true;
+    return snapshot;
+}
+
+TEST(PlaybackClockTest, SubtractsWhatIsStillInFlight) {
+    // the end of the buffer at frame 48000 is heard 20ms from now
+    PlaybackClockSnapshot snapshot = snapshotAt(48000, 100 * kNanosInMilli);
+    EXPECT_DOUBLE_EQ(48000 - 960, PlaybackClock::getPositionFrames(snapshot, 80 * kNanosInMilli));
+    EXPECT_DOUBLE_EQ(48000 - 480, PlaybackClock::getPositionFrames(snapshot, 90 * kNanosInMilli));
+}
+
+TEST(PlaybackClockTest, HoldsAtTheLastRenderedFrame) {
+    PlaybackClockSnapshot snapshot = snapshotAt(48000, 100 * kNanosInMilli);
+    EXPECT_DOUBLE_EQ(48000, PlaybackClock::getPositionFrames(snapshot, 100 * kNanosInMilli));
+    EXPECT_DOUBLE_EQ(48000, PlaybackClock::getPositionFrames(snapshot, 500 * kNanosInMilli));
+}
+
+TEST(PlaybackClockTest, FollowsSpeedAndPause) {
+    EXPECT_DOUBLE_EQ(48000 - 1920, PlaybackClock::getPositionFrames(snapshotAt(48000, 100 * kNanosInMilli, 2.0f),
+                                                                    80 * kNanosInMilli));
+    EXPECT_DOUBLE_EQ(48000, PlaybackClock::getPositionFrames(snapshotAt(48000, 100 * kNanosInMilli, 0.0f),
+                                                             80 * kNanosInMilli));
+    // never before the start of the track
+    EXPECT_DOUBLE_EQ(0, PlaybackClock::getPositionFrames(snapshotAt(100, 100 * kNanosInMilli), 0));
+}
+
+TEST(PlaybackClockTest, NothingPublishedIsPositionZero) {
+    PlaybackClock clock;
+    EXPECT_EQ(0, clock.getSnapshot().sampleRate);
+    EXPECT_DOUBLE_EQ(0, clock.getPositionMillis());
+}
+
+// Every snapshot a reader sees has to come from a single publish
+TEST(PlaybackClockTest, SnapshotsAreConsistent) {
+    PlaybackClock clock;
+    std::atomic<bool> isDone{false};
+    std::thread writer([&](){
+        for (int64_t i = 1; i <= 200000; ++i) clock.publish(snapshotAt(i, i * 1000, static_cast<float>(i % 7)));
+        isDone = true;
+    });
+
+    int64_t lastPosition = 0;
+    while (!isDone){
+        PlaybackClockSnapshot snapshot = clock.getSnapshot();
+        ASSERT_EQ(snapshot.positionFrames * 1000, snapshot.presentationNanos);
+        if (snapshot.positionFrames == 0) continue;
+        ASSERT_EQ(static_cast<float>(snapshot.positionFrames % 7), snapshot.speed);
+        ASSERT_GE(snapshot.positionFrames, lastPosition);
+        lastPosition = snapshot.positionFrames;
+    }
+    writer.join();
+    EXPECT_EQ(200000, clock.getSnapshot().positionFrames);
+}
@@ -0,0 +1,126 @@
+//
+// Created by 43975 on 1/30/2022.
+//
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include <benchmark/benchmark.h>
+#include "Player.h"
+#include "PcmBuilder.h"
+#include "PcmCache.h"
+
+// Player::renderAudio over a memory mapped source, which is how cached assets are played.
+// Arguments are the frames per callback and the channel count, items are frames.
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int64_t kSourceFrames = 10 * kSampleRate;
+
+/**
+ * In-memory source holding a sine wave, only used to write the cache files the benchmark plays.
+ */
+class SineDataSource : public DataSource{
+public:
+    SineDataSource(int32_t channelCount, SampleFormat format)
+    :mProperties{channelCount, kSampleRate}{
+        PcmBuilder builder(channelCount, SampleFormat::Float, format);
+        std::vector<float> block(kSampleRate * channelCount);
+        for (size_t i = 0; i < block.size(); ++i){
+            block[i] = 0.5f * sinf(static_cast<float>(i / channelCount) * 0.0575f);
+        }
+        for (int64_t frames = 0; frames < kSourceFrames; frames += kSampleRate){
+            builder.onDecodedData(reinterpret_cast<const uint8_t *>(block.data()), block.size() * sizeof(float));
+        }
+        mNumSamples = builder.getNumFrames() * channelCount;
+        mChunks = builder.build();
+    }
+
+    int64_t getSize() const override { return mNumSamples; }
+    AudioProperties getProperties() const override { return mProperties; }
+    SampleFormat getSampleFormat() const override { return mChunks->getSampleFormat(); }
+    const void *getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        return mChunks->getFrames(frameIndex, contiguousFrames);
+    }
+
+private:
+    const AudioProperties mProperties;
+    int64_t mNumSamples;
+    std::unique_ptr<PcmChunks> mChunks;
+};
+
+static void removeDirectory(const std::string &directory) {
+    DIR *entries = opendir(directory.c_str());
+    if (entries == nullptr) return;
+    while (dirent *entry = readdir(entries)){
+        if (entry->d_name[0] != '.') unlink((directory + "/" + entry->d_name).c_str());
+    }
+    closedir(entries);
+    rmdir(directory.c_str());
+}
+
+static std::shared_ptr<DataSource> newMappedSource(int32_t channelCount, SampleFormat format) {
+    char directory[] = "/tmp/player-benchmark-XXXXXX";
+    if (mkdtemp(directory) == nullptr) return nullptr;
+
+    PcmCache cache(directory);
+    SineDataSource source(channelCount, format);
+    cache.store("sine", source, 0);
+    std::shared_ptr<DataSource> mapped = cache.load("sine", source.getProperties(), format, 0);
+
+    // the mapping stays valid after the file is gone
+    removeDirectory(directory);
+    return mapped;
+}
+
+static void renderPlayer(benchmark::State &state, SampleFormat format) {
+    const auto numFrames = static_cast<int32_t>(state.range(0));
+    const auto channelCount = static_cast<int32_t>(state.range(1));
+    std::shared_ptr<DataSource> source = newMappedSource(channelCount, format);
+    if (source == nullptr){
+        state.SkipWithError("Could not create the source");
+        return;
+    }
+
+    Player player(source);
+    player.setLooping(true);
+    player.setPlaying(true);
+    std::vector<float> buffer(numFrames * channelCount);
+    for (auto _ : state){
+        player.renderAudio(buffer.data(), numFrames);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * numFrames);
+}
+
+static void playerArguments(benchmark::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"frames", "channels"});
+    for (int64_t channels : {1, 2}){
+        for (int64_t frames : {64, 192, 256, 1024, 4096}) benchmark->Args({frames, channels});
+    }
+}
+
+BENCHMARK_CAPTURE(renderPlayer, Float, SampleFormat::Float)->Apply(playerArguments);
+BENCHMARK_CAPTURE(renderPlayer, I16, SampleFormat::I16)->Apply(playerArguments);
+BENCHMARK_CAPTURE(renderPlayer, Half, SampleFormat::Half)->Apply(playerArguments);
+
+// Storing decoded float audio, which converts it to the storage format on the way.
+// The argument is the number of samples per decoded block.
+static void buildPcm(benchmark::State &state, SampleFormat format) {
+    const auto numSamples = static_cast<int32_t>(state.range(0));
+    std::vector<float> block(numSamples, 0.25f);
+    for (auto _ : state){
+        PcmBuilder builder(2, SampleFormat::Float, format);
+        for (int32_t i = 0; i < 64; ++i){
+            builder.onDecodedData(reinterpret_cast<const uint8_t *>(block.data()), numSamples * sizeof(float));
+        }
+        benchmark::DoNotOptimize(builder.build());
+    }
+    state.SetItemsProcessed(state.iterations() * 64 * numSamples);
+    state.SetBytesProcessed(state.iterations() * 64 * numSamples * sizeof(float));
+}
+
+BENCHMARK_CAPTURE(buildPcm, Float, SampleFormat::Float)->Arg(2048)->Arg(8192);
+BENCHMARK_CAPTURE(buildPcm, I16, SampleFormat::I16)->Arg(2048)->Arg(8192);
+BENCHMARK_CAPTURE(buildPcm, Half, SampleFormat::Half)->Arg(2048)->Arg(8192);
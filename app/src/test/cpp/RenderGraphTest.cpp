@@ -0,0 +1,146 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include "RenderGraph.h"
+
+constexpr int32_t kGraphTestFrames = 2048;
+// larger than the steps of a track, so a repeated or skipped frame shows up
+constexpr float kGraphFrameStep = 1e-4f;
+
+// The samples of a frame are firstValue plus the frame index in steps of kGraphFrameStep
+class SteppedDataSource : public DataSource{
+public:
+    SteppedDataSource(float firstValue, int64_t numFrames):mSamples(numFrames * kRenderChannelCount){
+        for (size_t i = 0; i < mSamples.size(); ++i){
+            mSamples[i] = firstValue + static_cast<float>(i / kRenderChannelCount) * kGraphFrameStep;
+        }
+    }
+
+    int64_t getSize() const override { return mSamples.size(); }
+    AudioProperties getProperties() const override { return AudioProperties{kRenderChannelCount, 48000}; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        contiguousFrames = getSize() / kRenderChannelCount - frameIndex;
+        return &mSamples[frameIndex * kRenderChannelCount];
+    }
+
+private:
+    std::vector<float> mSamples;
+};
+
+// Streams the same frames as SteppedDataSource, the play head of the player doesn't apply to it
+class SteppedStreamingSource : public SteppedDataSource{
+public:
+    using SteppedDataSource::SteppedDataSource;
+
+    bool isStreaming() const override { return true; }
+    int32_t readFrames(float *targetData, int32_t numFrames) override {
+        int64_t contiguousFrames;
+        auto frames = static_cast<const float *>(getFrames(mReadFrame, contiguousFrames));
+        const auto framesRead = static_cast<int32_t>(std::min<int64_t>(numFrames, contiguousFrames));
+        std::copy(frames, frames + framesRead * kRenderChannelCount, targetData);
+        mReadFrame += framesRead;
+        return framesRead;
+    }
+    bool isEndOfStream() const override { return mReadFrame * kRenderChannelCount >= getSize(); }
+    bool seekToFrame(int64_t frameIndex) override {
+        mReadFrame = frameIndex;
+        return true;
+    }
+
+private:
+    int64_t mReadFrame = 0;
+};
+
+static std::unique_ptr<Player> newTrack(float firstValue, int64_t numFrames, bool isStreaming = false) {
+    std::shared_ptr<DataSource> source;
+    if (isStreaming){
+        source = std::make_shared<SteppedStreamingSource>(firstValue, numFrames);
+    } else {
+        source = std::make_shared<SteppedDataSource>(firstValue, numFrames);
+    }
+    auto track = std::make_unique<Player>(source);
+    track->setPlaying(true);
+    track->setLooping(false);
+    return track;
+}
+
+// Renders like the audio callback, in buffers of blockFrames
+static std::vector<float> render(RenderGraph &graph, int32_t numFrames, int32_t blockFrames) {
+    std::vector<float> output(numFrames * kRenderChannelCount);
+    for (int32_t frame = 0; frame < numFrames; frame += blockFrames){
+        graph.render(&output[frame * kRenderChannelCount], std::min(blockFrames, numFrames - frame));
+    }
+    return output;
+}
+
+class RenderGraphTest : public ::testing::Test{
+protected:
+    void SetUp() override {
+        mGraph = std::make_unique<RenderGraph>();
+        mGraph->prepare(48000);
+    }
+
+    std::unique_ptr<RenderGraph> mGraph;
+};
+
+TEST_F(RenderGraphTest, SwitchesToThePreloadedTrackWithoutAGap) {
+    // the first track ends in the middle of a buffer
+    mGraph->setTrack(newTrack(0.0f, 1000));
+    ASSERT_FALSE(mGraph->isNextTrackReady());
+    mGraph->setNextTrack(newTrack(0.5f, 5000));
+    ASSERT_TRUE(mGraph->isNextTrackReady());
+
+    std::vector<float> output = render(*mGraph, kGraphTestFrames, 512);
+    for (int32_t frame = 0; frame < kGraphTestFrames; ++frame){
+        const float expected = (frame < 1000) ? frame * kGraphFrameStep : 0.5f + (frame - 1000) * kGraphFrameStep;
+        ASSERT_NEAR(expected, output[frame * kRenderChannelCount], 1e-5) << frame;
+        ASSERT_NEAR(expected, output[frame * kRenderChannelCount + 1], 1e-5) << frame;
+    }
+
+    // the position counts from the start of the new track
+    EXPECT_EQ(kGraphTestFrames - 1000, mGraph->getPositionFrames());
+
+    // the finished track is handed back to be destroyed off the render thread
+    EXPECT_FALSE(mGraph->isNextTrackReady());
+    std::unique_ptr<Player> finishedTrack = mGraph->takeFinishedTrack();
+    ASSERT_NE(nullptr, finishedTrack);
+    EXPECT_FALSE(finishedTrack->isPlaying());
+}
+
+TEST_F(RenderGraphTest, SwitchesOnTheLastFrameOfABuffer) {
+    mGraph->setTrack(newTrack(0.0f, 1024));
+    mGraph->setNextTrack(newTrack(0.5f, 5000));
+
+    std::vector<float> output = render(*mGraph, kGraphTestFrames, 512);
+    EXPECT_NEAR(1023 * kGraphFrameStep, output[1023 * kRenderChannelCount], 1e-5);
+    EXPECT_NEAR(0.5f, output[1024 * kRenderChannelCount], 1e-5);
+    EXPECT_NEAR(0.5f + 1023 * kGraphFrameStep, output[(kGraphTestFrames - 1) * kRenderChannelCount], 1e-5);
+}
+
+TEST_F(RenderGraphTest, EndsInSilenceWithoutANextTrack) {
+    mGraph->setTrack(newTrack(0.25f, 1000));
+
+    std::vector<float> output = render(*mGraph, kGraphTestFrames, 512);
+    EXPECT_NEAR(0.25f + 999 * kGraphFrameStep, output[999 * kRenderChannelCount], 1e-5);
+    for (int32_t frame = 1000; frame < kGraphTestFrames; ++frame){
+        ASSERT_NEAR(0.0f, output[frame * kRenderChannelCount], 1e-5) << frame;
+    }
+    EXPECT_EQ(nullptr, mGraph->takeFinishedTrack());
+}
+
+TEST_F(RenderGraphTest, PlayStartsAnEndedTrackOver) {
+    for (bool isStreaming : {false, true}){
+        mGraph->setTrack(newTrack(0.25f, 1000, isStreaming));
+        render(*mGraph, kGraphTestFrames, 512);
+
+        ASSERT_TRUE(mGraph->scheduleCommand(TransportCommand{TransportCommandType::Play}));
+        std::vector<float> output = render(*mGraph, 512, 512);
+        EXPECT_NEAR(0.25f, output[0], 1e-5) << isStreaming;
+        EXPECT_NEAR(0.25f + 511 * kGraphFrameStep, output[511 * kRenderChannelCount], 1e-5) << isStreaming;
+        EXPECT_EQ(512, mGraph->getPositionFrames()) << isStreaming;
+    }
+}
@@ -0,0 +1,34 @@
+//
+// Created by 43975 on 2/1/2022.
+//
+#include <cmath>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "Resampler.h"
+
+// Cost of converting the sample rate of a decoded stereo stream, as done by the extractors.
+// The arguments are the quality tier and the input rate, the output is always 48kHz.
+
+constexpr int32_t kChannelCount = 2;
+constexpr int32_t kOutputRate = 48000;
+
+static void BM_Resample(benchmark::State &state) {
+    const auto quality = static_cast<ResamplerQuality>(state.range(0));
+    const auto inputRate = static_cast<int32_t>(state.range(1));
+    Resampler resampler(kChannelCount, inputRate, kOutputRate, quality);
+
+    std::vector<float> input(kResamplerBlockFrames * kChannelCount);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = 0.5f * std::sin(0.01f * i);
+    std::vector<float> output(resampler.getMaxOutputFrames(kResamplerBlockFrames) * kChannelCount);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(resampler.process(input.data(), kResamplerBlockFrames, output.data()));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kResamplerBlockFrames);
+    state.counters["taps"] = resampler.getNumTaps();
+}
+BENCHMARK(BM_Resample)->ArgsProduct({
+        {static_cast<int64_t>(ResamplerQuality::Fast), static_cast<int64_t>(ResamplerQuality::Medium),
+         static_cast<int64_t>(ResamplerQuality::High)},
+        {44100, 96000}});
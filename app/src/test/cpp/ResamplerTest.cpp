@@ -0,0 +1,143 @@
+//
+// Created by 43975 on 2/1/2022.
+//
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Resampler.h"
+#include "ResamplingSink.h"
+
+struct RatePair{
+    int32_t inputRate;
+    int32_t outputRate;
+};
+
+static const RatePair kRates[] = {{44100, 48000}, {48000, 44100}, {44100, 32000},
+                                  {22050, 32000}, {48000, 16000}, {32000, 32000}};
+
+static std::vector<float> sine(int32_t numFrames, int32_t channelCount, double frequency, int32_t sampleRate) {
+    std::vector<float> samples(numFrames * channelCount);
+    for (int32_t i = 0; i < numFrames; ++i){
+        for (int32_t channel = 0; channel < channelCount; ++channel){
+            samples[i * channelCount + channel] = static_cast<float>(
+                    0.5 * std::sin(2 * M_PI * frequency * i / sampleRate + channel));
+        }
+    }
+    return samples;
+}
+
+// Feeds the input in blocks of blockFrames and returns everything including the flush
+static std::vector<float> resample(Resampler &resampler, const std::vector<float> &input,
+                                   int32_t channelCount, int32_t blockFrames) {
+    const auto numFrames = static_cast<int32_t>(input.size() / channelCount);
+    std::vector<float> output;
+    std::vector<float> block(std::max(resampler.getMaxOutputFrames(blockFrames),
+                                      resampler.getMaxFlushFrames()) * channelCount);
+    for (int32_t frame = 0; frame < numFrames; frame += blockFrames){
+        int32_t framesToProcess = std::min(blockFrames, numFrames - frame);
+        int32_t framesOutput = resampler.process(&input[frame * channelCount], framesToProcess, block.data());
+        EXPECT_LE(framesOutput, resampler.getMaxOutputFrames(framesToProcess));
+        output.insert(output.end(), block.begin(), block.begin() + framesOutput * channelCount);
+    }
+    int32_t framesOutput = resampler.flush(block.data());
+    output.insert(output.end(), block.begin(), block.begin() + framesOutput * channelCount);
+    return output;
+}
+
+TEST(ResamplerTest, OutputLastsAsLongAsInput) {
+    for (const RatePair &rates : kRates){
+        Resampler resampler(2, rates.inputRate, rates.outputRate);
+        const int32_t numFrames = 10007;
+        std::vector<float> output = resample(resampler, sine(numFrames, 2, 440, rates.inputRate), 2, 512);
+        const int64_t expectedFrames = (static_cast<int64_t>(numFrames) * rates.outputRate + rates.inputRate - 1)
+                / rates.inputRate;
+        EXPECT_EQ(expectedFrames * 2, static_cast<int64_t>(output.size()))
+                << rates.inputRate << " -> " << rates.outputRate;
+    }
+}
+
+TEST(ResamplerTest, KeepsTheLevelOfDc) {
+    for (const RatePair &rates : kRates){
+        Resampler resampler(1, rates.inputRate, rates.outputRate);
+        std::vector<float> output = resample(resampler, std::vector<float>(8000, 0.5f), 1, 1000);
+        // away from the edges where the filter runs into silence
+        for (size_t i = 100; i + 100 < output.size(); ++i){
+            ASSERT_NEAR(0.5f, output[i], 1e-4f) << rates.inputRate << " -> " << rates.outputRate << " at " << i;
+        }
+    }
+}
+
+TEST(ResamplerTest, KeepsFrequencyAndPhaseOfSine) {
+    for (ResamplerQuality quality : {ResamplerQuality::Fast, ResamplerQuality::Medium, ResamplerQuality::High}){
+        for (const RatePair &rates : kRates){
+            Resampler resampler(2, rates.inputRate, rates.outputRate, quality);
+            std::vector<float> output = resample(resampler, sine(8000, 2, 1000, rates.inputRate), 2, 333);
+            std::vector<float> expected = sine(static_cast<int32_t>(output.size() / 2), 2, 1000, rates.outputRate);
+            const float tolerance = (quality == ResamplerQuality::Fast) ? 1e-2f : 2e-3f;
+            for (size_t i = 200; i + 200 < output.size(); ++i){
+                ASSERT_NEAR(expected[i], output[i], tolerance)
+                        << rates.inputRate << " -> " << rates.outputRate << " at " << i;
+            }
+        }
+    }
+}
+
+TEST(ResamplerTest, RemovesFrequenciesAboveOutputNyquist) {
+    // 20kHz can't be represented at 32kHz and must not alias down to 12kHz
+    Resampler resampler(1, 48000, 32000, ResamplerQuality::High);
+    std::vector<float> output = resample(resampler, sine(16000, 1, 20000, 48000), 1, 1024);
+    float peak = 0;
+    for (size_t i = 200; i + 200 < output.size(); ++i) peak = std::max(peak, std::abs(output[i]));
+    EXPECT_LT(peak, 0.5f * 1e-3f);
+}
+
+TEST(ResamplerTest, BlockSizeDoesNotChangeTheOutput) {
+    std::vector<float> input = sine(5000, 2, 3000, 44100);
+    Resampler whole(2, 44100, 48000);
+    Resampler blocks(2, 44100, 48000);
+    std::vector<float> expected = resample(whole, input, 2, 5000);
+    std::vector<float> actual = resample(blocks, input, 2, 7);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) ASSERT_FLOAT_EQ(expected[i], actual[i]) << i;
+}
+
+TEST(ResamplerTest, ResetStartsAFreshStream) {
+    std::vector<float> input = sine(3000, 1, 500, 48000);
+    Resampler resampler(1, 48000, 44100);
+    std::vector<float> first = resample(resampler, input, 1, 256);
+    resampler.reset();
+    std::vector<float> second = resample(resampler, input, 1, 256);
+    EXPECT_EQ(first, second);
+}
+
+TEST(ResamplerTest, ApproximatesRatiosWithTooManyPhases) {
+    Resampler resampler(1, 44100, 48001);
+    std::vector<float> output = resample(resampler, std::vector<float>(44100, 0.25f), 1, 4096);
+    // off by no more than rounding the step to a whole phase, 941 phases here
+    const double maxError = 0.5 / std::lround(44100.0 * kMaxResamplerPhases / 48001);
+    EXPECT_NEAR(48001, static_cast<double>(output.size()), 48001 * maxError);
+}
+
+class CollectingSink : public PcmSink{
+public:
+    bool onDecodedData(const uint8_t *data, int64_t numBytes) override {
+        bytes.insert(bytes.end(), data, data + numBytes);
+        return true;
+    }
+    std::vector<uint8_t> bytes;
+};
+
+TEST(ResamplingSinkTest, ResamplesI16) {
+    CollectingSink target;
+    ResamplingSink sink(target, SampleFormat::I16, 2, 22050, 44100);
+    std::vector<int16_t> input(2 * 3000, 8192);
+    // uneven blocks of whole frames
+    ASSERT_TRUE(sink.onDecodedData(reinterpret_cast<const uint8_t *>(input.data()), 1000 * 4));
+    ASSERT_TRUE(sink.onDecodedData(reinterpret_cast<const uint8_t *>(input.data()), 2000 * 4));
+    ASSERT_TRUE(sink.finish());
+
+    ASSERT_EQ(6000u * 4, target.bytes.size());
+    EXPECT_EQ(static_cast<int64_t>(target.bytes.size()), sink.getBytesWritten());
+    auto output = reinterpret_cast<const int16_t *>(target.bytes.data());
+    for (int i = 200; i < 5800; ++i) ASSERT_NEAR(8192, output[i * 2], 2) << i;
+}
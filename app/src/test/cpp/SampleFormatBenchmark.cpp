@@ -0,0 +1,88 @@
+//
+// Created by 43975 on 1/25/2022.
+//
+#include <cstring>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "SampleKernels.h"
+#include "OutputFormat.h"
+
+// Cost of turning stored samples into a float callback buffer, which is what Player does for
+// every buffer. Float storage is a plain copy, the compact formats are converted on the fly.
+// The argument is the number of stereo frames per callback.
+
+constexpr int32_t kChannelCount = 2;
+
+static void setBufferCounters(benchmark::State &state, int32_t bytesPerSample) {
+    const int64_t numSamples = state.range(0) * kChannelCount;
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * numSamples * bytesPerSample);
+}
+
+static void BM_RenderFloat(benchmark::State &state) {
+    const int32_t numSamples = static_cast<int32_t>(state.range(0)) * kChannelCount;
+    std::vector<float> source(numSamples, 0.5f), target(numSamples);
+    for (auto _ : state) {
+        memcpy(target.data(), source.data(), numSamples * sizeof(float));
+        benchmark::ClobberMemory();
+    }
+    setBufferCounters(state, sizeof(float));
+}
+BENCHMARK(BM_RenderFloat)->Arg(192)->Arg(256)->Arg(1024);
+
+static void renderI16(benchmark::State &state, const SampleKernels *kernels) {
+    const int32_t numSamples = static_cast<int32_t>(state.range(0)) * kChannelCount;
+    std::vector<int16_t> source(numSamples, 1234);
+    std::vector<float> target(numSamples);
+    for (auto _ : state) {
+        kernels->convertI16ToFloat(source.data(), target.data(), numSamples);
+        benchmark::ClobberMemory();
+    }
+    setBufferCounters(state, sizeof(int16_t));
+}
+
+static void renderHalf(benchmark::State &state, const SampleKernels *kernels) {
+    const int32_t numSamples = static_cast<int32_t>(state.range(0)) * kChannelCount;
+    std::vector<float> values(numSamples, 0.5f);
+    std::vector<uint16_t> source(numSamples);
+    getScalarSampleKernels().convertFloatToHalf(values.data(), source.data(), numSamples);
+    std::vector<float> target(numSamples);
+    for (auto _ : state) {
+        kernels->convertHalfToFloat(source.data(), target.data(), numSamples);
+        benchmark::ClobberMemory();
+    }
+    setBufferCounters(state, sizeof(uint16_t));
+}
+
+// One benchmark per kernel implementation the CPU supports
+static const bool kRegistered = []() {
+    for (const SampleKernels *kernels : getSupportedSampleKernels()) {
+        const std::string suffix = std::string("/") + kernels->name;
+        benchmark::RegisterBenchmark(("BM_RenderI16" + suffix).c_str(), renderI16, kernels)
+                ->Arg(192)->Arg(256)->Arg(1024);
+        benchmark::RegisterBenchmark(("BM_RenderHalf" + suffix).c_str(), renderHalf, kernels)
+                ->Arg(192)->Arg(256)->Arg(1024);
+    }
+    return true;
+}();
+
+// Cost of converting the float mix to the sample type of the stream, for streams which don't
+// take float. The mix is written back each time since the dither is added to it in place.
+template <typename Sample>
+static void BM_ConvertOutput(benchmark::State &state) {
+    const int32_t numSamples = static_cast<int32_t>(state.range(0)) * kChannelCount;
+    const bool isDithered = state.range(1) != 0;
+    std::vector<float> mix(numSamples, 0.5f), source(numSamples);
+    std::vector<Sample> target(numSamples);
+    OutputConverter converter;
+    for (auto _ : state) {
+        memcpy(source.data(), mix.data(), numSamples * sizeof(float));
+        converter.convert(source.data(), target.data(), numSamples, isDithered);
+        benchmark::ClobberMemory();
+    }
+    setBufferCounters(state, sizeof(Sample));
+}
+BENCHMARK_TEMPLATE(BM_ConvertOutput, int16_t)->ArgsProduct({{192, 1024}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_ConvertOutput, PackedInt24)->ArgsProduct({{192, 1024}, {0, 1}});
+BENCHMARK_TEMPLATE(BM_ConvertOutput, int32_t)->ArgsProduct({{192, 1024}, {0}});
@@ -0,0 +1,189 @@
+//
+// Created by 43975 on 1/14/2022.
+//
+#include <cmath>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "SampleKernels.h"
+
+// Odd sizes so that the vector loops and the scalar tails are both exercised
+static const int32_t kSizes[] = {0, 1, 3, 7, 8, 15, 16, 17, 63, 64, 191, 1024, 1031};
+
+// The vectorized versions use the same operations in the same order as the scalar ones,
+// this only allows for differences like a fused multiply-add
+constexpr float kTolerance = 1e-6f;
+
+static std::vector<float> randomFloats(int32_t count, float range, uint32_t seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> distribution(-range, range);
+    std::vector<float> values(count);
+    for (float &value : values) value = distribution(generator);
+    return values;
+}
+
+class SampleKernelsTest : public ::testing::TestWithParam<const SampleKernels *> {
+protected:
+    const SampleKernels &kernels() const { return *GetParam(); }
+    const SampleKernels &scalar() const { return getScalarSampleKernels(); }
+};
+
+TEST_P(SampleKernelsTest, ConvertI16ToFloatMatchesScalar) {
+    for (int32_t size : kSizes) {
+        std::vector<int16_t> input(size + 1);
+        for (int i = 0; i < size + 1; ++i) input[i] = static_cast<int16_t>(i * 2731 - 32768);
+        input[0] = INT16_MIN;
+        std::vector<float> expected(size + 1), actual(size + 1);
+        // offset by one sample to check unaligned access
+        scalar().convertI16ToFloat(input.data() + 1, expected.data() + 1, size);
+        kernels().convertI16ToFloat(input.data() + 1, actual.data() + 1, size);
+        EXPECT_EQ(expected, actual) << "size " << size;
+    }
+}
+
+TEST_P(SampleKernelsTest, ConvertFloatToI16MatchesScalar) {
+    for (int32_t size : kSizes) {
+        // values outside [-1, 1] check the clipping
+        std::vector<float> input = randomFloats(size, 1.5f, size);
+        std::vector<int16_t> expected(size), actual(size);
+        scalar().convertFloatToI16(input.data(), expected.data(), size);
+        kernels().convertFloatToI16(input.data(), actual.data(), size);
+        for (int i = 0; i < size; ++i) {
+            // ARMv7 NEON rounds halfway values differently
+            EXPECT_NEAR(expected[i], actual[i], 1) << "size " << size << " index " << i;
+        }
+    }
+}
+
+TEST_P(SampleKernelsTest, ConvertFloatToI16Clips) {
+    const float input[8] = {-2.0f, -1.0f, -0.5f, 0.0f, 0.5f, 0.99999f, 1.0f, 2.0f};
+    int16_t output[8];
+    kernels().convertFloatToI16(input, output, 8);
+    EXPECT_EQ(-32768, output[0]);
+    EXPECT_EQ(-32768, output[1]);
+    EXPECT_EQ(-16384, output[2]);
+    EXPECT_EQ(0, output[3]);
+    EXPECT_EQ(16384, output[4]);
+    EXPECT_EQ(32767, output[5]);
+    EXPECT_EQ(32767, output[6]);
+    EXPECT_EQ(32767, output[7]);
+}
+
+TEST_P(SampleKernelsTest, HalfRoundTripsEveryValue) {
+    std::vector<uint16_t> halves;
+    for (uint32_t half = 0; half <= 0xffff; ++half) {
+        // skip NaNs, their payload doesn't have to survive
+        if ((half & 0x7c00u) == 0x7c00u && (half & 0x3ffu) != 0) continue;
+        halves.push_back(static_cast<uint16_t>(half));
+    }
+    const auto size = static_cast<int32_t>(halves.size());
+    std::vector<float> floats(size);
+    std::vector<uint16_t> roundTripped(size);
+    kernels().convertHalfToFloat(halves.data(), floats.data(), size);
+    kernels().convertFloatToHalf(floats.data(), roundTripped.data(), size);
+    EXPECT_EQ(halves, roundTripped);
+}
+
+TEST_P(SampleKernelsTest, ConvertFloatToHalfRoundsToNearestEven) {
+    const float input[8] = {1.0f, -2.0f, 65504.0f, 65520.0f, 5.9604645e-8f, 0.1f,
+                            1.0f + 1.0f / 2048.0f, 1.0f + 3.0f / 2048.0f};
+    uint16_t output[8];
+    kernels().convertFloatToHalf(input, output, 8);
+    EXPECT_EQ(0x3c00, output[0]);
+    EXPECT_EQ(0xc000, output[1]);
+    EXPECT_EQ(0x7bff, output[2]);
+    EXPECT_EQ(0x7c00, output[3]); // overflows to infinity
+    EXPECT_EQ(0x0001, output[4]); // smallest subnormal
+    EXPECT_EQ(0x2e66, output[5]);
+    EXPECT_EQ(0x3c00, output[6]); // halfway, rounds down to even
+    EXPECT_EQ(0x3c02, output[7]); // halfway, rounds up to even
+}
+
+TEST_P(SampleKernelsTest, ConvertHalfMatchesScalar) {
+    for (int32_t size : kSizes) {
+        // covers subnormals, normals and overflow
+        std::vector<float> input = randomFloats(size, 70000.0f, size);
+        for (int i = 0; i < size; i += 3) input[i] *= 1e-9f;
+        std::vector<uint16_t> expected(size), actual(size);
+        scalar().convertFloatToHalf(input.data(), expected.data(), size);
+        kernels().convertFloatToHalf(input.data(), actual.data(), size);
+        EXPECT_EQ(expected, actual) << "size " << size;
+
+        std::vector<float> expectedFloats(size), actualFloats(size);
+        scalar().convertHalfToFloat(expected.data(), expectedFloats.data(), size);
+        kernels().convertHalfToFloat(expected.data(), actualFloats.data(), size);
+        EXPECT_EQ(expectedFloats, actualFloats) << "size " << size;
+    }
+}
+
+TEST_P(SampleKernelsTest, ApplyGainMatchesScalar) {
+    for (int32_t size : kSizes) {
+        std::vector<float> expected = randomFloats(size, 1.0f, size);
+        std::vector<float> actual = expected;
+        scalar().applyGain(expected.data(), size, 0.7f);
+        kernels().applyGain(actual.data(), size, 0.7f);
+        EXPECT_EQ(expected, actual) << "size " << size;
+    }
+}
+
+TEST_P(SampleKernelsTest, ApplyGainRampMatchesScalar) {
+    for (int32_t channelCount : {1, 2, 3}) {
+        for (int32_t numFrames : kSizes) {
+            std::vector<float> expected = randomFloats(numFrames * channelCount, 1.0f, numFrames);
+            std::vector<float> actual = expected;
+            scalar().applyGainRamp(expected.data(), numFrames, channelCount, 0.1f, 0.9f);
+            kernels().applyGainRamp(actual.data(), numFrames, channelCount, 0.1f, 0.9f);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_NEAR(expected[i], actual[i], kTolerance)
+                        << "channels " << channelCount << " frames " << numFrames << " index " << i;
+            }
+        }
+    }
+}
+
+TEST_P(SampleKernelsTest, ApplyGainRampEndsBeforeEndGain) {
+    std::vector<float> buffer(8, 1.0f);
+    kernels().applyGainRamp(buffer.data(), 4, 2, 0.0f, 1.0f);
+    const float expected[8] = {0.0f, 0.0f, 0.25f, 0.25f, 0.5f, 0.5f, 0.75f, 0.75f};
+    for (int i = 0; i < 8; ++i) EXPECT_FLOAT_EQ(expected[i], buffer[i]);
+}
+
+TEST_P(SampleKernelsTest, MixStereoMatchesScalar) {
+    for (int32_t numFrames : kSizes) {
+        std::vector<float> source = randomFloats(numFrames * 2, 1.0f, numFrames);
+        std::vector<float> expected = randomFloats(numFrames * 2, 1.0f, numFrames + 1);
+        std::vector<float> actual = expected;
+        scalar().mixStereo(source.data(), expected.data(), numFrames, 0.3f, 0.8f);
+        kernels().mixStereo(source.data(), actual.data(), numFrames, 0.3f, 0.8f);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_NEAR(expected[i], actual[i], kTolerance) << "frames " << numFrames << " index " << i;
+        }
+    }
+}
+
+TEST_P(SampleKernelsTest, ClearZeroesOnlyTheGivenSamples) {
+    for (int32_t size : kSizes) {
+        std::vector<float> buffer(size + 2, 1.0f);
+        kernels().clear(buffer.data() + 1, size);
+        EXPECT_EQ(1.0f, buffer[0]);
+        for (int i = 1; i <= size; ++i) EXPECT_EQ(0.0f, buffer[i]);
+        EXPECT_EQ(1.0f, buffer[size + 1]);
+    }
+}
+
+TEST_P(SampleKernelsTest, DotProductMatchesScalar) {
+    for (int32_t size : kSizes) {
+        std::vector<float> a = randomFloats(size + 1, 1.0f, size);
+        std::vector<float> b = randomFloats(size + 1, 1.0f, size + 1);
+        float expected = scalar().dotProduct(a.data() + 1, b.data() + 1, size);
+        float actual = kernels().dotProduct(a.data() + 1, b.data() + 1, size);
+        // the partial sums are added in a different order
+        EXPECT_NEAR(expected, actual, 1e-5f * (size + 1)) << "size " << size;
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(AllSupported, SampleKernelsTest,
+        ::testing::ValuesIn(getSupportedSampleKernels()),
+        [](const ::testing::TestParamInfo<const SampleKernels *> &info) {
+            return std::string(info.param->name);
+        });
@@ -0,0 +1,54 @@
+//
+// Created by 43975 on 1/27/2022.
+//
+#include <gtest/gtest.h>
+#include "SeekIndex.h"
+
+// Packets of 1152 frames with the timestamp in frames and 400 bytes each
+static void addPackets(SeekIndex &index, int64_t firstPacket, int64_t count) {
+    for (int64_t i = firstPacket; i < firstPacket + count; ++i){
+        index.addPacket(i * 1152, i * 400, i * 1152);
+    }
+}
+
+TEST(SeekIndexTest, KeepsEveryFewPackets) {
+    SeekIndex index;
+    EXPECT_TRUE(index.isEmpty());
+    addPackets(index, 0, 10);
+    ASSERT_FALSE(index.isEmpty());
+    EXPECT_EQ(8 * 1152, index.getLastPoint()->frame);
+}
+
+TEST(SeekIndexTest, FindsPointBeforeFrame) {
+    SeekIndex index;
+    addPackets(index, 0, 100);
+
+    // frame 50 * 1152 is in the point of packet 48, the one before that is returned
+    const SeekPoint *point = index.findPointBefore(50 * 1152);
+    ASSERT_NE(point, nullptr);
+    EXPECT_EQ(44 * 1152, point->frame);
+    EXPECT_EQ(44 * 400, point->bytePosition);
+
+    EXPECT_EQ(0, index.findPointBefore(0)->frame);
+    EXPECT_EQ(0, index.findPointBefore(-5)->frame);
+}
+
+TEST(SeekIndexTest, CoversWhatHasBeenDemuxed) {
+    SeekIndex index;
+    EXPECT_FALSE(index.covers(0));
+    addPackets(index, 0, 10);
+    EXPECT_TRUE(index.covers(5 * 1152));
+    EXPECT_FALSE(index.covers(20 * 1152));
+    index.setComplete();
+    EXPECT_TRUE(index.covers(20 * 1152));
+}
+
+TEST(SeekIndexTest, IgnoresPacketsSeenBefore) {
+    SeekIndex index;
+    addPackets(index, 0, 8);
+    // demuxing again from an earlier point, e.g. when looping, doesn't add anything
+    addPackets(index, 4, 4);
+    addPackets(index, 8, 1);
+    EXPECT_EQ(8 * 1152, index.getLastPoint()->frame);
+    EXPECT_EQ(4 * 1152, index.findPointBefore(100000)->frame);
+}
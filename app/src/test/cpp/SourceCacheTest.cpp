@@ -0,0 +1,136 @@
+//
+// Created by 43975 on 1/28/2022.
+//
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "SourceCache.h"
+
+class FakeDataSource : public DataSource{
+public:
+    FakeDataSource(int64_t numSamples, bool isStreaming = false)
+    :mNumSamples(numSamples), mIsStreaming(isStreaming){}
+
+    int64_t getSize() const override { return mNumSamples; }
+    AudioProperties getProperties() const override { return AudioProperties{2, 48000}; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        contiguousFrames = 0;
+        return nullptr;
+    }
+    bool isStreaming() const override { return mIsStreaming; }
+
+private:
+    const int64_t mNumSamples;
+    const bool mIsStreaming;
+};
+
+constexpr AudioProperties kProperties{2, 48000};
+
+// float samples, so 4 bytes each
+static SourceCache::Loader loaderOf(int64_t numSamples, int *loadCount) {
+    return [numSamples, loadCount](){
+        ++*loadCount;
+        return std::make_shared<FakeDataSource>(numSamples);
+    };
+}
+
+TEST(SourceCacheTest, SharesLoadedSource) {
+    SourceCache cache(1000);
+    int loadCount = 0;
+    auto first = cache.getOrLoad("a", kProperties, loaderOf(10, &loadCount));
+    auto second = cache.getOrLoad("a", kProperties, loaderOf(10, &loadCount));
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(1, loadCount);
+    SourceCacheStats stats = cache.getStats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(0, stats.waits);
+    EXPECT_EQ(1, stats.misses);
+    EXPECT_EQ(40, stats.bytes);
+}
+
+TEST(SourceCacheTest, KeyIncludesProperties) {
+    SourceCache cache(1000);
+    int loadCount = 0;
+    cache.getOrLoad("a", kProperties, loaderOf(10, &loadCount));
+    cache.getOrLoad("a", AudioProperties{2, 44100}, loaderOf(10, &loadCount));
+    EXPECT_EQ(2, loadCount);
+}
+
+TEST(SourceCacheTest, EvictsLeastRecentlyUsed) {
+    SourceCache cache(100);
+    int loadCount = 0;
+    cache.getOrLoad("a", kProperties, loaderOf(10, &loadCount));
+    cache.getOrLoad("b", kProperties, loaderOf(10, &loadCount));
+    cache.getOrLoad("a", kProperties, loaderOf(10, &loadCount));
+    // pushes out b, which was used less recently than a
+    cache.getOrLoad("c", kProperties, loaderOf(10, &loadCount));
+    EXPECT_EQ(3, loadCount);
+    EXPECT_EQ(1, cache.getStats().evictions);
+
+    cache.getOrLoad("a", kProperties, loaderOf(10, &loadCount));
+    EXPECT_EQ(3, loadCount);
+    cache.getOrLoad("b", kProperties, loaderOf(10, &loadCount));
+    EXPECT_EQ(4, loadCount);
+}
+
+TEST(SourceCacheTest, DoesNotKeepOversizedOrStreamingSources) {
+    SourceCache cache(100);
+    int loadCount = 0;
+    EXPECT_NE(nullptr, cache.getOrLoad("big", kProperties, loaderOf(1000, &loadCount)));
+    EXPECT_NE(nullptr, cache.getOrLoad("stream", kProperties, [](){
+        return std::make_shared<FakeDataSource>(0, true);
+    }));
+    EXPECT_EQ(0, cache.getStats().bytes);
+    EXPECT_EQ(0, cache.getStats().evictions);
+}
+
+TEST(SourceCacheTest, ConcurrentRequestsLoadOnce) {
+    SourceCache cache(1000);
+    std::atomic<int> loadCount{0};
+    std::vector<std::shared_ptr<DataSource>> results(4);
+    std::vector<std::thread> threads;
+    for (auto &result : results){
+        threads.emplace_back([&cache, &loadCount, &result](){
+            result = cache.getOrLoad("a", kProperties, [&loadCount](){
+                ++loadCount;
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return std::make_shared<FakeDataSource>(10);
+            });
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    EXPECT_EQ(1, loadCount);
+    for (auto &result : results) EXPECT_EQ(results[0], result);
+}
+
+TEST(SourceCacheTest, CountsWaitingForALoadApartFromHits) {
+    SourceCache cache(1000);
+    std::promise<void> loadMayFinish;
+    std::shared_future<void> loadCanFinish = loadMayFinish.get_future().share();
+    std::thread loader([&cache, loadCanFinish](){
+        cache.getOrLoad("a", kProperties, [loadCanFinish](){
+            loadCanFinish.wait();
+            return std::make_shared<FakeDataSource>(10);
+        });
+    });
+    // the first caller is loading now
+    while (cache.getStats().misses == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::thread waiter([&cache](){
+        cache.getOrLoad("a", kProperties, [](){ return std::make_shared<FakeDataSource>(10); });
+    });
+    while (cache.getStats().waits == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    loadMayFinish.set_value();
+    loader.join();
+    waiter.join();
+
+    SourceCacheStats stats = cache.getStats();
+    EXPECT_EQ(0, stats.hits);
+    EXPECT_EQ(1, stats.waits);
+    EXPECT_EQ(1, stats.misses);
+}
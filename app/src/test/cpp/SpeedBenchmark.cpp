@@ -0,0 +1,63 @@
+//
+// Created by 43975 on 2/2/2022.
+//
+#include <cmath>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "TimeStretcher.h"
+#include "VarispeedProcessor.h"
+
+// CPU cost of playing at another speed, per channel. The arguments are the channel count and
+// the speed in percent, every iteration renders one 192 frame callback buffer.
+
+constexpr int32_t kCallbackFrames = 192;
+
+// Endless sine, so the processors never run dry
+class SineReader : public FrameReader{
+public:
+    explicit SineReader(int32_t channelCount):mChannelCount(channelCount){}
+
+    int32_t readFrames(float *buffer, int32_t numFrames) override {
+        for (int32_t i = 0; i < numFrames; ++i){
+            const float value = 0.5f * std::sin(mPhase);
+            for (int32_t channel = 0; channel < mChannelCount; ++channel) buffer[i * mChannelCount + channel] = value;
+            mPhase = std::fmod(mPhase + 0.0576f, 6.2831853f);
+        }
+        return numFrames;
+    }
+
+private:
+    const int32_t mChannelCount;
+    float mPhase = 0;
+};
+
+static void renderSpeed(benchmark::State &state, SpeedProcessor &processor) {
+    const auto channelCount = static_cast<int32_t>(state.range(0));
+    const float speed = state.range(1) / 100.0f;
+    SineReader reader(channelCount);
+    std::vector<float> output(kCallbackFrames * channelCount);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(processor.render(reader, output.data(), kCallbackFrames, speed));
+        benchmark::ClobberMemory();
+    }
+    // frames of a single channel, to compare the cost per channel
+    state.SetItemsProcessed(state.iterations() * kCallbackFrames * channelCount);
+}
+
+static void BM_SpeedLinear(benchmark::State &state) {
+    VarispeedProcessor processor(static_cast<int32_t>(state.range(0)), false);
+    renderSpeed(state, processor);
+}
+BENCHMARK(BM_SpeedLinear)->ArgsProduct({{1, 2}, {50, 150, 200}});
+
+static void BM_SpeedCubic(benchmark::State &state) {
+    VarispeedProcessor processor(static_cast<int32_t>(state.range(0)), true);
+    renderSpeed(state, processor);
+}
+BENCHMARK(BM_SpeedCubic)->ArgsProduct({{1, 2}, {50, 150, 200}});
+
+static void BM_SpeedTimeStretch(benchmark::State &state) {
+    TimeStretcher stretcher(static_cast<int32_t>(state.range(0)));
+    renderSpeed(state, stretcher);
+}
+BENCHMARK(BM_SpeedTimeStretch)->ArgsProduct({{1, 2}, {50, 150, 200}});
@@ -0,0 +1,218 @@
+//
+// Created by 43975 on 2/2/2022.
+//
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include "Player.h"
+#include "TimeStretcher.h"
+#include "VarispeedProcessor.h"
+
+// Hands out the samples in reads of at most mMaxFramesPerRead, to look like a source which
+// sometimes runs dry
+class VectorReader : public FrameReader{
+public:
+    VectorReader(std::vector<float> samples, int32_t channelCount, int32_t maxFramesPerRead = INT32_MAX)
+    :mSamples(std::move(samples)), mChannelCount(channelCount), mMaxFramesPerRead(maxFramesPerRead){}
+
+    int32_t readFrames(float *buffer, int32_t numFrames) override {
+        const auto framesLeft = static_cast<int32_t>(mSamples.size() / mChannelCount - mReadFrame);
+        const int32_t framesToRead = std::min(std::min(numFrames, framesLeft), mMaxFramesPerRead);
+        std::copy(mSamples.begin() + mReadFrame * mChannelCount,
+                  mSamples.begin() + (mReadFrame + framesToRead) * mChannelCount, buffer);
+        mReadFrame += framesToRead;
+        return framesToRead;
+    }
+
+    int32_t getReadFrame() const { return mReadFrame; }
+    bool isAtEnd() const { return mReadFrame == static_cast<int32_t>(mSamples.size()) / mChannelCount; }
+
+private:
+    std::vector<float> mSamples;
+    const int32_t mChannelCount;
+    const int32_t mMaxFramesPerRead;
+    int32_t mReadFrame = 0;
+};
+
+// Says so once everything has been read, like a source at its end
+class EndingReader : public VectorReader{
+public:
+    using VectorReader::VectorReader;
+
+    bool isEndOfInput() const override { return isAtEnd(); }
+};
+
+static std::vector<float> ramp(int32_t numFrames, int32_t channelCount) {
+    std::vector<float> samples(numFrames * channelCount);
+    for (int32_t i = 0; i < numFrames; ++i){
+        for (int32_t channel = 0; channel < channelCount; ++channel) samples[i * channelCount + channel] = i + channel * 0.25f;
+    }
+    return samples;
+}
+
+static std::vector<float> sine(int32_t numFrames, double frequency, int32_t sampleRate) {
+    std::vector<float> samples(numFrames);
+    for (int32_t i = 0; i < numFrames; ++i) samples[i] = static_cast<float>(0.5 * std::sin(2 * M_PI * frequency * i / sampleRate));
+    return samples;
+}
+
+// Renders until the reader has nothing left
+static std::vector<float> renderAll(SpeedProcessor &processor, FrameReader &reader, int32_t channelCount,
+                                    float speed, int32_t blockFrames = 192) {
+    std::vector<float> output;
+    std::vector<float> block(blockFrames * channelCount);
+    for (int32_t emptyBlocks = 0; emptyBlocks < 2;){
+        int32_t framesRendered = processor.render(reader, block.data(), blockFrames, speed);
+        output.insert(output.end(), block.begin(), block.begin() + framesRendered * channelCount);
+        emptyBlocks = (framesRendered == 0) ? emptyBlocks + 1 : 0;
+    }
+    return output;
+}
+
+static int32_t countZeroCrossings(const std::vector<float> &samples, size_t start, size_t end) {
+    int32_t crossings = 0;
+    for (size_t i = start + 1; i < end; ++i){
+        if ((samples[i - 1] < 0) != (samples[i] < 0)) ++crossings;
+    }
+    return crossings;
+}
+
+TEST(VarispeedProcessorTest, InterpolatesBetweenFrames) {
+    for (bool isCubic : {false, true}){
+        for (float speed : {0.5f, 0.75f, 1.5f, 2.0f}){
+            VarispeedProcessor processor(2, isCubic);
+            VectorReader reader(ramp(1000, 2), 2);
+            std::vector<float> output = renderAll(processor, reader, 2, speed);
+            // both interpolations are exact on a straight line
+            ASSERT_GT(output.size(), 2 * 990 / speed - 4);
+            // the cubic starts from a frame of silence before the first frame
+            for (size_t frame = isCubic ? 2 : 0; frame < output.size() / 2; ++frame){
+                ASSERT_NEAR(frame * speed, output[frame * 2], 1e-3f) << "speed " << speed << " frame " << frame;
+                ASSERT_NEAR(frame * speed + 0.25f, output[frame * 2 + 1], 1e-3f);
+            }
+        }
+    }
+}
+
+TEST(VarispeedProcessorTest, ContinuesWhenTheReaderCatchesUp) {
+    VarispeedProcessor processor(1, true);
+    VectorReader reader(ramp(2000, 1), 1, 5);
+    std::vector<float> output = renderAll(processor, reader, 1, 1.25f, 64);
+    for (size_t frame = 0; frame < output.size(); ++frame) ASSERT_NEAR(frame * 1.25f, output[frame], 1e-3f);
+}
+
+TEST(VarispeedProcessorTest, PlaysOutTheLastFrames) {
+    for (bool isCubic : {false, true}){
+        for (float speed : {0.75f, 1.5f, 2.0f}){
+            VarispeedProcessor processor(1, isCubic);
+            EndingReader reader(ramp(1000, 1), 1, 7);
+            std::vector<float> output = renderAll(processor, reader, 1, speed);
+            // one output frame for every position before the end of the input
+            ASSERT_EQ(static_cast<size_t>(std::ceil(1000 / speed)), output.size()) << "speed " << speed;
+            for (size_t frame = isCubic ? 2 : 0; frame * speed <= 998; ++frame){
+                ASSERT_NEAR(frame * speed, output[frame], 1e-3f) << "speed " << speed << " frame " << frame;
+            }
+        }
+    }
+}
+
+TEST(TimeStretcherTest, NormalSpeedPassesTheInputThrough) {
+    std::vector<float> input = sine(20000, 440, 48000);
+    TimeStretcher stretcher(1);
+    VectorReader reader(input, 1);
+    std::vector<float> output = renderAll(stretcher, reader, 1, 1.0f);
+    ASSERT_GT(output.size(), 18000u);
+    for (size_t i = 0; i < output.size(); ++i) ASSERT_NEAR(input[i], output[i], 1e-4f) << i;
+}
+
+TEST(TimeStretcherTest, PlaysTheInputOutToTheEnd) {
+    std::vector<float> input = sine(20000, 440, 48000);
+    TimeStretcher stretcher(1);
+    EndingReader reader(input, 1, 100);
+    std::vector<float> output = renderAll(stretcher, reader, 1, 1.0f);
+    ASSERT_GE(output.size(), input.size());
+    ASSERT_LT(output.size(), input.size() + kStretchOverlapFrames);
+    for (size_t i = 0; i < input.size(); ++i) ASSERT_NEAR(input[i], output[i], 1e-4f) << i;
+}
+
+TEST(TimeStretcherTest, ChangesDurationButNotPitch) {
+    const int32_t numFrames = 48000;
+    for (float speed : {0.5f, 0.8f, 1.25f, 2.0f}){
+        TimeStretcher stretcher(2);
+        std::vector<float> mono = sine(numFrames, 440, 48000);
+        std::vector<float> input(numFrames * 2);
+        for (int32_t i = 0; i < numFrames; ++i) input[i * 2] = input[i * 2 + 1] = mono[i];
+        EndingReader reader(input, 2, 100);
+        std::vector<float> output = renderAll(stretcher, reader, 2, speed);
+
+        const size_t outputFrames = output.size() / 2;
+        // the output is made of whole blocks and the last segments may have moved by up to the
+        // search range, but the buffered tail is played out
+        EXPECT_GT(outputFrames, numFrames / speed - kStretchOverlapFrames) << "speed " << speed;
+        EXPECT_LE(outputFrames, numFrames / speed + kStretchOverlapFrames + kStretchSearchFrames) << "speed " << speed;
+
+        std::vector<float> left(outputFrames);
+        for (size_t i = 0; i < outputFrames; ++i) left[i] = output[i * 2];
+        // 880 crossings a second at 440Hz, over the middle 10000 frames
+        const size_t start = outputFrames / 2 - 5000;
+        const int32_t crossings = countZeroCrossings(left, start, start + 10000);
+        EXPECT_NEAR(880.0 * 10000 / 48000, crossings, 3) << "speed " << speed;
+    }
+}
+
+class MonoRampDataSource : public DataSource{
+public:
+    explicit MonoRampDataSource(int64_t numFrames):mSamples(ramp(static_cast<int32_t>(numFrames), 1)){}
+
+    int64_t getSize() const override { return mSamples.size(); }
+    AudioProperties getProperties() const override { return AudioProperties{1, 48000}; }
+    const void* getFrames(int64_t frameIndex, int64_t &contiguousFrames) const override {
+        contiguousFrames = getSize() - frameIndex;
+        return &mSamples[frameIndex];
+    }
+
+private:
+    std::vector<float> mSamples;
+};
+
+TEST(PlayerSpeedTest, PlaysFasterAndStopsAtTheEnd) {
+    Player player(std::make_shared<MonoRampDataSource>(4000));
+    player.setPlaying(true);
+    player.setSpeed(2.0f, SpeedMode::Linear);
+
+    std::vector<float> output(256);
+    int32_t totalFrames = 0;
+    for (int i = 0; i < 20 && player.isPlaying(); ++i){
+        int32_t framesRendered = player.renderAudio(output.data(), 256);
+        for (int32_t frame = 0; frame < framesRendered; ++frame){
+            ASSERT_NEAR((totalFrames + frame) * 2.0f, output[frame], 1e-3f);
+        }
+        totalFrames += framesRendered;
+    }
+    EXPECT_FALSE(player.isPlaying());
+    EXPECT_NEAR(2000, totalFrames, 2);
+}
+
+TEST(PlayerSpeedTest, EndsOnceTheTimeStretcherHasPlayedItsTail) {
+    Player player(std::make_shared<MonoRampDataSource>(20000));
+    player.setPlaying(true);
+    player.setSpeed(0.5f, SpeedMode::TimeStretch);
+
+    std::vector<float> output(256);
+    int32_t totalFrames = 0;
+    for (int i = 0; i < 200 && player.isPlaying(); ++i) totalFrames += player.renderAudio(output.data(), 256);
+    EXPECT_FALSE(player.isPlaying());
+    // a segment may run ahead of the speed by an overlap and the search range, but the
+    // segments still buffered at the end of the source are played
+    EXPECT_GT(totalFrames, (20000 - kStretchOverlapFrames - kStretchSearchFrames) / 0.5f);
+    EXPECT_LE(totalFrames, 40000 + kStretchOverlapFrames + kStretchSearchFrames);
+}
+
+TEST(PlayerSpeedTest, SpeedIsClamped) {
+    Player player(std::make_shared<MonoRampDataSource>(10));
+    player.setSpeed(10.0f, SpeedMode::Cubic);
+    EXPECT_EQ(kMaxPlaybackSpeed, player.getSpeed());
+    player.setSpeed(0.0f, SpeedMode::Cubic);
+    EXPECT_EQ(kMinPlaybackSpeed, player.getSpeed());
+}
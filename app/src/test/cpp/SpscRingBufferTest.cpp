@@ -0,0 +1,107 @@
+//
+// Created by 43975 on 1/10/2022.
+//
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "SpscRingBuffer.h"
+
+TEST(SpscRingBufferTest, CapacityIsRoundedUpToPowerOfTwo) {
+    SpscRingBuffer<float> buffer(1000);
+    EXPECT_EQ(1024, buffer.getCapacity());
+    EXPECT_EQ(1024, buffer.getAvailableToWrite());
+    EXPECT_EQ(0, buffer.getAvailableToRead());
+}
+
+TEST(SpscRingBufferTest, WriteStopsWhenFullAndReadStopsWhenEmpty) {
+    SpscRingBuffer<float> buffer(8);
+    std::vector<float> input{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    EXPECT_EQ(8, buffer.write(input.data(), (int32_t)input.size()));
+    EXPECT_EQ(0, buffer.getAvailableToWrite());
+
+    std::vector<float> output(10);
+    EXPECT_EQ(8, buffer.read(output.data(), 10));
+    for (int i = 0; i < 8; ++i) EXPECT_EQ(input[i], output[i]);
+    EXPECT_EQ(0, buffer.read(output.data(), 10));
+}
+
+TEST(SpscRingBufferTest, SpansAreSplitAtWraparound) {
+    SpscRingBuffer<float> buffer(8);
+    std::vector<float> data(6, 1.0f);
+    buffer.write(data.data(), 6);
+    buffer.read(data.data(), 6);
+
+    SpscRingBuffer<float>::Span first, second;
+    EXPECT_EQ(8, buffer.getWriteSpans(first, second));
+    EXPECT_EQ(2, first.size);
+    EXPECT_EQ(6, second.size);
+
+    for (int i = 0; i < first.size; ++i) first.data[i] = (float)i;
+    for (int i = 0; i < second.size; ++i) second.data[i] = (float)(first.size + i);
+    buffer.commitWrite(8);
+
+    EXPECT_EQ(8, buffer.getReadSpans(first, second));
+    EXPECT_EQ(2, first.size);
+    EXPECT_EQ(6, second.size);
+    EXPECT_EQ(2.0f, second.data[0]);
+
+    std::vector<float> output(8);
+    EXPECT_EQ(8, buffer.read(output.data(), 8));
+    for (int i = 0; i < 8; ++i) EXPECT_EQ((float)i, output[i]);
+}
+
+TEST(SpscRingBufferTest, DiscardDropsReadableData) {
+    SpscRingBuffer<float> buffer(16);
+    std::vector<float> data(10, 0.5f);
+    buffer.write(data.data(), 10);
+    buffer.discard();
+    EXPECT_EQ(0, buffer.getAvailableToRead());
+    EXPECT_EQ(16, buffer.getAvailableToWrite());
+}
+
+/**
+ * A producer and a consumer hammer a small buffer with odd block sizes so that every possible
+ * wraparound split is hit. The consumer checks that it receives the exact sequence written.
+ */
+TEST(SpscRingBufferTest, StressDataIntegrityUnderContention) {
+    constexpr int64_t kTotalSamples = 4000000;
+    constexpr int32_t kMaxSequenceValue = 1 << 24; // floats represent integers exactly up to 2^24
+    SpscRingBuffer<float> buffer(257);
+
+    std::thread producer([&buffer]{
+        float block[97];
+        int64_t written = 0;
+        int32_t blockSize = 1;
+        while (written < kTotalSamples){
+            int32_t count = (int32_t)std::min<int64_t>(blockSize, kTotalSamples - written);
+            for (int i = 0; i < count; ++i) block[i] = (float)((written + i) % kMaxSequenceValue);
+            int32_t done = 0;
+            while (done < count){
+                int32_t samplesWritten = buffer.write(block + done, count - done);
+                if (samplesWritten == 0) std::this_thread::yield();
+                done += samplesWritten;
+            }
+            written += count;
+            blockSize = blockSize % 97 + 1;
+        }
+    });
+
+    float block[61];
+    int64_t read = 0;
+    int64_t mismatches = 0;
+    int32_t blockSize = 1;
+    while (read < kTotalSamples){
+        int32_t count = buffer.read(block, blockSize);
+        if (count == 0) std::this_thread::yield();
+        for (int i = 0; i < count; ++i){
+            if (block[i] != (float)((read + i) % kMaxSequenceValue)) ++mismatches;
+        }
+        read += count;
+        blockSize = blockSize % 61 + 1;
+    }
+    producer.join();
+
+    EXPECT_EQ(0, mismatches);
+    EXPECT_EQ(kTotalSamples, read);
+    EXPECT_EQ(0, buffer.getAvailableToRead());
+}
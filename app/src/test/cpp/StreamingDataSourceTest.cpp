@@ -0,0 +1,147 @@
+//
+// Created by 43975 on 2/9/2022.
+//
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "HostAssetManager.h"
+#include "MockMediaCodec.h"
+#include "StreamingDataSource.h"
+
+constexpr int32_t kStreamChannelCount = 2;
+constexpr int32_t kStreamSampleRate = 8000;
+constexpr int32_t kStreamPacketFrames = 1152;
+constexpr int32_t kStreamPackets = 12;
+constexpr int32_t kStreamFrames = kStreamPackets * kStreamPacketFrames;
+constexpr const char *kStreamAssetName = "stream.mock";
+// how long a test waits for the decoder thread before it gives up
+constexpr auto kStreamTimeout = std::chrono::seconds(5);
+
+// Every sample is its index, so the frame a sample came from can be read off its value
+static MockMediaTrack countingStreamTrack() {
+    MockMediaTrack track;
+    track.sampleRate = kStreamSampleRate;
+    track.channelCount = kStreamChannelCount;
+    int16_t sample = 0;
+    for (int32_t i = 0; i < kStreamPackets; ++i){
+        std::vector<int16_t> packet(kStreamPacketFrames * kStreamChannelCount);
+        for (auto &value : packet) value = sample++;
+        track.packets.push_back(packet);
+    }
+    return track;
+}
+
+static int32_t frameOf(float sample) {
+    return static_cast<int32_t>(sample * 32768.0f) / kStreamChannelCount;
+}
+
+// The mock extractor ignores the contents of the file, there only has to be one to open
+class StreamingDataSourceTest : public ::testing::Test{
+protected:
+    void SetUp() override {
+        char directory[] = "/tmp/streaming-source-XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(directory));
+        mDirectory = directory;
+        FILE *file = fopen((mDirectory + "/" + kStreamAssetName).c_str(), "wb");
+        ASSERT_NE(nullptr, file);
+        fputs("mock", file);
+        fclose(file);
+        mAssetManager = HostAssetManager_new(mDirectory.c_str());
+        MockMedia_setTrack(countingStreamTrack());
+    }
+
+    void TearDown() override {
+        mSource.reset();
+        HostAssetManager_delete(mAssetManager);
+        unlink((mDirectory + "/" + kStreamAssetName).c_str());
+        rmdir(mDirectory.c_str());
+        EXPECT_EQ(0, MockMedia_getStats().openCodecs);
+    }
+
+    void open(bool isLooping) {
+        AudioProperties properties{.channelCount = kStreamChannelCount, .sampleRate = kStreamSampleRate};
+        mSource.reset(StreamingDataSource::newFromCompressedAsset(*mAssetManager, kStreamAssetName,
+                properties, isLooping));
+        ASSERT_NE(nullptr, mSource);
+    }
+
+    // Reads like the audio callback until numFrames have arrived or the stream ends
+    std::vector<float> read(int32_t numFrames) {
+        std::vector<float> samples;
+        std::vector<float> buffer(256 * kStreamChannelCount);
+        const auto deadline = std::chrono::steady_clock::now() + kStreamTimeout;
+        while (static_cast<int32_t>(samples.size()) < numFrames * kStreamChannelCount
+                && std::chrono::steady_clock::now() < deadline){
+            const int32_t framesWanted = std::min<int32_t>(256, numFrames - samples.size() / kStreamChannelCount);
+            const int32_t framesRead = mSource->readFrames(buffer.data(), framesWanted);
+            samples.insert(samples.end(), buffer.begin(), buffer.begin() + framesRead * kStreamChannelCount);
+            if (framesRead == 0){
+                if (mSource->isEndOfStream()) break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        return samples;
+    }
+
+    std::string mDirectory;
+    AAssetManager *mAssetManager = nullptr;
+    std::unique_ptr<StreamingDataSource> mSource;
+};
+
+TEST_F(StreamingDataSourceTest, EndsAfterTheLastFrameWhenNotLooping) {
+    open(false);
+    std::vector<float> samples = read(kStreamFrames + 1000);
+    ASSERT_EQ(static_cast<size_t>(kStreamFrames * kStreamChannelCount), samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) ASSERT_FLOAT_EQ(i / 32768.0f, samples[i]) << i;
+
+    EXPECT_TRUE(mSource->isEndOfStream());
+    float frame[kStreamChannelCount];
+    EXPECT_EQ(0, mSource->readFrames(frame, 1));
+}
+
+TEST_F(StreamingDataSourceTest, WrapsAroundWhenLooping) {
+    open(true);
+    std::vector<float> samples = read(kStreamFrames + 500);
+    ASSERT_EQ(static_cast<size_t>((kStreamFrames + 500) * kStreamChannelCount), samples.size());
+    EXPECT_EQ(kStreamFrames - 1, frameOf(samples[(kStreamFrames - 1) * kStreamChannelCount]));
+    for (int32_t frame = 0; frame < 500; ++frame){
+        ASSERT_EQ(frame, frameOf(samples[(kStreamFrames + frame) * kStreamChannelCount])) << frame;
+    }
+    EXPECT_FALSE(mSource->isEndOfStream());
+}
+
+TEST_F(StreamingDataSourceTest, NothingFromBeforeASeekIsPlayed) {
+    open(false);
+    ASSERT_EQ(static_cast<size_t>(1000 * kStreamChannelCount), read(1000).size());
+
+    constexpr int32_t kSeekFrame = 9000;
+    ASSERT_TRUE(mSource->seekToFrame(kSeekFrame));
+    // the window still holds audio from before the seek, none of it may come out
+    float frame[kStreamChannelCount];
+    EXPECT_EQ(0, mSource->readFrames(frame, 1));
+
+    std::vector<float> samples = read(kStreamFrames);
+    ASSERT_EQ(static_cast<size_t>((kStreamFrames - kSeekFrame) * kStreamChannelCount), samples.size());
+    for (size_t i = 0; i < samples.size(); i += kStreamChannelCount){
+        ASSERT_EQ(kSeekFrame + static_cast<int32_t>(i / kStreamChannelCount), frameOf(samples[i])) << i;
+    }
+    EXPECT_TRUE(mSource->isEndOfStream());
+}
+
+TEST_F(StreamingDataSourceTest, SeeksAgainAfterTheEnd) {
+    open(false);
+    read(kStreamFrames);
+    ASSERT_TRUE(mSource->isEndOfStream());
+
+    ASSERT_TRUE(mSource->seekToFrame(0));
+    // no longer at the end as soon as the seek is asked for, not once the decoder wakes up
+    EXPECT_FALSE(mSource->isEndOfStream());
+    std::vector<float> samples = read(100);
+    ASSERT_EQ(static_cast<size_t>(100 * kStreamChannelCount), samples.size());
+    EXPECT_EQ(0, frameOf(samples[0]));
+}
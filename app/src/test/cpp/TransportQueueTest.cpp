@@ -0,0 +1,102 @@
+//
+// Created by 43975 on 2/5/2022.
+//
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "TransportQueue.h"
+
+static TransportCommand seekCommand(int64_t streamFrame, int64_t positionMillis) {
+    TransportCommand command{TransportCommandType::Seek, streamFrame};
+    command.positionMillis = positionMillis;
+    return command;
+}
+
+TEST(TransportQueueTest, ImmediateCommandsAreDueAtOnce) {
+    TransportQueue queue;
+    ASSERT_TRUE(queue.push(TransportCommand{TransportCommandType::Pause}));
+    queue.receive();
+
+    TransportCommand command;
+    ASSERT_TRUE(queue.popDue(1000, command));
+    EXPECT_EQ(TransportCommandType::Pause, command.type);
+    EXPECT_FALSE(queue.popDue(1000, command));
+}
+
+TEST(TransportQueueTest, OrdersCommandsByFrame) {
+    TransportQueue queue;
+    queue.push(seekCommand(500, 1));
+    queue.push(seekCommand(200, 2));
+    queue.push(seekCommand(500, 3));
+    queue.push(seekCommand(kTransportImmediate, 4));
+    queue.receive();
+    ASSERT_EQ(4, queue.getScheduledCount());
+
+    TransportCommand command;
+    ASSERT_TRUE(queue.popDue(100, command));
+    EXPECT_EQ(4, command.positionMillis);
+    EXPECT_FALSE(queue.popDue(100, command));
+    EXPECT_EQ(100, queue.getFramesUntilNext(100, 256));
+
+    ASSERT_TRUE(queue.popDue(200, command));
+    EXPECT_EQ(2, command.positionMillis);
+    EXPECT_EQ(256, queue.getFramesUntilNext(200, 256));
+
+    // same frame, pushed first comes first
+    ASSERT_TRUE(queue.popDue(600, command));
+    EXPECT_EQ(1, command.positionMillis);
+    ASSERT_TRUE(queue.popDue(600, command));
+    EXPECT_EQ(3, command.positionMillis);
+    EXPECT_EQ(0, queue.getScheduledCount());
+    EXPECT_EQ(256, queue.getFramesUntilNext(600, 256));
+}
+
+// Renders callbacks the way PlayerController does and records the frame each command lands on
+TEST(TransportQueueTest, SplitsCallbacksAtCommandFrames) {
+    TransportQueue queue;
+    for (int64_t frame : {1000, 130, 131, 4000}) queue.push(seekCommand(frame, frame));
+
+    std::vector<int64_t> appliedFrames;
+    int64_t streamFrame = 0;
+    for (int32_t callback = 0; callback < 20; ++callback){
+        queue.receive();
+        for (int32_t frame = 0; frame < 256;){
+            TransportCommand command;
+            while (queue.popDue(streamFrame, command)) appliedFrames.push_back(streamFrame);
+            const int32_t segmentFrames = queue.getFramesUntilNext(streamFrame, 256 - frame);
+            ASSERT_GT(segmentFrames, 0);
+            frame += segmentFrames;
+            streamFrame += segmentFrames;
+        }
+    }
+    EXPECT_EQ((std::vector<int64_t>{130, 131, 1000, 4000}), appliedFrames);
+}
+
+TEST(TransportQueueTest, KeepsCommandsBeyondTheScheduleQueued) {
+    TransportQueue queue;
+    for (int32_t i = 0; i < kMaxPendingTransportCommands; ++i) ASSERT_TRUE(queue.push(seekCommand(i, i)));
+    queue.receive();
+    for (int32_t i = 0; i < kMaxPendingTransportCommands; ++i) ASSERT_TRUE(queue.push(seekCommand(i, i)));
+    EXPECT_FALSE(queue.push(seekCommand(0, 0)));
+
+    queue.receive();
+    EXPECT_EQ(kMaxPendingTransportCommands, queue.getScheduledCount());
+    TransportCommand command;
+    while (queue.popDue(INT64_MAX, command)){}
+    queue.receive();
+    EXPECT_EQ(kMaxPendingTransportCommands, queue.getScheduledCount());
+}
+
+TEST(TransportQueueTest, AcceptsCommandsFromManyThreads) {
+    TransportQueue queue;
+    std::vector<std::thread> threads;
+    for (int32_t thread = 0; thread < 4; ++thread){
+        threads.emplace_back([&queue, thread](){
+            for (int32_t i = 0; i < 8; ++i) queue.push(seekCommand(kTransportImmediate, thread));
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    queue.receive();
+    EXPECT_EQ(32, queue.getScheduledCount());
+}
@@ -0,0 +1,95 @@
+//
+// Created by 43975 on 1/30/2022.
+//
+#include <cstdio>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "HostAssetManager.h"
+
+struct AAssetManager{
+    std::string rootDirectory;
+};
+
+struct AAsset{
+    int fd;
+    off_t length;
+    off_t position;
+    void *mapping;
+};
+
+AAssetManager *HostAssetManager_new(const char *rootDirectory) {
+    return new AAssetManager{rootDirectory};
+}
+
+void HostAssetManager_delete(AAssetManager *assetManager) {
+    delete assetManager;
+}
+
+AAsset *AAssetManager_open(AAssetManager *mgr, const char *filename, int mode) {
+    const std::string path = mgr->rootDirectory + "/" + filename;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) != 0){
+        close(fd);
+        return nullptr;
+    }
+    return new AAsset{fd, fileStat.st_size, 0, nullptr};
+}
+
+void AAsset_close(AAsset *asset) {
+    if (asset->mapping != nullptr) munmap(asset->mapping, asset->length);
+    close(asset->fd);
+    delete asset;
+}
+
+int AAsset_read(AAsset *asset, void *buf, size_t count) {
+    ssize_t bytesRead = pread(asset->fd, buf, count, asset->position);
+    if (bytesRead < 0) return -1;
+    asset->position += bytesRead;
+    return static_cast<int>(bytesRead);
+}
+
+off_t AAsset_seek(AAsset *asset, off_t offset, int whence) {
+    off_t position;
+    switch (whence){
+        case SEEK_SET: position = offset; break;
+        case SEEK_CUR: position = asset->position + offset; break;
+        case SEEK_END: position = asset->length + offset; break;
+        default: return -1;
+    }
+    if (position < 0 || position > asset->length) return -1;
+    asset->position = position;
+    return position;
+}
+
+off_t AAsset_getLength(AAsset *asset) {
+    return asset->length;
+}
+
+off64_t AAsset_getLength64(AAsset *asset) {
+    return asset->length;
+}
+
+off_t AAsset_getRemainingLength(AAsset *asset) {
+    return asset->length - asset->position;
+}
+
+const void *AAsset_getBuffer(AAsset *asset) {
+    if (asset->mapping == nullptr && asset->length > 0){
+        void *mapping = mmap(nullptr, asset->length, PROT_READ, MAP_PRIVATE, asset->fd, 0);
+        if (mapping == MAP_FAILED) return nullptr;
+        asset->mapping = mapping;
+    }
+    return asset->mapping;
+}
+
+int AAsset_openFileDescriptor(AAsset *asset, off_t *outStart, off_t *outLength) {
+    *outStart = 0;
+    *outLength = asset->length;
+    return dup(asset->fd);
+}
@@ -0,0 +1,16 @@
+//
+// Created by 43975 on 1/30/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_HOSTASSETMANAGER_H
+#define OBOE_AUDIO_PLAYER_HOSTASSETMANAGER_H
+
+#include <android/asset_manager.h>
+
+/**
+ * @param rootDirectory : directory the asset names are relative to, like the assets folder of the app
+ */
+AAssetManager *HostAssetManager_new(const char *rootDirectory);
+void HostAssetManager_delete(AAssetManager *assetManager);
+
+#endif //OBOE_AUDIO_PLAYER_HOSTASSETMANAGER_H
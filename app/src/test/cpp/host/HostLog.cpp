@@ -0,0 +1,18 @@
+//
+// Created by 43975 on 1/31/2022.
+//
+#include <cstdarg>
+#include <cstdio>
+#include <android/log.h>
+
+int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
+    if (prio < ANDROID_LOG_WARN) return 0;
+
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s: ", tag);
+    int result = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return result;
+}
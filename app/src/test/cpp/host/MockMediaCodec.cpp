@@ -0,0 +1,292 @@
+//
+// Created by 43975 on 2/3/2022.
+//
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include "MockMediaCodec.h"
+
+const char *AMEDIAFORMAT_KEY_SAMPLE_RATE = "sample-rate";
+const char *AMEDIAFORMAT_KEY_CHANNEL_COUNT = "channel-count";
+const char *AMEDIAFORMAT_KEY_MIME = "mime";
+
+static MockMediaTrack sTrack;
+static MockMediaStats sStats;
+static std::mutex sStatsLock;
+
+void MockMedia_setTrack(const MockMediaTrack &track) {
+    sTrack = track;
+    std::lock_guard<std::mutex> lock(sStatsLock);
+    sStats = MockMediaStats{};
+}
+
+MockMediaStats MockMedia_getStats() {
+    std::lock_guard<std::mutex> lock(sStatsLock);
+    return sStats;
+}
+
+static void countDequeue(int64_t timeoutUs) {
+    std::lock_guard<std::mutex> lock(sStatsLock);
+    if (timeoutUs == 0) ++sStats.zeroTimeoutDequeues;
+}
+
+// Format
+
+struct AMediaFormat{
+    std::map<std::string, int32_t> values;
+    std::string mimeType;
+};
+
+bool AMediaFormat_getInt32(AMediaFormat *format, const char *name, int32_t *out) {
+    auto value = format->values.find(name);
+    if (value == format->values.end()) return false;
+    *out = value->second;
+    return true;
+}
+
+bool AMediaFormat_getString(AMediaFormat *format, const char *name, const char **out) {
+    if (strcmp(name, AMEDIAFORMAT_KEY_MIME) != 0) return false;
+    *out = format->mimeType.c_str();
+    return true;
+}
+
+const char *AMediaFormat_toString(AMediaFormat *format) {
+    return format->mimeType.c_str();
+}
+
+media_status_t AMediaFormat_delete(AMediaFormat *format) {
+    delete format;
+    return AMEDIA_OK;
+}
+
+// Extractor
+
+struct AMediaExtractor{
+    size_t packetIndex = 0;
+    std::vector<int64_t> packetTimesUs;
+};
+
+AMediaExtractor *AMediaExtractor_new() {
+    auto extractor = new AMediaExtractor();
+    int64_t frame = 0;
+    for (const auto &packet : sTrack.packets){
+        extractor->packetTimesUs.push_back(frame * 1000000 / sTrack.sampleRate);
+        frame += packet.size() / sTrack.channelCount;
+    }
+    return extractor;
+}
+
+media_status_t AMediaExtractor_delete(AMediaExtractor *extractor) {
+    delete extractor;
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaExtractor_setDataSourceFd(AMediaExtractor *, int fd, off64_t, off64_t) {
+    return (fd >= 0) ? AMEDIA_OK : AMEDIA_ERROR_UNKNOWN;
+}
+
+AMediaFormat *AMediaExtractor_getTrackFormat(AMediaExtractor *, size_t) {
+    auto format = new AMediaFormat();
+    format->mimeType = kMockMimeType;
+    format->values[AMEDIAFORMAT_KEY_SAMPLE_RATE] = sTrack.sampleRate;
+    format->values[AMEDIAFORMAT_KEY_CHANNEL_COUNT] = sTrack.channelCount;
+    if (sTrack.encoderDelay != 0) format->values["encoder-delay"] = sTrack.encoderDelay;
+    if (sTrack.encoderPadding != 0) format->values["encoder-padding"] = sTrack.encoderPadding;
+    return format;
+}
+
+media_status_t AMediaExtractor_selectTrack(AMediaExtractor *, size_t) {
+    return AMEDIA_OK;
+}
+
+ssize_t AMediaExtractor_readSampleData(AMediaExtractor *extractor, uint8_t *buffer, size_t capacity) {
+    if (extractor->packetIndex >= sTrack.packets.size()) return -1;
+    const auto &packet = sTrack.packets[extractor->packetIndex];
+    const size_t size = packet.size() * sizeof(int16_t);
+    if (size > capacity) return -1;
+    memcpy(buffer, packet.data(), size);
+    return size;
+}
+
+int64_t AMediaExtractor_getSampleTime(AMediaExtractor *extractor) {
+    if (extractor->packetIndex >= sTrack.packets.size()) return -1;
+    return extractor->packetTimesUs[extractor->packetIndex];
+}
+
+bool AMediaExtractor_advance(AMediaExtractor *extractor) {
+    if (extractor->packetIndex >= sTrack.packets.size()) return false;
+    ++extractor->packetIndex;
+    return extractor->packetIndex < sTrack.packets.size();
+}
+
+media_status_t AMediaExtractor_seekTo(AMediaExtractor *extractor, int64_t seekPosUs, SeekMode) {
+    // every packet is a sync sample
+    extractor->packetIndex = 0;
+    while (extractor->packetIndex + 1 < extractor->packetTimesUs.size() &&
+           extractor->packetTimesUs[extractor->packetIndex + 1] <= seekPosUs){
+        ++extractor->packetIndex;
+    }
+    return AMEDIA_OK;
+}
+
+// Codec
+
+struct QueuedInput{
+    size_t inputIndex;
+    AMediaCodecBufferInfo info;
+};
+
+struct AMediaCodec{
+    std::mutex lock;
+    std::condition_variable changed;
+
+    std::vector<std::vector<uint8_t>> inputBuffers;
+    std::vector<bool> isInputFree;
+    std::vector<std::vector<uint8_t>> outputBuffers;
+    std::vector<bool> isOutputFree;
+
+    // queued input which hasn't been decoded yet, oldest first
+    std::deque<QueuedInput> pipeline;
+    bool isEndOfStreamQueued = false;
+    std::deque<std::pair<size_t, AMediaCodecBufferInfo>> readyOutputs;
+    bool isFormatReported = false;
+
+    // Moves input through the pipeline into free output buffers, with the lock held
+    void decode() {
+        while (!pipeline.empty() &&
+               (isEndOfStreamQueued || static_cast<int32_t>(pipeline.size()) > sTrack.latencyPackets)){
+            size_t outputIndex = 0;
+            while (outputIndex < isOutputFree.size() && !isOutputFree[outputIndex]) ++outputIndex;
+            if (outputIndex == isOutputFree.size()) return;
+
+            const QueuedInput input = pipeline.front();
+            pipeline.pop_front();
+            outputBuffers[outputIndex].assign(inputBuffers[input.inputIndex].begin(),
+                                              inputBuffers[input.inputIndex].begin() + input.info.size);
+            isOutputFree[outputIndex] = false;
+            isInputFree[input.inputIndex] = true;
+            readyOutputs.emplace_back(outputIndex, input.info);
+        }
+    }
+
+    template <typename Predicate>
+    bool waitFor(std::unique_lock<std::mutex> &locked, int64_t timeoutUs, Predicate isReady) {
+        if (timeoutUs < 0){
+            changed.wait(locked, isReady);
+            return true;
+        }
+        return changed.wait_for(locked, std::chrono::microseconds(timeoutUs), isReady);
+    }
+};
+
+AMediaCodec *AMediaCodec_createDecoderByType(const char *mimeType) {
+    if (strcmp(mimeType, kMockMimeType) != 0) return nullptr;
+    size_t maxPacketBytes = 0;
+    for (const auto &packet : sTrack.packets) maxPacketBytes = std::max(maxPacketBytes, packet.size() * sizeof(int16_t));
+
+    auto codec = new AMediaCodec();
+    codec->inputBuffers.assign(sTrack.numInputBuffers, std::vector<uint8_t>(maxPacketBytes));
+    codec->isInputFree.assign(sTrack.numInputBuffers, true);
+    codec->outputBuffers.resize(sTrack.numOutputBuffers);
+    codec->isOutputFree.assign(sTrack.numOutputBuffers, true);
+    std::lock_guard<std::mutex> lock(sStatsLock);
+    ++sStats.openCodecs;
+    return codec;
+}
+
+media_status_t AMediaCodec_configure(AMediaCodec *, const AMediaFormat *, void *, void *, uint32_t) {
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaCodec_start(AMediaCodec *) {
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaCodec_stop(AMediaCodec *) {
+    return AMEDIA_OK;
+}
+
+media_status_t AMediaCodec_delete(AMediaCodec *codec) {
+    delete codec;
+    std::lock_guard<std::mutex> lock(sStatsLock);
+    --sStats.openCodecs;
+    return AMEDIA_OK;
+}
+
+ssize_t AMediaCodec_dequeueInputBuffer(AMediaCodec *codec, int64_t timeoutUs) {
+    countDequeue(timeoutUs);
+    std::unique_lock<std::mutex> lock(codec->lock);
+    auto hasFreeInput = [codec](){
+        for (bool isFree : codec->isInputFree) if (isFree) return true;
+        return false;
+    };
+    if (!codec->waitFor(lock, timeoutUs, hasFreeInput)) return AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+
+    size_t index = 0;
+    while (!codec->isInputFree[index]) ++index;
+    codec->isInputFree[index] = false;
+    return index;
+}
+
+uint8_t *AMediaCodec_getInputBuffer(AMediaCodec *codec, size_t index, size_t *outSize) {
+    std::lock_guard<std::mutex> lock(codec->lock);
+    *outSize = codec->inputBuffers[index].size();
+    return codec->inputBuffers[index].data();
+}
+
+media_status_t AMediaCodec_queueInputBuffer(AMediaCodec *codec, size_t index, off_t offset, size_t size,
+                                            uint64_t time, uint32_t flags) {
+    {
+        std::lock_guard<std::mutex> lock(codec->lock);
+        AMediaCodecBufferInfo info{0, static_cast<int32_t>(size), static_cast<int64_t>(time), flags};
+        if (offset != 0) memmove(codec->inputBuffers[index].data(), codec->inputBuffers[index].data() + offset, size);
+        codec->pipeline.push_back(QueuedInput{index, info});
+        if (flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) codec->isEndOfStreamQueued = true;
+        codec->decode();
+    }
+    codec->changed.notify_all();
+    std::lock_guard<std::mutex> lock(sStatsLock);
+    ++sStats.inputBuffersQueued;
+    return AMEDIA_OK;
+}
+
+ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec *codec, AMediaCodecBufferInfo *info, int64_t timeoutUs) {
+    countDequeue(timeoutUs);
+    std::unique_lock<std::mutex> lock(codec->lock);
+    // a real codec reports its output format first
+    if (!codec->isFormatReported){
+        codec->isFormatReported = true;
+        return AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED;
+    }
+    if (!codec->waitFor(lock, timeoutUs, [codec](){ return !codec->readyOutputs.empty(); })){
+        return AMEDIACODEC_INFO_TRY_AGAIN_LATER;
+    }
+
+    const auto output = codec->readyOutputs.front();
+    codec->readyOutputs.pop_front();
+    *info = output.second;
+    return output.first;
+}
+
+uint8_t *AMediaCodec_getOutputBuffer(AMediaCodec *codec, size_t index, size_t *outSize) {
+    std::lock_guard<std::mutex> lock(codec->lock);
+    *outSize = codec->outputBuffers[index].size();
+    return codec->outputBuffers[index].data();
+}
+
+media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec *codec, size_t index, bool) {
+    {
+        std::lock_guard<std::mutex> lock(codec->lock);
+        codec->isOutputFree[index] = true;
+        codec->decode();
+    }
+    codec->changed.notify_all();
+    std::lock_guard<std::mutex> lock(sStatsLock);
+    ++sStats.outputBuffersReleased;
+    return AMEDIA_OK;
+}
@@ -0,0 +1,47 @@
+//
+// Created by 43975 on 2/3/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_MOCKMEDIACODEC_H
+#define OBOE_AUDIO_PLAYER_MOCKMEDIACODEC_H
+
+#include <cstdint>
+#include <vector>
+#include <media/NdkMediaExtractor.h>
+
+constexpr const char *kMockMimeType = "audio/mock";
+
+/**
+ * What the mock extractor serves for any file. The packets are int16 PCM already, the mock codec
+ * "decodes" them by copying them into its output buffers, holding back latencyPackets packets
+ * until the end of stream like the pipeline of a real decoder.
+ */
+struct MockMediaTrack{
+    int32_t sampleRate = 48000;
+    int32_t channelCount = 2;
+    std::vector<std::vector<int16_t>> packets;
+    // reported under the "encoder-delay" and "encoder-padding" keys if not 0
+    int32_t encoderDelay = 0;
+    int32_t encoderPadding = 0;
+    // keep it below numInputBuffers or the codec starves
+    int32_t latencyPackets = 2;
+    int32_t numInputBuffers = 4;
+    int32_t numOutputBuffers = 4;
+};
+
+struct MockMediaStats{
+    // dequeue calls with a zero timeout, which is polling
+    int32_t zeroTimeoutDequeues = 0;
+    int32_t inputBuffersQueued = 0;
+    int32_t outputBuffersReleased = 0;
+    // codecs still alive
+    int32_t openCodecs = 0;
+};
+
+/**
+ * Replaces the track and resets the stats. Not thread safe, call it between decodes.
+ */
+void MockMedia_setTrack(const MockMediaTrack &track);
+MockMediaStats MockMedia_getStats();
+
+#endif //OBOE_AUDIO_PLAYER_MOCKMEDIACODEC_H
@@ -0,0 +1,36 @@
+//
+// Created by 43975 on 1/30/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_HOST_ANDROID_ASSET_MANAGER_H
+#define OBOE_AUDIO_PLAYER_HOST_ANDROID_ASSET_MANAGER_H
+
+#include <sys/types.h>
+#include <cstddef>
+
+// Host stand-in for the part of the NDK asset manager the engine uses. Assets are plain files
+// under the directory the manager is created with, see HostAssetManager.h.
+
+typedef struct AAssetManager AAssetManager;
+typedef struct AAsset AAsset;
+
+enum{
+    AASSET_MODE_UNKNOWN = 0,
+    AASSET_MODE_RANDOM = 1,
+    AASSET_MODE_STREAMING = 2,
+    AASSET_MODE_BUFFER = 3
+};
+
+extern "C" {
+AAsset *AAssetManager_open(AAssetManager *mgr, const char *filename, int mode);
+void AAsset_close(AAsset *asset);
+int AAsset_read(AAsset *asset, void *buf, size_t count);
+off_t AAsset_seek(AAsset *asset, off_t offset, int whence);
+off_t AAsset_getLength(AAsset *asset);
+off64_t AAsset_getLength64(AAsset *asset);
+off_t AAsset_getRemainingLength(AAsset *asset);
+const void *AAsset_getBuffer(AAsset *asset);
+int AAsset_openFileDescriptor(AAsset *asset, off_t *outStart, off_t *outLength);
+}
+
+#endif //OBOE_AUDIO_PLAYER_HOST_ANDROID_ASSET_MANAGER_H
@@ -0,0 +1,24 @@
+//
+// Created by 43975 on 1/30/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_HOST_ANDROID_LOG_H
+#define OBOE_AUDIO_PLAYER_HOST_ANDROID_LOG_H
+
+// Host stand-in for the NDK log, warnings and errors go to stderr
+
+enum android_LogPriority{
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT
+};
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt, ...);
+
+#endif //OBOE_AUDIO_PLAYER_HOST_ANDROID_LOG_H
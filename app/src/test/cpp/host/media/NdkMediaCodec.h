@@ -0,0 +1,48 @@
+//
+// Created by 43975 on 2/3/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIACODEC_H
+#define OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIACODEC_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include "NdkMediaFormat.h"
+
+typedef struct AMediaCodec AMediaCodec;
+
+struct AMediaCodecBufferInfo{
+    int32_t offset;
+    int32_t size;
+    int64_t presentationTimeUs;
+    uint32_t flags;
+};
+
+enum{
+    AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM = 4
+};
+
+enum{
+    AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED = -3,
+    AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED = -2,
+    AMEDIACODEC_INFO_TRY_AGAIN_LATER = -1
+};
+
+extern "C" {
+AMediaCodec *AMediaCodec_createDecoderByType(const char *mimeType);
+media_status_t AMediaCodec_configure(AMediaCodec *codec, const AMediaFormat *format, void *surface,
+                                     void *crypto, uint32_t flags);
+media_status_t AMediaCodec_start(AMediaCodec *codec);
+media_status_t AMediaCodec_stop(AMediaCodec *codec);
+media_status_t AMediaCodec_delete(AMediaCodec *codec);
+ssize_t AMediaCodec_dequeueInputBuffer(AMediaCodec *codec, int64_t timeoutUs);
+uint8_t *AMediaCodec_getInputBuffer(AMediaCodec *codec, size_t index, size_t *outSize);
+media_status_t AMediaCodec_queueInputBuffer(AMediaCodec *codec, size_t index, off_t offset, size_t size,
+                                            uint64_t time, uint32_t flags);
+ssize_t AMediaCodec_dequeueOutputBuffer(AMediaCodec *codec, AMediaCodecBufferInfo *info, int64_t timeoutUs);
+uint8_t *AMediaCodec_getOutputBuffer(AMediaCodec *codec, size_t index, size_t *outSize);
+media_status_t AMediaCodec_releaseOutputBuffer(AMediaCodec *codec, size_t index, bool render);
+}
+
+#endif //OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIACODEC_H
@@ -0,0 +1,34 @@
+//
+// Created by 43975 on 2/3/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIAEXTRACTOR_H
+#define OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIAEXTRACTOR_H
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include "NdkMediaCodec.h"
+#include "NdkMediaFormat.h"
+
+typedef struct AMediaExtractor AMediaExtractor;
+
+typedef enum{
+    AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC,
+    AMEDIAEXTRACTOR_SEEK_NEXT_SYNC,
+    AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC
+} SeekMode;
+
+extern "C" {
+AMediaExtractor *AMediaExtractor_new();
+media_status_t AMediaExtractor_delete(AMediaExtractor *extractor);
+media_status_t AMediaExtractor_setDataSourceFd(AMediaExtractor *extractor, int fd, off64_t offset, off64_t length);
+AMediaFormat *AMediaExtractor_getTrackFormat(AMediaExtractor *extractor, size_t index);
+media_status_t AMediaExtractor_selectTrack(AMediaExtractor *extractor, size_t index);
+ssize_t AMediaExtractor_readSampleData(AMediaExtractor *extractor, uint8_t *buffer, size_t capacity);
+int64_t AMediaExtractor_getSampleTime(AMediaExtractor *extractor);
+bool AMediaExtractor_advance(AMediaExtractor *extractor);
+media_status_t AMediaExtractor_seekTo(AMediaExtractor *extractor, int64_t seekPosUs, SeekMode mode);
+}
+
+#endif //OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIAEXTRACTOR_H
@@ -0,0 +1,33 @@
+//
+// Created by 43975 on 2/3/2022.
+//
+
+#ifndef OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIAFORMAT_H
+#define OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIAFORMAT_H
+
+#include <sys/types.h>
+#include <cstdint>
+
+// Host stand-in for the part of the NDK media API the NDK decoder uses, backed by the mock
+// codec in MockMediaCodec.h
+
+typedef int32_t media_status_t;
+enum{
+    AMEDIA_OK = 0,
+    AMEDIA_ERROR_UNKNOWN = -10000
+};
+
+typedef struct AMediaFormat AMediaFormat;
+
+extern "C" {
+extern const char *AMEDIAFORMAT_KEY_SAMPLE_RATE;
+extern const char *AMEDIAFORMAT_KEY_CHANNEL_COUNT;
+extern const char *AMEDIAFORMAT_KEY_MIME;
+
+bool AMediaFormat_getInt32(AMediaFormat *format, const char *name, int32_t *out);
+bool AMediaFormat_getString(AMediaFormat *format, const char *name, const char **out);
+const char *AMediaFormat_toString(AMediaFormat *format);
+media_status_t AMediaFormat_delete(AMediaFormat *format);
+}
+
+#endif //OBOE_AUDIO_PLAYER_HOST_MEDIA_NDKMEDIAFORMAT_H